@@ -0,0 +1,97 @@
+from __future__ import annotations
+
+import argparse
+import json
+import math
+import shutil
+import sys
+from pathlib import Path
+
+
+# Compares a micro_benchmarks --json run against a stored baseline and flags regressions.
+DEFAULT_BASELINE = Path(__file__).resolve().parent / "baseline.json"
+CONTEXT_KEYS = ("host", "compiler", "assertions", "hardware_threads")
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Flag micro benchmark regressions against a stored baseline.")
+    parser.add_argument("current", type=Path, help="micro_benchmarks --json output")
+    parser.add_argument("--baseline", type=Path, default=DEFAULT_BASELINE)
+    parser.add_argument("--threshold", type=float, default=0.05, help="smallest relative slowdown reported (0.05 = 5%%)")
+    parser.add_argument(
+        "--mad-factor",
+        type=float,
+        default=3.0,
+        help="a change must also exceed this many standard errors of the difference of the two medians",
+    )
+    parser.add_argument("--save", action="store_true", help="store the current run as the baseline instead of comparing")
+    return parser.parse_args()
+
+
+def load(path: Path) -> dict:
+    with path.open() as handle:
+      data = json.load(handle)
+    if data.get("schema") != 1:
+      raise ValueError(f"{path}: unsupported schema {data.get('schema')}")
+    return data
+
+
+def median_error(entry: dict) -> float:
+    # Relative standard error of the median, estimating sigma from the MAD as for a normal distribution.
+    if entry["median_ns"] <= 0 or not entry["samples_ns"]:
+      return 0.0
+    sigma = 1.4826 * entry["mad_ns"] / entry["median_ns"]
+    return 1.2533 * sigma / math.sqrt(len(entry["samples_ns"]))
+
+
+def compare(baseline: dict, current: dict, threshold: float, mad_factor: float) -> int:
+    for key in CONTEXT_KEYS:
+      before = baseline["context"].get(key)
+      after = current["context"].get(key)
+      if before != after:
+        print(f"warning: {key} differs from the baseline ({before} -> {after}); timings may not be comparable")
+
+    base = {entry["name"]: entry for entry in baseline["benchmarks"]}
+    regressions = 0
+    print(f"{'benchmark':40} {'baseline':>12} {'current':>12} {'change':>8} {'noise':>7}")
+    for entry in current["benchmarks"]:
+      name = entry["name"]
+      if name not in base:
+        print(f"{name:40} {'-':>12} {entry['ns_per_item']:12.3f} {'new':>8}")
+        continue
+      before = base.pop(name)
+      change = entry["median_ns"] / before["median_ns"] - 1.0 if before["median_ns"] > 0 else 0.0
+      noise = mad_factor * math.hypot(median_error(before), median_error(entry))
+      tolerance = max(threshold, noise)
+      verdict = ""
+      if change > tolerance:
+        verdict = "REGRESSION"
+        regressions += 1
+      elif change < -tolerance:
+        verdict = "improved"
+      print(
+          f"{name:40} {before['ns_per_item']:12.3f} {entry['ns_per_item']:12.3f} {100 * change:+7.1f}% "
+          f"{100 * noise:6.1f}% {verdict}"
+      )
+    for name in base:
+      print(f"{name:40} missing from the current run")
+    unit_note = "times are ns per item (sample, string, pixel...)"
+    print(f"{regressions} regression(s); {unit_note}")
+    return 1 if regressions else 0
+
+
+def main() -> int:
+    args = parse_args()
+    if args.save:
+      load(args.current)
+      shutil.copyfile(args.current, args.baseline)
+      print(f"stored {args.current} as {args.baseline}")
+      return 0
+    if not args.baseline.is_file():
+      print(f"no baseline at {args.baseline}; store one with --save", file=sys.stderr)
+      return 2
+    return compare(load(args.baseline), load(args.current), args.threshold, args.mad_factor)
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
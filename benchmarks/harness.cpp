@@ -0,0 +1,174 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "benchmarks/harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+namespace bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const std::size_t middle = values.size() / 2U;
+  return values.size() % 2U == 1U ? values[middle] : (values[middle - 1U] + values[middle]) / 2.0;
+}
+
+double TimeIterations(const Suite::Body &body, uint64_t iterations) {
+  const auto start = Clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    body();
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Iterations for one repetition to last min_time_ms, growing at most tenfold per trial.
+uint64_t Calibrate(const Suite::Body &body, double min_time_ms) {
+  const double target_ns = min_time_ms * 1e6;
+  uint64_t iterations = 1;
+  while (true) {
+    const double elapsed = TimeIterations(body, iterations);
+    if (elapsed >= target_ns) {
+      return iterations;
+    }
+    const double wanted = 1.2 * target_ns / std::max(elapsed, 1.0) * static_cast<double>(iterations);
+    iterations = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(wanted)), iterations + 1U, iterations * 10U);
+  }
+}
+
+std::string Escape(std::string_view text) {
+  std::string escaped;
+  for (const char character : text) {
+    if (character == '"' || character == '\\') {
+      escaped += '\\';
+    }
+    escaped += static_cast<unsigned char>(character) < 0x20U ? ' ' : character;
+  }
+  return escaped;
+}
+
+std::string Hostname() {
+  char name[256] = {};
+  return gethostname(name, sizeof(name) - 1U) == 0 ? std::string(name) : std::string("unknown");
+}
+
+std::string UtcNow() {
+  const std::time_t now = std::time(nullptr);
+  std::tm utc{};
+  gmtime_r(&now, &utc);
+  std::ostringstream out;
+  out << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ");
+  return out.str();
+}
+
+} // namespace
+
+void Suite::Add(std::string name, std::string unit, uint64_t items, Body body) {
+  entries.push_back(Entry{std::move(name), std::move(unit), items, std::move(body)});
+}
+
+std::vector<std::string> Suite::Names() const {
+  std::vector<std::string> names;
+  for (const auto &entry : entries) {
+    names.push_back(entry.name);
+  }
+  return names;
+}
+
+std::vector<Result> Suite::Run(const RunOptions &options, std::ostream &out) const {
+  std::vector<Result> results;
+  for (const auto &entry : entries) {
+    if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    Result result;
+    result.name = entry.name;
+    result.unit = entry.unit;
+    result.items = entry.items;
+    result.iterations = Calibrate(entry.body, options.min_time_ms);
+    for (std::size_t i = 0; i < options.warmup; ++i) {
+      TimeIterations(entry.body, result.iterations);
+    }
+    for (std::size_t i = 0; i < std::max<std::size_t>(options.repetitions, 1U); ++i) {
+      result.ns.push_back(TimeIterations(entry.body, result.iterations) / static_cast<double>(result.iterations));
+    }
+    result.median_ns = Median(result.ns);
+    std::vector<double> deviations;
+    for (const double value : result.ns) {
+      deviations.push_back(std::abs(value - result.median_ns));
+    }
+    result.mad_ns = Median(deviations);
+    const auto [min_it, max_it] = std::minmax_element(result.ns.begin(), result.ns.end());
+    result.min_ns = *min_it;
+    result.max_ns = *max_it;
+    const double mad_percent = result.median_ns > 0.0 ? 100.0 * result.mad_ns / result.median_ns : 0.0;
+    out << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(14) << result.median_ns << " ns  +/- " << std::setw(5) << std::setprecision(2) << mad_percent
+        << "%  " << std::setw(10) << std::setprecision(3) << result.NsPerItem() << " ns/" << result.unit << std::endl;
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+void WriteJson(const std::vector<Result> &results, const RunOptions &options, const std::string &file_name) {
+  std::ofstream out(file_name, std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Unable to write " + file_name);
+  }
+  out << std::setprecision(17);
+  out << "{\n  \"schema\": 1,\n  \"context\": {\n"
+      << "    \"date\": \"" << UtcNow() << "\",\n"
+      << "    \"host\": \"" << Escape(Hostname()) << "\",\n"
+      << "    \"compiler\": \"" << Escape(__VERSION__) << "\",\n"
+#ifdef NDEBUG
+      << "    \"assertions\": false,\n"
+#else
+      << "    \"assertions\": true,\n"
+#endif
+      << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+      << "    \"warmup\": " << options.warmup << ",\n"
+      << "    \"repetitions\": " << options.repetitions << ",\n"
+      << "    \"min_time_ms\": " << options.min_time_ms << "\n  },\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto &result = results[i];
+    out << (i == 0U ? "\n" : ",\n") << "    {\"name\": \"" << Escape(result.name) << "\", \"unit\": \""
+        << Escape(result.unit) << "\", \"items\": " << result.items << ", \"iterations\": " << result.iterations
+        << ", \"median_ns\": " << result.median_ns << ", \"mad_ns\": " << result.mad_ns << ", \"min_ns\": "
+        << result.min_ns << ", \"max_ns\": " << result.max_ns << ", \"ns_per_item\": " << result.NsPerItem()
+        << ", \"samples_ns\": [";
+    for (std::size_t j = 0; j < result.ns.size(); ++j) {
+      out << (j == 0U ? "" : ", ") << result.ns[j];
+    }
+    out << "]}";
+  }
+  out << "\n  ]\n}\n";
+  out.close();
+  if (!out) {
+    throw std::runtime_error("Unable to write " + file_name);
+  }
+}
+
+} // namespace bench
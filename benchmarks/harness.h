@@ -0,0 +1,88 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * harness.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef BENCHMARKS_HARNESS_H_
+#define BENCHMARKS_HARNESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Keeps the compiler from discarding a result the benchmark never reads.
+template <typename T> inline void DoNotOptimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+struct RunOptions {
+  std::size_t warmup = 3;       // Untimed repetitions first, after calibration.
+  std::size_t repetitions = 15; // Timed repetitions; the statistics are over these.
+  double min_time_ms = 50.0;    // Each repetition runs enough iterations to last at least this long.
+  std::string filter;           // Only benchmarks whose name contains it.
+};
+
+struct Result {
+  std::string name;
+  std::string unit;            // What one item is, e.g. "sample".
+  uint64_t items = 0;          // Items per iteration.
+  uint64_t iterations = 0;     // Per repetition.
+  std::vector<double> ns;      // Per iteration, one entry per timed repetition.
+  double median_ns = 0.0;
+  double mad_ns = 0.0;         // Median absolute deviation from median_ns.
+  double min_ns = 0.0;
+  double max_ns = 0.0;
+
+  double NsPerItem() const { return items == 0U ? 0.0 : median_ns / static_cast<double>(items); }
+};
+
+/*
+ * Benchmarks registered by name and run in registration order. A benchmark
+ * body is one iteration; setup belongs outside it, in the registering code.
+ */
+class Suite {
+public:
+  using Body = std::function<void()>;
+
+  void Add(std::string name, std::string unit, uint64_t items, Body body);
+  std::vector<std::string> Names() const;
+
+  /*
+   * Calibrates, warms up and times every matching benchmark, printing one line
+   * per benchmark to out as it finishes.
+   * @parameters options, progress output
+   * @returns one result per benchmark run
+   */
+  std::vector<Result> Run(const RunOptions &options, std::ostream &out) const;
+
+private:
+  struct Entry {
+    std::string name;
+    std::string unit;
+    uint64_t items;
+    Body body;
+  };
+  std::vector<Entry> entries;
+};
+
+/*
+ * Writes results with the options and build they came from, for
+ * benchmarks/compare.py. Throws std::runtime_error when the file cannot be written.
+ * @parameters results, options, file name
+ */
+void WriteJson(const std::vector<Result> &results, const RunOptions &options, const std::string &file_name);
+
+} // namespace bench
+
+#endif // BENCHMARKS_HARNESS_H_
@@ -0,0 +1,216 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * micro_benchmarks.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "benchmarks/harness.h"
+#include "include/common.h"
+#include "include/filereader.h"
+#include "include/filewriter.h"
+#include "instrument/instrument_model.h"
+#include "instrument/string_oscillator.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: micro_benchmarks [options]\n"
+            << "-h --help\n"
+            << "--list (print the benchmark names)\n"
+            << "--filter <text> (only benchmarks whose name contains it)\n"
+            << "--warmup <3> (untimed repetitions)\n"
+            << "--repetitions <15> (timed repetitions; median and MAD are over these)\n"
+            << "--min-time-ms <50> (shortest repetition)\n"
+            << "--json <file> (write the results for benchmarks/compare.py)\n"
+            << std::endl;
+}
+
+namespace {
+
+constexpr uint32_t k_seed = 20261019;
+constexpr std::size_t k_note_samples = 4096;
+constexpr double k_note = 220.0;
+constexpr double k_velocity = 0.8;
+
+// The same strings on every run, scaled so the sum stays within full scale.
+std::shared_ptr<instrument::InstrumentModel> MakeInstrument(std::size_t strings) {
+  auto model = std::make_shared<instrument::InstrumentModel>(0, "bench" + std::to_string(strings));
+  std::mt19937 engine(k_seed);
+  for (std::size_t i = 0; i < strings; ++i) {
+    model->AddUntunedString(i % 4U != 3U, engine, 0.0, 1.0);
+  }
+  model->AmendGain(1.0 / static_cast<double>(strings));
+  return model;
+}
+
+void AddOscillatorBenchmarks(bench::Suite &suite) {
+  auto model = MakeInstrument(1);
+  auto sound_string = std::shared_ptr<instrument::oscillator::StringOccilator>(
+      instrument::oscillator::StringOccilator::CreateStringFromRecord(model->ToRecords().front()));
+  suite.Add("string/next_sample", "sample", k_note_samples, [sound_string]() {
+    sound_string->PrimeString(k_note, k_velocity);
+    double sum = 0.0;
+    for (std::size_t i = 0; i < k_note_samples; ++i) {
+      sum += sound_string->NextSample();
+    }
+    bench::DoNotOptimize(sum);
+  });
+
+  for (const std::size_t strings : {1U, 10U, 100U, 1000U}) {
+    auto instrument = MakeInstrument(strings);
+    const uint64_t string_samples = strings * k_note_samples;
+    suite.Add("model/generate_signal/" + std::to_string(strings), "string-sample", string_samples, [instrument]() {
+      const auto signal = instrument->GenerateSignal(k_velocity, k_note, k_note_samples);
+      bench::DoNotOptimize(signal.data());
+    });
+    auto out = std::make_shared<std::vector<int16_t>>(k_note_samples);
+    suite.Add("model/generate_int_signal/" + std::to_string(strings), "string-sample", string_samples,
+              [instrument, out]() {
+                bool has_distorted = false;
+                bench::DoNotOptimize(instrument->GenerateIntSignal(k_velocity, k_note, *out, has_distorted, false));
+                bench::DoNotOptimize(out->data());
+              });
+  }
+}
+
+void AddCsvBenchmarks(bench::Suite &suite) {
+  constexpr std::size_t strings = 100;
+  auto model = MakeInstrument(strings);
+  suite.Add("csv/instrument_to_csv/100", "string", strings, [model]() {
+    const auto csv = model->ToCsv();
+    bench::DoNotOptimize(csv.data());
+  });
+  auto lines = std::make_shared<std::vector<std::string>>();
+  for (const auto &record : model->ToRecords()) {
+    lines->push_back(instrument::oscillator::StringOccilator::CreateStringFromRecord(record)->ToCsv());
+  }
+  suite.Add("csv/create_string_from_csv", "string", strings, [lines]() {
+    for (const auto &line : *lines) {
+      const auto parsed = instrument::oscillator::StringOccilator::CreateStringFromCsv(line);
+      bench::DoNotOptimize(parsed.get());
+    }
+  });
+}
+
+void AddFileBenchmarks(bench::Suite &suite, const std::filesystem::path &directory) {
+  constexpr std::size_t seconds = 5;
+  auto samples = std::make_shared<std::vector<int16_t>>(seconds * SAMPLE_RATE);
+  for (std::size_t i = 0; i < samples->size(); ++i) {
+    const double phase = 2.0 * std::numbers::pi * k_note * static_cast<double>(i) / SAMPLE_RATE;
+    (*samples)[i] = static_cast<int16_t>(16000.0 * std::sin(phase));
+  }
+  const std::string wave_path = (directory / "read.wav").string();
+  filewriter::wave::MonoWriter(*samples).Write(wave_path);
+  suite.Add("wave/reader_load_mono_float", "sample", samples->size(), [wave_path]() {
+    const filereader::wave::WaveReaderC reader(wave_path);
+    const auto mono = reader.ToMonoFloatWave();
+    bench::DoNotOptimize(mono.data());
+  });
+  const std::string write_path = (directory / "write.wav").string();
+  suite.Add("wave/mono_writer_write", "sample", samples->size(),
+            [samples, write_path]() { filewriter::wave::MonoWriter(*samples).Write(write_path); });
+
+  // About the size of a feature spectrogram.
+  auto image = std::make_shared<filewriter::image::Image>(1024, 256);
+  for (std::size_t row = 0; row < image->Height(); ++row) {
+    for (std::size_t col = 0; col < image->Width(); ++col) {
+      image->At(col, row) = static_cast<float>((col * 7U + row * 13U) % 1024U) / 1023.0F;
+    }
+  }
+  const uint64_t pixels = image->Width() * image->Height();
+  const std::string ppm_path = (directory / "image.ppm").string();
+  suite.Add("image/ppm_write_inferno", "pixel", pixels,
+            [image, ppm_path]() { filewriter::ppm::Write(*image, ppm_path, ColorScaleType::INFERNO); });
+  const std::string bmp_path = (directory / "image.bmp").string();
+  suite.Add("image/bmp_write_inferno", "pixel", pixels,
+            [image, bmp_path]() { filewriter::bmp::Write(*image, bmp_path, ColorScaleType::INFERNO); });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bench::RunOptions options;
+  std::string json_file;
+  bool list = false;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    if (arg == "--list") {
+      list = true;
+      continue;
+    }
+    if (((arg == "--filter") || (arg == "--warmup") || (arg == "--repetitions") || (arg == "--min-time-ms") ||
+         (arg == "--json")) &&
+        (i + 1 < argc)) {
+      const std::string arg2 = argv[++i];
+      try {
+        if (arg == "--filter") {
+          options.filter = arg2;
+        } else if (arg == "--warmup") {
+          options.warmup = std::stoul(arg2);
+        } else if (arg == "--repetitions") {
+          options.repetitions = std::stoul(arg2);
+        } else if (arg == "--min-time-ms") {
+          options.min_time_ms = std::stod(arg2);
+        } else {
+          json_file = arg2;
+        }
+      } catch (const std::logic_error &) {
+        std::cerr << "Invalid value for " << arg << ": " << arg2 << std::endl;
+        return EXIT_BAD_ARGS;
+      }
+      continue;
+    }
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  const auto directory = std::filesystem::temp_directory_path() / ("soundlearner_bench_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+  bench::Suite suite;
+  AddOscillatorBenchmarks(suite);
+  AddCsvBenchmarks(suite);
+  AddFileBenchmarks(suite, directory);
+  if (list) {
+    for (const auto &name : suite.Names()) {
+      std::cout << name << "\n";
+    }
+    std::filesystem::remove_all(directory);
+    return EXIT_NORMAL;
+  }
+
+  int exit_code = EXIT_NORMAL;
+  try {
+    const auto results = suite.Run(options, std::cout);
+    if (!json_file.empty()) {
+      bench::WriteJson(results, options, json_file);
+      std::cout << "wrote " << json_file << std::endl;
+    }
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    exit_code = EXIT_WRITE_FILE_FAILED;
+  }
+  std::filesystem::remove_all(directory);
+  return exit_code;
+}
@@ -0,0 +1,492 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * pipeline_benchmark.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "include/common.h"
+
+extern char **environ;
+
+static void AppUsage() {
+  std::cerr << "Usage: pipeline_benchmark [options]\n"
+            << "Runs dataset_builder over every combination of the lists below, on tmpfs and on disk.\n"
+            << "-h --help\n"
+            << "--builder <path> (dataset_builder; default: ../dataset_builder/dataset_builder beside this program)\n"
+            << "--samples <64> (samples per run)\n"
+            << "--instrument-sizes <10,50> (coupled oscillators)\n"
+            << "--uncoupled <0> (uncoupled oscillators)\n"
+            << "--sample-times <1> (seconds per sample)\n"
+            << "--threads <1,hw> (render threads; hw is the hardware thread count)\n"
+            << "--formats <wav,slac,shard> (loose WAV, loose SLAC or shard output)\n"
+            << "--features <none> (none or FxT specs, e.g. none,128x128,128x128+256x64; loose formats only)\n"
+            << "--targets <tmpfs,disk>\n"
+            << "--tmpfs-dir </dev/shm>\n"
+            << "--disk-dir <.> (somewhere on the disk being sized)\n"
+            << "--repetitions <1> (runs per configuration; the median by time is kept)\n"
+            << "--json <file> (write every configuration's measurements)\n"
+            << std::endl;
+}
+
+namespace {
+
+struct Config {
+  std::string target;
+  std::string format;
+  std::string features;
+  std::size_t instrument_size = 0;
+  std::size_t uncoupled = 0;
+  std::size_t sample_time = 0;
+  std::size_t threads = 0;
+
+  // Everything but the thread count, to group runs for scaling efficiency.
+  auto ScalingGroup() const { return std::tie(target, format, features, instrument_size, uncoupled, sample_time); }
+};
+
+struct Measurement {
+  Config config;
+  bool ok = false;
+  std::size_t samples = 0;
+  double wall_s = 0.0;        // The builder process, start to exit.
+  double sync_s = 0.0;        // syncfs afterwards, so disk runs pay for reaching the device.
+  double user_s = 0.0;
+  double system_s = 0.0;
+  uint64_t bytes = 0;         // Everything the run left in its output directory.
+  long max_rss_kb = 0;
+  double scaling_efficiency = 0.0;
+
+  double Seconds() const { return wall_s + sync_s; }
+  double SamplesPerSecond() const { return Seconds() > 0.0 ? static_cast<double>(samples) / Seconds() : 0.0; }
+  double MegabytesPerSecond() const { return Seconds() > 0.0 ? static_cast<double>(bytes) / 1e6 / Seconds() : 0.0; }
+  double CpuCores() const { return wall_s > 0.0 ? (user_s + system_s) / wall_s : 0.0; }
+  // Busy cores over render threads; the writer thread can take it past 1.
+  double Utilization() const { return config.threads == 0U ? 0.0 : CpuCores() / static_cast<double>(config.threads); }
+};
+
+struct Target {
+  std::string name;
+  std::filesystem::path directory;
+  std::string filesystem;
+};
+
+bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+std::vector<std::string> SplitList(std::string_view source) {
+  std::vector<std::string> items;
+  while (!source.empty()) {
+    const std::size_t comma = std::min(source.find(','), source.size());
+    if (comma > 0U) {
+      items.emplace_back(source.substr(0, comma));
+    }
+    source.remove_prefix(std::min(comma + 1, source.size()));
+  }
+  return items;
+}
+
+bool ParseSizeList(std::string_view source, std::vector<std::size_t> &out, bool allow_hw = false) {
+  out.clear();
+  for (const auto &item : SplitList(source)) {
+    std::size_t value = 0;
+    if (allow_hw && item == "hw") {
+      value = std::max(1U, std::thread::hardware_concurrency());
+    } else if (!ParseSize(item, value)) {
+      return false;
+    }
+    if (std::find(out.begin(), out.end(), value) == out.end()) {
+      out.push_back(value);
+    }
+  }
+  return !out.empty();
+}
+
+std::string FilesystemName(const std::filesystem::path &directory) {
+  struct statfs status {};
+  if (statfs(directory.c_str(), &status) != 0) {
+    return "unknown";
+  }
+  switch (static_cast<unsigned long>(status.f_type)) {
+  case TMPFS_MAGIC:
+    return "tmpfs";
+  case EXT4_SUPER_MAGIC:
+    return "ext4";
+  case XFS_SUPER_MAGIC:
+    return "xfs";
+  case BTRFS_SUPER_MAGIC:
+    return "btrfs";
+  case OVERLAYFS_SUPER_MAGIC:
+    return "overlay";
+  default: {
+    std::ostringstream name;
+    name << "0x" << std::hex << static_cast<unsigned long>(status.f_type);
+    return name.str();
+  }
+  }
+}
+
+uint64_t DirectoryBytes(const std::filesystem::path &directory) {
+  uint64_t bytes = 0;
+  for (const auto &entry : std::filesystem::recursive_directory_iterator(directory)) {
+    if (entry.is_regular_file()) {
+      bytes += entry.file_size();
+    }
+  }
+  return bytes;
+}
+
+std::vector<std::string> BuilderArguments(const std::string &builder, const Config &config, std::size_t samples,
+                                          const std::filesystem::path &output) {
+  // A fixed seed, so every configuration renders the same instruments.
+  std::vector<std::string> arguments = {builder, "-n", std::to_string(samples), "--seed", "1"};
+  for (const auto &[option, value] : {std::pair{"-s", config.instrument_size}, std::pair{"-c", config.uncoupled},
+                                      std::pair{"-t", config.sample_time}, std::pair{"-j", config.threads}}) {
+    arguments.insert(arguments.end(), {option, std::to_string(value)});
+  }
+  if (config.format == "shard") {
+    arguments.insert(arguments.end(), {"--shard-output", output.string()});
+  } else {
+    arguments.insert(arguments.end(), {"-d", (output / "data").string(), "--audio-format", config.format});
+  }
+  if (config.features != "none") {
+    std::string specs = config.features;
+    std::replace(specs.begin(), specs.end(), '+', ',');
+    arguments.insert(arguments.end(), {"--features", specs});
+  }
+  return arguments;
+}
+
+// Runs the builder once into a fresh directory, which is removed afterwards.
+Measurement RunOnce(const std::string &builder, const Config &config, std::size_t samples,
+                    const std::filesystem::path &work, std::ostream &errors) {
+  Measurement measurement;
+  measurement.config = config;
+  measurement.samples = samples;
+  const auto output = work / "output";
+  const auto log = work / "builder.log";
+  std::filesystem::remove_all(output);
+  std::filesystem::create_directories(output);
+
+  const auto arguments = BuilderArguments(builder, config, samples, output);
+  std::vector<char *> argv;
+  for (const auto &argument : arguments) {
+    argv.push_back(const_cast<char *>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  pid_t pid = 0;
+  const auto start = std::chrono::steady_clock::now();
+  const int spawned = posix_spawn(&pid, builder.c_str(), &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (spawned != 0) {
+    throw std::runtime_error("Unable to run " + builder + ": " + std::strerror(spawned));
+  }
+  int status = 0;
+  struct rusage usage {};
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      throw std::runtime_error(std::string("wait4 failed: ") + std::strerror(errno));
+    }
+  }
+  const auto exited = std::chrono::steady_clock::now();
+  const int directory_fd = open(output.c_str(), O_RDONLY | O_DIRECTORY);
+  if (directory_fd >= 0) {
+    syncfs(directory_fd);
+    close(directory_fd);
+  }
+  const auto synced = std::chrono::steady_clock::now();
+
+  measurement.wall_s = std::chrono::duration<double>(exited - start).count();
+  measurement.sync_s = std::chrono::duration<double>(synced - exited).count();
+  measurement.user_s = static_cast<double>(usage.ru_utime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec) / 1e6;
+  measurement.system_s = static_cast<double>(usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_stime.tv_usec) / 1e6;
+  measurement.max_rss_kb = usage.ru_maxrss;
+  measurement.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (measurement.ok) {
+    measurement.bytes = DirectoryBytes(output);
+  } else {
+    errors << "dataset_builder failed (status " << status << "):";
+    for (const auto &argument : arguments) {
+      errors << " " << argument;
+    }
+    errors << "\n";
+    std::ifstream builder_log(log);
+    std::string line;
+    std::vector<std::string> tail;
+    while (std::getline(builder_log, line)) {
+      tail.push_back(line);
+    }
+    for (std::size_t i = tail.size() > 5U ? tail.size() - 5U : 0U; i < tail.size(); ++i) {
+      errors << "  " << tail[i] << "\n";
+    }
+  }
+  std::filesystem::remove_all(output);
+  return measurement;
+}
+
+// Within each group of runs that differ only in threads, throughput per thread relative to the fewest threads.
+void ComputeScaling(std::vector<Measurement> &measurements) {
+  for (auto &measurement : measurements) {
+    const Measurement *base = nullptr;
+    for (const auto &other : measurements) {
+      if (other.ok && other.config.ScalingGroup() == measurement.config.ScalingGroup() &&
+          (base == nullptr || other.config.threads < base->config.threads)) {
+        base = &other;
+      }
+    }
+    if (measurement.ok && base != nullptr && base->SamplesPerSecond() > 0.0) {
+      const double per_thread = measurement.SamplesPerSecond() / static_cast<double>(measurement.config.threads);
+      const double base_per_thread = base->SamplesPerSecond() / static_cast<double>(base->config.threads);
+      measurement.scaling_efficiency = per_thread / base_per_thread;
+    }
+  }
+}
+
+void PrintTable(const std::vector<Measurement> &measurements, std::ostream &out) {
+  out << std::left << std::setw(7) << "target" << std::setw(7) << "format" << std::setw(15) << "features" << std::right
+      << std::setw(6) << "size" << std::setw(6) << "uncpl" << std::setw(5) << "sec" << std::setw(5) << "thr"
+      << std::setw(11) << "samples/s" << std::setw(9) << "MB/s" << std::setw(7) << "cpu" << std::setw(7) << "util"
+      << std::setw(7) << "scale" << std::setw(9) << "wall s" << std::setw(8) << "sync s" << "\n";
+  for (const auto &measurement : measurements) {
+    const auto &config = measurement.config;
+    out << std::left << std::setw(7) << config.target << std::setw(7) << config.format << std::setw(15)
+        << config.features << std::right << std::setw(6) << config.instrument_size << std::setw(6) << config.uncoupled
+        << std::setw(5) << config.sample_time << std::setw(5) << config.threads;
+    if (!measurement.ok) {
+      out << "  failed\n";
+      continue;
+    }
+    out << std::fixed << std::setprecision(2) << std::setw(11) << measurement.SamplesPerSecond() << std::setw(9)
+        << measurement.MegabytesPerSecond() << std::setw(7) << measurement.CpuCores() << std::setw(6)
+        << std::setprecision(0) << 100.0 * measurement.Utilization() << "%" << std::setw(6)
+        << 100.0 * measurement.scaling_efficiency << "%" << std::setprecision(2) << std::setw(9) << measurement.wall_s
+        << std::setw(8) << measurement.sync_s << "\n";
+  }
+}
+
+void WriteJson(const std::vector<Measurement> &measurements, const std::vector<Target> &targets,
+               const std::string &file_name) {
+  std::ofstream out(file_name, std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Unable to write " + file_name);
+  }
+  out << std::setprecision(10) << "{\n  \"schema\": 1,\n  \"hardware_threads\": " << std::thread::hardware_concurrency()
+      << ",\n  \"targets\": [";
+  for (std::size_t i = 0; i < targets.size(); ++i) {
+    out << (i == 0U ? "" : ", ") << "{\"name\": \"" << targets[i].name << "\", \"directory\": "
+        << std::quoted(targets[i].directory.string()) << ", \"filesystem\": \"" << targets[i].filesystem << "\"}";
+  }
+  out << "],\n  \"runs\": [";
+  for (std::size_t i = 0; i < measurements.size(); ++i) {
+    const auto &measurement = measurements[i];
+    const auto &config = measurement.config;
+    out << (i == 0U ? "\n" : ",\n") << "    {\"target\": \"" << config.target << "\", \"format\": \"" << config.format
+        << "\", \"features\": \"" << config.features << "\", \"instrument_size\": " << config.instrument_size
+        << ", \"uncoupled\": " << config.uncoupled << ", \"sample_time\": " << config.sample_time
+        << ", \"threads\": " << config.threads << ", \"ok\": " << (measurement.ok ? "true" : "false")
+        << ", \"samples\": " << measurement.samples << ", \"bytes\": " << measurement.bytes
+        << ", \"wall_s\": " << measurement.wall_s << ", \"sync_s\": " << measurement.sync_s
+        << ", \"user_s\": " << measurement.user_s << ", \"system_s\": " << measurement.system_s
+        << ", \"max_rss_kb\": " << measurement.max_rss_kb << ", \"samples_per_s\": " << measurement.SamplesPerSecond()
+        << ", \"mb_per_s\": " << measurement.MegabytesPerSecond() << ", \"cpu_cores\": " << measurement.CpuCores()
+        << ", \"cpu_utilization\": " << measurement.Utilization()
+        << ", \"scaling_efficiency\": " << measurement.scaling_efficiency << "}";
+  }
+  out << "\n  ]\n}\n";
+  out.close();
+  if (!out) {
+    throw std::runtime_error("Unable to write " + file_name);
+  }
+}
+
+std::string DefaultBuilder() {
+  std::error_code error;
+  const auto self = std::filesystem::read_symlink("/proc/self/exe", error);
+  if (error) {
+    return "dataset_builder";
+  }
+  return (self.parent_path().parent_path() / "dataset_builder" / "dataset_builder").string();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string builder = DefaultBuilder();
+  std::size_t samples = 64;
+  std::vector<std::size_t> instrument_sizes = {10, 50};
+  std::vector<std::size_t> uncoupled = {0};
+  std::vector<std::size_t> sample_times = {1};
+  std::vector<std::size_t> threads;
+  ParseSizeList("1,hw", threads, true);
+  std::vector<std::string> formats = {"wav", "slac", "shard"};
+  std::vector<std::string> features = {"none"};
+  std::vector<std::string> target_names = {"tmpfs", "disk"};
+  std::string tmpfs_dir = "/dev/shm";
+  std::string disk_dir = ".";
+  std::size_t repetitions = 1;
+  std::string json_file;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    if (i + 1 >= argc) {
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+    const std::string_view arg2 = argv[++i];
+    bool ok = true;
+    if (arg == "--builder") {
+      builder = arg2;
+    } else if (arg == "--samples") {
+      ok = ParseSize(arg2, samples) && samples > 0U;
+    } else if (arg == "--instrument-sizes") {
+      ok = ParseSizeList(arg2, instrument_sizes);
+    } else if (arg == "--uncoupled") {
+      ok = ParseSizeList(arg2, uncoupled);
+    } else if (arg == "--sample-times") {
+      ok = ParseSizeList(arg2, sample_times) &&
+           std::find(sample_times.begin(), sample_times.end(), 0U) == sample_times.end();
+    } else if (arg == "--threads") {
+      ok = ParseSizeList(arg2, threads, true) && std::find(threads.begin(), threads.end(), 0U) == threads.end();
+    } else if (arg == "--formats") {
+      formats = SplitList(arg2);
+      ok = !formats.empty() && std::all_of(formats.begin(), formats.end(), [](const std::string &format) {
+        return format == "wav" || format == "slac" || format == "shard";
+      });
+    } else if (arg == "--features") {
+      features = SplitList(arg2);
+      ok = !features.empty();
+    } else if (arg == "--targets") {
+      target_names = SplitList(arg2);
+      ok = !target_names.empty() && std::all_of(target_names.begin(), target_names.end(), [](const std::string &name) {
+        return name == "tmpfs" || name == "disk";
+      });
+    } else if (arg == "--tmpfs-dir") {
+      tmpfs_dir = arg2;
+    } else if (arg == "--disk-dir") {
+      disk_dir = arg2;
+    } else if (arg == "--repetitions") {
+      ok = ParseSize(arg2, repetitions) && repetitions > 0U;
+    } else if (arg == "--json") {
+      json_file = arg2;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << "Invalid value for " << arg << ": " << arg2 << std::endl;
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (access(builder.c_str(), X_OK) != 0) {
+    std::cerr << "dataset_builder not found at " << builder << "; pass --builder" << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+
+  const std::string run_name = "soundlearner_pipeline_" + std::to_string(getpid());
+  std::vector<Target> targets;
+  for (const auto &name : target_names) {
+    const auto root = std::filesystem::absolute(name == "tmpfs" ? tmpfs_dir : disk_dir).lexically_normal();
+    Target target{name, root / run_name, ""};
+    std::error_code error;
+    std::filesystem::create_directories(target.directory, error);
+    if (error) {
+      std::cerr << "Unable to create " << target.directory.string() << ": " << error.message() << std::endl;
+      return EXIT_WRITE_FILE_FAILED;
+    }
+    target.filesystem = FilesystemName(target.directory);
+    if ((name == "tmpfs") != (target.filesystem == "tmpfs")) {
+      std::cerr << "warning: the " << name << " target " << target.directory.string() << " is on " << target.filesystem
+                << std::endl;
+    }
+    std::cout << name << ": " << target.directory.string() << " (" << target.filesystem << ")\n";
+    targets.push_back(std::move(target));
+  }
+
+  std::vector<Measurement> measurements;
+  int exit_code = EXIT_NORMAL;
+  try {
+    for (const auto &target : targets) {
+      for (const auto &format : formats) {
+        for (const auto &feature : features) {
+          if (format == "shard" && feature != "none") {
+            continue; // The builder writes features with loose files only.
+          }
+          for (const std::size_t size : instrument_sizes) {
+            for (const std::size_t uncoupled_count : uncoupled) {
+              for (const std::size_t seconds : sample_times) {
+                for (const std::size_t thread_count : threads) {
+                  const Config config{target.name, format, feature, size, uncoupled_count, seconds, thread_count};
+                  std::vector<Measurement> runs;
+                  for (std::size_t r = 0; r < repetitions; ++r) {
+                    runs.push_back(RunOnce(builder, config, samples, target.directory, std::cerr));
+                  }
+                  std::sort(runs.begin(), runs.end(), [](const Measurement &a, const Measurement &b) {
+                    return a.ok != b.ok ? a.ok : a.Seconds() < b.Seconds();
+                  });
+                  measurements.push_back(runs[runs.size() / 2U]);
+                  if (!measurements.back().ok) {
+                    exit_code = EXIT_WRITE_FILE_FAILED;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    ComputeScaling(measurements);
+    PrintTable(measurements, std::cout);
+    if (!json_file.empty()) {
+      WriteJson(measurements, targets, json_file);
+      std::cout << "wrote " << json_file << std::endl;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    exit_code = EXIT_WRITE_FILE_FAILED;
+  }
+  for (const auto &target : targets) {
+    std::error_code error;
+    std::filesystem::remove_all(target.directory, error);
+  }
+  return exit_code;
+}
@@ -0,0 +1,328 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capi/soundlearner.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "include/common.h"
+#include "include/structures.h"
+#include "instrument/instrument_model.h"
+#include "instrument/string_oscillator.h"
+
+static_assert(SL_SAMPLE_RATE == SAMPLE_RATE, "The C ABI renders at the player's sample rate");
+
+struct sl_instrument {
+  std::vector<instrument::oscillator::StringOccilator> strings; // Unprimed; voices copy them.
+};
+
+struct sl_voice {
+  const sl_instrument *instrument = nullptr;
+  std::vector<instrument::oscillator::StringOccilator> strings;
+  std::vector<double> block;
+  bool primed = false;
+};
+
+namespace {
+
+constexpr std::size_t k_block_size = 1024;
+
+thread_local std::string last_error;
+// CSV rows missing trailing fields draw them from the oscillators' shared random engine.
+std::mutex parse_mutex;
+
+int32_t Fail(int32_t status, std::string_view message) {
+  last_error = message;
+  return status;
+}
+
+// The ABI boundary: no exception leaves the library.
+template <typename Call> int32_t Guarded(Call &&call) {
+  try {
+    call();
+    return SL_OK;
+  } catch (const std::invalid_argument &error) {
+    return Fail(SL_ERROR_PARSE, error.what());
+  } catch (const std::bad_alloc &) {
+    return Fail(SL_ERROR_INTERNAL, "Out of memory");
+  } catch (const std::runtime_error &error) {
+    return Fail(SL_ERROR_IO, error.what());
+  } catch (const std::exception &error) {
+    return Fail(SL_ERROR_INTERNAL, error.what());
+  } catch (...) {
+    return Fail(SL_ERROR_INTERNAL, "Unknown error");
+  }
+}
+
+sl_instrument *FromRecords(const std::vector<InstrumentStringRecord> &records) {
+  auto created = std::make_unique<sl_instrument>();
+  created->strings.reserve(records.size());
+  for (const auto &record : records) {
+    created->strings.push_back(*instrument::oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+  return created.release();
+}
+
+void Reset(sl_voice &voice, const sl_instrument &source) {
+  voice.instrument = &source;
+  voice.strings.assign(source.strings.begin(), source.strings.end());
+  voice.block.resize(k_block_size);
+  voice.primed = false;
+}
+
+void Prime(sl_voice &voice, double frequency, double velocity) {
+  for (auto &sound_string : voice.strings) {
+    sound_string.PrimeString(frequency, velocity);
+  }
+  voice.primed = true;
+}
+
+// The next block.size() samples of the note, summed as GenerateSignal sums them with SL_RENDER_EXACT.
+void NextBlock(sl_voice &voice, std::span<double> block, uint32_t flags) {
+  if ((flags & SL_RENDER_EXACT) != 0U) {
+    for (auto &sample : block) {
+      double sample_val{0};
+      for (auto &sound_string : voice.strings) {
+        sample_val += sound_string.NextSample();
+      }
+      sample = sample_val;
+    }
+    return;
+  }
+  std::fill(block.begin(), block.end(), 0.0);
+  for (auto &sound_string : voice.strings) {
+    sound_string.AccumulateBlock(block);
+  }
+}
+
+std::size_t RenderFloat(sl_voice &voice, std::span<float> out, uint32_t flags) {
+  for (std::size_t first = 0; first < out.size(); first += k_block_size) {
+    const std::span<double> block(voice.block.data(), std::min(k_block_size, out.size() - first));
+    NextBlock(voice, block, flags);
+    std::transform(block.begin(), block.end(), out.begin() + static_cast<std::ptrdiff_t>(first),
+                   [](double sample) { return static_cast<float>(sample); });
+  }
+  return out.size();
+}
+
+// Converts as InstrumentModel::GenerateIntSignal does.
+std::size_t RenderInt16(sl_voice &voice, std::span<int16_t> out, uint32_t flags, bool &distorted) {
+  constexpr short max_int = std::numeric_limits<int16_t>::max();
+  const bool stop_on_clip = (flags & SL_RENDER_STOP_ON_CLIP) != 0U;
+  distorted = false;
+  for (std::size_t first = 0; first < out.size(); first += k_block_size) {
+    const std::span<double> block(voice.block.data(), std::min(k_block_size, out.size() - first));
+    NextBlock(voice, block, flags);
+    for (std::size_t i = 0; i < block.size(); ++i) {
+      double sample_val = block[i];
+      if (sample_val > 1.0 || sample_val < -1.0) {
+        sample_val = std::clamp(sample_val, -1.0, 1.0);
+        distorted = true;
+        if (stop_on_clip) {
+          return first + i;
+        }
+      }
+      out[first + i] = static_cast<int16_t>(max_int * sample_val);
+    }
+  }
+  return out.size();
+}
+
+bool ValidNote(double frequency, double velocity) { return std::isfinite(frequency) && frequency > 0.0 && std::isfinite(velocity) && velocity >= 0.0; }
+
+} // namespace
+
+extern "C" {
+
+uint32_t sl_abi_version(void) { return SL_ABI_VERSION; }
+
+const char *sl_last_error(void) { return last_error.c_str(); }
+
+int32_t sl_instrument_load(const char *path, sl_instrument **out) {
+  if (path == nullptr || out == nullptr) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_instrument_load needs a path and an output handle");
+  }
+  *out = nullptr;
+  return Guarded([&]() {
+    const std::lock_guard<std::mutex> lock(parse_mutex);
+    *out = FromRecords(instrument::InstrumentModel::Load(path).ToRecords());
+  });
+}
+
+int32_t sl_instrument_parse(const void *contents, size_t size, sl_instrument **out) {
+  if ((contents == nullptr && size != 0U) || out == nullptr) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_instrument_parse needs contents and an output handle");
+  }
+  *out = nullptr;
+  return Guarded([&]() {
+    const std::lock_guard<std::mutex> lock(parse_mutex);
+    const std::string_view text(static_cast<const char *>(contents), size);
+    *out = FromRecords(instrument::InstrumentModel::Parse(text, "capi").ToRecords());
+  });
+}
+
+int32_t sl_instrument_from_parameters(const double *rows, size_t row_count, sl_instrument **out) {
+  if ((rows == nullptr && row_count != 0U) || out == nullptr) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_instrument_from_parameters needs rows and an output handle");
+  }
+  *out = nullptr;
+  if (row_count > instrument::InstrumentModel::k_max_strings) {
+    return Fail(SL_ERROR_ARGUMENT, "Too many strings for one instrument");
+  }
+  const std::span<const double> values(rows, row_count * SL_PARAMETER_COLUMNS);
+  if (!std::all_of(values.begin(), values.end(), [](double value) { return std::isfinite(value); })) {
+    return Fail(SL_ERROR_ARGUMENT, "Instrument parameters must be finite");
+  }
+  return Guarded([&]() {
+    std::vector<InstrumentStringRecord> records(row_count);
+    for (std::size_t i = 0; i < row_count; ++i) {
+      const double *row = rows + i * SL_PARAMETER_COLUMNS;
+      records[i] = {row[0], row[1], row[2], row[3], row[4], row[5], row[6] > 0.5 ? 1U : 0U, 0U};
+    }
+    *out = FromRecords(records);
+  });
+}
+
+void sl_instrument_destroy(sl_instrument *instrument) { delete instrument; }
+
+size_t sl_instrument_string_count(const sl_instrument *instrument) { return instrument == nullptr ? 0U : instrument->strings.size(); }
+
+int32_t sl_voice_create(const sl_instrument *instrument, sl_voice **out) {
+  if (instrument == nullptr || out == nullptr) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_voice_create needs an instrument and an output handle");
+  }
+  *out = nullptr;
+  return Guarded([&]() {
+    auto voice = std::make_unique<sl_voice>();
+    Reset(*voice, *instrument);
+    *out = voice.release();
+  });
+}
+
+void sl_voice_destroy(sl_voice *voice) { delete voice; }
+
+int32_t sl_voice_prime(sl_voice *voice, double frequency, double velocity) {
+  if (voice == nullptr || !ValidNote(frequency, velocity)) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_voice_prime needs a voice, a positive frequency and a non-negative velocity");
+  }
+  Prime(*voice, frequency, velocity);
+  return SL_OK;
+}
+
+int32_t sl_voice_render_float(sl_voice *voice, float *out, size_t count, uint32_t flags, size_t *rendered) {
+  if (voice == nullptr || (out == nullptr && count != 0U) || !voice->primed) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_voice_render_float needs a primed voice and an output buffer");
+  }
+  const std::size_t done = RenderFloat(*voice, std::span<float>(out, count), flags);
+  if (rendered != nullptr) {
+    *rendered = done;
+  }
+  return SL_OK;
+}
+
+int32_t sl_voice_render_int16(sl_voice *voice, int16_t *out, size_t count, uint32_t flags, size_t *rendered, int32_t *distorted) {
+  if (voice == nullptr || (out == nullptr && count != 0U) || !voice->primed) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_voice_render_int16 needs a primed voice and an output buffer");
+  }
+  bool clipped = false;
+  const std::size_t done = RenderInt16(*voice, std::span<int16_t>(out, count), flags, clipped);
+  if (rendered != nullptr) {
+    *rendered = done;
+  }
+  if (distorted != nullptr) {
+    *distorted = clipped ? 1 : 0;
+  }
+  return SL_OK;
+}
+
+int32_t sl_render_batch(sl_render_job *jobs, size_t job_count, size_t threads) {
+  if (jobs == nullptr && job_count != 0U) {
+    return Fail(SL_ERROR_ARGUMENT, "sl_render_batch needs jobs");
+  }
+  std::atomic<std::size_t> next{0};
+  std::mutex failure_mutex;
+  std::size_t first_failure = job_count;
+  std::string failure_message;
+  const auto work = [&]() {
+    sl_voice voice;
+    for (std::size_t index = next++; index < job_count; index = next++) {
+      sl_render_job &job = jobs[index];
+      job.rendered = 0;
+      job.distorted = 0;
+      if (job.instrument == nullptr || !ValidNote(job.frequency, job.velocity) || (job.out_float == nullptr) == (job.out_int16 == nullptr)) {
+        job.status = Fail(SL_ERROR_ARGUMENT, "A batch job needs an instrument, a valid note and exactly one output");
+      } else {
+        job.status = Guarded([&]() {
+          Reset(voice, *job.instrument);
+          Prime(voice, job.frequency, job.velocity);
+          if (job.out_float != nullptr) {
+            job.rendered = RenderFloat(voice, std::span<float>(job.out_float, job.sample_count), job.flags);
+          } else {
+            bool clipped = false;
+            job.rendered = RenderInt16(voice, std::span<int16_t>(job.out_int16, job.sample_count), job.flags, clipped);
+            job.distorted = clipped ? 1 : 0;
+          }
+        });
+      }
+      if (job.status != SL_OK) {
+        const std::lock_guard<std::mutex> lock(failure_mutex);
+        if (index < first_failure) {
+          first_failure = index;
+          failure_message = "job " + std::to_string(index) + ": " + last_error;
+        }
+      }
+    }
+  };
+  const std::size_t workers_wanted = threads == 0U ? std::max(1U, std::thread::hardware_concurrency()) : threads;
+  const int32_t status = Guarded([&]() {
+    std::vector<std::thread> workers;
+    const auto join = [&workers]() {
+      for (auto &worker : workers) {
+        worker.join();
+      }
+    };
+    try {
+      for (std::size_t worker = 1; worker < std::min(workers_wanted, job_count); ++worker) {
+        workers.emplace_back(work);
+      }
+      work();
+    } catch (...) {
+      // A thread that failed to start (or an allocation failure here) must not destroy joinable workers: stop handing
+      // out jobs, wait for the started ones and report the error.
+      next = job_count;
+      join();
+      throw;
+    }
+    join();
+  });
+  if (status != SL_OK) {
+    return status;
+  }
+  if (first_failure < job_count) {
+    return Fail(jobs[first_failure].status, failure_message);
+  }
+  return SL_OK;
+}
+
+} // extern "C"
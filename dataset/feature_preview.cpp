@@ -0,0 +1,273 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * feature_preview.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "include/common.h"
+#include "include/filewriter.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: feature_preview <dataset root, features directory or .slft files> [options]\n"
+            << "Writes <root>/preview/<id>_rgb.bmp plus the <id>_logfreq_rgb.bmp alias, as\n"
+            << "deep_trainer.prepare_dataset does, from one channel of each SLFT tensor.\n"
+            << "-h --help\n"
+            << "-o --output <dir> (default: preview/ next to the features directory)\n"
+            << "-j --threads <hardware threads>\n"
+            << "--channel <0>\n"
+            << "--scale <inferno|rgb|yuv|grayscale> (default inferno)\n"
+            << "--width <n> --height <n> (bilinear resize; default: time frames x frequency bins)\n"
+            << "--format <bmp|ppm> (default bmp)\n"
+            << "--no-alias (skip the _logfreq_rgb copy)\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static bool ParseScale(std::string_view source, ColorScaleType &out) {
+  if (source == "inferno") {
+    out = ColorScaleType::INFERNO;
+  } else if (source == "rgb") {
+    out = ColorScaleType::RGB;
+  } else if (source == "yuv") {
+    out = ColorScaleType::YUV;
+  } else if (source == "grayscale") {
+    out = ColorScaleType::GRAYSCALE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct PreviewOptions {
+  std::string output;
+  std::size_t channel = 0;
+  ColorScaleType scale = ColorScaleType::INFERNO;
+  std::size_t width = 0;
+  std::size_t height = 0;
+  bool ppm = false;
+  bool alias = true;
+};
+
+// A dataset root stands for its features/ directory; directories expand to their sorted .slft files.
+static std::vector<std::filesystem::path> CollectInputs(const std::vector<std::string> &sources) {
+  std::vector<std::filesystem::path> inputs;
+  for (const auto &source : sources) {
+    std::filesystem::path directory(source);
+    if (!std::filesystem::is_directory(directory)) {
+      inputs.push_back(directory);
+      continue;
+    }
+    if (std::filesystem::is_directory(directory / "features")) {
+      directory /= "features";
+    }
+    std::vector<std::filesystem::path> found;
+    for (const auto &item : std::filesystem::directory_iterator(directory)) {
+      if (item.is_regular_file() && item.path().extension() == ".slft") {
+        found.push_back(item.path());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    inputs.insert(inputs.end(), found.begin(), found.end());
+  }
+  return inputs;
+}
+
+// One channel of an SLFT file as an image: time frames across, frequency bins down, values clipped to [0, 1].
+static filewriter::image::Image ReadChannel(const std::filesystem::path &path, std::size_t channel) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  SlftFileHeader header{};
+  const SlftFileHeader expected{};
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("Not an SLFT file: " + path.string());
+  }
+  if (channel >= header.channels) {
+    throw std::runtime_error("No channel " + std::to_string(channel) + " in " + path.string());
+  }
+  filewriter::image::Image image(header.time_frames, header.frequency_bins);
+  const std::size_t plane = static_cast<std::size_t>(header.time_frames) * header.frequency_bins;
+  file.seekg(static_cast<std::streamoff>(sizeof(header) + channel * plane * sizeof(float)));
+  for (std::size_t row = 0; row < image.Height(); ++row) {
+    const auto values = image.Row(row);
+    if (!file.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()))) {
+      throw std::runtime_error("Truncated SLFT file: " + path.string());
+    }
+    for (float &value : values) {
+      value = std::clamp(value, 0.0F, 1.0F);
+    }
+  }
+  return image;
+}
+
+// Bilinear, sampling at pixel centres.
+static filewriter::image::Image Resize(const filewriter::image::Image &source, std::size_t width, std::size_t height) {
+  filewriter::image::Image out(width, height);
+  const float x_scale = static_cast<float>(source.Width()) / static_cast<float>(width);
+  const float y_scale = static_cast<float>(source.Height()) / static_cast<float>(height);
+  const auto source_position = [](std::size_t target, float scale, std::size_t size, std::size_t &low, float &fraction) {
+    const float position = std::clamp((static_cast<float>(target) + 0.5F) * scale - 0.5F, 0.0F, static_cast<float>(size - 1));
+    low = std::min(static_cast<std::size_t>(position), size - 1);
+    fraction = position - static_cast<float>(low);
+  };
+  std::vector<std::size_t> x_low(width);
+  std::vector<float> x_fraction(width);
+  for (std::size_t col = 0; col < width; ++col) {
+    source_position(col, x_scale, source.Width(), x_low[col], x_fraction[col]);
+  }
+  for (std::size_t row = 0; row < height; ++row) {
+    std::size_t y_low = 0;
+    float y_fraction = 0.0F;
+    source_position(row, y_scale, source.Height(), y_low, y_fraction);
+    const auto upper = source.Row(y_low);
+    const auto lower = source.Row(std::min(y_low + 1, source.Height() - 1));
+    const auto target = out.Row(row);
+    for (std::size_t col = 0; col < width; ++col) {
+      const std::size_t x_high = std::min(x_low[col] + 1, source.Width() - 1);
+      const float top = upper[x_low[col]] + x_fraction[col] * (upper[x_high] - upper[x_low[col]]);
+      const float bottom = lower[x_low[col]] + x_fraction[col] * (lower[x_high] - lower[x_low[col]]);
+      target[col] = top + y_fraction * (bottom - top);
+    }
+  }
+  return out;
+}
+
+static void WritePreview(const std::filesystem::path &input, const PreviewOptions &options) {
+  auto image = ReadChannel(input, options.channel);
+  if (options.width != 0U && options.height != 0U && image.Width() != 0U && image.Height() != 0U) {
+    image = Resize(image, options.width, options.height);
+  }
+  const std::filesystem::path directory =
+      options.output.empty() ? input.parent_path().parent_path() / "preview" : std::filesystem::path(options.output);
+  const std::string extension = options.ppm ? ".ppm" : ".bmp";
+  const auto stem = input.stem().string();
+  const auto path = directory / (stem + "_rgb" + extension);
+  if (options.ppm) {
+    filewriter::ppm::Write(image, path.string(), options.scale);
+  } else {
+    filewriter::bmp::Write(image, path.string(), options.scale);
+  }
+  if (options.alias) {
+    // The log-frequency preview has always been the same image; link it rather than encode it twice.
+    const auto alias = directory / (stem + "_logfreq_rgb" + extension);
+    std::error_code error;
+    std::filesystem::remove(alias, error);
+    std::filesystem::create_hard_link(path, alias, error);
+    if (error) {
+      std::filesystem::copy_file(path, alias, std::filesystem::copy_options::overwrite_existing);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> sources;
+  PreviewOptions options;
+  std::size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if (((arg == "-o") || (arg == "--output")) && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (((arg == "-j") || (arg == "--threads")) && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], threads) && threads > 0U;
+    } else if (arg == "--channel" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.channel);
+    } else if (arg == "--scale" && i + 1 < argc) {
+      parsed = ParseScale(argv[++i], options.scale);
+    } else if (arg == "--width" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.width) && options.width > 0U;
+    } else if (arg == "--height" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.height) && options.height > 0U;
+    } else if (arg == "--format" && i + 1 < argc) {
+      const std::string_view format = argv[++i];
+      options.ppm = format == "ppm";
+      parsed = options.ppm || format == "bmp";
+    } else if (arg == "--no-alias") {
+      options.alias = false;
+    } else if (arg.starts_with("-")) {
+      parsed = false;
+    } else {
+      sources.emplace_back(arg);
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (sources.empty() || ((options.width == 0U) != (options.height == 0U))) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  std::vector<std::filesystem::path> inputs;
+  try {
+    inputs = CollectInputs(sources);
+    if (!options.output.empty()) {
+      std::filesystem::create_directories(options.output);
+    } else {
+      for (const auto &input : inputs) {
+        std::filesystem::create_directories(input.parent_path().parent_path() / "preview");
+      }
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+
+  // A bad tensor is reported and skipped; the rest of the dataset still gets its previews.
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> failed{0};
+  std::mutex log_mutex;
+  std::vector<std::thread> workers;
+  for (std::size_t worker = 0; worker < std::min(threads, inputs.size()); ++worker) {
+    workers.emplace_back([&]() {
+      for (std::size_t i = next++; i < inputs.size(); i = next++) {
+        try {
+          WritePreview(inputs[i], options);
+        } catch (const std::exception &error) {
+          ++failed;
+          const std::lock_guard<std::mutex> lock(log_mutex);
+          std::cerr << "Skipping " << inputs[i].string() << ": " << error.what() << std::endl;
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "previews: " << inputs.size() - failed << "/" << inputs.size() << " in " << std::fixed << std::setprecision(2) << seconds
+            << " s on " << workers.size() << " thread(s)" << std::endl;
+  return failed == 0U ? EXIT_NORMAL : EXIT_READ_FILE_FAILED;
+}
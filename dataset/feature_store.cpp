@@ -0,0 +1,433 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset/feature_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "include/structures.h"
+
+namespace dataset {
+namespace store {
+
+namespace {
+
+constexpr std::size_t k_csv_columns = 7;
+
+std::size_t AlignUp(std::size_t value, std::size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Unable to read " + path);
+  }
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// The number after "key": in the flat metadata JSON dataset_builder and prepare_dataset write; NaN when absent.
+float JsonNumber(std::string_view json, std::string_view key) {
+  const std::string quoted = "\"" + std::string(key) + "\":";
+  const auto found = json.find(quoted);
+  if (found == std::string_view::npos) {
+    return std::numeric_limits<float>::quiet_NaN();
+  }
+  const char *begin = json.data() + found + quoted.size();
+  const char *end = json.data() + json.size();
+  while (begin < end && *begin == ' ') {
+    ++begin;
+  }
+  double value = 0.0;
+  const auto result = std::from_chars(begin, end, value);
+  return result.ec == std::errc{} ? static_cast<float>(value) : std::numeric_limits<float>::quiet_NaN();
+}
+
+// read_oscillator_csv's rows for a .data CSV or a .slin instrument, file order, at most max_oscillators.
+std::size_t ReadTargets(const std::string &path, std::size_t max_oscillators, float *out) {
+  const std::string contents = ReadFile(path);
+  const InstrumentFileHeader slin{};
+  std::size_t rows = 0;
+  if (contents.size() >= k_instrument_header_v1_size && std::memcmp(contents.data(), slin.magic, sizeof(slin.magic)) == 0) {
+    InstrumentFileHeader header{};
+    std::memcpy(static_cast<void *>(&header), contents.data(), k_instrument_header_v1_size); // Version 1 prefix; the note stays 0.
+    const std::size_t header_size = InstrumentHeaderSize(header.version);
+    if (header.record_size != sizeof(InstrumentStringRecord) ||
+        contents.size() < header_size + static_cast<std::size_t>(header.string_count) * sizeof(InstrumentStringRecord)) {
+      throw std::runtime_error("Invalid instrument file " + path);
+    }
+    for (; rows < header.string_count && rows < max_oscillators; ++rows) {
+      InstrumentStringRecord record{};
+      std::memcpy(&record, contents.data() + header_size + rows * sizeof(record), sizeof(record));
+      float *row = out + rows * k_target_width;
+      row[0] = 1.0F;
+      row[1] = static_cast<float>(record.amplitude_factor);
+      row[2] = static_cast<float>(record.frequency_factor);
+      row[3] = static_cast<float>(record.phase);
+      row[4] = static_cast<float>(record.amplitude_decay);
+      row[5] = static_cast<float>(record.amplitude_attack);
+      row[6] = static_cast<float>(record.frequency_decay);
+      row[7] = static_cast<float>(record.coupled);
+    }
+    return rows;
+  }
+  std::string_view remaining = contents;
+  while (!remaining.empty() && rows < max_oscillators) {
+    const auto newline = remaining.find('\n');
+    std::string_view line = remaining.substr(0, newline);
+    remaining = newline == std::string_view::npos ? std::string_view() : remaining.substr(newline + 1);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+    float *row = out + rows * k_target_width;
+    row[0] = 1.0F;
+    const char *at = line.data();
+    const char *end = line.data() + line.size();
+    for (std::size_t column = 0; column < k_csv_columns; ++column) {
+      double value = 0.0;
+      const auto result = std::from_chars(at, end, value);
+      if (result.ec != std::errc{} || (column + 1 < k_csv_columns ? (result.ptr == end || *result.ptr != ',') : result.ptr != end)) {
+        throw std::runtime_error(path + " row " + std::to_string(rows) + " does not have " + std::to_string(k_csv_columns) + " values");
+      }
+      row[column + 1] = static_cast<float>(value);
+      at = result.ptr + 1;
+    }
+    ++rows;
+  }
+  return rows;
+}
+
+void WriteAt(int fd, const void *data, std::size_t size, uint64_t offset, const std::string &path) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0U) {
+    const ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+    if (written <= 0) {
+      throw std::runtime_error("Unable to write feature store: " + path);
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+}
+
+} // namespace
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const auto sign = static_cast<uint16_t>((bits >> 16U) & 0x8000U);
+  const uint32_t magnitude = bits & 0x7FFFFFFFU;
+  if (magnitude >= 0x7F800000U) {
+    return static_cast<uint16_t>(sign | 0x7C00U | (magnitude > 0x7F800000U ? 0x0200U : 0U)); // Infinity or quiet NaN.
+  }
+  if (magnitude >= 0x477FF000U) {
+    return static_cast<uint16_t>(sign | 0x7C00U); // Rounds past 65504.
+  }
+  if (magnitude < 0x38800000U) {
+    // Subnormal: a multiple of 2^-24, which the float scales to exactly; nearbyint rounds half to even.
+    const float scaled = std::nearbyint(std::fabs(value) * 16777216.0F);
+    return static_cast<uint16_t>(sign | static_cast<uint16_t>(scaled));
+  }
+  const uint32_t rounded = magnitude + 0x0FFFU + ((magnitude >> 13U) & 1U) - ((127U - 15U) << 23U);
+  return static_cast<uint16_t>(sign | (rounded >> 13U));
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000U) << 16U;
+  const uint32_t exponent = (value >> 10U) & 0x1FU;
+  const uint32_t mantissa = value & 0x03FFU;
+  if (exponent == 0U) {
+    const float magnitude = static_cast<float>(mantissa) / 16777216.0F;
+    return sign != 0U ? -magnitude : magnitude;
+  }
+  const uint32_t bits = exponent == 0x1FU ? (sign | 0x7F800000U | (mantissa << 13U)) : (sign | ((exponent + 112U) << 23U) | (mantissa << 13U));
+  float result = 0.0F;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+std::vector<PackSource> DiscoverSources(const std::string &root) {
+  const std::filesystem::path base(root);
+  std::vector<PackSource> sources;
+  if (!std::filesystem::is_directory(base / "features")) {
+    return sources;
+  }
+  for (const auto &item : std::filesystem::directory_iterator(base / "features")) {
+    if (!item.is_regular_file() || item.path().extension() != ".slft") {
+      continue;
+    }
+    PackSource source;
+    source.id = item.path().stem().string();
+    source.feature_path = item.path().string();
+    for (const char *extension : {".data", ".slin"}) {
+      if (std::filesystem::exists(base / (source.id + extension))) {
+        source.target_path = (base / (source.id + extension)).string();
+        break;
+      }
+    }
+    if (source.target_path.empty()) {
+      continue;
+    }
+    source.note_frequency = source.velocity = source.audio_rms = std::numeric_limits<float>::quiet_NaN();
+    const auto metadata = base / "metadata" / (source.id + ".json");
+    if (std::filesystem::exists(metadata)) {
+      const std::string json = ReadFile(metadata.string());
+      source.note_frequency = JsonNumber(json, "note_frequency");
+      source.velocity = JsonNumber(json, "velocity");
+      source.audio_rms = JsonNumber(json, "rms");
+    }
+    sources.push_back(std::move(source));
+  }
+  std::sort(sources.begin(), sources.end(), [](const PackSource &a, const PackSource &b) { return a.id < b.id; });
+  return sources;
+}
+
+uint64_t Pack(std::span<const PackSource> sources, const std::string &path, const PackOptions &options) {
+  if (options.alignment < k_table_alignment || (options.alignment & (options.alignment - 1U)) != 0U) {
+    throw std::runtime_error("Feature store alignment must be a power of two of at least 64");
+  }
+  const std::size_t value_size = options.precision == Precision::f16 ? sizeof(uint16_t) : sizeof(float);
+
+  // Shapes first, from the 24 byte SLFT headers, so every offset is known before any tensor is read.
+  StoreFileHeader header;
+  header.record_count = sources.size();
+  header.precision = static_cast<uint32_t>(options.precision);
+  header.alignment = static_cast<uint32_t>(options.alignment);
+  header.max_oscillators = static_cast<uint32_t>(options.max_oscillators);
+  std::vector<StoreRecord> records(sources.size());
+  std::string ids;
+  bool uniform = true;
+  for (std::size_t i = 0; i < sources.size(); ++i) {
+    std::ifstream file(sources[i].feature_path, std::ios::in | std::ios::binary);
+    SlftFileHeader slft{};
+    const SlftFileHeader expected{};
+    if (!file.read(reinterpret_cast<char *>(&slft), sizeof(slft)) || std::memcmp(slft.magic, expected.magic, sizeof(slft.magic)) != 0 ||
+        slft.version != expected.version) {
+      throw std::runtime_error("Not a version 1 SLFT file: " + sources[i].feature_path);
+    }
+    records[i].channels = slft.channels;
+    records[i].frequency_bins = slft.frequency_bins;
+    records[i].time_frames = slft.time_frames;
+    records[i].id_offset = static_cast<uint32_t>(ids.size());
+    records[i].id_size = static_cast<uint32_t>(sources[i].id.size());
+    ids += sources[i].id;
+    if (i == 0U) {
+      header.sample_rate = slft.sample_rate;
+    }
+    uniform = uniform && slft.channels == records[0].channels && slft.frequency_bins == records[0].frequency_bins &&
+              slft.time_frames == records[0].time_frames;
+  }
+  const auto tensor_bytes = [&](const StoreRecord &record) {
+    return static_cast<std::size_t>(record.channels) * record.frequency_bins * record.time_frames * value_size;
+  };
+
+  const std::size_t target_bytes = options.max_oscillators * k_target_width * sizeof(float);
+  header.records_offset = AlignUp(sizeof(StoreFileHeader), k_table_alignment);
+  header.targets_offset = AlignUp(header.records_offset + records.size() * sizeof(StoreRecord), k_table_alignment);
+  header.scalars_offset = AlignUp(header.targets_offset + records.size() * target_bytes, k_table_alignment);
+  header.ids_offset = AlignUp(header.scalars_offset + records.size() * k_scalar_count * sizeof(float), k_table_alignment);
+  header.ids_size = ids.size();
+  header.data_offset = AlignUp(header.ids_offset + ids.size(), options.alignment);
+  uint64_t offset = header.data_offset;
+  for (auto &record : records) {
+    record.offset = offset;
+    offset += AlignUp(tensor_bytes(record), options.alignment);
+  }
+  header.data_size = offset - header.data_offset;
+  if (uniform && !records.empty()) {
+    header.channels = records[0].channels;
+    header.frequency_bins = records[0].frequency_bins;
+    header.time_frames = records[0].time_frames;
+    header.record_stride = AlignUp(tensor_bytes(records[0]), options.alignment);
+  }
+
+  const std::string temporary = path + ".tmp";
+  const int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to create feature store: " + temporary);
+  }
+  try {
+    if (ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+      throw std::runtime_error("Unable to size feature store: " + temporary);
+    }
+    WriteAt(fd, &header, sizeof(header), 0, temporary);
+    WriteAt(fd, records.data(), records.size() * sizeof(StoreRecord), header.records_offset, temporary);
+    WriteAt(fd, ids.data(), ids.size(), header.ids_offset, temporary);
+
+    // Workers convert and write whole records at their final offsets; the first error stops them all.
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    const auto work = [&]() {
+      std::vector<float> values;
+      std::vector<uint16_t> halves;
+      std::vector<float> target(options.max_oscillators * k_target_width);
+      for (std::size_t i = next++; i < sources.size() && !failed; i = next++) {
+        try {
+          const StoreRecord &record = records[i];
+          const std::size_t count = static_cast<std::size_t>(record.channels) * record.frequency_bins * record.time_frames;
+          std::ifstream file(sources[i].feature_path, std::ios::in | std::ios::binary);
+          file.seekg(static_cast<std::streamoff>(sizeof(SlftFileHeader)));
+          values.resize(count);
+          if (!file.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(count * sizeof(float)))) {
+            throw std::runtime_error("Truncated SLFT file: " + sources[i].feature_path);
+          }
+          if (options.precision == Precision::f16) {
+            halves.resize(count);
+            std::transform(values.begin(), values.end(), halves.begin(), FloatToHalf);
+            WriteAt(fd, halves.data(), count * sizeof(uint16_t), record.offset, temporary);
+          } else {
+            WriteAt(fd, values.data(), count * sizeof(float), record.offset, temporary);
+          }
+
+          std::fill(target.begin(), target.end(), 0.0F);
+          const std::size_t rows = ReadTargets(sources[i].target_path, options.max_oscillators, target.data());
+          WriteAt(fd, target.data(), target_bytes, header.targets_offset + i * target_bytes, temporary);
+          const std::array<float, k_scalar_count> scalars = {sources[i].note_frequency, sources[i].velocity, sources[i].audio_rms,
+                                                             static_cast<float>(rows)};
+          WriteAt(fd, scalars.data(), sizeof(scalars), header.scalars_offset + i * sizeof(scalars), temporary);
+        } catch (...) {
+          const std::lock_guard<std::mutex> lock(error_mutex);
+          if (!failed.exchange(true)) {
+            error = std::current_exception();
+          }
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 1; worker < std::min(std::max<std::size_t>(options.threads, 1), sources.size()); ++worker) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  } catch (...) {
+    close(fd);
+    std::filesystem::remove(temporary);
+    throw;
+  }
+  if (close(fd) != 0) {
+    throw std::runtime_error("Unable to write feature store: " + temporary);
+  }
+  std::filesystem::rename(temporary, path);
+  return offset;
+}
+
+FeatureStore::FeatureStore(const std::string &a_file_name, bool populate, bool huge_pages) : file_name(a_file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open feature store: " + file_name);
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < sizeof(StoreFileHeader)) {
+    close(fd);
+    throw std::runtime_error("Feature store too small: " + file_name);
+  }
+  mapped_size = static_cast<std::size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED | (populate ? MAP_POPULATE : 0), fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Unable to map feature store: " + file_name);
+  }
+  mapped = static_cast<const char *>(address);
+  if (huge_pages) {
+    madvise(address, mapped_size, MADV_HUGEPAGE);
+  }
+
+  const auto reject = [&](const std::string &reason) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+    throw std::runtime_error(reason + ": " + file_name);
+  };
+  std::memcpy(&header, mapped, sizeof(header));
+  const StoreFileHeader expected{};
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != k_version) {
+    reject("Not a version " + std::to_string(k_version) + " feature store");
+  }
+  const std::size_t target_bytes = static_cast<std::size_t>(header.max_oscillators) * k_target_width * sizeof(float);
+  if (header.records_offset % k_table_alignment != 0U || header.targets_offset % k_table_alignment != 0U ||
+      header.scalars_offset % k_table_alignment != 0U || header.records_offset + header.record_count * sizeof(StoreRecord) > mapped_size ||
+      header.targets_offset + header.record_count * target_bytes > mapped_size ||
+      header.scalars_offset + header.record_count * k_scalar_count * sizeof(float) > mapped_size ||
+      header.ids_offset + header.ids_size > mapped_size || header.data_offset + header.data_size > mapped_size) {
+    reject("Feature store tables are truncated");
+  }
+  records = {reinterpret_cast<const StoreRecord *>(mapped + header.records_offset), header.record_count};
+  const std::size_t value_size = header.precision == static_cast<uint32_t>(Precision::f16) ? sizeof(uint16_t) : sizeof(float);
+  for (const auto &record : records) {
+    const std::size_t size = static_cast<std::size_t>(record.channels) * record.frequency_bins * record.time_frames * value_size;
+    if (record.offset + size > mapped_size || record.id_offset + record.id_size > header.ids_size) {
+      reject("Feature store record is out of range");
+    }
+  }
+}
+
+FeatureStore::~FeatureStore() {
+  if (mapped != nullptr) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+  }
+}
+
+std::string_view FeatureStore::Id(std::size_t i) const {
+  return {mapped + header.ids_offset + records[i].id_offset, records[i].id_size};
+}
+
+std::span<const float> FeatureStore::Target(std::size_t i) const {
+  const std::size_t width = static_cast<std::size_t>(header.max_oscillators) * k_target_width;
+  return {reinterpret_cast<const float *>(mapped + header.targets_offset) + i * width, width};
+}
+
+std::span<const float> FeatureStore::Scalars(std::size_t i) const {
+  return {reinterpret_cast<const float *>(mapped + header.scalars_offset) + i * k_scalar_count, k_scalar_count};
+}
+
+std::span<const std::byte> FeatureStore::Tensor(std::size_t i) const {
+  const StoreRecord &record = records[i];
+  const std::size_t value_size = header.precision == static_cast<uint32_t>(Precision::f16) ? sizeof(uint16_t) : sizeof(float);
+  return {reinterpret_cast<const std::byte *>(mapped + record.offset),
+          static_cast<std::size_t>(record.channels) * record.frequency_bins * record.time_frames * value_size};
+}
+
+void FeatureStore::ReadTensor(std::size_t i, std::span<float> out) const {
+  const auto bytes = Tensor(i);
+  if (header.precision == static_cast<uint32_t>(Precision::f16)) {
+    const std::size_t count = std::min(out.size(), bytes.size() / sizeof(uint16_t));
+    const auto *halves = reinterpret_cast<const uint16_t *>(bytes.data());
+    std::transform(halves, halves + count, out.begin(), HalfToFloat);
+  } else {
+    std::memcpy(out.data(), bytes.data(), std::min(out.size_bytes(), bytes.size()));
+  }
+}
+
+} // namespace store
+} // namespace dataset
@@ -0,0 +1,160 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * feature_store.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_FEATURE_STORE_H_
+#define DATASET_FEATURE_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** Feature store format (all integers little endian), one file per dataset
+      Offset 0         StoreFileHeader.
+      records_offset   record_count StoreRecord: where each tensor lives and its shape.
+      targets_offset   record_count x max_oscillators x k_target_width float32, the
+                       rows deep_trainer/dataset.py read_oscillator_csv builds
+                       (presence, then the seven .data columns), zero padded.
+      scalars_offset   record_count x k_scalar_count float32: note frequency,
+                       velocity, audio rms, oscillator count; NaN when unknown.
+      ids_offset       Sample ids (file stems), concatenated.
+      data_offset      The SLFT tensors without their headers, as float32 or
+                       float16, each starting on an `alignment` boundary.
+    When every tensor has the same shape, shape fields in the header are set and
+    tensor i starts at data_offset + i * record_stride, so the whole data section
+    is one strided array. Every table starts on a 64 byte boundary.
+*/
+namespace dataset {
+namespace store {
+
+constexpr uint32_t k_version = 1;
+constexpr std::size_t k_target_width = 8;
+constexpr std::size_t k_scalar_count = 4;
+constexpr std::size_t k_table_alignment = 64;
+
+enum class Precision : uint32_t { f32 = 1, f16 = 2 };
+
+#pragma pack(push, 1)
+
+struct StoreFileHeader {
+  char magic[4] = {'S', 'L', 'F', 'S'};
+  uint32_t version = k_version;
+  uint64_t record_count = 0;
+  uint32_t precision = 0; // Precision.
+  uint32_t alignment = 0;
+  uint32_t sample_rate = 44100;
+  uint32_t max_oscillators = 0;
+  // Shared shape and stride; all zero when shapes vary.
+  uint32_t channels = 0;
+  uint32_t frequency_bins = 0;
+  uint32_t time_frames = 0;
+  uint32_t reserved = 0;
+  uint64_t record_stride = 0;
+  uint64_t records_offset = 0;
+  uint64_t targets_offset = 0;
+  uint64_t scalars_offset = 0;
+  uint64_t ids_offset = 0;
+  uint64_t ids_size = 0;
+  uint64_t data_offset = 0;
+  uint64_t data_size = 0;
+};
+
+struct StoreRecord {
+  uint64_t offset = 0; // Absolute.
+  uint32_t channels = 0;
+  uint32_t frequency_bins = 0;
+  uint32_t time_frames = 0;
+  uint32_t id_offset = 0; // Into the ids section.
+  uint32_t id_size = 0;
+  uint32_t reserved = 0;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(StoreFileHeader) == 112, "Store header layout is part of the file format");
+static_assert(sizeof(StoreRecord) == 32, "Store record layout is part of the file format");
+
+// One example to pack: its SLFT tensor and its .data or .slin oscillator file.
+struct PackSource {
+  std::string id;
+  std::string feature_path;
+  std::string target_path;
+  float note_frequency = 0.0F; // NaN when unknown, as are the two below.
+  float velocity = 0.0F;
+  float audio_rms = 0.0F;
+};
+
+struct PackOptions {
+  Precision precision = Precision::f32;
+  // Record alignment in bytes, a power of two of at least 64. 4096 puts every
+  // record on its own pages; 2 MiB lines them up with transparent huge pages.
+  std::size_t alignment = 64;
+  std::size_t max_oscillators = 64;
+  std::size_t threads = 1;
+};
+
+/*
+ * Examples of a dataset root, as deep_trainer/dataset.py discover_examples finds
+ * them: features/<id>.slft with <id>.data or <id>.slin, labels from
+ * metadata/<id>.json when present.
+ * @parameters dataset root
+ * @returns sources sorted by id
+ */
+std::vector<PackSource> DiscoverSources(const std::string &root);
+
+/*
+ * Writes the store through a temporary file renamed over path. Tensors are
+ * converted and written by `threads` workers at precomputed offsets. Throws
+ * std::runtime_error on unreadable or inconsistent input.
+ * @parameters sources, output path, options
+ * @returns bytes written
+ */
+uint64_t Pack(std::span<const PackSource> sources, const std::string &path, const PackOptions &options);
+
+// IEEE binary16, round to nearest even; what numpy's float16 holds.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Memory-maps a store; spans stay valid for the store's lifetime.
+class FeatureStore {
+public:
+  // populate prefaults the whole map; huge_pages asks for transparent huge pages.
+  explicit FeatureStore(const std::string &file_name, bool populate = false, bool huge_pages = false);
+  ~FeatureStore();
+  FeatureStore(const FeatureStore &) = delete;
+  FeatureStore &operator=(const FeatureStore &) = delete;
+
+  std::size_t Size() const { return header.record_count; }
+  const StoreFileHeader &Header() const { return header; }
+  const StoreRecord &Record(std::size_t i) const { return records[i]; }
+  std::string_view Id(std::size_t i) const;
+  std::span<const float> Target(std::size_t i) const;  // max_oscillators x k_target_width.
+  std::span<const float> Scalars(std::size_t i) const; // k_scalar_count.
+  std::span<const std::byte> Tensor(std::size_t i) const; // Raw, in the store's precision.
+  // The tensor as float32, converting float16 stores.
+  void ReadTensor(std::size_t i, std::span<float> out) const;
+
+private:
+  std::string file_name;
+  StoreFileHeader header;
+  const char *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<const StoreRecord> records;
+};
+
+} // namespace store
+} // namespace dataset
+
+#endif // DATASET_FEATURE_STORE_H_
@@ -0,0 +1,159 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * feature_store_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dataset/feature_store.h"
+#include "include/common.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: feature_store <pack|info|bench> <dataset root or store> [options]\n"
+            << "  pack   features/<id>.slft + <id>.data|.slin (+ metadata/<id>.json) -> one .slfs store\n"
+            << "  info   print the store header\n"
+            << "  bench  random-access tensor reads\n"
+            << "-h --help\n"
+            << "-o --output <file> (pack; default <root>/features.slfs)\n"
+            << "--precision <f32|f16> (pack; default f32)\n"
+            << "--align <bytes> (pack; record alignment, power of two >= 64, e.g. 4096 or 2097152; default 64)\n"
+            << "--max-oscillators <64> (pack; target rows kept per example)\n"
+            << "-j --threads <hardware threads> (pack)\n"
+            << "--reads <10000> (bench)\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static void PrintInfo(const dataset::store::FeatureStore &store) {
+  const auto &header = store.Header();
+  std::cout << store.Size() << " records, " << (header.precision == static_cast<uint32_t>(dataset::store::Precision::f16) ? "f16" : "f32")
+            << ", alignment " << header.alignment << ", " << header.max_oscillators << " target rows, " << header.sample_rate << " Hz\n";
+  if (header.record_stride != 0U) {
+    std::cout << "shape " << header.channels << "x" << header.frequency_bins << "x" << header.time_frames << ", stride " << header.record_stride
+              << " bytes\n";
+  } else {
+    std::cout << "shapes vary, see the record table\n";
+  }
+  std::cout << "data " << std::fixed << std::setprecision(1) << static_cast<double>(header.data_size) / (1024.0 * 1024.0) << " MiB at offset "
+            << header.data_offset << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string command;
+  std::string source;
+  std::string output;
+  dataset::store::PackOptions options;
+  options.threads = std::max(1U, std::thread::hardware_concurrency());
+  std::size_t reads = 10000;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if (((arg == "-o") || (arg == "--output")) && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "--precision" && i + 1 < argc) {
+      const std::string_view precision = argv[++i];
+      options.precision = precision == "f16" ? dataset::store::Precision::f16 : dataset::store::Precision::f32;
+      parsed = precision == "f16" || precision == "f32";
+    } else if (arg == "--align" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.alignment);
+    } else if (arg == "--max-oscillators" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.max_oscillators) && options.max_oscillators > 0U;
+    } else if (((arg == "-j") || (arg == "--threads")) && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.threads) && options.threads > 0U;
+    } else if (arg == "--reads" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], reads);
+    } else if (arg.starts_with("-")) {
+      parsed = false;
+    } else if (command.empty()) {
+      command = arg;
+    } else if (source.empty()) {
+      source = arg;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (source.empty() || (command != "pack" && command != "info" && command != "bench")) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  try {
+    if (command == "pack") {
+      if (output.empty()) {
+        output = (std::filesystem::path(source) / "features.slfs").string();
+      }
+      const auto start = std::chrono::steady_clock::now();
+      const auto sources = dataset::store::DiscoverSources(source);
+      if (sources.empty()) {
+        throw std::runtime_error("No features/<id>.slft with a matching <id>.data or <id>.slin under " + source);
+      }
+      const uint64_t bytes = dataset::store::Pack(sources, output, options);
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "packed " << sources.size() << " examples into " << output << ", " << std::fixed << std::setprecision(1)
+                << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MiB in " << std::setprecision(2) << seconds << " s" << std::endl;
+      return EXIT_NORMAL;
+    }
+    const dataset::store::FeatureStore store(source);
+    if (command == "info") {
+      PrintInfo(store);
+      return EXIT_NORMAL;
+    }
+    if (store.Size() == 0U) {
+      throw std::runtime_error("Empty feature store: " + source);
+    }
+    std::mt19937_64 random(7);
+    std::uniform_int_distribution<std::size_t> pick(0, store.Size() - 1);
+    std::vector<float> tensor;
+    double checksum = 0.0;
+    uint64_t bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t read = 0; read < reads; ++read) {
+      const std::size_t i = pick(random);
+      const auto &record = store.Record(i);
+      tensor.resize(static_cast<std::size_t>(record.channels) * record.frequency_bins * record.time_frames);
+      store.ReadTensor(i, tensor);
+      checksum += tensor.empty() ? 0.0 : static_cast<double>(tensor[tensor.size() / 2]) + static_cast<double>(store.Target(i)[0]);
+      bytes += store.Tensor(i).size();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << reads << " random reads in " << std::fixed << std::setprecision(3) << seconds << " s, "
+              << static_cast<double>(reads) / std::max(seconds, 1e-9) << " reads/s, "
+              << static_cast<double>(bytes) / std::max(seconds, 1e-9) / 1e6 << " MB/s (checksum " << checksum << ")" << std::endl;
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
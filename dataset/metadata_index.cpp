@@ -0,0 +1,352 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset/metadata_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace dataset {
+namespace index {
+
+namespace {
+std::size_t AlignUp(std::size_t value) { return (value + k_column_alignment - 1U) / k_column_alignment * k_column_alignment; }
+
+void CopyName(char (&target)[k_name_size], const std::string &name) {
+  std::memset(target, 0, k_name_size);
+  std::memcpy(target, name.data(), std::min(name.size(), k_name_size - 1U));
+}
+
+std::string NameOf(const char (&name)[k_name_size]) { return std::string(name, strnlen(name, k_name_size)); }
+
+std::size_t TypeSize(uint32_t type) {
+  switch (static_cast<ColumnType>(type)) {
+  case ColumnType::u16:
+    return sizeof(uint16_t);
+  case ColumnType::u32:
+  case ColumnType::i32:
+  case ColumnType::f32:
+    return sizeof(uint32_t);
+  case ColumnType::u64:
+    return sizeof(uint64_t);
+  }
+  return 0;
+}
+
+// Accumulates columns into one file image, each starting on an aligned offset.
+class ImageWriter {
+public:
+  explicit ImageWriter(std::size_t directory_end) : image(AlignUp(directory_end), '\0') {}
+
+  template <typename T, typename Field> uint64_t Append(const std::vector<IndexRow> &rows, Field field) {
+    const std::size_t offset = image.size();
+    image.resize(AlignUp(offset + rows.size() * sizeof(T)), '\0');
+    auto *values = reinterpret_cast<T *>(image.data() + offset);
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+      values[i] = field(rows[i]);
+    }
+    return offset;
+  }
+
+  uint64_t Append(const std::vector<uint64_t> &counts) {
+    const std::size_t offset = image.size();
+    image.resize(AlignUp(offset + counts.size() * sizeof(uint64_t)), '\0');
+    std::memcpy(image.data() + offset, counts.data(), counts.size() * sizeof(uint64_t));
+    return offset;
+  }
+
+  std::vector<char> image;
+};
+
+template <typename T> void ApplyRange(std::span<const T> values, double min, double max, std::vector<uint8_t> &mask) {
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    const auto value = static_cast<double>(values[i]);
+    mask[i] &= static_cast<uint8_t>((value >= min) & (value <= max));
+  }
+}
+} // namespace
+
+SampleStats MeasureAudio(std::span<const int16_t> audio) {
+  // Integer accumulation is exact and vectorizes; normalize once at the end.
+  int64_t energy = 0;
+  int32_t peak = 0;
+  uint32_t clipped = 0;
+  for (const int16_t value : audio) {
+    const int32_t sample = value;
+    const int32_t magnitude = sample < 0 ? -sample : sample;
+    energy += static_cast<int64_t>(sample) * sample;
+    peak = std::max(peak, magnitude);
+    clipped += static_cast<uint32_t>(magnitude >= std::numeric_limits<int16_t>::max());
+  }
+  SampleStats stats;
+  if (!audio.empty()) {
+    stats.rms = static_cast<float>(std::sqrt(static_cast<double>(energy) / static_cast<double>(audio.size())) / 32768.0);
+  }
+  stats.peak = static_cast<float>(peak) / 32768.0F;
+  stats.clip_count = clipped;
+  return stats;
+}
+
+void IndexBuilder::Add(const IndexRow &row) {
+  std::lock_guard lock(rows_mutex);
+  rows.push_back(row);
+}
+
+void IndexBuilder::Merge(const MetadataIndex &existing) {
+  const auto sample_index = existing.Column<uint64_t>("sample_index");
+  const auto variant = existing.Column<int32_t>("variant");
+  const auto note_frequency = existing.Column<float>("note_frequency");
+  const auto velocity = existing.Column<float>("velocity");
+  const auto coupled_count = existing.Column<uint16_t>("coupled_count");
+  const auto uncoupled_count = existing.Column<uint16_t>("uncoupled_count");
+  const auto active_partials = existing.Column<uint16_t>("active_partials");
+  const auto clip_count = existing.Column<uint32_t>("clip_count");
+  const auto rms = existing.Column<float>("rms");
+  const auto peak = existing.Column<float>("peak");
+  const auto fundamental_hz = existing.Column<float>("fundamental_hz");
+  std::vector<IndexRow> merged(existing.Rows());
+  for (std::size_t i = 0; i < merged.size(); ++i) {
+    merged[i] = {sample_index[i], variant[i], note_frequency[i], velocity[i], coupled_count[i], uncoupled_count[i],
+                 SampleStats{rms[i], peak[i], clip_count[i], fundamental_hz[i], active_partials[i]}};
+  }
+  std::lock_guard lock(rows_mutex);
+  rows.insert(rows.begin(), merged.begin(), merged.end());
+}
+
+std::size_t IndexBuilder::Size() const {
+  std::lock_guard lock(rows_mutex);
+  return rows.size();
+}
+
+void IndexBuilder::Write(const std::string &path) const {
+  std::vector<IndexRow> sorted;
+  {
+    std::lock_guard lock(rows_mutex);
+    sorted = rows;
+  }
+  const auto key = [](const IndexRow &row) { return std::make_pair(row.sample_index, row.variant); };
+  std::stable_sort(sorted.begin(), sorted.end(), [&](const IndexRow &a, const IndexRow &b) { return key(a) < key(b); });
+  // Keep the last row added for every key.
+  std::vector<IndexRow> unique_rows;
+  unique_rows.reserve(sorted.size());
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    if (i + 1U == sorted.size() || key(sorted[i]) != key(sorted[i + 1U])) {
+      unique_rows.push_back(sorted[i]);
+    }
+  }
+
+  std::vector<IndexColumn> columns;
+  const auto add_column = [&](const std::string &name, ColumnType type) {
+    IndexColumn &column = columns.emplace_back();
+    CopyName(column.name, name);
+    column.type = static_cast<uint32_t>(type);
+  };
+  add_column("sample_index", ColumnType::u64);
+  add_column("variant", ColumnType::i32);
+  add_column("note_frequency", ColumnType::f32);
+  add_column("velocity", ColumnType::f32);
+  add_column("coupled_count", ColumnType::u16);
+  add_column("uncoupled_count", ColumnType::u16);
+  add_column("active_partials", ColumnType::u16);
+  add_column("clip_count", ColumnType::u32);
+  add_column("rms", ColumnType::f32);
+  add_column("peak", ColumnType::f32);
+  add_column("fundamental_hz", ColumnType::f32);
+
+  // String-count histograms: how many samples have each oscillator count.
+  const std::vector<std::pair<std::string, std::function<uint16_t(const IndexRow &)>>> counted = {
+      {"coupled_count", [](const IndexRow &row) { return row.coupled_count; }},
+      {"uncoupled_count", [](const IndexRow &row) { return row.uncoupled_count; }},
+      {"active_partials", [](const IndexRow &row) { return row.stats.active_partials; }},
+  };
+  std::vector<IndexHistogram> histograms(counted.size());
+  std::vector<std::vector<uint64_t>> counts(counted.size());
+  for (std::size_t h = 0; h < counted.size(); ++h) {
+    for (const auto &row : unique_rows) {
+      const uint16_t value = counted[h].second(row);
+      if (value >= counts[h].size()) {
+        counts[h].resize(value + 1U, 0U);
+      }
+      ++counts[h][value];
+    }
+    CopyName(histograms[h].name, counted[h].first);
+    histograms[h].bin_count = static_cast<uint32_t>(counts[h].size());
+  }
+
+  IndexFileHeader header;
+  header.row_count = unique_rows.size();
+  header.column_count = static_cast<uint32_t>(columns.size());
+  header.histogram_count = static_cast<uint32_t>(histograms.size());
+  header.sample_rate = sample_rate;
+  ImageWriter writer(sizeof(header) + columns.size() * sizeof(IndexColumn) + histograms.size() * sizeof(IndexHistogram));
+  std::size_t c = 0;
+  columns[c++].offset = writer.Append<uint64_t>(unique_rows, [](const IndexRow &row) { return row.sample_index; });
+  columns[c++].offset = writer.Append<int32_t>(unique_rows, [](const IndexRow &row) { return row.variant; });
+  columns[c++].offset = writer.Append<float>(unique_rows, [](const IndexRow &row) { return row.note_frequency; });
+  columns[c++].offset = writer.Append<float>(unique_rows, [](const IndexRow &row) { return row.velocity; });
+  columns[c++].offset = writer.Append<uint16_t>(unique_rows, [](const IndexRow &row) { return row.coupled_count; });
+  columns[c++].offset = writer.Append<uint16_t>(unique_rows, [](const IndexRow &row) { return row.uncoupled_count; });
+  columns[c++].offset = writer.Append<uint16_t>(unique_rows, [](const IndexRow &row) { return row.stats.active_partials; });
+  columns[c++].offset = writer.Append<uint32_t>(unique_rows, [](const IndexRow &row) { return row.stats.clip_count; });
+  columns[c++].offset = writer.Append<float>(unique_rows, [](const IndexRow &row) { return row.stats.rms; });
+  columns[c++].offset = writer.Append<float>(unique_rows, [](const IndexRow &row) { return row.stats.peak; });
+  columns[c++].offset = writer.Append<float>(unique_rows, [](const IndexRow &row) { return row.stats.fundamental_hz; });
+  for (std::size_t h = 0; h < histograms.size(); ++h) {
+    histograms[h].offset = writer.Append(counts[h]);
+  }
+
+  char *directory = writer.image.data();
+  std::memcpy(directory, &header, sizeof(header));
+  directory += sizeof(header);
+  std::memcpy(directory, columns.data(), columns.size() * sizeof(IndexColumn));
+  directory += columns.size() * sizeof(IndexColumn);
+  std::memcpy(directory, histograms.data(), histograms.size() * sizeof(IndexHistogram));
+
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(writer.image.data(), static_cast<std::streamsize>(writer.image.size()));
+    if (!file) {
+      throw std::runtime_error("Unable to write metadata index: " + temporary);
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+MetadataIndex::MetadataIndex(const std::string &a_file_name) : file_name(a_file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open metadata index: " + file_name);
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < sizeof(IndexFileHeader)) {
+    close(fd);
+    throw std::runtime_error("Metadata index too small: " + file_name);
+  }
+  mapped_size = static_cast<std::size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Unable to map metadata index: " + file_name);
+  }
+  mapped = static_cast<const char *>(address);
+
+  const auto reject = [&](const std::string &reason) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+    throw std::runtime_error(reason + ": " + file_name);
+  };
+  std::memcpy(&header, mapped, sizeof(header));
+  const IndexFileHeader expected{};
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != k_version) {
+    reject("Not a version " + std::to_string(k_version) + " metadata index");
+  }
+  const std::size_t directory_size = header.column_count * sizeof(IndexColumn) + header.histogram_count * sizeof(IndexHistogram);
+  if (sizeof(header) + directory_size > mapped_size) {
+    reject("Metadata index directory is truncated");
+  }
+  // The header and both directories are multiples of 16 bytes, so they are naturally aligned in the map.
+  columns = {reinterpret_cast<const IndexColumn *>(mapped + sizeof(header)), header.column_count};
+  histograms = {reinterpret_cast<const IndexHistogram *>(mapped + sizeof(header) + header.column_count * sizeof(IndexColumn)),
+                header.histogram_count};
+  for (const auto &column : columns) {
+    const std::size_t width = TypeSize(column.type);
+    if (width == 0U || column.offset % k_column_alignment != 0U || column.offset + header.row_count * width > mapped_size) {
+      reject("Metadata index column " + NameOf(column.name) + " is invalid");
+    }
+  }
+  for (const auto &histogram : histograms) {
+    if (histogram.offset % k_column_alignment != 0U || histogram.offset + histogram.bin_count * sizeof(uint64_t) > mapped_size) {
+      reject("Metadata index histogram " + NameOf(histogram.name) + " is invalid");
+    }
+  }
+}
+
+MetadataIndex::~MetadataIndex() {
+  if (mapped != nullptr) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+  }
+}
+
+const IndexColumn &MetadataIndex::FindColumn(const std::string &name) const {
+  for (const auto &column : columns) {
+    if (NameOf(column.name) == name) {
+      return column;
+    }
+  }
+  throw std::out_of_range("No index column " + name + " in " + file_name);
+}
+
+std::span<const uint64_t> MetadataIndex::Histogram(const std::string &name) const {
+  for (const auto &histogram : histograms) {
+    if (NameOf(histogram.name) == name) {
+      return {reinterpret_cast<const uint64_t *>(mapped + histogram.offset), histogram.bin_count};
+    }
+  }
+  throw std::out_of_range("No index histogram " + name + " in " + file_name);
+}
+
+IndexRow MetadataIndex::Row(std::size_t position) const {
+  IndexRow row;
+  row.sample_index = Column<uint64_t>("sample_index")[position];
+  row.variant = Column<int32_t>("variant")[position];
+  row.note_frequency = Column<float>("note_frequency")[position];
+  row.velocity = Column<float>("velocity")[position];
+  row.coupled_count = Column<uint16_t>("coupled_count")[position];
+  row.uncoupled_count = Column<uint16_t>("uncoupled_count")[position];
+  row.stats.active_partials = Column<uint16_t>("active_partials")[position];
+  row.stats.clip_count = Column<uint32_t>("clip_count")[position];
+  row.stats.rms = Column<float>("rms")[position];
+  row.stats.peak = Column<float>("peak")[position];
+  row.stats.fundamental_hz = Column<float>("fundamental_hz")[position];
+  return row;
+}
+
+std::vector<std::size_t> MetadataIndex::Select(std::span<const RangeFilter> filters) const {
+  std::vector<uint8_t> mask(header.row_count, 1U);
+  for (const auto &filter : filters) {
+    const IndexColumn &column = FindColumn(filter.column);
+    switch (static_cast<ColumnType>(column.type)) {
+    case ColumnType::u16:
+      ApplyRange(Column<uint16_t>(filter.column), filter.min, filter.max, mask);
+      break;
+    case ColumnType::u32:
+      ApplyRange(Column<uint32_t>(filter.column), filter.min, filter.max, mask);
+      break;
+    case ColumnType::u64:
+      ApplyRange(Column<uint64_t>(filter.column), filter.min, filter.max, mask);
+      break;
+    case ColumnType::i32:
+      ApplyRange(Column<int32_t>(filter.column), filter.min, filter.max, mask);
+      break;
+    case ColumnType::f32:
+      ApplyRange(Column<float>(filter.column), filter.min, filter.max, mask);
+      break;
+    }
+  }
+  std::vector<std::size_t> selected;
+  for (std::size_t i = 0; i < mask.size(); ++i) {
+    if (mask[i] != 0U) {
+      selected.push_back(i);
+    }
+  }
+  return selected;
+}
+
+} // namespace index
+} // namespace dataset
@@ -0,0 +1,197 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * metadata_index.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_METADATA_INDEX_H_
+#define DATASET_METADATA_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/** Metadata index format (all integers little endian)
+      Offset 0      IndexFileHeader.
+      Directory     column_count IndexColumn, then histogram_count IndexHistogram.
+      Columns       row_count values of the column's type each.
+      Histograms    bin_count uint64 counts each; bin i counts the rows whose
+                    column of the same name equals i.
+    Every column and histogram starts on a k_column_alignment boundary, so a
+    memory map of the file can be read as typed arrays directly (numpy.frombuffer).
+    Rows are sorted by (sample_index, variant), one per stored sample.
+*/
+namespace dataset {
+namespace index {
+
+constexpr std::size_t k_column_alignment = 64;
+constexpr uint32_t k_version = 1;
+constexpr std::size_t k_name_size = 32;
+// Strings whose peak amplitude is below -60 dBFS do not count as active partials.
+constexpr double k_active_partial_amplitude = 1e-3;
+
+enum class ColumnType : uint32_t { u16 = 1, u32 = 2, u64 = 3, i32 = 4, f32 = 5 };
+
+#pragma pack(push, 1)
+
+struct IndexFileHeader {
+  char magic[4] = {'S', 'L', 'I', 'X'};
+  uint32_t version = k_version;
+  uint64_t row_count = 0;
+  uint32_t column_count = 0;
+  uint32_t histogram_count = 0;
+  uint32_t sample_rate = 44100;
+  uint32_t reserved = 0;
+};
+
+struct IndexColumn {
+  char name[k_name_size] = {};
+  uint32_t type = 0; // ColumnType.
+  uint32_t reserved = 0;
+  uint64_t offset = 0;
+};
+
+struct IndexHistogram {
+  char name[k_name_size] = {};
+  uint32_t reserved = 0;
+  uint32_t bin_count = 0;
+  uint64_t offset = 0;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(IndexFileHeader) == 32, "Index header layout is part of the file format");
+static_assert(sizeof(IndexColumn) == 48 && sizeof(IndexHistogram) == 48, "Index directory layout is part of the file format");
+
+// Measured on the rendered audio, plus what the instrument says it played.
+struct SampleStats {
+  float rms = 0.0F;            // Of the pcm16 samples normalized to [-1, 1).
+  float peak = 0.0F;           // Largest absolute normalized sample.
+  uint32_t clip_count = 0;     // Samples at full scale, where the renderer clamped.
+  float fundamental_hz = 0.0F; // Lowest active coupled partial (any active one when none is coupled), 0 when silent.
+  uint16_t active_partials = 0;
+};
+
+/*
+ * RMS, peak and clip count of a pcm16 signal in one pass. fundamental_hz and
+ * active_partials are left for the caller, who knows the partials.
+ * @parameters audio
+ * @returns the audio half of the stats
+ */
+SampleStats MeasureAudio(std::span<const int16_t> audio);
+
+// One row: the sample's labels and stats.
+struct IndexRow {
+  uint64_t sample_index = 0;
+  int32_t variant = -1; // Augmented variant, -1 for the clean sample.
+  float note_frequency = 0.0F;
+  float velocity = 0.0F;
+  uint16_t coupled_count = 0;
+  uint16_t uncoupled_count = 0;
+  SampleStats stats;
+};
+
+class MetadataIndex;
+
+/*
+ * Collects rows from any number of threads and writes the index once. A row
+ * added for a (sample_index, variant) that is already present replaces it, so
+ * merging the existing index first keeps --only-indices regenerations consistent.
+ */
+class IndexBuilder {
+public:
+  explicit IndexBuilder(uint32_t a_sample_rate = 44100) : sample_rate(a_sample_rate) {}
+
+  void Add(const IndexRow &row);
+  void Merge(const MetadataIndex &existing);
+  std::size_t Size() const;
+  // Sorts, drops replaced rows and writes through a temporary file renamed over path.
+  void Write(const std::string &path) const;
+
+private:
+  uint32_t sample_rate;
+  mutable std::mutex rows_mutex;
+  std::vector<IndexRow> rows;
+};
+
+// Inclusive range on one column; rows outside it are filtered out.
+struct RangeFilter {
+  std::string column;
+  double min = -std::numeric_limits<double>::infinity();
+  double max = std::numeric_limits<double>::infinity();
+};
+
+// Memory-maps an index; column views stay valid for the index's lifetime.
+class MetadataIndex {
+public:
+  explicit MetadataIndex(const std::string &file_name);
+  ~MetadataIndex();
+  MetadataIndex(const MetadataIndex &) = delete;
+  MetadataIndex &operator=(const MetadataIndex &) = delete;
+
+  std::size_t Rows() const { return header.row_count; }
+  uint32_t SampleRate() const { return header.sample_rate; }
+  std::span<const IndexColumn> Columns() const { return columns; }
+  std::span<const IndexHistogram> Histograms() const { return histograms; }
+
+  // Typed view of a column; throws std::out_of_range for an unknown name or a type mismatch.
+  template <typename T> std::span<const T> Column(const std::string &name) const {
+    const IndexColumn &column = FindColumn(name);
+    if (column.type != static_cast<uint32_t>(TypeOf<T>())) {
+      throw std::out_of_range("Index column " + name + " has a different type");
+    }
+    return {reinterpret_cast<const T *>(mapped + column.offset), header.row_count};
+  }
+  std::span<const uint64_t> Histogram(const std::string &name) const;
+  IndexRow Row(std::size_t position) const;
+
+  /*
+   * Rows passing every filter, in index order. Each filter is one branch-free
+   * pass over its column.
+   * @parameters filters
+   * @returns row positions
+   */
+  std::vector<std::size_t> Select(std::span<const RangeFilter> filters) const;
+
+private:
+  std::string file_name;
+  IndexFileHeader header;
+  const char *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<const IndexColumn> columns;
+  std::span<const IndexHistogram> histograms;
+
+  const IndexColumn &FindColumn(const std::string &name) const;
+  template <typename T> static constexpr ColumnType TypeOf() {
+    if constexpr (std::is_same_v<T, uint16_t>) {
+      return ColumnType::u16;
+    } else if constexpr (std::is_same_v<T, uint32_t>) {
+      return ColumnType::u32;
+    } else if constexpr (std::is_same_v<T, uint64_t>) {
+      return ColumnType::u64;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+      return ColumnType::i32;
+    } else {
+      static_assert(std::is_same_v<T, float>, "Unsupported index column type");
+      return ColumnType::f32;
+    }
+  }
+};
+
+} // namespace index
+} // namespace dataset
+
+#endif // DATASET_METADATA_INDEX_H_
@@ -0,0 +1,145 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * metadata_index_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dataset/metadata_index.h"
+#include "include/common.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: dataset_index <index.slix or dataset root> [options]\n"
+            << "-h --help\n"
+            << "-w --where <column=min:max> (inclusive, either bound may be empty; repeat to combine)\n"
+            << "-l --list (print the matching sample ids)\n"
+            << "-d --data_save <'data'> (file name prefix of the listed ids)\n"
+            << "--limit <n> (list at most n ids)\n"
+            << "Without --where, prints the columns and the string-count histograms.\n"
+            << std::endl;
+}
+
+static bool ParseBound(std::string_view text, double &out) {
+  if (text.empty()) {
+    return true;
+  }
+  const auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+  return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+static bool ParseFilter(std::string_view text, dataset::index::RangeFilter &filter) {
+  const auto equals = text.find('=');
+  const auto colon = text.find(':', equals);
+  if (equals == std::string_view::npos || colon == std::string_view::npos) {
+    return false;
+  }
+  filter.column = std::string(text.substr(0, equals));
+  return ParseBound(text.substr(equals + 1, colon - equals - 1), filter.min) && ParseBound(text.substr(colon + 1), filter.max);
+}
+
+static void PrintSummary(const dataset::index::MetadataIndex &index) {
+  std::cout << index.Rows() << " rows at " << index.SampleRate() << " Hz\ncolumns:";
+  for (const auto &column : index.Columns()) {
+    std::cout << " " << std::string(column.name);
+  }
+  std::cout << "\n";
+  for (const auto &histogram : index.Histograms()) {
+    const std::string name(histogram.name);
+    std::cout << name << ":";
+    const auto counts = index.Histogram(name);
+    for (std::size_t value = 0; value < counts.size(); ++value) {
+      if (counts[value] != 0U) {
+        std::cout << " " << value << "x" << counts[value];
+      }
+    }
+    std::cout << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string source;
+  std::string prefix = "data";
+  std::vector<dataset::index::RangeFilter> filters;
+  bool list = false;
+  std::size_t limit = std::numeric_limits<std::size_t>::max();
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if ((arg == "-l") || (arg == "--list")) {
+      list = true;
+    } else if (((arg == "-w") || (arg == "--where")) && (i + 1 < argc)) {
+      parsed = ParseFilter(argv[++i], filters.emplace_back());
+    } else if (((arg == "-d") || (arg == "--data_save")) && (i + 1 < argc)) {
+      prefix = argv[++i];
+    } else if (arg == "--limit" && (i + 1 < argc)) {
+      const std::string_view value = argv[++i];
+      parsed = std::from_chars(value.data(), value.data() + value.size(), limit).ec == std::errc{};
+    } else if (source.empty() && !arg.starts_with("-")) {
+      source = arg;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (source.empty()) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+  if (std::filesystem::is_directory(source)) {
+    source = (std::filesystem::path(source) / "index.slix").string();
+  }
+
+  try {
+    const dataset::index::MetadataIndex index(source);
+    if (filters.empty() && !list) {
+      PrintSummary(index);
+      return EXIT_NORMAL;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto selected = index.Select(filters);
+    const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << selected.size() << "/" << index.Rows() << " rows selected in " << std::fixed << std::setprecision(3) << elapsed << " ms"
+              << std::endl;
+    if (list) {
+      const auto sample_index = index.Column<uint64_t>("sample_index");
+      const auto variant = index.Column<int32_t>("variant");
+      for (std::size_t i = 0; i < selected.size() && i < limit; ++i) {
+        const std::size_t row = selected[i];
+        std::cout << prefix << sample_index[row];
+        if (variant[row] >= 0) {
+          std::cout << "_aug" << std::setw(2) << std::setfill('0') << variant[row] << std::setfill(' ');
+        }
+        std::cout << "\n";
+      }
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
@@ -0,0 +1,289 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * pitch_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dsp/pitch.h"
+#include "include/common.h"
+#include "include/filereader.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: pitch_tag <wav files or directories> [options]\n"
+            << "Estimates the fundamental frequency of every WAV, as deep_trainer.audio_features\n"
+            << "estimate_fundamental_frequency does, and writes one row per file.\n"
+            << "-h --help\n"
+            << "-m --manifest <file> (one WAV path per line, relative to the manifest; # comments)\n"
+            << "-o --output <file> (default stdout)\n"
+            << "--format <json|csv> (default json)\n"
+            << "--method <autocorrelation|yin> (default autocorrelation)\n"
+            << "--min-hz <40> --max-hz <1200>\n"
+            << "--frame <0.08> --hop <0.04> (seconds)\n"
+            << "-j --threads <hardware threads>\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static bool ParseDouble(std::string_view source, double &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+// Files as given, directories expanded to their sorted .wav files (recursively), manifests line by line.
+static void CollectInputs(const std::string &source, std::vector<std::string> &inputs) {
+  if (!std::filesystem::is_directory(source)) {
+    inputs.push_back(source);
+    return;
+  }
+  std::vector<std::string> found;
+  for (const auto &item : std::filesystem::recursive_directory_iterator(source)) {
+    auto extension = item.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (item.is_regular_file() && extension == ".wav") {
+      found.push_back(item.path().string());
+    }
+  }
+  std::sort(found.begin(), found.end());
+  inputs.insert(inputs.end(), found.begin(), found.end());
+}
+
+static void ReadManifest(const std::string &manifest, std::vector<std::string> &inputs) {
+  std::ifstream file(manifest);
+  if (!file) {
+    throw std::runtime_error("Unable to read manifest " + manifest);
+  }
+  const auto base = std::filesystem::path(manifest).parent_path();
+  std::string line;
+  while (std::getline(file, line)) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+      line.pop_back();
+    }
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    const std::filesystem::path path(line);
+    inputs.push_back(path.is_absolute() ? line : (base / path).string());
+  }
+}
+
+struct PitchRow {
+  dsp::PitchEstimate estimate;
+  uint32_t sample_rate = 0;
+  double seconds = 0.0;
+  std::string error;
+};
+
+static std::string JsonString(std::string_view text) {
+  std::string quoted = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20U) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+static std::string CsvField(std::string_view text) {
+  if (text.find_first_of(",\"\n") == std::string_view::npos) {
+    return std::string(text);
+  }
+  std::string quoted = "\"";
+  for (const char c : text) {
+    quoted += c;
+    if (c == '"') {
+      quoted += '"';
+    }
+  }
+  return quoted + "\"";
+}
+
+static void WriteJson(std::ostream &out, const std::vector<std::string> &inputs, const std::vector<PitchRow> &rows) {
+  out << std::setprecision(10) << "[\n";
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    const auto &row = rows[i];
+    out << "  {\"path\": " << JsonString(inputs[i]) << ", \"f0_hz\": ";
+    if (row.estimate.frequency) {
+      out << *row.estimate.frequency;
+    } else {
+      out << "null";
+    }
+    out << ", \"strength\": " << row.estimate.strength << ", \"voiced_frames\": " << row.estimate.voiced_frames
+        << ", \"frames\": " << row.estimate.frames << ", \"sample_rate\": " << row.sample_rate << ", \"seconds\": " << row.seconds;
+    if (!row.error.empty()) {
+      out << ", \"error\": " << JsonString(row.error);
+    }
+    out << (i + 1 < rows.size() ? "},\n" : "}\n");
+  }
+  out << "]\n";
+}
+
+static void WriteCsv(std::ostream &out, const std::vector<std::string> &inputs, const std::vector<PitchRow> &rows) {
+  out << std::setprecision(10) << "path,f0_hz,strength,voiced_frames,frames,sample_rate,seconds,error\n";
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    const auto &row = rows[i];
+    out << CsvField(inputs[i]) << ",";
+    if (row.estimate.frequency) {
+      out << *row.estimate.frequency;
+    }
+    out << "," << row.estimate.strength << "," << row.estimate.voiced_frames << "," << row.estimate.frames << "," << row.sample_rate
+        << "," << row.seconds << "," << CsvField(row.error) << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> sources;
+  std::vector<std::string> manifests;
+  std::string output;
+  bool csv = false;
+  dsp::PitchOptions options;
+  std::size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if (((arg == "-m") || (arg == "--manifest")) && i + 1 < argc) {
+      manifests.emplace_back(argv[++i]);
+    } else if (((arg == "-o") || (arg == "--output")) && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "--format" && i + 1 < argc) {
+      const std::string_view format = argv[++i];
+      csv = format == "csv";
+      parsed = csv || format == "json";
+    } else if (arg == "--method" && i + 1 < argc) {
+      try {
+        options.method = dsp::PitchOptions::ParseMethod(argv[++i]);
+      } catch (const std::invalid_argument &) {
+        parsed = false;
+      }
+    } else if (arg == "--min-hz" && i + 1 < argc) {
+      parsed = ParseDouble(argv[++i], options.minimum_hz);
+    } else if (arg == "--max-hz" && i + 1 < argc) {
+      parsed = ParseDouble(argv[++i], options.maximum_hz);
+    } else if (arg == "--frame" && i + 1 < argc) {
+      parsed = ParseDouble(argv[++i], options.frame_seconds);
+    } else if (arg == "--hop" && i + 1 < argc) {
+      parsed = ParseDouble(argv[++i], options.hop_seconds);
+    } else if (((arg == "-j") || (arg == "--threads")) && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], threads) && threads > 0U;
+    } else if (arg.starts_with("-")) {
+      parsed = false;
+    } else {
+      sources.emplace_back(arg);
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (sources.empty() && manifests.empty()) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  std::vector<std::string> inputs;
+  try {
+    dsp::PitchEstimator check(44100, options); // Rejects bad option combinations before any file is read.
+    for (const auto &manifest : manifests) {
+      ReadManifest(manifest, inputs);
+    }
+    for (const auto &source : sources) {
+      CollectInputs(source, inputs);
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+
+  // One estimator per sample rate, shared by every thread; an unreadable file gets its error in the output row.
+  std::map<uint32_t, std::shared_ptr<const dsp::PitchEstimator>> estimators;
+  std::mutex estimators_mutex;
+  const auto estimator_for = [&](uint32_t sample_rate) {
+    const std::lock_guard<std::mutex> lock(estimators_mutex);
+    auto &estimator = estimators[sample_rate];
+    if (!estimator) {
+      estimator = std::make_shared<const dsp::PitchEstimator>(sample_rate, options);
+    }
+    return estimator;
+  };
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<PitchRow> rows(inputs.size());
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> failed{0};
+  std::vector<std::thread> workers;
+  for (std::size_t worker = 0; worker < std::min(threads, inputs.size()); ++worker) {
+    workers.emplace_back([&]() {
+      for (std::size_t i = next++; i < inputs.size(); i = next++) {
+        try {
+          const filereader::wave::WaveReaderC reader(inputs[i]);
+          const auto samples = reader.ToMonoFloatWave();
+          rows[i].sample_rate = reader.SampleRate();
+          rows[i].seconds = reader.SampleRate() == 0U ? 0.0 : static_cast<double>(samples.size()) / reader.SampleRate();
+          rows[i].estimate = estimator_for(reader.SampleRate())->Estimate(samples);
+        } catch (const std::exception &error) {
+          ++failed;
+          rows[i].error = error.what();
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  if (output.empty()) {
+    csv ? WriteCsv(std::cout, inputs, rows) : WriteJson(std::cout, inputs, rows);
+  } else {
+    std::ofstream file(output);
+    csv ? WriteCsv(file, inputs, rows) : WriteJson(file, inputs, rows);
+    if (!file) {
+      std::cerr << "ERROR!!! Unable to write " << output << std::endl;
+      return EXIT_READ_FILE_FAILED;
+    }
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "pitch: " << inputs.size() - failed << "/" << inputs.size() << " files in " << std::fixed << std::setprecision(2) << seconds
+            << " s on " << workers.size() << " thread(s)" << std::endl;
+  return failed == 0U ? EXIT_NORMAL : EXIT_READ_FILE_FAILED;
+}
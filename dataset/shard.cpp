@@ -0,0 +1,263 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset/shard.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "include/async_writer.h"
+
+namespace dataset {
+namespace shard {
+
+namespace {
+constexpr char k_shard_extension[] = ".sls";
+
+constexpr char k_shard_prefix[] = "shard_";
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + k_payload_alignment - 1U) / k_payload_alignment * k_payload_alignment;
+}
+
+// True when [offset, offset + length) lies within [begin, end); written so that no sum can overflow.
+bool InRange(uint64_t offset, uint64_t length, uint64_t begin, uint64_t end) {
+  return offset >= begin && offset <= end && length <= end - offset;
+}
+
+// The number in shard_NNNNN.sls, or nothing for any other file name.
+std::optional<std::size_t> ShardNumber(const std::filesystem::path &path) {
+  const std::string stem = path.stem().string();
+  if (path.extension() != k_shard_extension || !stem.starts_with(k_shard_prefix)) {
+    return std::nullopt;
+  }
+  const std::string_view digits = std::string_view(stem).substr(std::strlen(k_shard_prefix));
+  std::size_t number = 0;
+  const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), number);
+  if (digits.empty() || error != std::errc() || end != digits.data() + digits.size()) {
+    return std::nullopt;
+  }
+  return number;
+}
+} // namespace
+
+ShardWriter::ShardWriter(const std::string &a_file_name, uint32_t sample_rate)
+    : file_name(a_file_name), fd(open(a_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open shard file: " + file_name);
+  }
+  header.sample_rate = sample_rate;
+  // The header block is written with the final counts on Close().
+  write_offset = k_payload_alignment;
+}
+
+ShardWriter::~ShardWriter() {
+  if (fd >= 0) {
+    try {
+      Close();
+    } catch (...) {
+      // Destructors must not throw; an unclosed shard is rejected by ShardReader.
+    }
+  }
+}
+
+void ShardWriter::Append(const SampleRecord &record) {
+  static constexpr std::array<char, k_payload_alignment> zeros{};
+  ShardIndexEntry entry{};
+  entry.sample_index = record.sample_index;
+  entry.note_frequency = record.note_frequency;
+  entry.velocity = record.velocity;
+  entry.coupled_count = static_cast<uint32_t>(record.coupled_count);
+  entry.uncoupled_count = static_cast<uint32_t>(record.uncoupled_count);
+  entry.sample_count = static_cast<uint32_t>(record.audio.size());
+
+  entry.audio_offset = write_offset;
+  entry.audio_length = record.audio.size_bytes();
+  entry.params_offset = entry.audio_offset + entry.audio_length;
+  entry.params_length = static_cast<uint32_t>(record.parameters.size());
+  entry.meta_offset = entry.params_offset + entry.params_length;
+  entry.meta_length = static_cast<uint32_t>(record.meta.size());
+  const uint64_t record_end = entry.meta_offset + entry.meta_length;
+  const uint64_t aligned_end = AlignUp(record_end);
+
+  // One gathered write per record, padded so the next record stays aligned.
+  const std::array<filewriter::async::Buffer, 4> parts = {
+      filewriter::async::AsBuffer(record.audio),
+      filewriter::async::AsBuffer(record.parameters),
+      filewriter::async::AsBuffer(record.meta),
+      filewriter::async::Buffer(zeros.data(), aligned_end - record_end),
+  };
+  filewriter::async::WriteVectored(fd, parts, write_offset, file_name);
+  write_offset = aligned_end;
+  index.push_back(entry);
+}
+
+void ShardWriter::Close() {
+  if (fd < 0) {
+    return;
+  }
+  header.index_offset = write_offset;
+  header.record_count = index.size();
+  const std::array<filewriter::async::Buffer, 1> index_part = {
+      filewriter::async::AsBuffer(std::span<const ShardIndexEntry>(index)),
+  };
+  const std::array<filewriter::async::Buffer, 1> header_part = {
+      filewriter::async::AsBuffer(std::span<const ShardFileHeader>(&header, 1)),
+  };
+  const int closing_fd = fd;
+  fd = -1;
+  try {
+    filewriter::async::WriteVectored(closing_fd, index_part, header.index_offset, file_name);
+    filewriter::async::WriteVectored(closing_fd, header_part, 0, file_name);
+  } catch (...) {
+    close(closing_fd);
+    throw;
+  }
+  if (close(closing_fd) != 0) {
+    throw std::runtime_error("Failed finalizing shard file: " + file_name);
+  }
+}
+
+ShardSetWriter::ShardSetWriter(const std::string &a_directory, std::size_t a_records_per_shard, uint32_t a_sample_rate)
+    : directory(a_directory), records_per_shard(std::max<std::size_t>(1U, a_records_per_shard)), sample_rate(a_sample_rate) {
+  std::filesystem::create_directories(directory);
+  // A rerun into the same directory (--only-indices) appends new shards after the existing ones instead of replacing them.
+  for (const auto &item : std::filesystem::directory_iterator(directory)) {
+    if (const auto number = ShardNumber(item.path())) {
+      shard_count = std::max(shard_count, *number + 1U);
+    }
+  }
+}
+
+void ShardSetWriter::Append(const SampleRecord &record) {
+  if (!current || current->Size() >= records_per_shard) {
+    Close();
+    std::string number = std::to_string(shard_count++);
+    number.insert(0, number.size() < 5 ? 5 - number.size() : 0, '0');
+    const auto path = std::filesystem::path(directory) / (k_shard_prefix + number + k_shard_extension);
+    current = std::make_unique<ShardWriter>(path.string(), sample_rate);
+  }
+  current->Append(record);
+}
+
+void ShardSetWriter::Close() {
+  if (current) {
+    current->Close();
+    current.reset();
+  }
+}
+
+ShardReader::ShardReader(const std::string &a_file_name) : file_name(a_file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open shard file: " + file_name);
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < sizeof(ShardFileHeader)) {
+    close(fd);
+    throw std::runtime_error("Shard file too small: " + file_name);
+  }
+  mapped_size = static_cast<std::size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Unable to map shard file: " + file_name);
+  }
+  mapped = static_cast<const char *>(address);
+
+  std::memcpy(&header, mapped, sizeof(header));
+  const ShardFileHeader expected{};
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != k_version) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+    throw std::runtime_error("Not a version " + std::to_string(k_version) + " shard file: " + file_name);
+  }
+  if (header.record_count == 0 || header.record_count > mapped_size / sizeof(ShardIndexEntry) ||
+      !InRange(header.index_offset, header.record_count * sizeof(ShardIndexEntry), k_payload_alignment, mapped_size)) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+    throw std::runtime_error("Shard file was not closed or is truncated: " + file_name);
+  }
+  // The index follows an aligned payload, so it is suitably aligned for direct access.
+  entries = std::span<const ShardIndexEntry>(reinterpret_cast<const ShardIndexEntry *>(mapped + header.index_offset), header.record_count);
+  // Checked once here so Audio, Parameters and Meta can hand out views without bounds checks.
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const auto &entry = entries[i];
+    if (entry.audio_offset % alignof(int16_t) != 0U || entry.audio_length % sizeof(int16_t) != 0U ||
+        !InRange(entry.audio_offset, entry.audio_length, k_payload_alignment, header.index_offset) ||
+        !InRange(entry.params_offset, entry.params_length, k_payload_alignment, header.index_offset) ||
+        !InRange(entry.meta_offset, entry.meta_length, k_payload_alignment, header.index_offset)) {
+      munmap(const_cast<char *>(mapped), mapped_size);
+      throw std::runtime_error("Shard index entry " + std::to_string(i) + " points outside the records: " + file_name);
+    }
+  }
+}
+
+ShardReader::~ShardReader() {
+  if (mapped != nullptr) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+  }
+}
+
+std::span<const int16_t> ShardReader::Audio(std::size_t i) const {
+  const auto &entry = entries[i];
+  return {reinterpret_cast<const int16_t *>(mapped + entry.audio_offset), entry.audio_length / sizeof(int16_t)};
+}
+
+std::string_view ShardReader::Parameters(std::size_t i) const {
+  const auto &entry = entries[i];
+  return {mapped + entry.params_offset, entry.params_length};
+}
+
+std::string_view ShardReader::Meta(std::size_t i) const {
+  const auto &entry = entries[i];
+  return {mapped + entry.meta_offset, entry.meta_length};
+}
+
+std::vector<std::string> ListShards(const std::string &directory) {
+  // Numbers compare as integers so shard_100000 follows shard_99999; other .sls names come first, by name.
+  std::vector<std::pair<std::optional<std::size_t>, std::string>> shards;
+  for (const auto &item : std::filesystem::directory_iterator(directory)) {
+    if (item.is_regular_file() && item.path().extension() == k_shard_extension) {
+      shards.emplace_back(ShardNumber(item.path()), item.path().string());
+    }
+  }
+  std::sort(shards.begin(), shards.end());
+  std::vector<std::string> names;
+  names.reserve(shards.size());
+  for (auto &shard : shards) {
+    names.push_back(std::move(shard.second));
+  }
+  return names;
+}
+
+std::unordered_map<uint64_t, std::pair<std::size_t, std::size_t>> NewestCopies(const std::vector<std::string> &shards) {
+  std::unordered_map<uint64_t, std::pair<std::size_t, std::size_t>> newest;
+  for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+    const ShardReader reader(shards[shard]);
+    for (std::size_t i = 0; i < reader.Size(); ++i) {
+      newest[reader.Entry(i).sample_index] = {shard, i};
+    }
+  }
+  return newest;
+}
+
+} // namespace shard
+} // namespace dataset
@@ -0,0 +1,164 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * shard.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_SHARD_H_
+#define DATASET_SHARD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** Shard container format (all integers little endian)
+      Offset 0      ShardFileHeader, zero padded to k_payload_alignment.
+      Records       One per sample. Each record starts on a k_payload_alignment
+                    boundary and holds the audio payload, then the oscillator
+                    CSV, then the legacy meta text.
+      index_offset  record_count ShardIndexEntry structs, written at close.
+    A shard that was never closed has record_count == 0 and is rejected.
+*/
+namespace dataset {
+namespace shard {
+
+constexpr std::size_t k_payload_alignment = 4096;
+constexpr uint32_t k_version = 1;
+
+enum class AudioFormat : uint32_t { pcm16 = 1 };
+
+#pragma pack(push, 1)
+
+struct ShardFileHeader {
+  char magic[4] = {'S', 'L', 'S', 'H'};
+  uint32_t version = k_version;
+  uint32_t alignment = k_payload_alignment;
+  uint32_t sample_rate = 44100;
+  uint64_t record_count = 0;
+  uint64_t index_offset = 0;
+};
+
+struct ShardIndexEntry {
+  uint64_t sample_index = 0;
+  uint64_t audio_offset = 0;  // Aligned start of the record.
+  uint64_t audio_length = 0;  // In bytes.
+  uint64_t params_offset = 0; // Oscillator CSV, as written to dataN.data.
+  uint64_t meta_offset = 0;   // Legacy meta text, as written to dataN.meta.
+  uint32_t params_length = 0;
+  uint32_t meta_length = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  uint32_t coupled_count = 0;
+  uint32_t uncoupled_count = 0;
+  uint32_t audio_format = static_cast<uint32_t>(AudioFormat::pcm16);
+  uint32_t sample_count = 0;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(ShardFileHeader) <= k_payload_alignment, "Shard header must fit in the first aligned block");
+static_assert(sizeof(ShardIndexEntry) == 80, "Shard index layout is part of the file format");
+
+struct SampleRecord {
+  std::size_t sample_index = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  std::size_t coupled_count = 0;
+  std::size_t uncoupled_count = 0;
+  std::span<const int16_t> audio;
+  std::string_view parameters;
+  std::string_view meta;
+};
+
+class ShardWriter {
+public:
+  explicit ShardWriter(const std::string &file_name, uint32_t sample_rate = 44100);
+  ~ShardWriter();
+  ShardWriter(const ShardWriter &) = delete;
+  ShardWriter &operator=(const ShardWriter &) = delete;
+
+  void Append(const SampleRecord &record);
+  void Close();
+  std::size_t Size() const { return index.size(); }
+
+private:
+  std::string file_name;
+  int fd = -1;
+  ShardFileHeader header;
+  std::vector<ShardIndexEntry> index;
+  uint64_t write_offset = 0;
+};
+
+// Rolls over to a new shard_NNNNN.sls file in a directory every records_per_shard samples.
+// Numbering continues after the highest shard already in the directory, so a
+// rerun adds shards whose records supersede earlier copies of the same sample
+// for readers that go through NewestCopies.
+class ShardSetWriter {
+public:
+  ShardSetWriter(const std::string &directory, std::size_t records_per_shard, uint32_t sample_rate = 44100);
+
+  void Append(const SampleRecord &record);
+  void Close();
+
+private:
+  std::string directory;
+  std::size_t records_per_shard;
+  uint32_t sample_rate;
+  std::size_t shard_count = 0;
+  std::unique_ptr<ShardWriter> current;
+};
+
+// Memory-maps a closed shard; the returned views stay valid for the reader's lifetime.
+// Every index entry is checked against the file when it is opened; a shard
+// with an entry outside its records throws std::runtime_error.
+class ShardReader {
+public:
+  explicit ShardReader(const std::string &file_name);
+  ~ShardReader();
+  ShardReader(const ShardReader &) = delete;
+  ShardReader &operator=(const ShardReader &) = delete;
+
+  std::size_t Size() const { return entries.size(); }
+  uint32_t SampleRate() const { return header.sample_rate; }
+  const ShardIndexEntry &Entry(std::size_t i) const { return entries[i]; }
+  std::span<const ShardIndexEntry> Entries() const { return entries; }
+  std::span<const int16_t> Audio(std::size_t i) const;
+  std::string_view Parameters(std::size_t i) const;
+  std::string_view Meta(std::size_t i) const;
+
+private:
+  std::string file_name;
+  ShardFileHeader header;
+  const char *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<const ShardIndexEntry> entries;
+};
+
+// The .sls files of a directory in ascending shard number.
+std::vector<std::string> ListShards(const std::string &directory);
+
+/*
+ * Finds the copy of every sample that wins after reruns: the one in the highest
+ * numbered shard, and the last one written within a shard.
+ * @parameters shards (in ListShards order)
+ * @returns sample_index -> (position in shards, entry index)
+ */
+std::unordered_map<uint64_t, std::pair<std::size_t, std::size_t>> NewestCopies(const std::vector<std::string> &shards);
+
+} // namespace shard
+} // namespace dataset
+
+#endif // DATASET_SHARD_H_
@@ -0,0 +1,102 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * shard_unpack.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dataset/shard.h"
+#include "include/common.h"
+#include "include/filewriter.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: shard_unpack <shard file or directory> [options]\n"
+            << "-h --help\n"
+            << "-o --output <'.'> (directory for the legacy dataN.wav/.data/.meta files)\n"
+            << "-d --data_save <'data'> (file name prefix)\n"
+            << "-l --list (print the index instead of unpacking)\n"
+            << "Only the newest copy of each sample is kept: the highest numbered shard wins.\n"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string source;
+  std::string output = ".";
+  std::string prefix = "data";
+  bool list_only = false;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    if ((arg == "-l") || (arg == "--list")) {
+      list_only = true;
+    } else if (((arg == "-o") || (arg == "--output")) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else if (((arg == "-d") || (arg == "--data_save")) && (i + 1 < argc)) {
+      prefix = argv[++i];
+    } else if (source.empty()) {
+      source = arg;
+    } else {
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (source.empty()) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  try {
+    const std::vector<std::string> shards =
+        std::filesystem::is_directory(source) ? dataset::shard::ListShards(source) : std::vector<std::string>{source};
+    std::filesystem::create_directories(output);
+    // A rerun appends newer copies of samples in higher numbered shards; only those are listed and unpacked.
+    const auto newest = dataset::shard::NewestCopies(shards);
+    std::size_t unpacked = 0;
+    for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+      const auto &shard_path = shards[shard];
+      const dataset::shard::ShardReader reader(shard_path);
+      for (std::size_t i = 0; i < reader.Size(); ++i) {
+        const auto &entry = reader.Entry(i);
+        if (newest.at(entry.sample_index) != std::pair(shard, i)) {
+          continue;
+        }
+        if (list_only) {
+          std::cout << shard_path << "," << entry.sample_index << "," << entry.audio_offset << "," << entry.audio_length << ","
+                    << entry.note_frequency << "," << entry.velocity << "," << entry.coupled_count << "," << entry.uncoupled_count << "\n";
+          continue;
+        }
+        const auto sample_id = (std::filesystem::path(output) / (prefix + std::to_string(entry.sample_index))).string();
+        filewriter::wave::MonoWriter(reader.Audio(i)).Write(sample_id + ".wav");
+        filewriter::text::WriteFile(sample_id + ".data", std::string(reader.Parameters(i)));
+        filewriter::text::WriteFile(sample_id + ".meta", std::string(reader.Meta(i)));
+        ++unpacked;
+      }
+    }
+    if (!list_only) {
+      if (unpacked != newest.size()) {
+        throw std::runtime_error("Unpacked " + std::to_string(unpacked) + " samples, expected one per index (" + std::to_string(newest.size()) + ")");
+      }
+      std::cout << "Unpacked " << unpacked << " samples from " << shards.size() << " shard(s) into " << output << std::endl;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
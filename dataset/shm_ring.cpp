@@ -0,0 +1,160 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset/shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+namespace dataset {
+namespace ring {
+
+namespace {
+std::size_t AlignUp(std::size_t value, std::size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+uint32_t LoadState(uint32_t &state) { return std::atomic_ref<uint32_t>(state).load(std::memory_order_acquire); }
+} // namespace
+
+std::size_t ParseOscillatorRows(std::string_view csv, std::span<float> out) {
+  std::fill(out.begin(), out.end(), 0.0F);
+  const std::size_t max_rows = out.size() / k_parameter_count;
+  std::size_t rows = 0;
+  while (!csv.empty() && rows < max_rows) {
+    const auto line_end = std::min(csv.find('\n'), csv.size());
+    std::string_view line = csv.substr(0, line_end);
+    csv.remove_prefix(std::min(line_end + 1, csv.size()));
+    if (line.empty()) {
+      continue;
+    }
+    for (std::size_t column = 0; column < k_parameter_count; ++column) {
+      const auto comma = std::min(line.find(','), line.size());
+      float value = 0.0F;
+      std::from_chars(line.data(), line.data() + comma, value);
+      out[rows * k_parameter_count + column] = value;
+      line.remove_prefix(std::min(comma + 1, line.size()));
+    }
+    ++rows;
+  }
+  return rows;
+}
+
+RingProducer::RingProducer(std::string ring_name, const RingShape &shape) : name(std::move(ring_name)) {
+  if (name.empty() || name.front() != '/') {
+    name.insert(name.begin(), '/');
+  }
+  if (shape.slot_count == 0U) {
+    throw std::invalid_argument("Shared-memory ring needs at least one slot");
+  }
+  RingHeader layout{};
+  layout.slot_count = shape.slot_count;
+  layout.sample_rate = shape.sample_rate;
+  layout.channels = shape.channels;
+  layout.frequency_bins = shape.frequency_bins;
+  layout.time_frames = shape.time_frames;
+  layout.max_oscillators = shape.max_oscillators;
+  layout.feature_offset = sizeof(RingSlotHeader);
+  const std::size_t feature_bytes = std::size_t{shape.channels} * shape.frequency_bins * shape.time_frames * sizeof(float);
+  layout.target_offset = AlignUp(layout.feature_offset + feature_bytes, k_slot_alignment);
+  const std::size_t target_bytes = std::size_t{shape.max_oscillators} * k_parameter_count * sizeof(float);
+  layout.slot_size = AlignUp(layout.target_offset + target_bytes, k_slot_alignment);
+  mapped_size = k_ring_header_size + layout.slot_size * shape.slot_count;
+
+  // Replace a stale ring from an earlier run rather than attaching to it.
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to create shared-memory ring: " + name + " (" + std::strerror(errno) + ")");
+  }
+  if (ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Unable to size shared-memory ring: " + name);
+  }
+  void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Unable to map shared-memory ring: " + name);
+  }
+  header = new (mapped) RingHeader(layout);
+  slots = static_cast<std::byte *>(mapped) + k_ring_header_size;
+  std::atomic_ref<uint32_t>(header->producer_state).store(static_cast<uint32_t>(ProducerState::running), std::memory_order_release);
+}
+
+RingProducer::~RingProducer() {
+  if (header != nullptr) {
+    Finish();
+    munmap(header, mapped_size);
+  }
+  if (unlink_on_close) {
+    shm_unlink(name.c_str());
+  }
+}
+
+uint64_t RingProducer::Published() const { return std::atomic_ref<uint64_t>(header->write_index).load(std::memory_order_relaxed); }
+
+void RingProducer::Finish() {
+  std::atomic_ref<uint32_t>(header->producer_state).store(static_cast<uint32_t>(ProducerState::finished), std::memory_order_release);
+}
+
+bool RingProducer::Publish(const RingSample &sample, const std::atomic<bool> &stop) {
+  const std::size_t feature_values = std::size_t{header->channels} * header->frequency_bins * header->time_frames;
+  if (sample.features.size() != feature_values) {
+    throw std::invalid_argument("Ring sample features do not match the ring shape");
+  }
+  const uint64_t write_index = std::atomic_ref<uint64_t>(header->write_index).load(std::memory_order_relaxed);
+  // Spin briefly, then back off to sleeps: a trainer step usually frees a slot within milliseconds.
+  for (unsigned attempt = 0;; ++attempt) {
+    if (LoadState(header->consumer_state) == static_cast<uint32_t>(ConsumerState::closed) || stop.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    const uint64_t read_index = std::atomic_ref<uint64_t>(header->read_index).load(std::memory_order_acquire);
+    if (write_index - read_index < header->slot_count) {
+      break;
+    }
+    if (attempt == 0U) {
+      ++full_waits;
+    }
+    if (attempt < 64U) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(std::min(1000U, 10U * (attempt - 63U))));
+    }
+  }
+
+  std::byte *slot = slots + (write_index % header->slot_count) * header->slot_size;
+  RingSlotHeader slot_header{};
+  slot_header.sample_index = sample.sample_index;
+  slot_header.note_frequency = sample.note_frequency;
+  slot_header.velocity = sample.velocity;
+  slot_header.audio_rms = sample.audio_rms;
+  slot_header.coupled_count = static_cast<uint32_t>(sample.coupled_count);
+  slot_header.uncoupled_count = static_cast<uint32_t>(sample.uncoupled_count);
+  auto *targets = reinterpret_cast<float *>(slot + header->target_offset);
+  slot_header.oscillator_rows = static_cast<uint32_t>(
+      ParseOscillatorRows(sample.parameters, std::span<float>(targets, std::size_t{header->max_oscillators} * k_parameter_count)));
+  std::memcpy(slot, &slot_header, sizeof(slot_header));
+  std::memcpy(slot + header->feature_offset, sample.features.data(), sample.features.size_bytes());
+  std::atomic_ref<uint64_t>(header->write_index).store(write_index + 1, std::memory_order_release);
+  return true;
+}
+
+} // namespace ring
+} // namespace dataset
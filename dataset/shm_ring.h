@@ -0,0 +1,155 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * shm_ring.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_SHM_RING_H_
+#define DATASET_SHM_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/** Shared-memory sample ring (all integers little endian)
+      Offset 0            RingHeader, zero padded to k_ring_header_size.
+      k_ring_header_size  slot_count slots of slot_size bytes each.
+    Slot layout:
+      0                   RingSlotHeader (64 bytes).
+      feature_offset      channels * frequency_bins * time_frames float32, channel
+                          major, the same values an SLFT file holds.
+      target_offset       max_oscillators * parameter_count float32, one row per
+                          oscillator as in dataN.data; rows past oscillator_rows are zero.
+    Single producer, single consumer. write_index counts published slots and
+    read_index counts released slots, both monotonic; slot i lives at
+    i % slot_count. The producer fills slot write_index only while
+    write_index - read_index < slot_count, then publishes it with a release
+    store of write_index + 1. The consumer reads write_index with acquire,
+    reads its slot and releases it with a release store of read_index + 1.
+    The two indices sit on separate cache lines.
+*/
+namespace dataset {
+namespace ring {
+
+constexpr std::size_t k_ring_header_size = 4096;
+constexpr std::size_t k_slot_alignment = 64;
+constexpr uint32_t k_version = 1;
+constexpr uint32_t k_parameter_count = 7;
+
+enum class ProducerState : uint32_t { starting = 0, running = 1, finished = 2 };
+enum class ConsumerState : uint32_t { detached = 0, attached = 1, closed = 2 };
+
+struct RingHeader {
+  char magic[4] = {'S', 'L', 'R', 'G'};
+  uint32_t version = k_version;
+  uint32_t header_size = k_ring_header_size;
+  uint32_t slot_count = 0;
+  uint64_t slot_size = 0;
+  uint32_t sample_rate = 44100;
+  uint32_t channels = 0;
+  uint32_t frequency_bins = 0;
+  uint32_t time_frames = 0;
+  uint32_t max_oscillators = 0;
+  uint32_t parameter_count = k_parameter_count;
+  uint64_t feature_offset = 0;
+  uint64_t target_offset = 0;
+  uint32_t producer_state = 0; // ProducerState, written by the producer.
+  uint32_t consumer_state = 0; // ConsumerState, written by the consumer.
+  uint8_t reserved_0[56] = {};
+  uint64_t write_index = 0; // Offset 128, producer cache line.
+  uint8_t reserved_1[56] = {};
+  uint64_t read_index = 0; // Offset 192, consumer cache line.
+  uint8_t reserved_2[56] = {};
+};
+
+struct RingSlotHeader {
+  uint64_t sample_index = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  double audio_rms = 0.0;
+  uint32_t coupled_count = 0;
+  uint32_t uncoupled_count = 0;
+  uint32_t oscillator_rows = 0;
+  uint32_t reserved = 0;
+  uint8_t padding[16] = {};
+};
+
+static_assert(offsetof(RingHeader, write_index) == 128, "Ring header layout is part of the shared-memory format");
+static_assert(offsetof(RingHeader, read_index) == 192, "Ring header layout is part of the shared-memory format");
+static_assert(sizeof(RingHeader) <= k_ring_header_size, "Ring header must fit in the first page");
+static_assert(sizeof(RingSlotHeader) == 64, "Ring slot layout is part of the shared-memory format");
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free, "Ring indices must be lock free to live in shared memory");
+
+struct RingShape {
+  uint32_t slot_count = 64;
+  uint32_t sample_rate = 44100;
+  uint32_t channels = 3;
+  uint32_t frequency_bins = 128;
+  uint32_t time_frames = 128;
+  uint32_t max_oscillators = 64;
+};
+
+struct RingSample {
+  std::size_t sample_index = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  double audio_rms = 0.0;
+  std::size_t coupled_count = 0;
+  std::size_t uncoupled_count = 0;
+  std::span<const float> features; // Must hold exactly channels * bins * frames values.
+  std::string_view parameters;     // Oscillator CSV as written to dataN.data.
+};
+
+/*
+ * Creates (or replaces) the POSIX shared-memory object `name` and publishes
+ * samples into it. The object is unlinked when the producer is destroyed unless
+ * Keep() was called.
+ */
+class RingProducer {
+public:
+  RingProducer(std::string name, const RingShape &shape);
+  ~RingProducer();
+  RingProducer(const RingProducer &) = delete;
+  RingProducer &operator=(const RingProducer &) = delete;
+
+  /*
+   * Copies one sample into the next free slot, waiting while the ring is full.
+   * @parameters sample, stop (abandon the wait when set)
+   * @returns false when the consumer closed the ring or stop was set.
+   */
+  bool Publish(const RingSample &sample, const std::atomic<bool> &stop);
+  // Marks the stream finished so consumers stop after draining it.
+  void Finish();
+  void Keep() { unlink_on_close = false; }
+
+  const std::string &Name() const { return name; }
+  uint64_t Published() const;
+  uint64_t FullWaits() const { return full_waits; }
+
+private:
+  std::string name;
+  RingHeader *header = nullptr;
+  std::byte *slots = nullptr;
+  std::size_t mapped_size = 0;
+  uint64_t full_waits = 0;
+  bool unlink_on_close = true;
+};
+
+// Parses oscillator CSV rows into a row-major float table.
+// @returns the number of rows stored, at most out.size() / k_parameter_count.
+std::size_t ParseOscillatorRows(std::string_view csv, std::span<float> out);
+
+} // namespace ring
+} // namespace dataset
+
+#endif // DATASET_SHM_RING_H_
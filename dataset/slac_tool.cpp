@@ -0,0 +1,227 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * slac_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/common.h"
+#include "include/filereader.h"
+#include "include/filewriter.h"
+#include "include/lossless_audio.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: slac <encode|decode|info|bench> <files or directories> [options]\n"
+            << "  encode  dataN.wav -> dataN.slac\n"
+            << "  decode  dataN.slac -> dataN.wav\n"
+            << "  info    print stream headers and compression ratios\n"
+            << "  bench   encode and decode in memory, verify, report throughput\n"
+            << "-h --help\n"
+            << "-o --output <dir> (default: next to each input)\n"
+            << "-j --threads <1> (blocks encoded or decoded in parallel per file)\n"
+            << "--lpc-order <12> (0..32)\n"
+            << "--block-size <4096>\n"
+            << "--exhaustive (try every LPC order)\n"
+            << "--remove (delete each input after converting it)\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static std::vector<uint8_t> ReadBytes(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Unable to read " + path.string());
+  }
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteBytes(const std::filesystem::path &path, const std::vector<uint8_t> &bytes) {
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    throw std::runtime_error("Unable to write " + path.string());
+  }
+}
+
+// Expands directories to the files with the given extension, sorted for stable output.
+static std::vector<std::filesystem::path> CollectInputs(const std::vector<std::string> &sources, const std::string &extension) {
+  std::vector<std::filesystem::path> inputs;
+  for (const auto &source : sources) {
+    if (!std::filesystem::is_directory(source)) {
+      inputs.emplace_back(source);
+      continue;
+    }
+    std::vector<std::filesystem::path> found;
+    for (const auto &item : std::filesystem::directory_iterator(source)) {
+      if (item.is_regular_file() && item.path().extension() == extension) {
+        found.push_back(item.path());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    inputs.insert(inputs.end(), found.begin(), found.end());
+  }
+  return inputs;
+}
+
+int main(int argc, char **argv) {
+  std::string command;
+  std::vector<std::string> sources;
+  std::string output;
+  std::size_t threads = 1;
+  bool remove_input = false;
+  lossless::EncoderOptions options;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    std::size_t value = 0;
+    if (arg == "--exhaustive") {
+      options.exhaustive_order_search = true;
+    } else if (arg == "--remove") {
+      remove_input = true;
+    } else if (((arg == "-o") || (arg == "--output")) && i + 1 < argc) {
+      output = argv[++i];
+    } else if (((arg == "-j") || (arg == "--threads")) && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], threads) && threads > 0U;
+    } else if (arg == "--lpc-order" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], value) && value <= lossless::k_max_lpc_order;
+      options.max_lpc_order = static_cast<uint32_t>(value);
+    } else if (arg == "--block-size" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], value) && value > 0U && value <= lossless::k_max_block_size;
+      options.block_size = static_cast<uint32_t>(value);
+    } else if (arg.starts_with("-")) {
+      parsed = false;
+    } else if (command.empty()) {
+      command = arg;
+    } else {
+      sources.emplace_back(arg);
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (sources.empty() || (command != "encode" && command != "decode" && command != "info" && command != "bench")) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+  options.threads = threads;
+
+  try {
+    const bool reads_wav = command == "encode" || command == "bench";
+    const auto inputs = CollectInputs(sources, reads_wav ? ".wav" : ".slac");
+    if (!output.empty()) {
+      std::filesystem::create_directories(output);
+    }
+    std::uint64_t pcm_bytes = 0;
+    std::uint64_t encoded_bytes = 0;
+    double encode_seconds = 0.0;
+    double decode_seconds = 0.0;
+    std::size_t unreadable = 0;
+    for (const auto &input : inputs) {
+      const auto target_directory = output.empty() ? input.parent_path() : std::filesystem::path(output);
+      std::optional<filereader::wave::WaveReaderC> wave;
+      std::vector<int16_t> converted;
+      std::span<const int16_t> samples;
+      if (reads_wav) {
+        // One bad reference file is reported and skipped rather than ending the batch.
+        try {
+          wave.emplace(input.string());
+          // Mono 16 bit PCM is encoded in place; other layouts are downmixed to it first.
+          const bool native = wave->AudioFormat() == 1U && wave->BitDepth() == 16U && wave->Channels() == 1U;
+          if (!native) {
+            converted = wave->ToMono16BitWave();
+          }
+          samples = native ? wave->Samples() : std::span<const int16_t>(converted);
+        } catch (const filereader::wave::ReadError &error) {
+          std::cerr << "Skipping " << error.what() << std::endl;
+          ++unreadable;
+          continue;
+        }
+      }
+      if (command == "encode") {
+        const auto encoded = lossless::Encode(samples, wave->SampleRate(), options);
+        WriteBytes(target_directory / input.filename().replace_extension(".slac"), encoded);
+        pcm_bytes += samples.size() * sizeof(int16_t);
+        encoded_bytes += encoded.size();
+      } else if (command == "decode") {
+        const auto encoded = ReadBytes(input);
+        const auto wav_path = target_directory / input.filename().replace_extension(".wav");
+        filewriter::wave::MonoWriter(lossless::Decode(encoded, threads), lossless::ReadInfo(encoded).sample_rate).Write(wav_path.string());
+        pcm_bytes += lossless::ReadInfo(encoded).sample_count * sizeof(int16_t);
+        encoded_bytes += encoded.size();
+      } else if (command == "info") {
+        const auto encoded = ReadBytes(input);
+        const auto info = lossless::ReadInfo(encoded);
+        std::cout << input.string() << ": " << info.sample_count << " samples at " << info.sample_rate << " Hz, block size " << info.block_size
+                  << ", " << encoded.size() << " bytes, "
+                  << static_cast<double>(info.sample_count * sizeof(int16_t)) / static_cast<double>(encoded.size()) << "x\n";
+        pcm_bytes += info.sample_count * sizeof(int16_t);
+        encoded_bytes += encoded.size();
+      } else {
+        const auto encode_start = std::chrono::steady_clock::now();
+        const auto encoded = lossless::Encode(samples, wave->SampleRate(), options);
+        const auto decode_start = std::chrono::steady_clock::now();
+        const auto decoded = lossless::Decode(encoded, threads);
+        const auto decode_end = std::chrono::steady_clock::now();
+        if (!std::ranges::equal(decoded, samples)) {
+          throw std::runtime_error("Round trip mismatch: " + input.string());
+        }
+        encode_seconds += std::chrono::duration<double>(decode_start - encode_start).count();
+        decode_seconds += std::chrono::duration<double>(decode_end - decode_start).count();
+        pcm_bytes += samples.size() * sizeof(int16_t);
+        encoded_bytes += encoded.size();
+      }
+      if (remove_input && (command == "encode" || command == "decode")) {
+        std::filesystem::remove(input);
+      }
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << command << ": " << inputs.size() - unreadable << " file(s), " << static_cast<double>(pcm_bytes) / 1e6 << " MB PCM, "
+              << static_cast<double>(encoded_bytes) / 1e6 << " MB encoded, "
+              << static_cast<double>(pcm_bytes) / std::max(1.0, static_cast<double>(encoded_bytes)) << "x\n";
+    if (command == "bench") {
+      std::cout << "encode " << static_cast<double>(pcm_bytes) / std::max(encode_seconds, 1e-9) / 1e6 << " MB/s, decode "
+                << static_cast<double>(pcm_bytes) / std::max(decode_seconds, 1e-9) / 1e6 << " MB/s of PCM on " << threads
+                << " thread(s), all round trips exact" << std::endl;
+    }
+    if (unreadable != 0U) {
+      std::cerr << unreadable << " file(s) could not be read" << std::endl;
+      return EXIT_READ_FILE_FAILED;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
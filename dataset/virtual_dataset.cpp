@@ -0,0 +1,313 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset/virtual_dataset.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "dataset/shard.h"
+#include "instrument/instrument_model.h"
+
+namespace dataset {
+
+namespace {
+std::string ReadText(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Unable to read " + path.string());
+  }
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<std::string> SplitLines(std::string_view text) {
+  std::vector<std::string> lines;
+  while (!text.empty()) {
+    const auto end = std::min(text.find('\n'), text.size());
+    if (end > 0U) {
+      lines.emplace_back(text.substr(0, end));
+    }
+    text.remove_prefix(std::min(end + 1, text.size()));
+  }
+  return lines;
+}
+
+// Legacy meta: note frequency, velocity, coupled count, uncoupled count, one per line.
+void ParseMeta(std::string_view text, ParameterRecord &record) {
+  const auto lines = SplitLines(text);
+  record.note_frequency = lines.size() > 0U ? std::stod(lines[0]) : 440.0;
+  record.velocity = lines.size() > 1U ? std::stod(lines[1]) : 0.0;
+  record.coupled_count = lines.size() > 2U ? static_cast<std::size_t>(std::stod(lines[2])) : 0U;
+  record.uncoupled_count = lines.size() > 3U ? static_cast<std::size_t>(std::stod(lines[3])) : 0U;
+}
+
+// Trailing digits of a stem such as "data17"; stems without digits sort first.
+std::size_t StemIndex(const std::string &stem) {
+  std::size_t first_digit = stem.size();
+  while (first_digit > 0U && std::isdigit(static_cast<unsigned char>(stem[first_digit - 1])) != 0) {
+    --first_digit;
+  }
+  return first_digit == stem.size() ? 0U : std::stoull(stem.substr(first_digit));
+}
+
+// Appends the records of shards[shard] that NewestCopies picked; superseded copies from earlier runs are skipped.
+void AppendShard(const std::vector<std::string> &shards, std::size_t shard,
+                 const std::unordered_map<uint64_t, std::pair<std::size_t, std::size_t>> &newest, std::vector<ParameterRecord> &records) {
+  const shard::ShardReader reader(shards[shard]);
+  for (std::size_t i = 0; i < reader.Size(); ++i) {
+    const auto &entry = reader.Entry(i);
+    if (newest.at(entry.sample_index) != std::pair(shard, i)) {
+      continue;
+    }
+    ParameterRecord record;
+    record.id = "data" + std::to_string(entry.sample_index);
+    record.sample_index = entry.sample_index;
+    record.note_frequency = entry.note_frequency;
+    record.velocity = entry.velocity;
+    record.coupled_count = entry.coupled_count;
+    record.uncoupled_count = entry.uncoupled_count;
+    record.sample_count = entry.sample_count;
+    record.parameters = std::string(reader.Parameters(i));
+    records.push_back(std::move(record));
+  }
+}
+} // namespace
+
+std::vector<ParameterRecord> LoadParameterRecords(const std::string &path) {
+  std::vector<ParameterRecord> records;
+  const auto shards = std::filesystem::is_regular_file(path) ? std::vector<std::string>{path} : shard::ListShards(path);
+  if (!shards.empty()) {
+    const auto newest = shard::NewestCopies(shards);
+    for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+      AppendShard(shards, shard, newest, records);
+    }
+  } else if (std::filesystem::is_directory(path)) {
+    for (const auto &item : std::filesystem::directory_iterator(path)) {
+      // A .slin holds the exact parameters, so it replaces a .data of the same stem.
+      const auto extension = item.path().extension();
+      if (extension != ".slin" && (extension != ".data" || std::filesystem::exists(std::filesystem::path(item.path()).replace_extension(".slin")))) {
+        continue;
+      }
+      ParameterRecord record;
+      record.id = item.path().stem().string();
+      record.sample_index = StemIndex(record.id);
+      record.parameters = ReadText(item.path());
+      auto meta_path = item.path();
+      meta_path.replace_extension(".meta");
+      if (std::filesystem::exists(meta_path)) {
+        ParseMeta(ReadText(meta_path), record);
+      }
+      if (extension == ".slin") {
+        // The .meta rounds the note to six decimals; a version 2 header holds it exactly.
+        const auto header = instrument::InstrumentModel::ReadBinaryHeader(record.parameters, record.id);
+        if (header.note_frequency > 0.0) {
+          record.note_frequency = header.note_frequency;
+          record.velocity = header.velocity;
+        }
+      }
+      records.push_back(std::move(record));
+    }
+  }
+  if (records.empty()) {
+    throw std::runtime_error("No parameter records (dataN.data, dataN.slin or shard_*.sls) found in " + path);
+  }
+  std::sort(records.begin(), records.end(), [](const auto &a, const auto &b) {
+    return a.sample_index != b.sample_index ? a.sample_index < b.sample_index : a.id < b.id;
+  });
+  return records;
+}
+
+VirtualDataset::VirtualDataset(std::vector<ParameterRecord> parameter_records, VirtualDatasetOptions dataset_options)
+    : records(std::move(parameter_records)), options(std::move(dataset_options)) {
+  if (options.features) {
+    extractor = std::make_unique<dsp::FeatureExtractor>(*options.features);
+  }
+  for (std::size_t i = 0; i < options.prefetch_threads; ++i) {
+    prefetch_workers.emplace_back([this] { PrefetchWorker(); });
+  }
+}
+
+VirtualDataset::~VirtualDataset() {
+  {
+    std::lock_guard lock(prefetch_mutex);
+    stopping = true;
+  }
+  prefetch_ready.notify_all();
+  for (auto &worker : prefetch_workers) {
+    worker.join();
+  }
+}
+
+/*
+ * Renders a record through the instrument model, then extracts features.
+ * @parameters index (record position)
+ * @returns the rendered sample
+ */
+VirtualSample VirtualDataset::Render(std::size_t index) const {
+  const ParameterRecord &record = records.at(index);
+  auto model = instrument::InstrumentModel::Parse(record.parameters, record.id);
+  const std::size_t sample_count = record.sample_count > 0U ? record.sample_count : options.sample_count;
+  bool distorted = false;
+  VirtualSample sample;
+  sample.audio = model.GenerateIntSignal(record.velocity, record.note_frequency, sample_count, distorted, false);
+  if (extractor) {
+    sample.features = extractor->Extract(sample.audio);
+  }
+  if (!options.render_audio) {
+    sample.audio = {};
+  }
+  return sample;
+}
+
+std::shared_ptr<const VirtualSample> VirtualDataset::Get(std::size_t index) {
+  if (index >= records.size()) {
+    throw std::out_of_range("Virtual dataset index " + std::to_string(index) + " is out of range");
+  }
+  auto sample = Materialize(index, false);
+  std::vector<std::size_t> ahead;
+  for (std::size_t next = index + 1; next < records.size() && ahead.size() < options.prefetch_depth; ++next) {
+    ahead.push_back(next);
+  }
+  Prefetch(ahead);
+  return sample;
+}
+
+void VirtualDataset::Prefetch(const std::vector<std::size_t> &indices) {
+  if (prefetch_workers.empty() || indices.empty()) {
+    return;
+  }
+  {
+    std::lock_guard lock(prefetch_mutex);
+    for (const auto index : indices) {
+      if (index < records.size()) {
+        prefetch_queue.push_back(index);
+      }
+    }
+    // Stale requests from earlier reads are dropped first when reads outrun the prefetcher.
+    const std::size_t limit = std::max<std::size_t>(options.prefetch_depth, indices.size()) * 2U;
+    while (prefetch_queue.size() > limit) {
+      prefetch_queue.pop_front();
+    }
+  }
+  prefetch_ready.notify_all();
+}
+
+void VirtualDataset::PrefetchWorker() {
+  for (;;) {
+    std::size_t index = 0;
+    {
+      std::unique_lock lock(prefetch_mutex);
+      prefetch_ready.wait(lock, [this] { return stopping || !prefetch_queue.empty(); });
+      if (stopping) {
+        return;
+      }
+      // Newest requests first: they belong to the reader's current position.
+      index = prefetch_queue.back();
+      prefetch_queue.pop_back();
+    }
+    try {
+      Materialize(index, true);
+    } catch (...) {
+      // A failing record surfaces when it is actually read.
+    }
+  }
+}
+
+std::shared_ptr<const VirtualSample> VirtualDataset::Materialize(std::size_t index, bool prefetch) {
+  std::promise<std::shared_ptr<const VirtualSample>> promise;
+  {
+    std::unique_lock lock(cache_mutex);
+    if (const auto found = cache.find(index); found != cache.end()) {
+      if (prefetch) {
+        return nullptr;
+      }
+      CacheEntry &entry = found->second;
+      ++stats.hits;
+      if (entry.prefetched) {
+        ++stats.prefetch_hits;
+        entry.prefetched = false;
+      }
+      lru.splice(lru.begin(), lru, entry.lru_position);
+      auto pending = entry.sample;
+      lock.unlock();
+      return pending.get();
+    }
+    if (!prefetch) {
+      ++stats.misses;
+    }
+    lru.push_front(index);
+    CacheEntry entry;
+    entry.sample = promise.get_future().share();
+    entry.lru_position = lru.begin();
+    entry.prefetched = prefetch;
+    cache.emplace(index, std::move(entry));
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::shared_ptr<const VirtualSample> sample;
+  try {
+    sample = std::make_shared<const VirtualSample>(Render(index));
+  } catch (...) {
+    {
+      std::lock_guard lock(cache_mutex);
+      const auto found = cache.find(index);
+      lru.erase(found->second.lru_position);
+      cache.erase(found);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  {
+    std::lock_guard lock(cache_mutex);
+    CacheEntry &entry = cache.at(index);
+    entry.ready = true;
+    entry.bytes = sample->Bytes();
+    stats.cached_bytes += entry.bytes;
+    ++stats.cached_samples;
+    ++stats.renders;
+    stats.render_seconds += elapsed.count();
+    EvictLocked();
+  }
+  promise.set_value(sample);
+  return sample;
+}
+
+void VirtualDataset::EvictLocked() {
+  // Entries still rendering are skipped: their size is unknown and readers are waiting on them.
+  auto position = lru.end();
+  while (stats.cached_bytes > options.cache_bytes && position != lru.begin()) {
+    --position;
+    const auto found = cache.find(*position);
+    if (!found->second.ready) {
+      continue;
+    }
+    stats.cached_bytes -= found->second.bytes;
+    --stats.cached_samples;
+    ++stats.evictions;
+    cache.erase(found);
+    position = lru.erase(position);
+  }
+}
+
+VirtualDatasetStats VirtualDataset::Stats() const {
+  std::lock_guard lock(cache_mutex);
+  return stats;
+}
+
+} // namespace dataset
@@ -0,0 +1,140 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * virtual_dataset.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_VIRTUAL_DATASET_H_
+#define DATASET_VIRTUAL_DATASET_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dsp/feature_extractor.h"
+
+namespace dataset {
+
+// Labels of one sample: everything dataN.data and dataN.meta (or a shard record) hold.
+struct ParameterRecord {
+  std::string id; // File stem, e.g. "data17".
+  std::size_t sample_index = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  std::size_t coupled_count = 0;
+  std::size_t uncoupled_count = 0;
+  std::size_t sample_count = 0; // 0: use VirtualDatasetOptions::sample_count.
+  std::string parameters;       // Oscillator CSV or .slin bytes (InstrumentModel::Parse).
+};
+
+/*
+ * Loads parameter records from a loose dataset directory (dataN.data or
+ * dataN.slin with dataN.meta), a shard file or a directory of shards.
+ * @returns records sorted by sample index; throws std::runtime_error when none are found.
+ */
+std::vector<ParameterRecord> LoadParameterRecords(const std::string &path);
+
+struct VirtualDatasetOptions {
+  bool render_audio = true;
+  std::optional<dsp::FeatureSpec> features; // Set to materialize SLFT features.
+  std::size_t sample_count = 5U * 44100U;   // Render length when a record does not carry one.
+  std::size_t cache_bytes = 512U << 20U;
+  std::size_t prefetch_depth = 8; // Indices after each read to render ahead.
+  std::size_t prefetch_threads = 2;
+};
+
+struct VirtualSample {
+  std::vector<int16_t> audio;  // Empty unless render_audio.
+  std::vector<float> features; // Empty unless features were requested.
+
+  std::size_t Bytes() const { return audio.size() * sizeof(int16_t) + features.size() * sizeof(float); }
+};
+
+struct VirtualDatasetStats {
+  std::uint64_t hits = 0;          // Served from the cache, including renders already in flight.
+  std::uint64_t misses = 0;        // Rendered on the reading thread.
+  std::uint64_t prefetch_hits = 0; // Hits on samples the prefetcher rendered.
+  std::uint64_t renders = 0;
+  std::uint64_t evictions = 0;
+  std::size_t cached_bytes = 0;
+  std::size_t cached_samples = 0;
+  double render_seconds = 0.0;
+
+  double HitRate() const { return hits + misses == 0U ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses); }
+};
+
+/*
+ * A dataset that stores only parameters and renders audio and features on read
+ * through the instrument model. Rendered samples are kept in an LRU cache with
+ * a byte budget, and reads schedule the following indices on background
+ * prefetch threads. Get is thread safe; concurrent reads of one index render it once.
+ */
+class VirtualDataset {
+public:
+  VirtualDataset(std::vector<ParameterRecord> records, VirtualDatasetOptions options);
+  ~VirtualDataset();
+  VirtualDataset(const VirtualDataset &) = delete;
+  VirtualDataset &operator=(const VirtualDataset &) = delete;
+
+  std::size_t Size() const { return records.size(); }
+  const ParameterRecord &Record(std::size_t index) const { return records.at(index); }
+  const VirtualDatasetOptions &Options() const { return options; }
+  const dsp::FeatureExtractor *Extractor() const { return extractor.get(); }
+
+  std::shared_ptr<const VirtualSample> Get(std::size_t index);
+  // Queues indices for background rendering, e.g. the next positions of a shuffled epoch.
+  void Prefetch(const std::vector<std::size_t> &indices);
+  VirtualDatasetStats Stats() const;
+
+  // Renders one record without touching the cache.
+  VirtualSample Render(std::size_t index) const;
+
+private:
+  struct CacheEntry {
+    std::shared_future<std::shared_ptr<const VirtualSample>> sample;
+    std::list<std::size_t>::iterator lru_position;
+    std::size_t bytes = 0;
+    bool ready = false;
+    bool prefetched = false;
+  };
+
+  std::vector<ParameterRecord> records;
+  VirtualDatasetOptions options;
+  std::unique_ptr<dsp::FeatureExtractor> extractor;
+
+  mutable std::mutex cache_mutex;
+  std::unordered_map<std::size_t, CacheEntry> cache;
+  std::list<std::size_t> lru; // Most recently used first.
+  VirtualDatasetStats stats;
+
+  std::mutex prefetch_mutex;
+  std::condition_variable prefetch_ready;
+  std::deque<std::size_t> prefetch_queue;
+  bool stopping = false;
+  std::vector<std::thread> prefetch_workers;
+
+  std::shared_ptr<const VirtualSample> Materialize(std::size_t index, bool prefetch);
+  void EvictLocked();
+  void PrefetchWorker();
+};
+
+} // namespace dataset
+
+#endif // DATASET_VIRTUAL_DATASET_H_
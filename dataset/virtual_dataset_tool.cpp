@@ -0,0 +1,192 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * virtual_dataset_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dataset/virtual_dataset.h"
+#include "include/common.h"
+#include "include/filewriter.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: virtual_dataset <dataset directory, shard file or shard directory> [options]\n"
+            << "-h --help\n"
+            << "--features <FxT> (materialize SLFT features)\n"
+            << "--crop-seconds <5>\n"
+            << "--no-audio (keep only features in the cache)\n"
+            << "-t --sample-time <5> (render length for records that do not store one)\n"
+            << "--cache-mb <512> (LRU cache budget)\n"
+            << "--prefetch <8> (indices rendered ahead of each read)\n"
+            << "--prefetch-threads <2>\n"
+            << "--epochs <1> (read passes over the dataset)\n"
+            << "--shuffle <seed> (read each epoch in a seeded random order)\n"
+            << "--limit <all> (records to read per epoch)\n"
+            << "--export <dir> (write dataN.wav and features/dataN.slft for the records read)\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static bool ParseDouble(std::string_view source, double &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+int main(int argc, char **argv) {
+  std::string source;
+  std::string feature_resolution;
+  std::string export_dir;
+  double crop_seconds = 5.0;
+  double sample_time = 5.0;
+  std::size_t cache_mb = 512;
+  std::size_t epochs = 1;
+  std::size_t limit = 0;
+  std::size_t shuffle_seed = 0;
+  bool shuffle = false;
+  dataset::VirtualDatasetOptions options;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if (arg == "--no-audio") {
+      options.render_audio = false;
+    } else if (i + 1 < argc && arg.starts_with("-")) {
+      const std::string_view value = argv[++i];
+      if (arg == "--features") {
+        feature_resolution = value;
+      } else if (arg == "--crop-seconds") {
+        parsed = ParseDouble(value, crop_seconds);
+      } else if ((arg == "-t") || (arg == "--sample-time")) {
+        parsed = ParseDouble(value, sample_time) && sample_time > 0.0;
+      } else if (arg == "--cache-mb") {
+        parsed = ParseSize(value, cache_mb);
+      } else if (arg == "--prefetch") {
+        parsed = ParseSize(value, options.prefetch_depth);
+      } else if (arg == "--prefetch-threads") {
+        parsed = ParseSize(value, options.prefetch_threads);
+      } else if (arg == "--epochs") {
+        parsed = ParseSize(value, epochs);
+      } else if (arg == "--shuffle") {
+        parsed = ParseSize(value, shuffle_seed);
+        shuffle = true;
+      } else if (arg == "--limit") {
+        parsed = ParseSize(value, limit);
+      } else if (arg == "--export") {
+        export_dir = value;
+      } else {
+        parsed = false;
+      }
+    } else if (source.empty() && !arg.starts_with("-")) {
+      source = arg;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (source.empty() || (!options.render_audio && feature_resolution.empty())) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  try {
+    if (!feature_resolution.empty()) {
+      dsp::FeatureSpec spec;
+      spec.crop_seconds = crop_seconds;
+      options.features = spec.WithResolution(feature_resolution);
+    }
+    options.sample_count = static_cast<std::size_t>(sample_time * SAMPLE_RATE);
+    options.cache_bytes = cache_mb << 20U;
+
+    auto records = dataset::LoadParameterRecords(source);
+    std::uint64_t parameter_bytes = 0;
+    for (const auto &record : records) {
+      parameter_bytes += record.parameters.size();
+    }
+    dataset::VirtualDataset virtual_dataset(std::move(records), options);
+    const std::size_t reads_per_epoch = limit == 0U ? virtual_dataset.Size() : std::min(limit, virtual_dataset.Size());
+    std::cout << "Virtual dataset: " << virtual_dataset.Size() << " records, " << parameter_bytes << " parameter bytes" << std::endl;
+
+    if (!export_dir.empty()) {
+      std::filesystem::create_directories(std::filesystem::path(export_dir) / "features");
+    }
+    std::mt19937_64 shuffle_engine(shuffle_seed);
+    std::uint64_t materialized_bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t epoch = 0; epoch < epochs; ++epoch) {
+      std::vector<std::size_t> order(virtual_dataset.Size());
+      std::iota(order.begin(), order.end(), 0U);
+      if (shuffle) {
+        std::shuffle(order.begin(), order.end(), shuffle_engine);
+      }
+      order.resize(reads_per_epoch);
+      for (std::size_t position = 0; position < order.size(); ++position) {
+        if (shuffle) {
+          // Sequential reads prefetch their successors; shuffled reads hint the upcoming order instead.
+          const auto ahead_end = std::min(order.size(), position + 1 + options.prefetch_depth);
+          virtual_dataset.Prefetch(std::vector<std::size_t>(order.begin() + static_cast<std::ptrdiff_t>(position + 1),
+                                                            order.begin() + static_cast<std::ptrdiff_t>(ahead_end)));
+        }
+        const std::size_t index = order[position];
+        const auto sample = virtual_dataset.Get(index);
+        materialized_bytes += sample->Bytes();
+        if (!export_dir.empty() && epoch == 0U) {
+          const auto base = std::filesystem::path(export_dir);
+          const auto &record = virtual_dataset.Record(index);
+          if (!sample->audio.empty()) {
+            filewriter::wave::MonoWriter(sample->audio).Write((base / (record.id + ".wav")).string());
+          }
+          if (const auto *extractor = virtual_dataset.Extractor()) {
+            filewriter::slft::Write((base / "features" / (record.id + ".slft")).string(), extractor->Header(), sample->features);
+          }
+        }
+      }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto stats = virtual_dataset.Stats();
+    const double reads = static_cast<double>(reads_per_epoch * epochs);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Read " << reads_per_epoch * epochs << " samples in " << seconds << " s: " << reads / std::max(seconds, 1e-9) << " samples/s\n";
+    std::cout << "cache: hit rate " << 100.0 * stats.HitRate() << "% (" << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.prefetch_hits << " prefetched), " << stats.evictions << " evictions, " << stats.cached_samples << " samples / "
+              << static_cast<double>(stats.cached_bytes) / 1e6 << " MB resident\n";
+    std::cout << "render: " << stats.renders << " renders, " << stats.render_seconds / std::max<double>(1.0, static_cast<double>(stats.renders)) * 1e3
+              << " ms each\n";
+    if (parameter_bytes > 0U && reads > 0.0) {
+      std::cout << "storage: " << static_cast<double>(materialized_bytes) / reads / (static_cast<double>(parameter_bytes) / static_cast<double>(virtual_dataset.Size()))
+                << "x smaller than materialized samples" << std::endl;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
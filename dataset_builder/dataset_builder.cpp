@@ -14,21 +14,35 @@
 #include "dataset_builder/dataset_builder.h"
 
 #include <algorithm>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "dataset_builder/generation_pipeline.h"
+#include "dsp/augmentation.h"
+#include "dsp/feature_extractor.h"
 #include "include/common.h"
-#include "include/filewriter.h"
+#include "include/filereader.h"
+#include "include/lossless_audio.h"
 #include "instrument/instrument_model.h"
 
+static std::atomic<bool> stop_requested{false};
+
+static void RequestStop(int) { stop_requested = true; }
+
 static inline void AppUsage() {
   std::cerr << "Usage: \n"
             << "-h --help\n"
@@ -48,7 +62,38 @@ static inline void AppUsage() {
             << "--coupled-frequency-factors <csv of 0..1 factors>\n"
             << "--require-fundamental (force one coupled oscillator to 1.0*f0)\n"
             << "-t --sample-time <5>\n"
-            << "-d --data_save <'data'> (save data)"
+            << "--seed <random> (run seed, samples are a pure function of seed and index)\n"
+            << "--only-indices <csv of indices or ranges, e.g. 3,17,40-49> (regenerate a subset of the -p/-n range)\n"
+            << "--shard-output <dir> (pack samples into shard_NNNNN.sls containers instead of loose files)\n"
+            << "--shard-size <1024> (samples per shard file)\n"
+            << "-j --jobs <1> (render threads)\n"
+            << "--writer-threads <1> (file writer threads, shard output always uses one)\n"
+            << "--queue-depth <2 x jobs> (rendered samples buffered ahead of the writers)\n"
+            << "--write-batch <16> (samples submitted per writer batch)\n"
+            << "--no-io-uring (force the pwritev writer)\n"
+            << "--features <FxT[,FxT...]> (write SLFT feature tensors and metadata JSON, e.g. 128x128,256x64)\n"
+            << "--crop-seconds <5> (feature crop window)\n"
+            << "--crop-start-seconds <0>\n"
+            << "--fft-size-multiplier <4> (FFT size = max(256, bins * multiplier))\n"
+            << "--no-wav (skip the .wav files, features and labels are still written)\n"
+            << "--audio-format <wav|slac> (slac: lossless compressed dataN.slac instead of dataN.wav)\n"
+            << "--slac-lpc-order <12> (0..32, lower decodes faster, higher compresses better)\n"
+            << "--augment-variants <0> (augmented copies of each render, written as dataN_augVV next to dataN)\n"
+            << "--augment-only (write the augmented variants without the clean sample)\n"
+            << "--augment-gain-db <-3,3> (gain range)\n"
+            << "--augment-snr-db <28,42> (noise SNR range)\n"
+            << "--augment-noise <white,pink,brown> (noise colours to draw from, or none)\n"
+            << "--augment-shift-ms <50> (maximum delay or advance)\n"
+            << "--augment-wet <0,0.25> (convolution dry/wet range)\n"
+            << "--augment-ir <wav[,wav...]> (impulse responses at 44.1 kHz, or none; default: synthetic rooms)\n"
+            << "--augment-rooms <8> (synthetic room impulse responses generated from the run seed)\n"
+            << "--instrument-format <csv> (parameters as csv dataN.data, slin dataN.slin exact binary, or both)\n"
+            << "--no-index (skip index.slix, the columnar metadata and audio statistics index)\n"
+            << "--render-cache <dir> (reuse renders and clean features cached by earlier runs, store new ones)\n"
+            << "--render-cache-mb <4096> (cache size cap, least recently used entries are evicted)\n"
+            << "--shm-ring <name> (daemon: stream features and targets into a shared-memory ring, needs --features)\n"
+            << "--ring-slots <64> (slots in the shared-memory ring)\n"
+            << "-d --data_save <'data'> (output path prefix)\n"
             << "-p --startpoint <0> (save data)" << std::endl;
 }
 
@@ -62,6 +107,86 @@ static bool ParseDouble(std::string_view source, double &out) {
   return result.ec == std::errc{} && result.ptr == source.data() + source.size();
 }
 
+static bool ParseSeed(std::string_view source, std::uint64_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+// "3,17,40-49" into inclusive ranges; expanded once the run's index range is known.
+static bool ParseIndexList(std::string_view source, std::vector<std::pair<std::size_t, std::size_t>> &out) {
+  std::stringstream stream{std::string(source)};
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    const std::string_view view = item;
+    const auto dash = view.find('-');
+    std::size_t first = 0;
+    std::size_t last = 0;
+    if (dash == std::string_view::npos) {
+      if (!ParseSize(view, first)) {
+        return false;
+      }
+      last = first;
+    } else if (!ParseSize(view.substr(0, dash), first) || !ParseSize(view.substr(dash + 1), last) || last < first) {
+      return false;
+    }
+    out.emplace_back(first, last);
+  }
+  return !out.empty();
+}
+
+// "min,max" into an ordered pair.
+static bool ParseRange(std::string_view source, double &min, double &max) {
+  const auto comma = source.find(',');
+  return comma != std::string_view::npos && ParseDouble(source.substr(0, comma), min) &&
+         ParseDouble(source.substr(comma + 1), max) && min <= max;
+}
+
+static bool ParseNoiseColors(std::string_view source, dsp::AugmentationSpec &spec) {
+  spec.noise_colors.clear();
+  spec.noise = source != "none";
+  std::stringstream stream{std::string(source)};
+  std::string item;
+  while (spec.noise && std::getline(stream, item, ',')) {
+    try {
+      spec.noise_colors.push_back(dsp::ParseNoiseColor(item));
+    } catch (const std::invalid_argument &) {
+      return false;
+    }
+  }
+  return !spec.noise || !spec.noise_colors.empty();
+}
+
+// Impulse response files, read once at startup into the augmenter's bank.
+static bool LoadImpulseResponses(std::string_view source, dsp::AugmentationSpec &spec) {
+  spec.convolution = source != "none";
+  std::stringstream stream{std::string(source)};
+  std::string item;
+  while (spec.convolution && std::getline(stream, item, ',')) {
+    try {
+      // Any PCM or float layout; stereo responses are downmixed.
+      spec.impulse_responses.push_back(filereader::wave::WaveReaderC(item).ToMonoFloatWave());
+    } catch (const std::exception &error) {
+      std::cerr << "Unable to read impulse response " << item << ": " << error.what() << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ParseFeatureSpecs(std::string_view source, const dsp::FeatureSpec &base,
+                              std::vector<dsp::FeatureSpec> &out) {
+  std::stringstream stream{std::string(source)};
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    try {
+      out.push_back(base.WithResolution(item));
+    } catch (const std::invalid_argument &) {
+      return false;
+    }
+  }
+  return !out.empty();
+}
+
 static bool ParseFrequencyFactorList(std::string_view source, std::vector<double> &out) {
   std::stringstream stream{std::string(source)};
   std::string item;
@@ -75,6 +200,58 @@ static bool ParseFrequencyFactorList(std::string_view source, std::vector<double
   return !out.empty();
 }
 
+/*
+ * Daemon mode: render `indices`, or every index from first_index on when there are
+ * none, and stream their features and targets into a shared-memory ring until the
+ * consumer closes it, a signal arrives or all indices were published.
+ * @returns exit code
+ */
+static int RunRingDaemon(const DataBuilder &builder, const FeatureExtractors &features,
+                         const std::shared_ptr<const dsp::Augmenter> &augmenter,
+                         const std::shared_ptr<instrument::RenderCache> &cache, const std::string &ring_name,
+                         std::size_t slots, std::size_t max_oscillators,
+                         const std::optional<std::vector<std::size_t>> &indices, std::size_t first_index,
+                         std::size_t render_threads, bool keep_clean) {
+  std::signal(SIGINT, RequestStop);
+  std::signal(SIGTERM, RequestStop);
+  const auto &spec = features.front()->Spec();
+  dataset::ring::RingShape shape;
+  shape.slot_count = static_cast<uint32_t>(slots);
+  shape.sample_rate = spec.sample_rate;
+  shape.channels = static_cast<uint32_t>(dsp::FeatureExtractor::k_channels);
+  shape.frequency_bins = static_cast<uint32_t>(spec.frequency_bins);
+  shape.time_frames = static_cast<uint32_t>(spec.time_frames);
+  shape.max_oscillators = static_cast<uint32_t>(std::max<std::size_t>(1U, max_oscillators));
+  try {
+    dataset::ring::RingProducer producer(ring_name, shape);
+    std::cout << "Streaming " << spec.Name() << " features into shared-memory ring " << producer.Name() << " (" << slots
+              << " slots)" << std::endl;
+    PipelineOptions options;
+    options.render_threads = render_threads;
+    options.writer_threads = 1;
+    options.write_batch = 1;
+    options.features = features;
+    options.augment = augmenter;
+    options.keep_clean = keep_clean;
+    options.cache = cache;
+    options.stop = &stop_requested;
+    options.make_sink = [&](std::size_t) -> std::unique_ptr<SampleSink> {
+      return std::make_unique<RingSink>(producer, stop_requested);
+    };
+    GenerationPipeline pipeline(builder, std::move(options));
+    const PipelineReport report =
+        indices ? pipeline.Run(*indices, std::cout) : pipeline.RunUnbounded(first_index, std::cout);
+    producer.Finish();
+    report.Print(std::cout);
+    std::cout << "ring: published " << producer.Published() << " samples, waited on a full ring "
+              << producer.FullWaits() << " times" << std::endl;
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
+
 int main(int argc, char **argv) {
   // Application defaults.
   std::size_t min_coupled_oscilators = 50;
@@ -90,6 +267,31 @@ int main(int argc, char **argv) {
   double max_frequency_factor = 1.0;
   bool require_fundamental = false;
   std::vector<double> coupled_frequency_factors;
+  std::uint64_t run_seed = (static_cast<std::uint64_t>(std::random_device{}()) << 32U) | std::random_device{}();
+  std::vector<std::pair<std::size_t, std::size_t>> only_indices;
+  std::string data_output = "data";
+  std::string shard_output;
+  std::size_t shard_size = 1024;
+  std::size_t render_threads = 1;
+  std::size_t writer_threads = 1;
+  std::size_t queue_depth = 0;
+  std::size_t write_batch = 16;
+  bool allow_io_uring = true;
+  bool write_wav = true;
+  std::string audio_format = "wav";
+  std::string instrument_format = "csv";
+  lossless::EncoderOptions slac_options;
+  std::string feature_resolutions;
+  dsp::FeatureSpec feature_base;
+  std::string shm_ring;
+  std::size_t ring_slots = 64;
+  bool dataset_size_set = false;
+  dsp::AugmentationSpec augment_spec;
+  augment_spec.variants = 0;
+  double augment_shift_ms = 50.0;
+  bool augment_only = false;
+  bool write_index = true;
+  instrument::RenderCache::Options cache_options;
 
   // Parse arguments.
   for (int i = 1; i < argc; i++) {
@@ -102,18 +304,44 @@ int main(int argc, char **argv) {
       require_fundamental = true;
       continue;
     }
-    if (((arg1 == "-n") || (arg1 == "--dataset-size") || (arg1 == "-m") || (arg1 == "--midi") || (arg1 == "-s") || (arg1 == "--instrument-size") ||
-         (arg1 == "--min-instrument-size") || (arg1 == "--max-instrument-size") || (arg1 == "-d") || (arg1 == "--data_save") ||
-         (arg1 == "-c") || (arg1 == "--uncoupled-oscilators") || (arg1 == "--min-uncoupled-oscilators") || (arg1 == "--max-uncoupled-oscilators") ||
-         (arg1 == "--note-frequency") || (arg1 == "--min-note-frequency") || (arg1 == "--max-note-frequency") || (arg1 == "-p") ||
-         (arg1 == "--frequency-factor") || (arg1 == "--min-frequency-factor") || (arg1 == "--max-frequency-factor") ||
-         (arg1 == "--coupled-frequency-factors") ||
-         (arg1 == "-t") || (arg1 == "--sample-time") || (arg1 == "--startpoint")) &&
+    if (arg1 == "--no-io-uring") {
+      allow_io_uring = false;
+      continue;
+    }
+    if (arg1 == "--no-wav") {
+      write_wav = false;
+      continue;
+    }
+    if (arg1 == "--no-index") {
+      write_index = false;
+      continue;
+    }
+    if (arg1 == "--augment-only") {
+      augment_only = true;
+      continue;
+    }
+    if (((arg1 == "-n") || (arg1 == "--dataset-size") || (arg1 == "-m") || (arg1 == "--midi") || (arg1 == "-s") ||
+         (arg1 == "--instrument-size") || (arg1 == "--min-instrument-size") || (arg1 == "--max-instrument-size") ||
+         (arg1 == "-d") || (arg1 == "--data_save") || (arg1 == "-c") || (arg1 == "--uncoupled-oscilators") ||
+         (arg1 == "--min-uncoupled-oscilators") || (arg1 == "--max-uncoupled-oscilators") ||
+         (arg1 == "--note-frequency") || (arg1 == "--min-note-frequency") || (arg1 == "--max-note-frequency") ||
+         (arg1 == "-p") || (arg1 == "--frequency-factor") || (arg1 == "--min-frequency-factor") ||
+         (arg1 == "--max-frequency-factor") || (arg1 == "--coupled-frequency-factors") || (arg1 == "--seed") ||
+         (arg1 == "--only-indices") || (arg1 == "--shard-output") || (arg1 == "--shard-size") || (arg1 == "-j") ||
+         (arg1 == "--jobs") || (arg1 == "--writer-threads") || (arg1 == "--queue-depth") || (arg1 == "--write-batch") ||
+         (arg1 == "--features") || (arg1 == "--audio-format") || (arg1 == "--instrument-format") ||
+         (arg1 == "--slac-lpc-order") || (arg1 == "--shm-ring") || (arg1 == "--ring-slots") ||
+         (arg1 == "--augment-variants") || (arg1 == "--augment-gain-db") || (arg1 == "--augment-snr-db") ||
+         (arg1 == "--augment-noise") || (arg1 == "--augment-shift-ms") || (arg1 == "--augment-wet") ||
+         (arg1 == "--augment-ir") || (arg1 == "--augment-rooms") || (arg1 == "--render-cache") ||
+         (arg1 == "--render-cache-mb") || (arg1 == "--crop-seconds") || (arg1 == "--crop-start-seconds") ||
+         (arg1 == "--fft-size-multiplier") || (arg1 == "-t") || (arg1 == "--sample-time") ||
+         (arg1 == "--startpoint")) &&
         (i + 1 < argc)) {
       const std::string_view arg2 = argv[++i];
       std::cout << arg1 << " " << arg2 << std::endl;
       if ((arg1 == "-n") || (arg1 == "--dataset-size")) {
-        ParseSize(arg2, dataset_size);
+        dataset_size_set = ParseSize(arg2, dataset_size);
       } else if ((arg1 == "-c") || (arg1 == "--uncoupled-oscilators")) {
         ParseSize(arg2, min_uncoupled_oscilators);
         max_uncoupled_oscilators = min_uncoupled_oscilators;
@@ -151,6 +379,94 @@ int main(int argc, char **argv) {
           std::cerr << "--coupled-frequency-factors must be a comma-separated list of normalized values from 0.0 to 1.0." << std::endl;
           return EXIT_BAD_ARGS;
         }
+      } else if (arg1 == "--seed") {
+        if (!ParseSeed(arg2, run_seed)) {
+          std::cerr << "--seed must be an unsigned 64-bit integer." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if (arg1 == "--only-indices") {
+        if (!ParseIndexList(arg2, only_indices)) {
+          std::cerr << "--only-indices must be a comma-separated list of indices or first-last ranges." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if ((arg1 == "-d") || (arg1 == "--data_save")) {
+        data_output = arg2;
+      } else if (arg1 == "--shard-output") {
+        shard_output = arg2;
+      } else if (arg1 == "--shard-size") {
+        if (!ParseSize(arg2, shard_size) || shard_size == 0U) {
+          std::cerr << "--shard-size must be a positive sample count." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if ((arg1 == "-j") || (arg1 == "--jobs")) {
+        ParseSize(arg2, render_threads);
+      } else if (arg1 == "--writer-threads") {
+        ParseSize(arg2, writer_threads);
+      } else if (arg1 == "--queue-depth") {
+        ParseSize(arg2, queue_depth);
+      } else if (arg1 == "--write-batch") {
+        ParseSize(arg2, write_batch);
+      } else if (arg1 == "--shm-ring") {
+        shm_ring = arg2;
+      } else if (arg1 == "--ring-slots") {
+        if (!ParseSize(arg2, ring_slots) || ring_slots == 0U || ring_slots > std::numeric_limits<uint32_t>::max()) {
+          std::cerr << "--ring-slots must be a positive slot count." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if (arg1 == "--features") {
+        feature_resolutions = arg2;
+      } else if (arg1 == "--audio-format") {
+        audio_format = arg2;
+      } else if (arg1 == "--instrument-format") {
+        instrument_format = arg2;
+      } else if (arg1 == "--slac-lpc-order") {
+        std::size_t order = 0;
+        if (!ParseSize(arg2, order) || order > lossless::k_max_lpc_order) {
+          std::cerr << "--slac-lpc-order must be between 0 and " << lossless::k_max_lpc_order << "." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+        slac_options.max_lpc_order = static_cast<uint32_t>(order);
+      } else if (arg1 == "--augment-variants") {
+        ParseSize(arg2, augment_spec.variants);
+      } else if (arg1 == "--augment-gain-db" || arg1 == "--augment-snr-db" || arg1 == "--augment-wet") {
+        double &min = arg1 == "--augment-gain-db"  ? augment_spec.gain_db_min
+                      : arg1 == "--augment-snr-db" ? augment_spec.snr_db_min
+                                                   : augment_spec.wet_min;
+        double &max = arg1 == "--augment-gain-db"  ? augment_spec.gain_db_max
+                      : arg1 == "--augment-snr-db" ? augment_spec.snr_db_max
+                                                   : augment_spec.wet_max;
+        if (!ParseRange(arg2, min, max)) {
+          std::cerr << arg1 << " must be a min,max pair with min <= max." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if (arg1 == "--augment-noise") {
+        if (!ParseNoiseColors(arg2, augment_spec)) {
+          std::cerr << "--augment-noise must be a comma-separated list of white, pink and brown, or none." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+      } else if (arg1 == "--augment-shift-ms") {
+        ParseDouble(arg2, augment_shift_ms);
+      } else if (arg1 == "--augment-ir") {
+        if (!LoadImpulseResponses(arg2, augment_spec)) {
+          return EXIT_READ_FILE_FAILED;
+        }
+      } else if (arg1 == "--augment-rooms") {
+        ParseSize(arg2, augment_spec.synthetic_rooms);
+      } else if (arg1 == "--render-cache") {
+        cache_options.directory = arg2;
+      } else if (arg1 == "--render-cache-mb") {
+        std::size_t megabytes = 0;
+        if (!ParseSize(arg2, megabytes) || megabytes == 0U) {
+          std::cerr << "--render-cache-mb must be a positive size." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+        cache_options.max_bytes = static_cast<uint64_t>(megabytes) << 20U;
+      } else if (arg1 == "--crop-seconds") {
+        ParseDouble(arg2, feature_base.crop_seconds);
+      } else if (arg1 == "--crop-start-seconds") {
+        ParseDouble(arg2, feature_base.crop_start_seconds);
+      } else if (arg1 == "--fft-size-multiplier") {
+        ParseSize(arg2, feature_base.fft_size_multiplier);
       } else {
         std::cerr << "--destination option requires one argument." << std::endl;
         return EXIT_BAD_ARGS;
@@ -164,6 +480,14 @@ int main(int argc, char **argv) {
     std::cerr << "Minimum oscillator counts must be less than or equal to maximum counts." << std::endl;
     return EXIT_BAD_ARGS;
   }
+  // Checked after the loop because -n and -p may follow --only-indices.
+  for (const auto &[first, last] : only_indices) {
+    if (first < starting_point || last - starting_point >= dataset_size) {
+      std::cerr << "--only-indices " << first << "-" << last << " lies outside the run's " << dataset_size
+                << " samples starting at " << starting_point << " (set by -n and -p)." << std::endl;
+      return EXIT_BAD_ARGS;
+    }
+  }
   if (min_note_frequency <= 0.0 || max_note_frequency <= 0.0) {
     std::cerr << "Note frequencies must be positive." << std::endl;
     return EXIT_BAD_ARGS;
@@ -173,73 +497,291 @@ int main(int argc, char **argv) {
     return EXIT_BAD_ARGS;
   }
 
-  auto builder = DataBuilder(sample_time, min_coupled_oscilators, max_coupled_oscilators, min_uncoupled_oscilators, max_uncoupled_oscilators,
-                             starting_point, min_note_frequency, max_note_frequency, min_frequency_factor, max_frequency_factor,
-                             require_fundamental, coupled_frequency_factors);
-  for (std::size_t i = 0; i < dataset_size; ++i) {
-    builder.DataBuildJob(i);
+  // Parsed after the loop so --crop-seconds and friends apply regardless of order.
+  std::vector<dsp::FeatureSpec> feature_specs;
+  if (!feature_resolutions.empty() && !ParseFeatureSpecs(feature_resolutions, feature_base, feature_specs)) {
+    std::cerr << "--features must be a comma-separated list of FxT resolutions, e.g. 128x128." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (!shm_ring.empty() && (feature_specs.size() != 1U || !shard_output.empty())) {
+    std::cerr << "--shm-ring needs exactly one --features resolution and no --shard-output." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (audio_format != "wav" && audio_format != "slac") {
+    std::cerr << "--audio-format must be wav or slac." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  const bool lossless_audio = audio_format == "slac";
+  if (instrument_format != "csv" && instrument_format != "slin" && instrument_format != "both") {
+    std::cerr << "--instrument-format must be csv, slin or both." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (instrument_format != "csv" && (!shard_output.empty() || !shm_ring.empty())) {
+    std::cerr << "--instrument-format applies to loose file output; shards and the ring carry the CSV." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (!shard_output.empty() && (!feature_specs.empty() || !write_wav || lossless_audio)) {
+    std::cerr << "--features, --no-wav and --audio-format slac apply to loose file output, not --shard-output."
+              << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (lossless_audio && !write_wav) {
+    std::cerr << "--audio-format slac and --no-wav are mutually exclusive." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  if (feature_base.crop_seconds <= 0.0 || feature_base.crop_start_seconds < 0.0 ||
+      feature_base.fft_size_multiplier == 0U) {
+    std::cerr << "--crop-seconds and --fft-size-multiplier must be positive, --crop-start-seconds non-negative."
+              << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+
+  std::shared_ptr<const dsp::Augmenter> augmenter;
+  if (augment_spec.variants > 0U) {
+    if (!shard_output.empty()) {
+      std::cerr << "--augment-variants applies to loose file and --shm-ring output, not --shard-output." << std::endl;
+      return EXIT_BAD_ARGS;
+    }
+    augment_spec.max_shift_seconds = std::max(0.0, augment_shift_ms) / 1000.0;
+    augment_spec.room_seed = run_seed;
+    try {
+      augmenter = std::make_shared<const dsp::Augmenter>(augment_spec);
+    } catch (const std::invalid_argument &error) {
+      std::cerr << error.what() << std::endl;
+      return EXIT_BAD_ARGS;
+    }
+  } else if (augment_only) {
+    std::cerr << "--augment-only needs --augment-variants." << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+
+  std::shared_ptr<instrument::RenderCache> cache;
+  if (!cache_options.directory.empty()) {
+    try {
+      cache = std::make_shared<instrument::RenderCache>(cache_options);
+    } catch (const std::runtime_error &error) {
+      std::cerr << error.what() << std::endl;
+      return EXIT_WRITE_FILE_FAILED;
+    }
+  }
+
+  LooseFileLayout layout;
+  layout.prefix = data_output;
+  layout.write_wav = write_wav;
+  layout.lossless_audio = lossless_audio;
+  layout.write_csv = instrument_format != "slin";
+  layout.write_slin = instrument_format != "csv";
+  for (const auto &spec : feature_specs) {
+    layout.features.push_back(std::make_shared<const dsp::FeatureExtractor>(spec));
+  }
+  if (shard_output.empty() && shm_ring.empty()) {
+    std::error_code error;
+    for (std::size_t i = 0; i < layout.features.size(); ++i) {
+      std::filesystem::create_directories(layout.FeatureDirectory(i), error);
+    }
+    if (!layout.features.empty()) {
+      std::filesystem::create_directories(layout.MetadataDirectory(), error);
+    }
+  }
+
+  const auto builder =
+      DataBuilder(sample_time, min_coupled_oscilators, max_coupled_oscilators, min_uncoupled_oscilators,
+                  max_uncoupled_oscilators, min_note_frequency, max_note_frequency, min_frequency_factor,
+                  max_frequency_factor, require_fundamental, coupled_frequency_factors, run_seed);
+  std::cout << "Run seed: " << builder.GetRunSeed() << std::endl;
+  std::vector<std::size_t> sample_indices;
+  for (const auto &[first, last] : only_indices) {
+    for (std::size_t index = first; index <= last; ++index) {
+      sample_indices.push_back(index);
+    }
+  }
+  if (sample_indices.empty()) {
+    sample_indices.resize(dataset_size);
+    std::iota(sample_indices.begin(), sample_indices.end(), starting_point);
+  }
+
+  if (!shm_ring.empty()) {
+    return RunRingDaemon(builder, layout.features, augmenter, cache, shm_ring, ring_slots,
+                         max_coupled_oscilators + max_uncoupled_oscilators,
+                         dataset_size_set || !only_indices.empty() ? std::optional(sample_indices) : std::nullopt,
+                         starting_point, render_threads, !augment_only);
+  }
+
+  PipelineOptions options;
+  options.render_threads = render_threads;
+  options.writer_threads = shard_output.empty() ? writer_threads : 1U;
+  options.queue_depth = queue_depth;
+  options.write_batch = write_batch;
+  options.features = layout.features;
+  options.augment = augmenter;
+  options.keep_clean = !augment_only;
+  options.cache = cache;
+  // Merged with an existing index so partial regenerations keep the rows they did not touch.
+  const auto index_root = std::filesystem::path(shard_output.empty() ? layout.DatasetRoot() : shard_output);
+  const auto index_path = (index_root / "index.slix").string();
+  if (write_index) {
+    options.index = std::make_shared<dataset::index::IndexBuilder>(SAMPLE_RATE);
+    if (std::filesystem::exists(index_path)) {
+      try {
+        options.index->Merge(dataset::index::MetadataIndex(index_path));
+      } catch (const std::exception &error) {
+        std::cerr << "Replacing unreadable index: " << error.what() << std::endl;
+      }
+    }
+  }
+  const auto index = options.index;
+  if (lossless_audio) {
+    options.encode_audio = slac_options;
+  }
+  options.make_sink = [&](std::size_t) -> std::unique_ptr<SampleSink> {
+    if (!shard_output.empty()) {
+      return std::make_unique<ShardSink>(shard_output, shard_size);
+    }
+    return std::make_unique<LooseFileSink>(layout, allow_io_uring);
+  };
+  try {
+    GenerationPipeline pipeline(builder, std::move(options));
+    const PipelineReport report = pipeline.Run(sample_indices, std::cout);
+    report.Print(std::cout);
+    if (index) {
+      index->Write(index_path);
+      std::cout << "index: " << index_path << std::endl;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
   }
 
   return EXIT_NORMAL;
 }
 
-void DataBuilder::DataBuildJob(std::size_t index) {
-  const auto sample_index = starting_index + index;
+// splitmix64 finaliser: spreads nearby inputs over the whole 64-bit range.
+static std::uint64_t SplitMix(std::uint64_t value) {
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27U)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31U);
+}
+
+// Stream tag for augmentation variants. Render engines are untagged, so their seed
+// sequences are one tag shorter and never equal a variant's.
+static constexpr std::uint64_t k_variant_stream = 0x76617269616E7400ULL; // "variant"
+
+/*
+ * Derive the random engine for one sample. The (seed, index) pair is mixed with
+ * splitmix64 so neighbouring indices get unrelated engine states.
+ * @parameters: seed (run seed), sample_index (absolute sample index)
+ * @returns: seeded engine
+ */
+std::mt19937 DataBuilder::SampleEngine(std::uint64_t seed, std::size_t sample_index) {
+  const std::uint64_t mixed = SplitMix(seed ^ SplitMix(static_cast<std::uint64_t>(sample_index)));
+  std::seed_seq seq{static_cast<std::uint32_t>(mixed), static_cast<std::uint32_t>(mixed >> 32U),
+                    static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32U)};
+  return std::mt19937(seq);
+}
+
+/*
+ * Derive the random engine for one augmented variant. Same splitmix64 derivation as
+ * SampleEngine with the variant folded into the index hash under its own stream tag,
+ * so no variant shares a state with any render engine or any other variant.
+ * @parameters: seed (run seed), sample_index (absolute sample index), variant
+ * @returns: seeded engine
+ */
+std::mt19937 DataBuilder::VariantEngine(std::uint64_t seed, std::size_t sample_index, std::size_t variant) {
+  const std::uint64_t stream = SplitMix(k_variant_stream ^ SplitMix(static_cast<std::uint64_t>(variant)));
+  const std::uint64_t mixed = SplitMix(seed ^ SplitMix(static_cast<std::uint64_t>(sample_index) ^ stream));
+  std::seed_seq seq{static_cast<std::uint32_t>(mixed),  static_cast<std::uint32_t>(mixed >> 32U),
+                    static_cast<std::uint32_t>(seed),   static_cast<std::uint32_t>(seed >> 32U),
+                    static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32U)};
+  return std::mt19937(seq);
+}
+
+/*
+ * Render one sample and its label text. Depends only on the configuration, the
+ * run seed and the sample index.
+ * @parameters: sample_index (absolute sample index)
+ * @returns: the sample, or nothing when the oscillator count resolved to zero
+ */
+std::optional<RenderedSample> DataBuilder::RenderSample(std::size_t sample_index,
+                                                        instrument::RenderCache *cache) const {
+  std::mt19937 rand_eng = SampleEngine(run_seed, sample_index);
   const auto coupled_count = std::uniform_int_distribution<std::size_t>(min_coupled_oscilators, max_coupled_oscilators)(rand_eng);
   const auto uncoupled_count = std::uniform_int_distribution<std::size_t>(min_uncoupled_oscilators, max_uncoupled_oscilators)(rand_eng);
   const double freq = std::uniform_real_distribution<double>(min_note_frequency, max_note_frequency)(rand_eng);
   const auto oscillator_count = coupled_count + uncoupled_count;
   if (oscillator_count == 0U) {
     std::cerr << "Skipping sample " << sample_index << " because oscillator count resolved to zero." << std::endl;
-    return;
+    return std::nullopt;
   }
   const double velocity = 1.0 / static_cast<double>(oscillator_count);
   instrument::InstrumentModel rand_instrument(0, 0, std::to_string(sample_index));
-  instrument::oscillator::StringOccilator::SetUntunedFrequencyFactorRange(min_frequency_factor, max_frequency_factor);
   for (std::size_t i = 0; i < uncoupled_count; ++i) {
-    rand_instrument.AddUntunedString(false);
+    rand_instrument.AddUntunedString(false, rand_eng, min_frequency_factor, max_frequency_factor);
   }
   if (!coupled_frequency_factors.empty()) {
     for (std::size_t i = 0; i < coupled_count; ++i) {
       if (i < coupled_frequency_factors.size()) {
         const double factor = coupled_frequency_factors[i];
-        instrument::oscillator::StringOccilator::SetUntunedFrequencyFactorRange(factor, factor);
+        rand_instrument.AddUntunedString(true, rand_eng, factor, factor);
       } else {
-        instrument::oscillator::StringOccilator::SetUntunedFrequencyFactorRange(min_frequency_factor, max_frequency_factor);
+        rand_instrument.AddUntunedString(true, rand_eng, min_frequency_factor, max_frequency_factor);
       }
-      rand_instrument.AddUntunedString(true);
     }
   } else if (require_fundamental && coupled_count > 0U) {
     constexpr double fundamental_factor = 1.5 / 7.0;
-    instrument::oscillator::StringOccilator::SetUntunedFrequencyFactorRange(fundamental_factor, fundamental_factor);
-    rand_instrument.AddUntunedString(true);
-    instrument::oscillator::StringOccilator::SetUntunedFrequencyFactorRange(min_frequency_factor, max_frequency_factor);
+    rand_instrument.AddUntunedString(true, rand_eng, fundamental_factor, fundamental_factor);
     for (std::size_t i = 1; i < coupled_count; ++i) {
-      rand_instrument.AddUntunedString(true);
+      rand_instrument.AddUntunedString(true, rand_eng, min_frequency_factor, max_frequency_factor);
     }
   } else {
     for (std::size_t i = 0; i < coupled_count; ++i) {
-      rand_instrument.AddUntunedString(true);
-    }
-  }
-  bool sample_has_distorted = false;
-  std::vector<int16_t> sample = rand_instrument.GenerateIntSignal(velocity, freq, num_samples, sample_has_distorted, false);
-
-  // Write out the sample to a mono .wav file
-  std::cout << "IDX: " << sample_index << "...\n";
-  const auto sample_id = std::string(data_output) + std::to_string(sample_index);
-  const auto wav_path = sample_id + ".wav";
-  const auto oscillator_path = sample_id + ".data";
-  filewriter::wave::MonoWriter wave_writer(sample);
-  wave_writer.Write(wav_path);
-
-  // Write out meta and data files
-  std::string instrument_data = rand_instrument.ToCsv(instrument::SortType::frequency);
-  std::string instrument_meta = std::to_string(freq) + "\n";
-  instrument_meta += std::to_string(velocity) + "\n";
-  instrument_meta += std::to_string(coupled_count) + "\n";
-  instrument_meta += std::to_string(uncoupled_count) + "\n";
-  filewriter::text::WriteFile(sample_id + ".meta", instrument_meta);
-  filewriter::text::WriteFile(oscillator_path, instrument_data);
-  std::cout << "done\n";
+      rand_instrument.AddUntunedString(true, rand_eng, min_frequency_factor, max_frequency_factor);
+    }
+  }
+  const auto partials = rand_instrument.PrimePartials(velocity, freq);
+  std::shared_ptr<const instrument::RenderKey> cache_key;
+  std::optional<std::vector<int16_t>> sample;
+  if (cache != nullptr) {
+    cache_key = std::make_shared<const instrument::RenderKey>(
+        instrument::RenderKey::Make(rand_instrument, freq, velocity, num_samples, SAMPLE_RATE, false));
+    sample = cache->LoadAudio(*cache_key);
+  }
+  if (!sample) {
+    const auto render_start = std::chrono::steady_clock::now();
+    bool sample_has_distorted = false;
+    sample = rand_instrument.GenerateIntSignal(velocity, freq, num_samples, sample_has_distorted, false);
+    if (cache != nullptr) {
+      cache->StoreAudio(*cache_key, *sample, std::chrono::steady_clock::now() - render_start);
+    }
+  }
+
+  RenderedSample rendered;
+  rendered.sample_index = sample_index;
+  rendered.note_frequency = freq;
+  rendered.velocity = velocity;
+  rendered.coupled_count = coupled_count;
+  rendered.uncoupled_count = uncoupled_count;
+  rendered.audio = std::move(*sample);
+  rendered.cache_key = std::move(cache_key);
+  rendered.stats = dataset::index::MeasureAudio(rendered.audio);
+  double lowest_coupled = 0.0;
+  double lowest_any = 0.0;
+  for (const auto &partial : partials) {
+    if (partial.peak_amplitude < dataset::index::k_active_partial_amplitude) {
+      continue;
+    }
+    ++rendered.stats.active_partials;
+    lowest_any = lowest_any == 0.0 ? partial.frequency : std::min(lowest_any, partial.frequency);
+    if (partial.coupled) {
+      lowest_coupled = lowest_coupled == 0.0 ? partial.frequency : std::min(lowest_coupled, partial.frequency);
+    }
+  }
+  rendered.stats.fundamental_hz = static_cast<float>(lowest_coupled > 0.0 ? lowest_coupled : lowest_any);
+  rendered.instrument = rand_instrument.ToRecords();
+  rendered.parameters = rand_instrument.ToCsv(instrument::SortType::frequency);
+  rendered.meta = std::to_string(freq) + "\n";
+  rendered.meta += std::to_string(velocity) + "\n";
+  rendered.meta += std::to_string(coupled_count) + "\n";
+  rendered.meta += std::to_string(uncoupled_count) + "\n";
+  return rendered;
 }
@@ -15,44 +15,76 @@
 #ifndef DATASET_BUILDER_H_
 #define DATASET_BUILDER_H_
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "dataset/metadata_index.h"
+#include "dsp/augmentation.h"
 #include "include/common.h"
+#include "instrument/render_cache.h"
+
+// One rendered sample with everything the legacy dataN.wav/.data/.meta files hold.
+struct RenderedSample {
+  std::size_t sample_index = 0;
+  double note_frequency = 0.0;
+  double velocity = 0.0;
+  std::size_t coupled_count = 0;
+  std::size_t uncoupled_count = 0;
+  std::vector<int16_t> audio;
+  std::string parameters;                              // Oscillator CSV, strings sorted by frequency.
+  std::vector<InstrumentStringRecord> instrument;      // The same strings, exact and in render order, for .slin output.
+  std::string meta;
+  std::vector<std::vector<float>> features;            // One SLFT tensor per configured feature spec.
+  std::vector<uint8_t> encoded_audio;                  // SLAC stream of audio when lossless audio output is enabled.
+  std::optional<dsp::AugmentationParams> augmentation; // Set on augmented variants, whose files get an _augVV suffix.
+  dataset::index::SampleStats stats;                   // Measured while rendering, for the metadata index.
+  std::shared_ptr<const instrument::RenderKey> cache_key; // Set when rendered through a render cache.
+};
 
 class DataBuilder {
 private:
-  static constexpr char data_output[] = "data";
   // Define the range.
   std::size_t num_samples;
   std::size_t min_coupled_oscilators;
   std::size_t max_coupled_oscilators;
   std::size_t min_uncoupled_oscilators;
   std::size_t max_uncoupled_oscilators;
-  std::size_t starting_index;
   double min_note_frequency;
   double max_note_frequency;
   double min_frequency_factor;
   double max_frequency_factor;
   bool require_fundamental;
   std::vector<double> coupled_frequency_factors;
-  std::mt19937 rand_eng;
+  std::uint64_t run_seed;
 
 public:
-  void DataBuildJob(std::size_t index);
+  // Every sample draws from its own engine seeded by (run seed, sample index), so any
+  // sample can be regenerated bit-exactly regardless of order or worker count.
+  static std::mt19937 SampleEngine(std::uint64_t seed, std::size_t sample_index);
+  // Engine for augmented variant `variant` of a sample, independent of the render engine.
+  static std::mt19937 VariantEngine(std::uint64_t seed, std::size_t sample_index, std::size_t variant);
+
+  // Thread safe: rendering only reads the builder's configuration. With a cache,
+  // the audio is loaded from it when present and stored into it otherwise.
+  std::optional<RenderedSample> RenderSample(std::size_t sample_index, instrument::RenderCache *cache = nullptr) const;
+  std::uint64_t GetRunSeed() const { return run_seed; }
 
   DataBuilder(std::size_t sample_time_secs, std::size_t min_coupled_count, std::size_t max_coupled_count,
-              std::size_t min_uncoupled_count = 0, std::size_t max_uncoupled_count = 0, std::size_t first_index = 0,
+              std::size_t min_uncoupled_count = 0, std::size_t max_uncoupled_count = 0,
               double min_note_freq = 1000.0, double max_note_freq = 1000.0, double min_freq_factor = 0.0,
               double max_freq_factor = 1.0, bool require_fundamental_oscillator = false,
-              std::vector<double> coupled_freq_factors = {}, std::size_t rand_seed = std::random_device{}())
+              std::vector<double> coupled_freq_factors = {}, std::uint64_t rand_seed = std::random_device{}())
       : num_samples(SAMPLE_RATE * sample_time_secs), min_coupled_oscilators(min_coupled_count),
         max_coupled_oscilators(std::max(min_coupled_count, max_coupled_count)), min_uncoupled_oscilators(min_uncoupled_count),
-        max_uncoupled_oscilators(std::max(min_uncoupled_count, max_uncoupled_count)), starting_index(first_index),
+        max_uncoupled_oscilators(std::max(min_uncoupled_count, max_uncoupled_count)),
         min_note_frequency(std::min(min_note_freq, max_note_freq)), max_note_frequency(std::max(min_note_freq, max_note_freq)),
         min_frequency_factor(std::min(min_freq_factor, max_freq_factor)), max_frequency_factor(std::max(min_freq_factor, max_freq_factor)),
         require_fundamental(require_fundamental_oscillator), coupled_frequency_factors(std::move(coupled_freq_factors)),
-        rand_eng(static_cast<std::mt19937::result_type>(rand_seed)) {}
+        run_seed(rand_seed) {}
 };
 #endif // DATASET_BUILDER_H_
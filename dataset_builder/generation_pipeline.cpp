@@ -0,0 +1,521 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dataset_builder/generation_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "include/filewriter.h"
+
+namespace {
+constexpr char k_newline[] = "\n";
+
+double Seconds(std::chrono::nanoseconds duration) { return std::chrono::duration<double>(duration).count(); }
+
+// "12" for a clean sample, "12_aug03" for its fourth augmented variant, as dataset_augmentor.py names them.
+std::string SampleKey(const RenderedSample &sample) {
+  std::string key = std::to_string(sample.sample_index);
+  if (sample.augmentation) {
+    const auto variant = std::to_string(sample.augmentation->variant);
+    key += "_aug" + std::string(variant.size() < 2U ? 2U - variant.size() : 0U, '0') + variant;
+  }
+  return key;
+}
+
+// Python's float repr: shortest round trip, integral values keep a trailing ".0".
+std::string JsonNumber(double value) {
+  char buffer[64];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  std::string text(buffer, result.ptr);
+  if (text.find_first_of(".en") == std::string::npos) {
+    text += ".0";
+  }
+  return text;
+}
+
+// Everything that shapes an extracted tensor, so cached features never outlive a spec or extractor change.
+std::string FeatureCacheTag(const dsp::FeatureSpec &spec) {
+  return "slft1:" + spec.Name() + ":" + JsonNumber(spec.crop_seconds) + ":" + JsonNumber(spec.crop_start_seconds) + ":" +
+         std::to_string(spec.fft_size_multiplier) + ":" + std::to_string(spec.sample_rate);
+}
+
+dataset::index::IndexRow MakeIndexRow(const RenderedSample &sample) {
+  dataset::index::IndexRow row;
+  row.sample_index = sample.sample_index;
+  row.variant = sample.augmentation ? static_cast<int32_t>(sample.augmentation->variant) : -1;
+  row.note_frequency = static_cast<float>(sample.note_frequency);
+  row.velocity = static_cast<float>(sample.velocity);
+  row.coupled_count = static_cast<uint16_t>(sample.coupled_count);
+  row.uncoupled_count = static_cast<uint16_t>(sample.uncoupled_count);
+  row.stats = sample.stats;
+  return row;
+}
+
+double AudioRms(std::span<const int16_t> audio) {
+  double energy = 0.0;
+  for (const int16_t value : audio) {
+    const double normalized = static_cast<double>(static_cast<float>(value) / 32768.0F);
+    energy += normalized * normalized;
+  }
+  return audio.empty() ? 0.0 : std::sqrt(energy / static_cast<double>(audio.size()));
+}
+
+// The .meta file stores "%f" text and prepare_dataset.py parses it back, so the
+// JSON target carries the same rounded value.
+double MetaValue(double value) { return std::stod(std::to_string(value)); }
+} // namespace
+
+std::string LooseFileLayout::DatasetRoot() const {
+  const auto parent = std::filesystem::path(prefix).parent_path();
+  return parent.empty() ? std::string(".") : parent.string();
+}
+
+std::string LooseFileLayout::FeatureDirectory(std::size_t feature) const {
+  const auto directory = std::filesystem::path(DatasetRoot());
+  return (feature == 0U ? directory / "features" : directory / ("features_" + features[feature]->Spec().Name())).string();
+}
+
+std::string LooseFileLayout::MetadataDirectory() const { return (std::filesystem::path(DatasetRoot()) / "metadata").string(); }
+
+LooseFileSink::LooseFileSink(LooseFileLayout file_layout, bool allow_io_uring)
+    : layout(std::move(file_layout)), root(layout.DatasetRoot()), sample_stem(std::filesystem::path(layout.prefix).filename().string()),
+      writer(allow_io_uring) {
+  for (std::size_t i = 0; i < layout.features.size(); ++i) {
+    feature_directories.push_back(layout.FeatureDirectory(i));
+    feature_headers.push_back(layout.features[i]->Header());
+  }
+}
+
+std::string LooseFileSink::Describe() const { return "files/" + std::string(writer.Backend()); }
+
+std::size_t LooseFileSink::Write(std::span<const RenderedSample> batch) {
+  using filewriter::async::AsBuffer;
+  std::vector<WavFileHeader> headers;
+  std::vector<InstrumentFileHeader> instrument_headers;
+  std::vector<std::string> metadata;
+  std::vector<filewriter::async::FileWrite> files;
+  // Buffers point into these vectors, so they must not reallocate.
+  headers.reserve(batch.size());
+  instrument_headers.reserve(batch.size());
+  metadata.reserve(batch.size());
+  files.reserve(batch.size() * (5U + feature_headers.size()));
+  for (const auto &sample : batch) {
+    const auto sample_path = layout.prefix + SampleKey(sample);
+    const auto sample_id = sample_stem + SampleKey(sample);
+    if (layout.lossless_audio) {
+      files.push_back({sample_path + ".slac", {AsBuffer(std::span(sample.encoded_audio))}});
+    } else if (layout.write_wav) {
+      headers.push_back(filewriter::wave::MakeMonoHeader(sample.audio.size()));
+      // Same bytes as MonoWriter and filewriter::text::WriteFile produce.
+      files.push_back({sample_path + ".wav", {AsBuffer(std::span<const WavFileHeader>(&headers.back(), 1)), AsBuffer(std::span(sample.audio))}});
+    }
+    files.push_back({sample_path + ".meta", {AsBuffer(sample.meta), AsBuffer(k_newline)}});
+    if (layout.write_csv) {
+      files.push_back({sample_path + ".data", {AsBuffer(sample.parameters), AsBuffer(k_newline)}});
+    }
+    if (layout.write_slin) {
+      auto &instrument_header = instrument_headers.emplace_back();
+      instrument_header.string_count = static_cast<uint32_t>(sample.instrument.size());
+      instrument_header.note_frequency = sample.note_frequency;
+      instrument_header.velocity = sample.velocity;
+      files.push_back({sample_path + ".slin",
+                       {AsBuffer(std::span<const InstrumentFileHeader>(&instrument_headers.back(), 1)), AsBuffer(std::span(sample.instrument))}});
+    }
+    for (std::size_t i = 0; i < feature_headers.size() && i < sample.features.size(); ++i) {
+      files.push_back({feature_directories[i] + "/" + sample_id + ".slft",
+                       {AsBuffer(std::span<const SlftFileHeader>(&feature_headers[i], 1)), AsBuffer(std::span(sample.features[i]))}});
+    }
+    if (!feature_headers.empty()) {
+      metadata.push_back(MetadataJson(sample, sample_id));
+      files.push_back({layout.MetadataDirectory() + "/" + sample_id + ".json", {AsBuffer(metadata.back())}});
+    }
+  }
+  writer.Write(files);
+  for (const auto &file : files) {
+    for (const auto &part : file.parts) {
+      bytes_written += part.size();
+    }
+  }
+  return batch.size();
+}
+
+/*
+ * Byte for byte what prepare_dataset.py's json.dumps(build_metadata(...), indent=2)
+ * writes, without previews. The audio path is left out when no audio file is written.
+ * Augmented variants add dataset_augmentor.py's "source" and "augmentation" blocks.
+ * @parameters sample (rendered sample with features), sample_id (file stem)
+ * @returns the JSON document with a trailing newline
+ */
+std::string LooseFileSink::MetadataJson(const RenderedSample &sample, const std::string &sample_id) const {
+  const dsp::FeatureSpec &spec = layout.features.front()->Spec();
+  const double rms = AudioRms(sample.audio);
+  const auto crop_samples = static_cast<std::size_t>(std::nearbyint(spec.crop_seconds * static_cast<double>(spec.sample_rate)));
+  const std::size_t total = sample.coupled_count + sample.uncoupled_count;
+
+  std::string json = "{\n  \"id\": \"" + sample_id + "\",\n  \"audio\": {\n";
+  if (layout.lossless_audio) {
+    json += "    \"path\": \"" + sample_id + ".slac\",\n";
+  } else if (layout.write_wav) {
+    json += "    \"path\": \"" + sample_id + ".wav\",\n";
+  }
+  json += "    \"sample_rate\": " + std::to_string(spec.sample_rate) + ",\n";
+  json += "    \"sample_count\": " + std::to_string(crop_samples) + ",\n";
+  json += "    \"rms\": " + JsonNumber(rms) + "\n  },\n";
+  json += "  \"analysis\": {\n    \"feature_path\": \"features/" + sample_id + ".slft\",\n";
+  json += "    \"format\": \"SLFT.float32.v1\",\n    \"frequency_scale\": \"python_log_frequency\",\n";
+  json += "    \"frequency_bins\": " + std::to_string(spec.frequency_bins) + ",\n";
+  json += "    \"time_frames\": " + std::to_string(spec.time_frames) + ",\n";
+  json += "    \"channels\": [\n      \"log_frequency_magnitude\",\n      \"temporal_delta\",\n      \"onset_emphasis\"\n    ]\n  },\n";
+  json += "  \"target\": {\n    \"note_frequency\": " + JsonNumber(MetaValue(sample.note_frequency)) + ",\n";
+  json += "    \"velocity\": " + JsonNumber(MetaValue(sample.velocity)) + ",\n";
+  json += "    \"coupled_oscillator_count\": " + std::to_string(sample.coupled_count) + ",\n";
+  json += "    \"uncoupled_oscillator_count\": " + std::to_string(sample.uncoupled_count) + ",\n";
+  json += "    \"total_oscillator_count\": " + std::to_string(total) + ",\n";
+  if (layout.write_slin) {
+    json += "    \"oscillator_slin_path\": \"" + sample_id + ".slin\"" + (layout.write_csv ? ",\n" : "\n  },\n");
+  }
+  if (layout.write_csv) {
+    json += "    \"oscillator_csv_path\": \"" + sample_id + ".data\"\n  },\n";
+  }
+  if (sample.augmentation) {
+    const dsp::AugmentationParams &params = *sample.augmentation;
+    json += "  \"source\": {\n    \"dataset_id\": \"" + sample_stem + std::to_string(sample.sample_index) + "\"\n  },\n";
+    json += "  \"augmentation\": {\n    \"variant\": " + std::to_string(params.variant) + ",\n";
+    json += "    \"gain_db\": " + JsonNumber(params.gain_db) + ",\n";
+    if (params.noise) {
+      json += "    \"noise_color\": \"" + dsp::NoiseColorName(params.noise_color) + "\",\n";
+      json += "    \"snr_db\": " + JsonNumber(params.snr_db) + ",\n";
+    }
+    json += "    \"shift_seconds\": " + JsonNumber(static_cast<double>(params.shift_samples) / static_cast<double>(spec.sample_rate)) + ",\n";
+    json += "    \"impulse_response\": " + std::to_string(params.impulse_response) + ",\n";
+    json += "    \"wet_mix\": " + JsonNumber(params.wet_mix) + ",\n";
+    json += "    \"limiter_gain\": " + JsonNumber(params.limiter_gain) + "\n  },\n";
+  }
+  json += "  \"previews\": {}\n}\n";
+  return json;
+}
+
+ShardSink::ShardSink(const std::string &directory, std::size_t records_per_shard) : writer(directory, records_per_shard, SAMPLE_RATE) {}
+
+std::size_t ShardSink::Write(std::span<const RenderedSample> batch) {
+  for (const auto &sample : batch) {
+    dataset::shard::SampleRecord record;
+    record.sample_index = sample.sample_index;
+    record.note_frequency = sample.note_frequency;
+    record.velocity = sample.velocity;
+    record.coupled_count = sample.coupled_count;
+    record.uncoupled_count = sample.uncoupled_count;
+    record.audio = sample.audio;
+    record.parameters = sample.parameters;
+    record.meta = sample.meta;
+    writer.Append(record);
+    bytes_written += record.audio.size_bytes() + record.parameters.size() + record.meta.size();
+  }
+  return batch.size();
+}
+
+void ShardSink::Close() { writer.Close(); }
+
+RingSink::RingSink(dataset::ring::RingProducer &ring_producer, std::atomic<bool> &stop_flag) : producer(ring_producer), stop(stop_flag) {}
+
+std::size_t RingSink::Write(std::span<const RenderedSample> batch) {
+  std::size_t published = 0;
+  for (const auto &sample : batch) {
+    dataset::ring::RingSample ring_sample;
+    ring_sample.sample_index = sample.sample_index;
+    ring_sample.note_frequency = sample.note_frequency;
+    ring_sample.velocity = sample.velocity;
+    ring_sample.audio_rms = AudioRms(sample.audio);
+    ring_sample.coupled_count = sample.coupled_count;
+    ring_sample.uncoupled_count = sample.uncoupled_count;
+    ring_sample.features = sample.features.front();
+    ring_sample.parameters = sample.parameters;
+    if (!producer.Publish(ring_sample, stop)) {
+      // Consumer closed the ring (or a signal arrived): wind the pipeline down.
+      stop = true;
+      break;
+    }
+    ++published;
+    bytes_written += ring_sample.features.size_bytes() + ring_sample.parameters.size();
+  }
+  return published;
+}
+
+GenerationPipeline::GenerationPipeline(const DataBuilder &a_builder, PipelineOptions pipeline_options)
+    : builder(a_builder), options(std::move(pipeline_options)) {
+  options.render_threads = std::max<std::size_t>(1U, options.render_threads);
+  options.writer_threads = std::max<std::size_t>(1U, options.writer_threads);
+  options.write_batch = std::max<std::size_t>(1U, options.write_batch);
+  if (options.queue_depth == 0U) {
+    options.queue_depth = 2U * options.render_threads;
+  }
+}
+
+PipelineReport GenerationPipeline::Run(const std::vector<std::size_t> &sample_indices, std::ostream &progress) {
+  return Run([&](std::size_t i) { return sample_indices[i]; }, sample_indices.size(), progress);
+}
+
+PipelineReport GenerationPipeline::RunUnbounded(std::size_t first_index, std::ostream &progress) {
+  return Run([first_index](std::size_t i) { return first_index + i; }, std::numeric_limits<std::size_t>::max(), progress);
+}
+
+PipelineReport GenerationPipeline::Run(const std::function<std::size_t(std::size_t)> &index_at, std::size_t count, std::ostream &progress) {
+  const bool unbounded = count == std::numeric_limits<std::size_t>::max();
+  const auto stop_requested = [this] { return options.stop != nullptr && options.stop->load(std::memory_order_relaxed); };
+  const std::size_t variants = options.augment ? options.augment->Spec().variants : 0U;
+  const std::size_t outputs_per_render = variants + (options.keep_clean || variants == 0U ? 1U : 0U);
+  PipelineReport report;
+  report.requested = unbounded ? 0U : count * outputs_per_render;
+  report.augment_variants = variants;
+  report.render_threads = options.render_threads;
+  report.writer_threads = options.writer_threads;
+  report.feature_specs = options.features.size();
+
+  std::vector<std::string> feature_tags;
+  for (const auto &extractor : options.features) {
+    feature_tags.push_back(FeatureCacheTag(extractor->Spec()));
+  }
+
+  BoundedQueue<RenderedSample> queue(options.queue_depth);
+  std::atomic<std::size_t> next_index{0};
+  std::atomic<std::size_t> written{0};
+  std::atomic<std::size_t> skipped{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::int64_t> render_busy_ns{0};
+  std::atomic<std::int64_t> feature_busy_ns{0};
+  std::atomic<std::int64_t> augment_busy_ns{0};
+  std::atomic<std::int64_t> encode_busy_ns{0};
+  std::atomic<std::uint64_t> pcm_bytes{0};
+  std::atomic<std::uint64_t> encoded_bytes{0};
+  std::atomic<std::int64_t> write_busy_ns{0};
+  std::atomic<std::uint64_t> write_batches{0};
+  std::atomic<bool> failed{false};
+  std::mutex state_mutex;
+  std::condition_variable state_changed;
+  std::exception_ptr first_error;
+  std::size_t renderers_running = options.render_threads;
+  std::size_t writers_running = options.writer_threads;
+
+  const auto fail = [&](std::exception_ptr error) {
+    {
+      std::lock_guard lock(state_mutex);
+      if (!first_error) {
+        first_error = error;
+      }
+    }
+    failed = true;
+    queue.Close();
+    state_changed.notify_all();
+  };
+
+  std::vector<std::unique_ptr<SampleSink>> sinks;
+  for (std::size_t i = 0; i < options.writer_threads; ++i) {
+    sinks.push_back(options.make_sink(i));
+  }
+  report.sink = sinks.front()->Describe();
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (std::size_t worker = 0; worker < options.render_threads; ++worker) {
+    threads.emplace_back([&] {
+      try {
+        for (std::size_t i = next_index++; i < count && !failed && !stop_requested(); i = next_index++) {
+          const auto render_start = std::chrono::steady_clock::now();
+          auto sample = builder.RenderSample(index_at(i), options.cache.get());
+          const auto augment_start = std::chrono::steady_clock::now();
+          render_busy_ns += (augment_start - render_start).count();
+          if (!sample) {
+            skipped += outputs_per_render;
+            continue;
+          }
+          // Variants share the clean sample's labels; only audio and augmentation differ.
+          std::vector<RenderedSample> outputs;
+          outputs.reserve(outputs_per_render);
+          if (variants > 0U) {
+            auto clean_audio = std::move(sample->audio);
+            for (std::size_t variant = 0; variant < variants; ++variant) {
+              auto engine = DataBuilder::VariantEngine(builder.GetRunSeed(), sample->sample_index, variant);
+              auto augmented = options.augment->Apply(clean_audio, variant, engine);
+              RenderedSample &output = outputs.emplace_back(*sample);
+              output.audio = std::move(augmented.audio);
+              output.augmentation = augmented.params;
+              const auto measured = dataset::index::MeasureAudio(output.audio);
+              output.stats.rms = measured.rms;
+              output.stats.peak = measured.peak;
+              output.stats.clip_count = measured.clip_count;
+            }
+            sample->audio = std::move(clean_audio);
+            if (options.keep_clean) {
+              outputs.insert(outputs.begin(), std::move(*sample));
+            }
+            augment_busy_ns += (std::chrono::steady_clock::now() - augment_start).count();
+          } else {
+            outputs.push_back(std::move(*sample));
+          }
+          bool closed = false;
+          for (auto &output : outputs) {
+            const auto feature_start = std::chrono::steady_clock::now();
+            for (std::size_t feature = 0; feature < options.features.size(); ++feature) {
+              const auto &extractor = options.features[feature];
+              // Augmented audio is not part of the render key, so only clean features are cached.
+              const bool cacheable = options.cache && output.cache_key && !output.augmentation;
+              std::optional<std::vector<float>> tensor;
+              if (cacheable) {
+                tensor = options.cache->LoadFeatures(*output.cache_key, feature_tags[feature], extractor->TensorSize());
+              }
+              if (!tensor) {
+                const auto extract_start = std::chrono::steady_clock::now();
+                tensor = extractor->Extract(output.audio);
+                if (cacheable) {
+                  options.cache->StoreFeatures(*output.cache_key, feature_tags[feature], *tensor, std::chrono::steady_clock::now() - extract_start);
+                }
+              }
+              output.features.push_back(std::move(*tensor));
+            }
+            const auto encode_start = std::chrono::steady_clock::now();
+            feature_busy_ns += (encode_start - feature_start).count();
+            if (options.encode_audio) {
+              output.encoded_audio = lossless::Encode(output.audio, SAMPLE_RATE, *options.encode_audio);
+              encode_busy_ns += (std::chrono::steady_clock::now() - encode_start).count();
+            }
+            if (!queue.Push(std::move(output))) {
+              closed = true;
+              break;
+            }
+          }
+          if (closed) {
+            break;
+          }
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      std::lock_guard lock(state_mutex);
+      if (--renderers_running == 0U) {
+        queue.Close();
+      }
+      state_changed.notify_all();
+    });
+  }
+  for (std::size_t writer = 0; writer < options.writer_threads; ++writer) {
+    threads.emplace_back([&, writer] {
+      try {
+        for (auto batch = queue.PopBatch(options.write_batch); !batch.empty(); batch = queue.PopBatch(options.write_batch)) {
+          const auto write_start = std::chrono::steady_clock::now();
+          const std::uint64_t bytes_before = sinks[writer]->BytesWritten();
+          const std::size_t stored = sinks[writer]->Write(batch);
+          bytes += sinks[writer]->BytesWritten() - bytes_before;
+          write_busy_ns += (std::chrono::steady_clock::now() - write_start).count();
+          ++write_batches;
+          for (std::size_t i = 0; i < stored; ++i) {
+            if (options.index) {
+              options.index->Add(MakeIndexRow(batch[i]));
+            }
+            if (!batch[i].encoded_audio.empty()) {
+              pcm_bytes += batch[i].audio.size() * sizeof(int16_t);
+              encoded_bytes += batch[i].encoded_audio.size();
+            }
+          }
+          written += stored;
+        }
+        sinks[writer]->Close();
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      std::lock_guard lock(state_mutex);
+      --writers_running;
+      state_changed.notify_all();
+    });
+  }
+
+  // Progress once a second instead of a flushed line per sample.
+  {
+    std::unique_lock lock(state_mutex);
+    while (!state_changed.wait_for(lock, std::chrono::seconds(1), [&] { return writers_running == 0U; })) {
+      progress << "progress: " << written.load();
+      if (!unbounded) {
+        progress << "/" << report.requested;
+      }
+      progress << " samples, queue " << queue.Depth() << "/" << options.queue_depth << "\n";
+      progress.flush();
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+
+  report.wall = std::chrono::steady_clock::now() - start;
+  report.written = written;
+  if (unbounded) {
+    report.requested = written + skipped;
+  }
+  report.skipped = skipped;
+  report.bytes = bytes;
+  report.render_busy = std::chrono::nanoseconds(render_busy_ns.load());
+  report.feature_busy = std::chrono::nanoseconds(feature_busy_ns.load());
+  report.augment_busy = std::chrono::nanoseconds(augment_busy_ns.load());
+  report.encode_busy = std::chrono::nanoseconds(encode_busy_ns.load());
+  report.pcm_bytes = pcm_bytes;
+  report.encoded_bytes = encoded_bytes;
+  report.write_busy = std::chrono::nanoseconds(write_busy_ns.load());
+  report.write_batches = write_batches;
+  report.queue = queue.GetStats();
+  if (options.cache) {
+    report.cache = options.cache->GetStats();
+  }
+  return report;
+}
+
+void PipelineReport::Print(std::ostream &out) const {
+  const double wall_seconds = std::max(Seconds(wall), 1e-9);
+  const double render_threads_d = static_cast<double>(render_threads);
+  const double writer_threads_d = static_cast<double>(writer_threads);
+  // Renderers blocked on a full queue wait for the disk; writers blocked on an empty one wait for renders.
+  const double render_blocked = Seconds(queue.push_stall) / render_threads_d;
+  const double writer_idle = Seconds(queue.pop_stall) / writer_threads_d;
+  out << std::fixed << std::setprecision(2);
+  out << "Generated " << written << "/" << requested << " samples (" << skipped << " skipped) in " << wall_seconds << " s: "
+      << static_cast<double>(written) / wall_seconds << " samples/s, " << static_cast<double>(bytes) / wall_seconds / 1e6 << " MB/s\n";
+  out << "render: " << render_threads << " thread(s), busy " << Seconds(render_busy) / render_threads_d << " s/thread, blocked on full queue "
+      << render_blocked << " s/thread\n";
+  if (augment_variants > 0U) {
+    out << "augment: " << augment_variants << " variant(s) per render on the render threads, busy " << Seconds(augment_busy) / render_threads_d
+        << " s/thread\n";
+  }
+  if (feature_specs > 0U) {
+    out << "features: " << feature_specs << " spec(s) on the render threads, busy " << Seconds(feature_busy) / render_threads_d << " s/thread\n";
+  }
+  if (cache) {
+    cache->Print(out);
+  }
+  if (encoded_bytes > 0U) {
+    out << "audio: slac on the render threads, busy " << Seconds(encode_busy) / render_threads_d << " s/thread, "
+        << static_cast<double>(pcm_bytes) / static_cast<double>(encoded_bytes) << "x smaller than PCM\n";
+  }
+  out << "queue: capacity " << queue.capacity << ", mean depth " << queue.mean_depth << ", max depth " << queue.max_depth << "\n";
+  out << "write: " << writer_threads << " thread(s) (" << sink << "), busy " << Seconds(write_busy) / writer_threads_d
+      << " s/thread, idle waiting for samples " << writer_idle << " s/thread, " << write_batches << " batches\n";
+  const char *output_stage = sink.starts_with("shm:") ? "consumer" : "disk";
+  out << "bottleneck: " << (render_blocked > writer_idle ? output_stage : "render") << std::endl;
+  out << std::defaultfloat;
+}
@@ -0,0 +1,187 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * generation_pipeline.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DATASET_BUILDER_GENERATION_PIPELINE_H_
+#define DATASET_BUILDER_GENERATION_PIPELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dataset/metadata_index.h"
+#include "dataset/shard.h"
+#include "dataset/shm_ring.h"
+#include "dataset_builder/dataset_builder.h"
+#include "dsp/augmentation.h"
+#include "dsp/feature_extractor.h"
+#include "include/async_writer.h"
+#include "include/bounded_queue.h"
+#include "include/lossless_audio.h"
+#include "instrument/render_cache.h"
+
+// Consumes rendered samples on a writer thread. Each writer thread owns one sink.
+// Write returns how many samples of the batch were stored.
+class SampleSink {
+public:
+  virtual ~SampleSink() = default;
+  virtual std::size_t Write(std::span<const RenderedSample> batch) = 0;
+  virtual void Close() {}
+  virtual std::string Describe() const = 0;
+  // What the sink has actually stored so far: file bytes, shard payloads or ring payloads.
+  std::uint64_t BytesWritten() const { return bytes_written; }
+
+protected:
+  std::uint64_t bytes_written = 0;
+};
+
+using FeatureExtractors = std::vector<std::shared_ptr<const dsp::FeatureExtractor>>;
+
+/*
+ * Where loose files go. The dataset root is the directory of the prefix; the
+ * first feature spec writes <root>/features/<id>.slft and further specs write
+ * <root>/features_FxT/<id>.slft. With features, <root>/metadata/<id>.json is
+ * written in the deep_trainer/prepare_dataset.py format. With lossless_audio the
+ * audio goes to <id>.slac (the sample's encoded_audio) instead of <id>.wav.
+ * The oscillator parameters go to <id>.data, <id>.slin or both.
+ */
+struct LooseFileLayout {
+  std::string prefix = "data";
+  bool write_wav = true;
+  bool write_csv = true;   // Oscillator parameters as <id>.data CSV.
+  bool write_slin = false; // Oscillator parameters as <id>.slin binary instrument.
+  bool lossless_audio = false;
+  FeatureExtractors features;
+
+  std::string DatasetRoot() const;
+  std::string FeatureDirectory(std::size_t feature) const;
+  std::string MetadataDirectory() const;
+};
+
+// Legacy dataN.wav/.data/.meta files plus optional SLFT features, every file of
+// a batch written in one submission.
+class LooseFileSink : public SampleSink {
+public:
+  LooseFileSink(LooseFileLayout layout, bool allow_io_uring);
+  std::size_t Write(std::span<const RenderedSample> batch) override;
+  std::string Describe() const override;
+
+private:
+  LooseFileLayout layout;
+  std::string root;
+  std::string sample_stem; // File name part of the prefix, e.g. "data".
+  std::vector<std::string> feature_directories;
+  std::vector<SlftFileHeader> feature_headers;
+  filewriter::async::BatchFileWriter writer;
+
+  std::string MetadataJson(const RenderedSample &sample, const std::string &sample_id) const;
+};
+
+class ShardSink : public SampleSink {
+public:
+  ShardSink(const std::string &directory, std::size_t records_per_shard);
+  std::size_t Write(std::span<const RenderedSample> batch) override;
+  void Close() override;
+  std::string Describe() const override { return "shard"; }
+
+private:
+  dataset::shard::ShardSetWriter writer;
+};
+
+/*
+ * Publishes features and oscillator targets into a shared-memory ring for a
+ * trainer to consume (deep_trainer/dataset.py SharedMemoryRingDataset). Sets
+ * `stop` once the consumer closes the ring.
+ */
+class RingSink : public SampleSink {
+public:
+  RingSink(dataset::ring::RingProducer &producer, std::atomic<bool> &stop);
+  std::size_t Write(std::span<const RenderedSample> batch) override;
+  std::string Describe() const override { return "shm:" + producer.Name(); }
+
+private:
+  dataset::ring::RingProducer &producer;
+  std::atomic<bool> &stop;
+};
+
+struct PipelineOptions {
+  std::size_t render_threads = 1;
+  std::size_t writer_threads = 1;
+  std::size_t queue_depth = 0; // 0: two slots per render thread.
+  std::size_t write_batch = 16;
+  FeatureExtractors features; // Run on the render threads, right after each sample is rendered.
+  std::optional<lossless::EncoderOptions> encode_audio; // SLAC-encode audio on the render threads.
+  // Augmented variants of every render, made on the render threads and queued
+  // after the clean sample; keep_clean = false queues the variants only.
+  std::shared_ptr<const dsp::Augmenter> augment;
+  bool keep_clean = true;
+  std::shared_ptr<dataset::index::IndexBuilder> index; // Gets a row for every stored sample.
+  // Consulted before rendering and before extracting features of clean samples.
+  std::shared_ptr<instrument::RenderCache> cache;
+  const std::atomic<bool> *stop = nullptr; // Optional external stop request, checked between samples.
+  std::function<std::unique_ptr<SampleSink>(std::size_t writer_id)> make_sink;
+};
+
+struct PipelineReport {
+  std::size_t requested = 0; // Samples, so renders times the outputs per render.
+  std::size_t written = 0;
+  std::size_t skipped = 0;
+  std::uint64_t bytes = 0;
+  std::size_t render_threads = 0;
+  std::size_t writer_threads = 0;
+  std::string sink;
+  std::chrono::nanoseconds wall{0};
+  std::chrono::nanoseconds render_busy{0};
+  std::chrono::nanoseconds feature_busy{0};
+  std::size_t feature_specs = 0;
+  std::chrono::nanoseconds augment_busy{0};
+  std::size_t augment_variants = 0;
+  std::chrono::nanoseconds encode_busy{0};
+  std::uint64_t pcm_bytes = 0;     // Audio of the stored samples before encoding, when encoding.
+  std::uint64_t encoded_bytes = 0;
+  std::chrono::nanoseconds write_busy{0};
+  std::uint64_t write_batches = 0;
+  BoundedQueue<RenderedSample>::Stats queue;
+  std::optional<instrument::RenderCache::Stats> cache;
+
+  void Print(std::ostream &out) const;
+};
+
+/*
+ * Render workers pull sample indices and push finished samples into a bounded
+ * queue; writer threads drain it in batches. A full queue blocks the renderers,
+ * so memory stays bounded when the disk falls behind.
+ */
+class GenerationPipeline {
+public:
+  GenerationPipeline(const DataBuilder &builder, PipelineOptions options);
+
+  PipelineReport Run(const std::vector<std::size_t> &sample_indices, std::ostream &progress);
+  // Renders first_index, first_index + 1, ... until options.stop is set or a sink fails.
+  PipelineReport RunUnbounded(std::size_t first_index, std::ostream &progress);
+
+private:
+  const DataBuilder &builder;
+  PipelineOptions options;
+
+  PipelineReport Run(const std::function<std::size_t(std::size_t)> &index_at, std::size_t count, std::ostream &progress);
+};
+
+#endif // DATASET_BUILDER_GENERATION_PIPELINE_H_
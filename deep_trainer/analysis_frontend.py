@@ -11,6 +11,7 @@ import re
 import shlex
 import shutil
 import subprocess
+import threading
 import time
 from typing import Any
 from urllib.parse import parse_qs, unquote, urlparse
@@ -30,6 +31,7 @@ from .dataset import TARGET_CHANNELS, discover_examples, read_oscillator_csv
 from .differentiable_audio import denormalize_log_frequency
 from .evaluate import path_for_record
 from .model import SoundLearnerNet, model_config_from_mapping
+from .render_client import RenderClient, RenderServerError, player_note, player_velocity
 from .slft import read_slft
 
 
@@ -251,7 +253,40 @@ def decoded_frequency_factor(normalized_factor: float, is_coupled: bool) -> floa
     return float(anchors[anchor_index] * detune)
 
 
+RENDER_SERVERS: dict[str, RenderClient] = {}
+RENDER_SERVERS_LOCK = threading.Lock()
+
+
+def render_server(player_command: str) -> RenderClient:
+    # One `player --serve` per player binary, kept for the life of the frontend.
+    with RENDER_SERVERS_LOCK:
+      client = RENDER_SERVERS.get(player_command)
+      if client is None or client.process.poll() is not None:
+        bash_command = f"cd {shlex.quote(to_wsl_path(REPO_ROOT))} && exec {shlex.quote(player_command)} --serve"
+        client = RenderClient(["wsl", "bash", "-lc", bash_command])
+        RENDER_SERVERS[player_command] = client
+      return client
+
+
 def render_prediction(player_path: Path, instrument_path: Path, note_frequency: float, velocity: int, length: int) -> Path:
+    player_command = to_wsl_path(player_path) if player_path.is_absolute() else str(player_path.as_posix())
+    rendered = instrument_path.with_suffix(instrument_path.suffix + ".wav")
+    try:
+      render_server(player_command).render_wave(
+          path_for_record(instrument_path, REPO_ROOT),
+          path_for_record(rendered, REPO_ROOT),
+          player_note(note_frequency),
+          player_velocity(velocity),
+          length,
+      )
+      return rendered
+    except (OSError, RenderServerError) as exc:
+      # An older player without --serve, or a failed render: retry once the slow way for the full error.
+      print(f"[analysis] render server unavailable, running the player directly: {exc}")
+    return render_prediction_once(player_path, instrument_path, note_frequency, velocity, length)
+
+
+def render_prediction_once(player_path: Path, instrument_path: Path, note_frequency: float, velocity: int, length: int) -> Path:
     player_command = to_wsl_path(player_path) if player_path.is_absolute() else str(player_path.as_posix())
     command = [
         player_command,
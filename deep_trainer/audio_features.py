@@ -7,6 +7,7 @@ import wave
 import numpy as np
 from PIL import Image
 
+from .slac import is_slac, read_slac
 from .slft import write_slft
 
 
@@ -25,6 +26,9 @@ class FeatureSpec:
 
 
 def read_pcm16_mono(path: Path) -> tuple[int, np.ndarray]:
+    if is_slac(path):
+      sample_rate, pcm = read_slac(path)
+      return sample_rate, pcm.astype(np.float32) / 32768.0
     with wave.open(str(path), "rb") as handle:
       channels = handle.getnchannels()
       sample_width = handle.getsampwidth()
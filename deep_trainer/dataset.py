@@ -2,12 +2,16 @@ from __future__ import annotations
 
 from dataclasses import dataclass
 import json
+import mmap
+import os
 from pathlib import Path
-from typing import Iterable
+import struct
+import time
+from typing import Iterable, Iterator
 
 import numpy as np
 import torch
-from torch.utils.data import Dataset
+from torch.utils.data import Dataset, IterableDataset
 
 from .audio_features import read_pcm16_mono, resample_linear
 from .slft import read_slft
@@ -155,3 +159,249 @@ class SoundLearnerDataset(Dataset):
           "feature_path": str(example.feature_path),
           "target_path": str(example.target_path),
       }
+
+
+# Shared-memory ring written by `dataset_builder --shm-ring`; layout documented in dataset/shm_ring.h.
+RING_HEADER_FORMAT = "<4s3IQ6I2Q2I"
+RING_HEADER_SIZE = 4096
+RING_WRITE_INDEX_OFFSET = 128
+RING_READ_INDEX_OFFSET = 192
+RING_STATE_OFFSET = 64
+RING_PRODUCER_FINISHED = 2
+RING_CONSUMER_ATTACHED = 1
+RING_CONSUMER_CLOSED = 2
+RING_SLOT_DTYPE = np.dtype(
+    [
+        ("sample_index", "<u8"),
+        ("note_frequency", "<f8"),
+        ("velocity", "<f8"),
+        ("audio_rms", "<f8"),
+        ("coupled_count", "<u4"),
+        ("uncoupled_count", "<u4"),
+        ("oscillator_rows", "<u4"),
+        ("reserved", "<u4"),
+        ("padding", "V16"),
+    ]
+)
+
+
+class SharedMemoryRingDataset(IterableDataset):
+    """Streams freshly generated samples from a `dataset_builder --shm-ring` daemon.
+
+    Items match SoundLearnerDataset. Feature tensors are zero-copy views of the
+    ring slot. A slot goes back to the producer `hold_slots` items later, so a
+    DataLoader batch (collated after all of its items are fetched) stays valid
+    as long as hold_slots >= batch_size. The ring is single consumer, so use it
+    with DataLoader(num_workers=0).
+    """
+
+    def __init__(self, name: str, max_oscillators: int, hold_slots: int | None = None, poll_seconds: float = 0.0005) -> None:
+      path = Path("/dev/shm") / name.lstrip("/")
+      fd = os.open(path, os.O_RDWR)
+      try:
+        self._map = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+      finally:
+        os.close(fd)
+      (
+          magic,
+          version,
+          header_size,
+          self.slot_count,
+          self.slot_size,
+          self.sample_rate,
+          self.channels,
+          self.frequency_bins,
+          self.time_frames,
+          self.ring_max_oscillators,
+          self.parameter_count,
+          self.feature_offset,
+          self.target_offset,
+          _,
+          _,
+      ) = struct.unpack_from(RING_HEADER_FORMAT, self._map, 0)
+      if magic != b"SLRG" or version != 1 or header_size != RING_HEADER_SIZE:
+        raise ValueError(f"{path} is not a version 1 SoundLearner ring")
+      self.name = name
+      self.max_oscillators = max_oscillators
+      self.poll_seconds = poll_seconds
+      self.hold_slots = hold_slots if hold_slots is not None else max(1, self.slot_count // 2)
+      if not 1 <= self.hold_slots < self.slot_count:
+        raise ValueError(f"hold_slots must be between 1 and {self.slot_count - 1} for a {self.slot_count}-slot ring")
+      words = np.frombuffer(self._map, dtype="<u8", count=RING_HEADER_SIZE // 8)
+      self._write_index = words[RING_WRITE_INDEX_OFFSET // 8 : RING_WRITE_INDEX_OFFSET // 8 + 1]
+      self._read_index = words[RING_READ_INDEX_OFFSET // 8 : RING_READ_INDEX_OFFSET // 8 + 1]
+      self._states = np.frombuffer(self._map, dtype="<u4", count=2, offset=RING_STATE_OFFSET)  # producer, consumer
+      self._states[1] = RING_CONSUMER_ATTACHED
+
+    def close(self) -> None:
+      """Tell the producer to stop; it exits once it notices."""
+      self._states[1] = RING_CONSUMER_CLOSED
+
+    def _slot(self, index: int) -> dict[str, torch.Tensor | str]:
+      base = RING_HEADER_SIZE + (index % self.slot_count) * self.slot_size
+      header = np.frombuffer(self._map, dtype=RING_SLOT_DTYPE, count=1, offset=base)[0]
+      feature_count = self.channels * self.frequency_bins * self.time_frames
+      features = np.frombuffer(self._map, dtype="<f4", count=feature_count, offset=base + self.feature_offset)
+      rows = np.frombuffer(
+          self._map, dtype="<f4", count=self.ring_max_oscillators * self.parameter_count, offset=base + self.target_offset
+      ).reshape((self.ring_max_oscillators, self.parameter_count))
+
+      active = min(int(header["oscillator_rows"]), self.max_oscillators)
+      target = np.zeros((self.max_oscillators, TARGET_CHANNELS), dtype=np.float32)
+      mask = np.zeros((self.max_oscillators,), dtype=np.float32)
+      target[:active, 0] = 1.0
+      target[:active, 1:] = rows[:active]
+      mask[:active] = 1.0
+      sample_id = f"{self.name}:{int(header['sample_index'])}"
+      return {
+          "features": torch.from_numpy(features.reshape((self.channels, self.frequency_bins, self.time_frames))),
+          "target": torch.from_numpy(target),
+          "mask": torch.from_numpy(mask),
+          "note_frequency": torch.tensor(float(header["note_frequency"]), dtype=torch.float32),
+          "velocity": torch.tensor(float(header["velocity"]), dtype=torch.float32),
+          "source_rms": torch.tensor(float(header["audio_rms"]), dtype=torch.float32),
+          "feature_path": sample_id,
+          "target_path": sample_id,
+      }
+
+    def __iter__(self) -> Iterator[dict[str, torch.Tensor | str]]:
+      next_index = int(self._read_index[0])
+      while True:
+        # x86 loads are ordered, so reading write_index before the slot matches the producer's release store.
+        while int(self._write_index[0]) == next_index:
+          if self._states[0] == RING_PRODUCER_FINISHED and int(self._write_index[0]) == next_index:
+            self._read_index[0] = next_index
+            return
+          time.sleep(self.poll_seconds)
+        yield self._slot(next_index)
+        next_index += 1
+        if next_index - self.hold_slots > int(self._read_index[0]):
+          self._read_index[0] = next_index - self.hold_slots
+
+
+# Single-file store written by `feature_store pack`; layout documented in dataset/feature_store.h.
+STORE_HEADER_FORMAT = "<4sIQ8I8Q"
+STORE_PRECISION_DTYPES = {1: np.dtype("<f4"), 2: np.dtype("<f2")}
+STORE_RECORD_DTYPE = np.dtype(
+    [
+        ("offset", "<u8"),
+        ("channels", "<u4"),
+        ("frequency_bins", "<u4"),
+        ("time_frames", "<u4"),
+        ("id_offset", "<u4"),
+        ("id_size", "<u4"),
+        ("reserved", "<u4"),
+    ]
+)
+STORE_SCALAR_COUNT = 4  # note frequency, velocity, audio rms, oscillator rows
+
+
+class FeatureStore:
+    """Zero-copy NumPy views of a `feature_store pack` file.
+
+    The file is mapped copy-on-write, so views are writable without touching the
+    file and pages are read on first access. `features` is an (N, C, F, T) view
+    when every record has the same shape, otherwise None; `tensor(i)` works
+    either way.
+    """
+
+    def __init__(self, path: str | Path) -> None:
+      self.path = Path(path)
+      with open(self.path, "rb") as file:
+        self._map = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_COPY)
+      (
+          magic,
+          version,
+          self.record_count,
+          precision,
+          self.alignment,
+          self.sample_rate,
+          self.max_oscillators,
+          channels,
+          frequency_bins,
+          time_frames,
+          _,
+          record_stride,
+          records_offset,
+          targets_offset,
+          scalars_offset,
+          ids_offset,
+          ids_size,
+          data_offset,
+          _,
+      ) = struct.unpack_from(STORE_HEADER_FORMAT, self._map, 0)
+      if magic != b"SLFS" or version != 1 or precision not in STORE_PRECISION_DTYPES:
+        raise ValueError(f"{path} is not a version 1 SoundLearner feature store")
+      self.dtype = STORE_PRECISION_DTYPES[precision]
+      count = self.record_count
+      self.records = np.frombuffer(self._map, dtype=STORE_RECORD_DTYPE, count=count, offset=records_offset)
+      self.targets = np.frombuffer(
+          self._map, dtype="<f4", count=count * self.max_oscillators * TARGET_CHANNELS, offset=targets_offset
+      ).reshape((count, self.max_oscillators, TARGET_CHANNELS))
+      self.scalars = np.frombuffer(self._map, dtype="<f4", count=count * STORE_SCALAR_COUNT, offset=scalars_offset).reshape(
+          (count, STORE_SCALAR_COUNT)
+      )
+      self._ids = bytes(self._map[ids_offset : ids_offset + ids_size])
+      self.features = None
+      if record_stride and count:
+        shape = (count, channels, frequency_bins, time_frames)
+        item = self.dtype.itemsize
+        strides = (record_stride, frequency_bins * time_frames * item, time_frames * item, item)
+        size = (count - 1) * record_stride + channels * frequency_bins * time_frames * item
+        base = np.frombuffer(self._map, dtype=np.uint8, count=size, offset=data_offset)
+        self.features = np.lib.stride_tricks.as_strided(base.view(self.dtype), shape=shape, strides=strides)
+
+    def __len__(self) -> int:
+      return self.record_count
+
+    def id(self, index: int) -> str:
+      record = self.records[index]
+      start = int(record["id_offset"])
+      return self._ids[start : start + int(record["id_size"])].decode()
+
+    def tensor(self, index: int) -> np.ndarray:
+      if self.features is not None:
+        return self.features[index]
+      record = self.records[index]
+      shape = (int(record["channels"]), int(record["frequency_bins"]), int(record["time_frames"]))
+      return np.frombuffer(self._map, dtype=self.dtype, count=shape[0] * shape[1] * shape[2], offset=int(record["offset"])).reshape(shape)
+
+
+class FeatureStoreDataset(Dataset):
+    """SoundLearnerDataset items read from one `feature_store pack` file.
+
+    Unknown labels get SoundLearnerDataset's defaults. float32 stores hand out
+    the mapped tensors as they are; float16 stores are widened per item.
+    """
+
+    def __init__(self, path: str | Path, max_oscillators: int) -> None:
+      self.store = FeatureStore(path)
+      if max_oscillators > self.store.max_oscillators:
+        raise ValueError(f"{path} keeps {self.store.max_oscillators} oscillators per example, {max_oscillators} requested")
+      self.max_oscillators = max_oscillators
+      if len(self.store) == 0:
+        raise ValueError("No SoundLearner examples found")
+
+    def __len__(self) -> int:
+      return len(self.store)
+
+    def __getitem__(self, index: int) -> dict[str, torch.Tensor | str]:
+      note_frequency, velocity, source_rms, rows = (float(value) for value in self.store.scalars[index])
+      active = min(int(rows), self.max_oscillators)
+      target = self.store.targets[index, : self.max_oscillators]
+      mask = np.zeros((self.max_oscillators,), dtype=np.float32)
+      mask[:active] = 1.0
+      note_frequency = 1000.0 if np.isnan(note_frequency) else note_frequency
+      velocity = 1.0 / max(float(active), 1.0) if np.isnan(velocity) else velocity
+      source_rms = 0.0 if np.isnan(source_rms) else source_rms
+      sample_id = f"{self.store.path}:{self.store.id(index)}"
+      return {
+          "features": torch.from_numpy(self.store.tensor(index)).float(),
+          "target": torch.from_numpy(target),
+          "mask": torch.from_numpy(mask),
+          "note_frequency": torch.tensor(note_frequency, dtype=torch.float32),
+          "velocity": torch.tensor(velocity, dtype=torch.float32),
+          "source_rms": torch.tensor(source_rms, dtype=torch.float32),
+          "feature_path": sample_id,
+          "target_path": sample_id,
+      }
@@ -13,6 +13,7 @@ import numpy as np
 
 from .audio_features import FeatureSpec, extract_feature_tensor_from_wav, write_feature_preview_bmp, write_feature_tensor
 from .audio_preview import write_mel_preview
+from .slac import is_slac, read_slac
 
 @dataclass(frozen=True)
 class DatasetItem:
@@ -79,6 +80,9 @@ def clamp_audio(signal: np.ndarray) -> np.ndarray:
 
 
 def read_pcm16_mono(path: Path) -> tuple[int, np.ndarray]:
+    if is_slac(path):
+        sample_rate, pcm = read_slac(path)
+        return sample_rate, pcm.astype(np.float32) / 32768.0
     with wave.open(str(path), "rb") as handle:
         channels = handle.getnchannels()
         sample_width = handle.getsampwidth()
@@ -19,6 +19,8 @@ from .audio_features import FeatureSpec, extract_feature_tensor_from_wav, write_
 from .audio_preview import write_ab_mel_preview, write_mel_preview
 from .differentiable_audio import denormalize_log_frequency
 from .model import SoundLearnerNet, model_config_from_mapping
+from .native_renderer import NativeRenderer
+from .render_client import RenderClient, player_note, player_velocity
 from .slft import read_slft
 
 
@@ -71,6 +73,17 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--length", type=int, default=5, help="Rendered length in seconds.")
     parser.add_argument("--tool-mode", choices=["wsl", "native"], default="wsl")
     parser.add_argument("--player", type=Path, default=Path("build/player/player"))
+    parser.add_argument(
+        "--render-server",
+        action="store_true",
+        help="Render through one long-lived `player --serve` process instead of one player run per example.",
+    )
+    parser.add_argument(
+        "--render-native",
+        action="store_true",
+        help="Render in-process through libsoundlearner.so (ctypes), byte-identical to the player; needs --tool-mode native.",
+    )
+    parser.add_argument("--native-library", type=Path, default=None, help="libsoundlearner.so; default $SOUNDLEARNER_LIBRARY or build/capi.")
     return parser.parse_args()
 
 
@@ -121,6 +134,14 @@ def run_tool(args: argparse.Namespace, command: list[str]) -> None:
       completed.check_returncode()
 
 
+def start_render_server(args: argparse.Namespace) -> RenderClient:
+    command = [str(args.player.as_posix()), "--serve"]
+    if args.tool_mode == "native":
+      return RenderClient(command, cwd=repo_root())
+    quoted = " ".join(shlex.quote(arg) for arg in command)
+    return RenderClient(["bash", "-lc", f"cd {shlex.quote(path_to_wsl(repo_root()))} && exec {quoted}"])
+
+
 def format_tool_number(value: float | int) -> str:
     numeric = float(value)
     if numeric.is_integer():
@@ -240,21 +261,41 @@ def render_prediction(args: argparse.Namespace, instrument_path: Path, note_freq
     render_dir.mkdir(parents=True, exist_ok=True)
     render_instrument = render_dir / instrument_path.name
     shutil.copyfile(instrument_path, render_instrument)
-    run_tool(
-        args,
-        [
-            str(args.player.as_posix()),
-            "-f",
-            path_for_record(render_instrument, repo_root()),
-            "-n",
-            f"{note_frequency:.6f}",
-            "-v",
-            str(args.velocity),
-            "-l",
-            str(args.length),
-        ],
-    )
     rendered_wav = render_instrument.with_suffix(render_instrument.suffix + ".wav")
+    if args.native_renderer is not None:
+      instrument = args.native_renderer.load(render_instrument)
+      try:
+        pcm = args.native_renderer.render_player(instrument, player_note(note_frequency), player_velocity(args.velocity), args.length)
+      finally:
+        instrument.close()
+      with wave.open(str(rendered_wav), "wb") as handle:
+        handle.setnchannels(1)
+        handle.setsampwidth(2)
+        handle.setframerate(44100)
+        handle.writeframes(pcm.astype("<i2", copy=False).tobytes())
+    elif args.render_client is not None:
+      args.render_client.render_wave(
+          path_for_record(render_instrument, repo_root()),
+          path_for_record(rendered_wav, repo_root()),
+          player_note(note_frequency),
+          player_velocity(args.velocity),
+          args.length,
+      )
+    else:
+      run_tool(
+          args,
+          [
+              str(args.player.as_posix()),
+              "-f",
+              path_for_record(render_instrument, repo_root()),
+              "-n",
+              f"{note_frequency:.6f}",
+              "-v",
+              str(args.velocity),
+              "-l",
+              str(args.length),
+          ],
+      )
     friendly_wav = render_dir / f"{instrument_path.stem}.wav"
     if rendered_wav.exists():
       shutil.copyfile(rendered_wav, friendly_wav)
@@ -458,15 +499,23 @@ def main() -> None:
     summary_path = args.output_dir / "summary.csv"
     if summary_path.exists():
       summary_path.unlink()
-    for index, item in enumerate(items, start=1):
-      print(f"[{index}/{len(items)}] {item.name}")
-      row = evaluate_item(args, model, device, item)
-      write_summary_row(summary_path, row)
-      write_ab_artifacts(args.output_dir, item.name, item.input_wav, repo_root() / row["rendered_wav"], row)
-      print(
-          f"  feature_mae={row['feature_mae']:.6f} feature_rmse={row['feature_rmse']:.6f} "
-          f"rows={row['predicted_rows']} note={row['note_frequency']:.3f} source={row['note_source']}"
-      )
+    if args.render_native and args.tool_mode != "native":
+      raise ValueError("--render-native loads the library into this process, so it needs --tool-mode native")
+    args.native_renderer = NativeRenderer(args.native_library) if args.render_native else None
+    args.render_client = start_render_server(args) if args.render_server and not args.render_native else None
+    try:
+      for index, item in enumerate(items, start=1):
+        print(f"[{index}/{len(items)}] {item.name}")
+        row = evaluate_item(args, model, device, item)
+        write_summary_row(summary_path, row)
+        write_ab_artifacts(args.output_dir, item.name, item.input_wav, repo_root() / row["rendered_wav"], row)
+        print(
+            f"  feature_mae={row['feature_mae']:.6f} feature_rmse={row['feature_rmse']:.6f} "
+            f"rows={row['predicted_rows']} note={row['note_frequency']:.3f} source={row['note_source']}"
+        )
+    finally:
+      if args.render_client is not None:
+        args.render_client.close()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,76 @@
+from __future__ import annotations
+
+import mmap
+from pathlib import Path
+import struct
+
+import numpy as np
+
+
+INDEX_MAGIC = b"SLIX"
+INDEX_VERSION = 1
+INDEX_FILE_NAME = "index.slix"
+INDEX_HEADER_FORMAT = "<4sIQ4I"
+INDEX_ENTRY_FORMAT = "<32sIIQ"
+INDEX_COLUMN_DTYPES = {1: "<u2", 2: "<u4", 3: "<u8", 4: "<i4", 5: "<f4"}
+
+
+class MetadataIndex:
+    """Memory-mapped reader for the index.slix file dataset_builder writes next to the samples."""
+
+    def __init__(self, path: str | Path) -> None:
+      path = Path(path)
+      self.path = path / INDEX_FILE_NAME if path.is_dir() else path
+      with self.path.open("rb") as handle:
+        self._map = mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ)
+      header_size = struct.calcsize(INDEX_HEADER_FORMAT)
+      magic, version, row_count, column_count, histogram_count, sample_rate, _ = struct.unpack(
+          INDEX_HEADER_FORMAT, self._map[:header_size]
+      )
+      if magic != INDEX_MAGIC or version != INDEX_VERSION:
+        raise ValueError(f"{self.path} is not a version {INDEX_VERSION} metadata index")
+      self.sample_rate = sample_rate
+      self.rows = row_count
+      entry_size = struct.calcsize(INDEX_ENTRY_FORMAT)
+      self.columns: dict[str, np.ndarray] = {}
+      self.histograms: dict[str, np.ndarray] = {}
+      offset = header_size
+      for position in range(column_count + histogram_count):
+        raw_name, first, second, data_offset = struct.unpack_from(INDEX_ENTRY_FORMAT, self._map, offset)
+        offset += entry_size
+        name = raw_name.rstrip(b"\0").decode("ascii")
+        if position < column_count:
+          self.columns[name] = np.frombuffer(self._map, dtype=INDEX_COLUMN_DTYPES[first], count=row_count, offset=data_offset)
+        else:
+          self.histograms[name] = np.frombuffer(self._map, dtype="<u8", count=second, offset=data_offset)
+
+    def __len__(self) -> int:
+      return self.rows
+
+    def __getitem__(self, name: str) -> np.ndarray:
+      return self.columns[name]
+
+    def select(self, **ranges: tuple[float | None, float | None]) -> np.ndarray:
+      """Row positions whose columns fall inside every inclusive (min, max) range; None leaves a bound open.
+
+      index.select(rms=(0.01, None), active_partials=(4, 16))
+      """
+      mask = np.ones(self.rows, dtype=bool)
+      for name, (low, high) in ranges.items():
+        column = self.columns[name]
+        if low is not None:
+          mask &= column >= low
+        if high is not None:
+          mask &= column <= high
+      return np.flatnonzero(mask)
+
+    def sample_ids(self, positions: np.ndarray | None = None, prefix: str = "data") -> list[str]:
+      """File stems of the given rows (all rows by default), e.g. data12 or data12_aug00."""
+      sample_index = self.columns["sample_index"]
+      variant = self.columns["variant"]
+      if positions is None:
+        positions = np.arange(self.rows)
+      return [
+          f"{prefix}{int(sample_index[row])}" + (f"_aug{int(variant[row]):02d}" if variant[row] >= 0 else "")
+          for row in positions
+      ]
@@ -0,0 +1,273 @@
+from __future__ import annotations
+
+import ctypes
+import os
+from pathlib import Path
+from typing import Sequence
+
+import numpy as np
+
+
+# libsoundlearner C ABI, see capi/soundlearner.h.
+ABI_VERSION = 1
+SAMPLE_RATE = 44100
+PARAMETER_COLUMNS = 7
+
+RENDER_EXACT = 1
+RENDER_STOP_ON_CLIP = 2
+
+ERROR_NAMES = {-1: "bad argument", -2: "parse error", -3: "I/O error", -4: "internal error"}
+
+LIBRARY_CANDIDATES = (
+    "build/capi/libsoundlearner.so",
+    "builddir/capi/libsoundlearner.so",
+)
+
+
+class NativeRendererError(RuntimeError):
+    pass
+
+
+class _RenderJob(ctypes.Structure):
+    _fields_ = [
+        ("instrument", ctypes.c_void_p),
+        ("frequency", ctypes.c_double),
+        ("velocity", ctypes.c_double),
+        ("out_float", ctypes.POINTER(ctypes.c_float)),
+        ("out_int16", ctypes.POINTER(ctypes.c_int16)),
+        ("sample_count", ctypes.c_size_t),
+        ("flags", ctypes.c_uint32),
+        ("status", ctypes.c_int32),
+        ("rendered", ctypes.c_size_t),
+        ("distorted", ctypes.c_int32),
+    ]
+
+
+def find_library(explicit: str | Path | None = None) -> Path:
+    # An explicit path, then $SOUNDLEARNER_LIBRARY, then the usual meson build directories.
+    candidates: list[Path] = []
+    if explicit is not None:
+      candidates.append(Path(explicit))
+    if os.environ.get("SOUNDLEARNER_LIBRARY"):
+      candidates.append(Path(os.environ["SOUNDLEARNER_LIBRARY"]))
+    root = Path(__file__).resolve().parents[1]
+    candidates.extend(root / candidate for candidate in LIBRARY_CANDIDATES)
+    for candidate in candidates:
+      if candidate.is_file():
+        return candidate
+    searched = ", ".join(str(candidate) for candidate in candidates)
+    raise FileNotFoundError(f"libsoundlearner.so not found (searched {searched}); build it with meson")
+
+
+class NativeInstrument:
+    """An immutable instrument owned by the library; safe to share between threads."""
+
+    def __init__(self, library: NativeLibrary, handle: int) -> None:
+      self._library = library
+      self.handle = handle
+
+    @property
+    def string_count(self) -> int:
+      return int(self._library.lib.sl_instrument_string_count(self.handle))
+
+    def close(self) -> None:
+      if self.handle:
+        self._library.lib.sl_instrument_destroy(self.handle)
+        self.handle = 0
+
+    def __enter__(self) -> NativeInstrument:
+      return self
+
+    def __exit__(self, *exc: object) -> None:
+      self.close()
+
+    def __del__(self) -> None:
+      self.close()
+
+
+class NativeVoice:
+    """One note's oscillator state, rendered a buffer at a time; use from one thread at a time."""
+
+    def __init__(self, library: NativeLibrary, instrument: NativeInstrument) -> None:
+      self._library = library
+      self._instrument = instrument
+      handle = ctypes.c_void_p()
+      library.check(library.lib.sl_voice_create(instrument.handle, ctypes.byref(handle)))
+      self.handle = handle.value
+
+    def prime(self, frequency: float, velocity: float) -> None:
+      self._library.check(self._library.lib.sl_voice_prime(self.handle, float(frequency), float(velocity)))
+
+    def render(self, out: np.ndarray, exact: bool = False, stop_on_clip: bool = False) -> tuple[int, bool]:
+      # Fills a contiguous float32 or int16 array in place; returns (samples rendered, clipped).
+      flags = (RENDER_EXACT if exact else 0) | (RENDER_STOP_ON_CLIP if stop_on_clip else 0)
+      rendered = ctypes.c_size_t()
+      distorted = ctypes.c_int32()
+      if out.dtype == np.float32:
+        self._library.check(
+            self._library.lib.sl_voice_render_float(self.handle, _buffer(out, ctypes.c_float), out.size, flags, ctypes.byref(rendered))
+        )
+        return int(rendered.value), False
+      self._library.check(
+          self._library.lib.sl_voice_render_int16(
+              self.handle, _buffer(out, ctypes.c_int16), out.size, flags, ctypes.byref(rendered), ctypes.byref(distorted)
+          )
+      )
+      return int(rendered.value), bool(distorted.value)
+
+    def close(self) -> None:
+      if self.handle:
+        self._library.lib.sl_voice_destroy(self.handle)
+        self.handle = None
+
+    def __del__(self) -> None:
+      self.close()
+
+
+def _buffer(array: np.ndarray, ctype: type) -> ctypes._Pointer:
+    if array.ndim != 1 or not array.flags.c_contiguous or not array.flags.writeable:
+      raise ValueError("Render buffers must be writable, one-dimensional and contiguous")
+    if array.dtype not in (np.float32, np.int16):
+      raise ValueError(f"Render buffers are float32 or int16, not {array.dtype}")
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
+
+
+class NativeLibrary:
+    def __init__(self, path: str | Path | None = None) -> None:
+      self.path = find_library(path)
+      self.lib = ctypes.CDLL(str(self.path))
+      lib = self.lib
+      lib.sl_abi_version.restype = ctypes.c_uint32
+      lib.sl_abi_version.argtypes = []
+      version = int(lib.sl_abi_version())
+      if version != ABI_VERSION:
+        raise NativeRendererError(f"{self.path} has ABI version {version}, expected {ABI_VERSION}")
+      handle_out = ctypes.POINTER(ctypes.c_void_p)
+      signatures = {
+          "sl_last_error": (ctypes.c_char_p, []),
+          "sl_instrument_load": (ctypes.c_int32, [ctypes.c_char_p, handle_out]),
+          "sl_instrument_parse": (ctypes.c_int32, [ctypes.c_char_p, ctypes.c_size_t, handle_out]),
+          "sl_instrument_from_parameters": (ctypes.c_int32, [ctypes.POINTER(ctypes.c_double), ctypes.c_size_t, handle_out]),
+          "sl_instrument_destroy": (None, [ctypes.c_void_p]),
+          "sl_instrument_string_count": (ctypes.c_size_t, [ctypes.c_void_p]),
+          "sl_voice_create": (ctypes.c_int32, [ctypes.c_void_p, handle_out]),
+          "sl_voice_destroy": (None, [ctypes.c_void_p]),
+          "sl_voice_prime": (ctypes.c_int32, [ctypes.c_void_p, ctypes.c_double, ctypes.c_double]),
+          "sl_voice_render_float": (
+              ctypes.c_int32,
+              [ctypes.c_void_p, ctypes.POINTER(ctypes.c_float), ctypes.c_size_t, ctypes.c_uint32, ctypes.POINTER(ctypes.c_size_t)],
+          ),
+          "sl_voice_render_int16": (
+              ctypes.c_int32,
+              [
+                  ctypes.c_void_p,
+                  ctypes.POINTER(ctypes.c_int16),
+                  ctypes.c_size_t,
+                  ctypes.c_uint32,
+                  ctypes.POINTER(ctypes.c_size_t),
+                  ctypes.POINTER(ctypes.c_int32),
+              ],
+          ),
+          "sl_render_batch": (ctypes.c_int32, [ctypes.POINTER(_RenderJob), ctypes.c_size_t, ctypes.c_size_t]),
+      }
+      for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    def check(self, status: int) -> None:
+      if status != 0:
+        message = self.lib.sl_last_error().decode(errors="replace")
+        raise NativeRendererError(f"{ERROR_NAMES.get(status, status)}: {message}")
+
+
+class NativeRenderer:
+    """Renders instruments straight into NumPy arrays through libsoundlearner; no files, no processes.
+
+    ctypes releases the GIL for every call, so renders on several Python threads run in parallel.
+    """
+
+    def __init__(self, library_path: str | Path | None = None) -> None:
+      self.library = NativeLibrary(library_path)
+
+    def load(self, path: str | Path) -> NativeInstrument:
+      # .data CSV or .slin, as player -f reads them.
+      return self._create(self.library.lib.sl_instrument_load, str(path).encode())
+
+    def parse(self, contents: bytes | str) -> NativeInstrument:
+      data = contents.encode() if isinstance(contents, str) else bytes(contents)
+      return self._create(self.library.lib.sl_instrument_parse, data, len(data))
+
+    def from_parameters(self, rows: np.ndarray) -> NativeInstrument:
+      # Rows in .data column order, e.g. a model's predicted parameters after activity thresholding.
+      table = np.ascontiguousarray(rows, dtype=np.float64)
+      if table.ndim != 2 or table.shape[1] != PARAMETER_COLUMNS:
+        raise ValueError(f"Instrument parameters must be shaped (strings, {PARAMETER_COLUMNS}), not {table.shape}")
+      return self._create(self.library.lib.sl_instrument_from_parameters, table.ctypes.data_as(ctypes.POINTER(ctypes.c_double)), table.shape[0])
+
+    def voice(self, instrument: NativeInstrument) -> NativeVoice:
+      return NativeVoice(self.library, instrument)
+
+    def render(
+        self,
+        instrument: NativeInstrument,
+        note_frequency: float,
+        velocity: float = 1.0,
+        sample_count: int = 5 * SAMPLE_RATE,
+        dtype: type = np.float32,
+        out: np.ndarray | None = None,
+        exact: bool = False,
+        stop_on_clip: bool = False,
+    ) -> np.ndarray:
+      buffer = np.zeros(sample_count, dtype=dtype) if out is None else out
+      voice = self.voice(instrument)
+      try:
+        voice.prime(note_frequency, velocity)
+        voice.render(buffer, exact=exact, stop_on_clip=stop_on_clip)
+      finally:
+        voice.close()
+      return buffer
+
+    def render_player(self, instrument: NativeInstrument, note_frequency: float, velocity: float, seconds: int) -> np.ndarray:
+      # Byte for byte what player -f writes for the same note, velocity and length.
+      return self.render(instrument, note_frequency, velocity, seconds * SAMPLE_RATE, np.int16, exact=True, stop_on_clip=True)
+
+    def render_batch(
+        self,
+        notes: Sequence[tuple[NativeInstrument, float, float]],
+        sample_count: int,
+        dtype: type = np.float32,
+        out: np.ndarray | None = None,
+        threads: int = 0,
+        exact: bool = False,
+        stop_on_clip: bool = False,
+    ) -> np.ndarray:
+      """Renders (instrument, frequency, velocity) notes into the rows of one (len(notes), sample_count) array.
+
+      threads=0 uses one worker per core. Rows after a clip stop stay zero, as the player leaves them.
+      """
+      buffer = np.zeros((len(notes), sample_count), dtype=dtype) if out is None else out
+      if buffer.shape != (len(notes), sample_count) or not buffer.flags.c_contiguous or buffer.dtype not in (np.float32, np.int16):
+        raise ValueError("Batch output must be a contiguous float32 or int16 array of shape (notes, sample_count)")
+      flags = (RENDER_EXACT if exact else 0) | (RENDER_STOP_ON_CLIP if stop_on_clip else 0)
+      jobs = (_RenderJob * len(notes))()
+      row_bytes = buffer.strides[0]
+      base = buffer.ctypes.data
+      for index, (instrument, frequency, velocity) in enumerate(notes):
+        job = jobs[index]
+        job.instrument = instrument.handle
+        job.frequency = float(frequency)
+        job.velocity = float(velocity)
+        if buffer.dtype == np.float32:
+          job.out_float = ctypes.cast(base + index * row_bytes, ctypes.POINTER(ctypes.c_float))
+        else:
+          job.out_int16 = ctypes.cast(base + index * row_bytes, ctypes.POINTER(ctypes.c_int16))
+        job.sample_count = sample_count
+        job.flags = flags
+      self.library.check(self.library.lib.sl_render_batch(jobs, len(notes), threads))
+      return buffer
+
+    def _create(self, function: ctypes._CFuncPtr, *arguments: object) -> NativeInstrument:
+      handle = ctypes.c_void_p()
+      self.library.check(function(*arguments, ctypes.byref(handle)))
+      return NativeInstrument(self.library, handle.value)
@@ -3,6 +3,7 @@ from __future__ import annotations
 import argparse
 import json
 from pathlib import Path
+import subprocess
 from typing import Any
 
 from .audio_features import CHANNEL_NAMES, FeatureSpec, extract_feature_tensor_from_wav, read_pcm16_mono, resample_linear, write_feature_preview_bmp, write_feature_tensor
@@ -20,6 +21,12 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--fft-size-multiplier", type=int, default=4)
     parser.add_argument("--skip-previews", action="store_true")
     parser.add_argument("--skip-mel-previews", action="store_true")
+    parser.add_argument(
+        "--preview-tool",
+        type=Path,
+        default=Path("build/dataset/feature_preview"),
+        help="Native feature preview renderer; previews are drawn in Python when it is missing.",
+    )
     return parser.parse_args()
 
 
@@ -129,6 +136,7 @@ def main() -> None:
     if not args.skip_mel_previews:
       mel_dir.mkdir(parents=True, exist_ok=True)
 
+    native_previews = args.preview_tool.is_file()
     stems = discover_sample_stems(dataset_root)
     for index, stem in enumerate(stems, start=1):
       wav_path = dataset_root / f"{stem}.wav"
@@ -140,7 +148,7 @@ def main() -> None:
       features = extract_feature_tensor_from_wav(wav_path, spec)
       write_feature_tensor(feature_path, features, sample_rate=spec.sample_rate)
 
-      if not args.skip_previews:
+      if not args.skip_previews and not native_previews:
         rgb_path = preview_dir / f"{stem}_rgb.bmp"
         logfreq_path = preview_dir / f"{stem}_logfreq_rgb.bmp"
         write_feature_preview_bmp(rgb_path, features)
@@ -168,6 +176,13 @@ def main() -> None:
       metadata_path.write_text(json.dumps(metadata, indent=2) + "\n")
       print(f"[{index}/{len(stems)}] prepared {stem}")
 
+    if not args.skip_previews and native_previews:
+      # One pass over every tensor, multithreaded, instead of a Pillow encode per sample.
+      subprocess.run(
+          [str(args.preview_tool), str(features_dir), "--output", str(preview_dir)],
+          check=True,
+      )
+
 
 if __name__ == "__main__":
     main()
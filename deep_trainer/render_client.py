@@ -0,0 +1,223 @@
+from __future__ import annotations
+
+from dataclasses import dataclass
+from multiprocessing import shared_memory
+from pathlib import Path
+import struct
+import subprocess
+import threading
+
+import numpy as np
+
+
+# player --serve protocol, see player/render_server.h.
+REQUEST_MAGIC = b"SLRQ"
+RESPONSE_MAGIC = b"SLRS"
+PROTOCOL_VERSION = 1
+REQUEST_HEADER_FORMAT = "<4sIQ4I2d2I"
+RESPONSE_HEADER_FORMAT = "<4sIQ4IQ"
+REQUEST_HEADER_SIZE = struct.calcsize(REQUEST_HEADER_FORMAT)
+RESPONSE_HEADER_SIZE = struct.calcsize(RESPONSE_HEADER_FORMAT)
+SAMPLE_RATE = 44100
+
+KIND_RENDER = 1
+KIND_PING = 2
+KIND_STATS = 3
+KIND_SHUTDOWN = 4
+
+OUTPUT_INLINE = 0
+OUTPUT_SHARED_MEMORY = 1
+OUTPUT_WAVE_FILE = 2
+
+REQUEST_INSTRUMENT_INLINE = 1
+REQUEST_RENDER_PAST_CLIP = 2
+
+RESPONSE_DISTORTED = 1
+RESPONSE_RENDER_CACHE_HIT = 2
+RESPONSE_INSTRUMENT_CACHE_HIT = 4
+
+STATUS_NAMES = {0: "ok", 1: "bad request", 2: "instrument error", 3: "output error", 4: "render error"}
+
+
+class RenderServerError(RuntimeError):
+    pass
+
+
+def player_velocity(percent: int) -> float:
+    # What player -v does with its argument.
+    return (int(percent) & 0xFF) / 100.0
+
+
+def player_note(frequency: float) -> float:
+    # player -n goes through std::stof, so one-shot renders play the float32 nearest the formatted note.
+    return struct.unpack("<f", struct.pack("<f", float(f"{frequency:.6f}")))[0]
+
+
+@dataclass(frozen=True)
+class RenderRequest:
+    instrument: str | Path | bytes
+    note_frequency: float
+    velocity: float = 1.0
+    sample_count: int = 5 * SAMPLE_RATE
+    output: int = OUTPUT_INLINE
+    output_name: str = ""
+    render_past_clip: bool = False
+
+
+@dataclass(frozen=True)
+class RenderResult:
+    request_id: int
+    sample_count: int
+    sample_rate: int
+    flags: int
+    render_ns: int
+    pcm: bytes = b""
+
+    @property
+    def distorted(self) -> bool:
+      return bool(self.flags & RESPONSE_DISTORTED)
+
+    def samples(self) -> np.ndarray:
+      return np.frombuffer(self.pcm, dtype="<i2")
+
+
+class RenderClient:
+    """Keeps one `player --serve` process and sends it render requests.
+
+    The server parses each instrument once and reuses it while the file is
+    unchanged, so repeated renders skip process start-up and instrument parsing.
+    `command` starts the server, e.g. ["build/player/player", "--serve", "-j", "4"],
+    or a ["wsl", "bash", "-lc", "cd ... && player --serve"] wrapper.
+    """
+
+    def __init__(self, command: list[str], cwd: Path | None = None) -> None:
+      self.process = subprocess.Popen(command, cwd=cwd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+      self.lock = threading.Lock()
+      self.next_id = 1
+
+    def __enter__(self) -> RenderClient:
+      return self
+
+    def __exit__(self, *exc: object) -> None:
+      self.close()
+
+    def render(self, request: RenderRequest) -> RenderResult:
+      return self.render_many([request])[0]
+
+    def render_many(self, requests: list[RenderRequest]) -> list[RenderResult]:
+      """Sends every request before reading answers so the server's workers run in parallel."""
+      with self.lock:
+        ids = list(range(self.next_id, self.next_id + len(requests)))
+
+        # Written from a second thread: the server answers while it still reads, and both pipes are bounded.
+        def send_all() -> None:
+          for request in requests:
+            self._send(KIND_RENDER, request)
+          self._flush()
+
+        sender = threading.Thread(target=send_all, daemon=True)
+        sender.start()
+        answers = {}
+        try:
+          for _ in ids:
+            header, payload = self._receive()
+            answers[header[2]] = (header, payload)
+        finally:
+          sender.join()
+      results = []
+      for request, request_id in zip(requests, ids):
+        header, payload = answers[request_id]
+        _, status, _, flags, sample_count, sample_rate, _, render_ns = header
+        if status != 0:
+          raise RenderServerError(f"{STATUS_NAMES.get(status, status)}: {payload.decode('utf-8', 'replace')}")
+        if request.output == OUTPUT_SHARED_MEMORY:
+          payload = read_shared_samples(request.output_name, sample_count)
+        results.append(RenderResult(request_id, sample_count, sample_rate, flags, render_ns, payload))
+      return results
+
+    def render_wave(self, instrument: str | Path, path: str | Path, note_frequency: float, velocity: float, seconds: int) -> RenderResult:
+      """Writes what `player -f instrument -n ... -l seconds` would write to `instrument.wav`."""
+      return self.render(
+          RenderRequest(str(instrument), note_frequency, velocity, seconds * SAMPLE_RATE, OUTPUT_WAVE_FILE, str(Path(path).as_posix()))
+      )
+
+    def ping(self) -> None:
+      self._simple(KIND_PING)
+
+    def stats(self) -> str:
+      return self._simple(KIND_STATS).decode("utf-8", "replace")
+
+    def close(self) -> None:
+      if self.process.poll() is None:
+        try:
+          self._simple(KIND_SHUTDOWN)
+        except (OSError, RenderServerError):
+          pass
+        self.process.stdin.close()
+        self.process.wait()
+
+    def _simple(self, kind: int) -> bytes:
+      with self.lock:
+        self._send(kind, None)
+        self._flush()
+        header, payload = self._receive()
+      if header[1] != 0:
+        raise RenderServerError(payload.decode("utf-8", "replace"))
+      return payload
+
+    def _send(self, kind: int, request: RenderRequest | None) -> int:
+      request_id = self.next_id
+      self.next_id += 1
+      instrument = b""
+      output_name = b""
+      flags = 0
+      note_frequency, velocity, sample_count, output = 440.0, 1.0, 0, OUTPUT_INLINE
+      if request is not None:
+        if isinstance(request.instrument, bytes):
+          instrument = request.instrument
+          flags |= REQUEST_INSTRUMENT_INLINE
+        else:
+          instrument = str(Path(request.instrument).as_posix()).encode("utf-8")
+        if request.render_past_clip:
+          flags |= REQUEST_RENDER_PAST_CLIP
+        output_name = request.output_name.encode("utf-8")
+        note_frequency, velocity, sample_count, output = request.note_frequency, request.velocity, request.sample_count, request.output
+      header = struct.pack(
+          REQUEST_HEADER_FORMAT,
+          REQUEST_MAGIC,
+          PROTOCOL_VERSION,
+          request_id,
+          kind,
+          output,
+          flags,
+          sample_count,
+          float(note_frequency),
+          float(velocity),
+          len(instrument),
+          len(output_name),
+      )
+      self.process.stdin.write(header + instrument + output_name)
+      return request_id
+
+    def _flush(self) -> None:
+      self.process.stdin.flush()
+
+    def _receive(self) -> tuple[tuple, bytes]:
+      raw = self.process.stdout.read(RESPONSE_HEADER_SIZE)
+      if len(raw) != RESPONSE_HEADER_SIZE:
+        raise RenderServerError(f"render server exited with {self.process.poll()}")
+      header = struct.unpack(RESPONSE_HEADER_FORMAT, raw)
+      if header[0] != RESPONSE_MAGIC:
+        raise RenderServerError("render server sent a malformed response")
+      payload = self.process.stdout.read(header[6]) if header[6] else b""
+      return header, payload
+
+
+def read_shared_samples(name: str, sample_count: int) -> bytes:
+    # The server creates the object; the client copies the samples out and removes it.
+    memory = shared_memory.SharedMemory(name=name.lstrip("/"))
+    try:
+      return bytes(memory.buf[: sample_count * 2])
+    finally:
+      memory.close()
+      memory.unlink()
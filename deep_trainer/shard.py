@@ -0,0 +1,104 @@
+from __future__ import annotations
+
+from dataclasses import dataclass
+import mmap
+from pathlib import Path
+import struct
+
+import numpy as np
+
+
+SHARD_MAGIC = b"SLSH"
+SHARD_VERSION = 1
+SHARD_ALIGNMENT = 4096  # The header block; records start after it.
+SHARD_HEADER_FORMAT = "<4s3I2Q"
+SHARD_INDEX_DTYPE = np.dtype(
+    [
+        ("sample_index", "<u8"),
+        ("audio_offset", "<u8"),
+        ("audio_length", "<u8"),
+        ("params_offset", "<u8"),
+        ("meta_offset", "<u8"),
+        ("params_length", "<u4"),
+        ("meta_length", "<u4"),
+        ("note_frequency", "<f8"),
+        ("velocity", "<f8"),
+        ("coupled_count", "<u4"),
+        ("uncoupled_count", "<u4"),
+        ("audio_format", "<u4"),
+        ("sample_count", "<u4"),
+    ]
+)
+
+
+@dataclass(frozen=True)
+class ShardSample:
+    sample_index: int
+    note_frequency: float
+    velocity: float
+    coupled_count: int
+    uncoupled_count: int
+    audio: np.ndarray
+    parameters: str
+    meta: str
+
+
+class ShardReader:
+    """Memory-mapped reader for dataset_builder --shard-output containers."""
+
+    def __init__(self, path: str | Path) -> None:
+      self.path = Path(path)
+      with self.path.open("rb") as handle:
+        self._map = mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ)
+      header_size = struct.calcsize(SHARD_HEADER_FORMAT)
+      magic, version, _, sample_rate, record_count, index_offset = struct.unpack(SHARD_HEADER_FORMAT, self._map[:header_size])
+      if magic != SHARD_MAGIC or version != SHARD_VERSION:
+        raise ValueError(f"{self.path} is not a version {SHARD_VERSION} shard")
+      if record_count == 0:
+        raise ValueError(f"{self.path} was not closed by its writer")
+      index_bytes = record_count * SHARD_INDEX_DTYPE.itemsize
+      if index_offset < SHARD_ALIGNMENT or index_offset + index_bytes > len(self._map):
+        raise ValueError(f"{self.path} was not closed by its writer or is truncated")
+      self.sample_rate = sample_rate
+      self.index = np.frombuffer(self._map, dtype=SHARD_INDEX_DTYPE, count=record_count, offset=index_offset)
+      # Same checks as the C++ reader: slices past the records would silently come back short.
+      for part in ("audio", "params", "meta"):
+        # Python ints, so offset + length cannot wrap around as uint64 would.
+        starts = self.index[f"{part}_offset"].tolist()
+        lengths = self.index[f"{part}_length"].tolist()
+        for position, (start, length) in enumerate(zip(starts, lengths)):
+          if start < SHARD_ALIGNMENT or start + length > index_offset or (part == "audio" and (start | length) % 2):
+            raise ValueError(f"{self.path} index entry {position} points outside the records")
+
+    def __len__(self) -> int:
+      return int(self.index.shape[0])
+
+    def audio(self, position: int) -> np.ndarray:
+      entry = self.index[position]
+      return np.frombuffer(self._map, dtype="<i2", count=int(entry["audio_length"]) // 2, offset=int(entry["audio_offset"]))
+
+    def __getitem__(self, position: int) -> ShardSample:
+      entry = self.index[position]
+      params_offset = int(entry["params_offset"])
+      meta_offset = int(entry["meta_offset"])
+      return ShardSample(
+          sample_index=int(entry["sample_index"]),
+          note_frequency=float(entry["note_frequency"]),
+          velocity=float(entry["velocity"]),
+          coupled_count=int(entry["coupled_count"]),
+          uncoupled_count=int(entry["uncoupled_count"]),
+          audio=self.audio(position),
+          parameters=self._map[params_offset : params_offset + int(entry["params_length"])].decode("ascii"),
+          meta=self._map[meta_offset : meta_offset + int(entry["meta_length"])].decode("ascii"),
+      )
+
+
+def _shard_order(path: Path) -> tuple[int, int, str]:
+    # Same order as the C++ ListShards: other names first, then shard_NNNNN by number, so reruns come last.
+    digits = path.stem.removeprefix("shard_")
+    return (1, int(digits), path.name) if path.stem.startswith("shard_") and digits.isdigit() else (0, 0, path.name)
+
+
+def discover_shards(root: str | Path) -> list[Path]:
+    """Shards under root in ascending shard number; later shards hold the newer copy of a rerun sample."""
+    return sorted(Path(root).glob("*.sls"), key=_shard_order)
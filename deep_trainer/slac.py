@@ -0,0 +1,168 @@
+from __future__ import annotations
+
+from pathlib import Path
+import struct
+import zlib
+
+import numpy as np
+
+
+# Reader for SLAC lossless audio as written by `dataset_builder --audio-format slac`.
+# The layout is documented next to SlacFileHeader in include/structures.h. This is a
+# plain Python decoder: fine for the occasional sample, use `slac decode` for whole datasets.
+FILE_HEADER = struct.Struct("<4sHHIHHIIQ")
+BLOCK_HEADER = struct.Struct("<IHBBI")
+BLOCK_CRC_BYTES = 8  # Header fields covered by the block CRC: everything before it.
+VERSION = 2
+UNKNOWN_SAMPLE_COUNT = (1 << 64) - 1
+
+METHOD_CONSTANT = 0
+METHOD_VERBATIM = 1
+METHOD_FIXED = 2
+METHOD_LPC = 3
+MAX_FIXED_ORDER = 4
+MAX_LPC_ORDER = 32
+ESCAPE_PARAMETER = 31
+FIXED_COEFFICIENTS = ([], [1], [2, -1], [3, -3, 1], [4, -6, 4, -1])
+
+
+class SlacError(ValueError):
+    pass
+
+
+class _BitReader:
+    """MSB-first reader over one block payload."""
+
+    def __init__(self, payload: bytes) -> None:
+      self.bits = format(int.from_bytes(payload, "big"), f"0{len(payload) * 8}b") if payload else ""
+      self.position = 0
+
+    def get(self, count: int) -> int:
+      if count == 0:
+        return 0
+      end = self.position + count
+      if end > len(self.bits):
+        raise SlacError("block payload is truncated")
+      value = int(self.bits[self.position : end], 2)
+      self.position = end
+      return value
+
+    def get_signed(self, count: int) -> int:
+      value = self.get(count)
+      return value - (1 << count) if value >> (count - 1) else value
+
+    def get_rice(self, parameter: int) -> int:
+      one = self.bits.find("1", self.position)
+      if one < 0:
+        raise SlacError("Rice code runs past the end of the block")
+      quotient = one - self.position
+      self.position = one + 1
+      return (quotient << parameter) | self.get(parameter)
+
+
+def _unzigzag(value: int) -> int:
+    return (value >> 1) ^ -(value & 1)
+
+
+def _wrap16(value: int) -> int:
+    return ((value + 32768) & 0xFFFF) - 32768
+
+
+def _read_residual(reader: _BitReader, count: int, order: int) -> list[int]:
+    partition_order = reader.get(4)
+    partition_size = count >> partition_order
+    if (partition_size << partition_order) != count or partition_size <= order:
+      raise SlacError("invalid Rice partition order")
+    residual: list[int] = []
+    first = order
+    for partition in range(1 << partition_order):
+      last = (partition + 1) * partition_size
+      parameter = reader.get(5)
+      if parameter == ESCAPE_PARAMETER:
+        width = reader.get(5)
+        residual.extend(_unzigzag(reader.get(width)) for _ in range(first, last))
+      else:
+        residual.extend(_unzigzag(reader.get_rice(parameter)) for _ in range(first, last))
+      first = last
+    return residual
+
+
+def _decode_block(count: int, method: int, order: int, payload: bytes) -> list[int]:
+    reader = _BitReader(payload)
+    if method == METHOD_CONSTANT:
+      return [reader.get_signed(16)] * count
+    if method == METHOD_VERBATIM:
+      return [reader.get_signed(16) for _ in range(count)]
+    if method not in (METHOD_FIXED, METHOD_LPC):
+      raise SlacError(f"unknown block method {method}")
+    if (method == METHOD_FIXED and order > MAX_FIXED_ORDER) or (method == METHOD_LPC and not 0 < order <= MAX_LPC_ORDER) or order >= count:
+      raise SlacError(f"invalid predictor order {order}")
+    samples = [reader.get_signed(16) for _ in range(order)]
+    shift = 0
+    coefficients = FIXED_COEFFICIENTS[order] if method == METHOD_FIXED else []
+    if method == METHOD_LPC:
+      precision = reader.get(4) + 1
+      shift = reader.get(5)
+      coefficients = [reader.get_signed(precision) for _ in range(order)]
+    # Same recurrence as the C++ predictors: coefficient j weights the sample j + 1 back.
+    taps = coefficients[::-1]
+    for index, value in enumerate(_read_residual(reader, count, order), start=order):
+      prediction = sum(tap * sample for tap, sample in zip(taps, samples[index - order : index]))
+      samples.append(_wrap16(value + (prediction >> shift)))
+    return samples
+
+
+def decode_slac(raw: bytes, name: str = "SLAC stream") -> tuple[int, np.ndarray]:
+    """Decode a SLAC stream, checking every block CRC and the whole-stream CRC.
+
+    Returns the sample rate and the samples as int16. Raises SlacError on a
+    truncated, corrupt or unsupported stream.
+    """
+    if len(raw) < FILE_HEADER.size:
+      raise SlacError(f"{name} is too small to be a SLAC stream")
+    magic, version, channels, sample_rate, bits, _, block_size, stream_crc, sample_count = FILE_HEADER.unpack_from(raw)
+    if magic != b"SLAC":
+      raise SlacError(f"{name} has invalid magic {magic!r}")
+    if version != VERSION or channels != 1 or bits != 16:
+      raise SlacError(f"{name} uses unsupported SLAC version {version}, {channels} channel(s), {bits} bit")
+    if not 0 < block_size <= 0xFFFF:
+      raise SlacError(f"{name} has block size {block_size}")
+
+    samples: list[int] = []
+    offset = FILE_HEADER.size
+    while offset < len(raw):
+      if len(raw) - offset < BLOCK_HEADER.size:
+        raise SlacError(f"{name}: truncated block header")
+      payload_bytes, count, method, order, block_crc = BLOCK_HEADER.unpack_from(raw, offset)
+      payload_start = offset + BLOCK_HEADER.size
+      payload = raw[payload_start : payload_start + payload_bytes]
+      if len(payload) != payload_bytes:
+        raise SlacError(f"{name}: truncated block payload")
+      if zlib.crc32(payload, zlib.crc32(raw[offset : offset + BLOCK_CRC_BYTES])) != block_crc:
+        raise SlacError(f"{name}: block checksum mismatch at byte {offset}")
+      if count == 0:
+        raise SlacError(f"{name}: empty block at byte {offset}")
+      try:
+        samples.extend(_decode_block(count, method, order, payload))
+      except SlacError as error:
+        raise SlacError(f"{name}: {error} in the block at byte {offset}") from None
+      offset = payload_start + payload_bytes
+
+    pcm = np.asarray(samples, dtype="<i2")
+    if sample_count != UNKNOWN_SAMPLE_COUNT:
+      if pcm.size != sample_count:
+        raise SlacError(f"{name}: header announces {sample_count} samples, blocks hold {pcm.size}")
+      if zlib.crc32(pcm.tobytes()) != stream_crc:
+        raise SlacError(f"{name}: sample checksum mismatch")
+    return sample_rate, pcm.astype(np.int16)
+
+
+def is_slac(path: str | Path) -> bool:
+    with Path(path).open("rb") as handle:
+      return handle.read(4) == b"SLAC"
+
+
+def read_slac(path: str | Path) -> tuple[int, np.ndarray]:
+    """Read a .slac file; see decode_slac."""
+    slac_path = Path(path)
+    return decode_slac(slac_path.read_bytes(), str(slac_path))
@@ -16,7 +16,7 @@ try:
 except ImportError:
     SummaryWriter = None
 
-from .dataset import SoundLearnerDataset, discover_examples
+from .dataset import FeatureStoreDataset, SoundLearnerDataset, discover_examples
 from .differentiable_audio import RenderLossConfig
 from .losses import OscillatorLoss
 from .model import ModelConfig, SoundLearnerNet, model_config_from_mapping
@@ -36,6 +36,7 @@ def load_config_file(path: Path) -> dict[str, Any]:
 
 def add_train_arguments(parser: argparse.ArgumentParser) -> None:
     parser.add_argument("--dataset-root", type=Path, default=Path("."), help="Root containing features/, metadata/, and dataN.data files.")
+    parser.add_argument("--feature-store", type=Path, default=None, help="Train from a `feature_store pack` file instead of --dataset-root.")
     parser.add_argument("--output-dir", type=Path, default=Path("runs/baseline"), help="Directory for checkpoints.")
     parser.add_argument("--epochs", type=int, default=50)
     parser.add_argument("--batch-size", type=int, default=8)
@@ -259,14 +260,16 @@ def main() -> None:
     random.seed(args.seed)
     torch.manual_seed(args.seed)
 
-    examples = discover_examples(args.dataset_root)
-    dataset = SoundLearnerDataset(
-        examples,
-        max_oscillators=args.max_oscillators,
-        expected_resolution=args.resolution,
-        expected_frequency_bins=args.freq_bins,
-        expected_time_frames=args.time_frames,
-    )
+    if args.feature_store is not None:
+      dataset = FeatureStoreDataset(args.feature_store, max_oscillators=args.max_oscillators)
+    else:
+      dataset = SoundLearnerDataset(
+          discover_examples(args.dataset_root),
+          max_oscillators=args.max_oscillators,
+          expected_resolution=args.resolution,
+          expected_frequency_bins=args.freq_bins,
+          expected_time_frames=args.time_frames,
+      )
     train_dataset, validation_dataset = split_dataset(dataset, args.validation_split, args.seed)
 
     first_sample = dataset[0]
@@ -0,0 +1,299 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dsp/augmentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace dsp {
+
+namespace {
+constexpr float k_pcm_scale = 1.0F / 32768.0F;
+constexpr double k_peak_limit = 0.999;
+
+double DbToLinear(double value_db) { return std::pow(10.0, value_db / 20.0); }
+
+double Rms(std::span<const float> signal) {
+  double energy = 0.0;
+  for (const float value : signal) {
+    energy += static_cast<double>(value) * static_cast<double>(value);
+  }
+  return signal.empty() ? 0.0 : std::sqrt(energy / static_cast<double>(signal.size()));
+}
+
+// Scales an impulse response to unit energy so the wet mix means the same for every room.
+std::vector<float> Normalized(std::vector<float> impulse_response) {
+  const double energy = Rms(impulse_response) * std::sqrt(static_cast<double>(impulse_response.size()));
+  if (energy > 0.0) {
+    const auto scale = static_cast<float>(1.0 / energy);
+    for (auto &value : impulse_response) {
+      value *= scale;
+    }
+  }
+  return impulse_response;
+}
+
+// A small room: a few early reflections over an exponentially decaying noise
+// tail that reaches -60 dB at the end of the response.
+std::vector<float> SyntheticRoom(std::mt19937 &engine, const AugmentationSpec &spec) {
+  const double seconds = std::uniform_real_distribution<double>(spec.room_seconds_min, spec.room_seconds_max)(engine);
+  const auto length = std::max<std::size_t>(2U, static_cast<std::size_t>(seconds * static_cast<double>(spec.sample_rate)));
+  std::normal_distribution<float> gaussian(0.0F, 1.0F);
+  std::vector<float> room(length);
+  const double decay = std::log(1000.0) / static_cast<double>(length);
+  for (std::size_t i = 0; i < length; ++i) {
+    room[i] = gaussian(engine) * static_cast<float>(std::exp(-decay * static_cast<double>(i)));
+  }
+  const auto reflections = std::uniform_int_distribution<std::size_t>(2U, 4U)(engine);
+  for (std::size_t i = 0; i < reflections; ++i) {
+    const auto tap = std::uniform_int_distribution<std::size_t>(0U, length / 4U)(engine);
+    room[tap] += std::uniform_real_distribution<float>(0.5F, 1.5F)(engine) * static_cast<float>(std::sqrt(static_cast<double>(length)) / 8.0);
+  }
+  return Normalized(std::move(room));
+}
+
+// Unit variance gaussian noise shaped to the colour. Pink is Paul Kellet's
+// three-pole approximation of -3 dB/octave; brown a leaky integrator (-6 dB/octave
+// above ~35 Hz, so it does not wander off as pure integration would).
+std::vector<float> ColoredNoise(std::size_t count, NoiseColor color, std::mt19937 &engine) {
+  std::normal_distribution<float> gaussian(0.0F, 1.0F);
+  std::vector<float> noise(count);
+  for (auto &value : noise) {
+    value = gaussian(engine);
+  }
+  if (color == NoiseColor::pink) {
+    float b0 = 0.0F;
+    float b1 = 0.0F;
+    float b2 = 0.0F;
+    for (auto &value : noise) {
+      b0 = 0.99765F * b0 + value * 0.0990460F;
+      b1 = 0.96300F * b1 + value * 0.2965164F;
+      b2 = 0.57000F * b2 + value * 1.0526913F;
+      value = b0 + b1 + b2 + value * 0.1848F;
+    }
+  } else if (color == NoiseColor::brown) {
+    float state = 0.0F;
+    for (auto &value : noise) {
+      state = 0.995F * state + value;
+      value = state;
+    }
+  }
+  return noise;
+}
+
+void Shift(std::vector<float> &signal, std::ptrdiff_t shift) {
+  const auto count = static_cast<std::ptrdiff_t>(signal.size());
+  if (shift == 0 || count == 0) {
+    return;
+  }
+  if (std::abs(shift) >= count) {
+    std::fill(signal.begin(), signal.end(), 0.0F);
+  } else if (shift > 0) {
+    std::copy_backward(signal.begin(), signal.end() - shift, signal.end());
+    std::fill(signal.begin(), signal.begin() + shift, 0.0F);
+  } else {
+    std::copy(signal.begin() - shift, signal.end(), signal.begin());
+    std::fill(signal.end() + shift, signal.end(), 0.0F);
+  }
+}
+} // namespace
+
+std::string NoiseColorName(NoiseColor color) {
+  switch (color) {
+  case NoiseColor::pink:
+    return "pink";
+  case NoiseColor::brown:
+    return "brown";
+  case NoiseColor::white:
+    break;
+  }
+  return "white";
+}
+
+NoiseColor ParseNoiseColor(const std::string &name) {
+  for (const auto color : {NoiseColor::white, NoiseColor::pink, NoiseColor::brown}) {
+    if (NoiseColorName(color) == name) {
+      return color;
+    }
+  }
+  throw std::invalid_argument("Unknown noise colour: " + name);
+}
+
+PartitionedConvolver::PartitionedConvolver(std::span<const float> impulse_response, std::size_t a_partition_size)
+    : partition_size(a_partition_size), length(impulse_response.size()) {
+  if (partition_size < 2U || NextPowerOfTwo(partition_size) != partition_size) {
+    throw std::invalid_argument("Convolution partition size must be a power of two.");
+  }
+  if (impulse_response.empty()) {
+    throw std::invalid_argument("Empty impulse response.");
+  }
+  plan = GetRealPlan(2U * partition_size);
+  std::vector<double> frame(plan->Size());
+  std::vector<Complex> spectrum(plan->SpectrumSize());
+  for (std::size_t start = 0; start < length; start += partition_size) {
+    const std::size_t count = std::min(partition_size, length - start);
+    std::fill(frame.begin(), frame.end(), 0.0);
+    std::copy_n(impulse_response.begin() + static_cast<std::ptrdiff_t>(start), count, frame.begin());
+    plan->Forward(frame, spectrum);
+    auto &real = partition_real.emplace_back(spectrum.size());
+    auto &imag = partition_imag.emplace_back(spectrum.size());
+    for (std::size_t k = 0; k < spectrum.size(); ++k) {
+      real[k] = spectrum[k].real();
+      imag[k] = spectrum[k].imag();
+    }
+  }
+}
+
+void PartitionedConvolver::Process(std::span<const float> input, std::span<float> output) const {
+  const std::size_t bins = plan->SpectrumSize();
+  const std::size_t partitions = Partitions();
+  // Frequency-domain delay line: the spectrum of each of the last `partitions` input frames.
+  std::vector<std::vector<double>> delay_real(partitions, std::vector<double>(bins));
+  std::vector<std::vector<double>> delay_imag(partitions, std::vector<double>(bins));
+  std::vector<double> accumulate_real(bins);
+  std::vector<double> accumulate_imag(bins);
+  std::vector<double> frame(plan->Size(), 0.0);
+  std::vector<double> block(plan->Size());
+  std::vector<Complex> spectrum(bins);
+
+  for (std::size_t block_index = 0, start = 0; start < input.size(); ++block_index, start += partition_size) {
+    const std::size_t count = std::min(partition_size, input.size() - start);
+    // Overlap-save frame: the previous input block followed by the current one.
+    std::copy(frame.begin() + static_cast<std::ptrdiff_t>(partition_size), frame.end(), frame.begin());
+    const auto current = frame.begin() + static_cast<std::ptrdiff_t>(partition_size);
+    std::copy_n(input.begin() + static_cast<std::ptrdiff_t>(start), count, current);
+    std::fill(current + static_cast<std::ptrdiff_t>(count), frame.end(), 0.0);
+    plan->Forward(frame, spectrum);
+
+    const std::size_t slot = block_index % partitions;
+    for (std::size_t k = 0; k < bins; ++k) {
+      delay_real[slot][k] = spectrum[k].real();
+      delay_imag[slot][k] = spectrum[k].imag();
+    }
+    std::fill(accumulate_real.begin(), accumulate_real.end(), 0.0);
+    std::fill(accumulate_imag.begin(), accumulate_imag.end(), 0.0);
+    for (std::size_t partition = 0; partition < std::min(partitions, block_index + 1U); ++partition) {
+      const std::size_t source = (slot + partitions - partition) % partitions;
+      const double *x_real = delay_real[source].data();
+      const double *x_imag = delay_imag[source].data();
+      const double *h_real = partition_real[partition].data();
+      const double *h_imag = partition_imag[partition].data();
+      for (std::size_t k = 0; k < bins; ++k) {
+        accumulate_real[k] += x_real[k] * h_real[k] - x_imag[k] * h_imag[k];
+        accumulate_imag[k] += x_real[k] * h_imag[k] + x_imag[k] * h_real[k];
+      }
+    }
+    for (std::size_t k = 0; k < bins; ++k) {
+      spectrum[k] = Complex(accumulate_real[k], accumulate_imag[k]);
+    }
+    plan->Inverse(spectrum, block);
+    // The first half wrapped around circularly; the second half is the linear result.
+    for (std::size_t i = 0; i < count; ++i) {
+      output[start + i] = static_cast<float>(block[partition_size + i]);
+    }
+  }
+}
+
+Augmenter::Augmenter(AugmentationSpec augmentation_spec) : spec(std::move(augmentation_spec)) {
+  if (spec.gain_db_min > spec.gain_db_max || spec.snr_db_min > spec.snr_db_max || spec.wet_min > spec.wet_max || spec.wet_min < 0.0 ||
+      spec.wet_max > 1.0 || spec.max_shift_seconds < 0.0 || spec.room_seconds_min <= 0.0 || spec.room_seconds_min > spec.room_seconds_max) {
+    throw std::invalid_argument("Augmentation ranges must be ordered min <= max, wet mix within 0..1.");
+  }
+  if (spec.noise && spec.noise_colors.empty()) {
+    throw std::invalid_argument("Noise augmentation needs at least one noise colour.");
+  }
+  if (!spec.convolution) {
+    return;
+  }
+  std::vector<std::vector<float>> bank;
+  for (const auto &impulse_response : spec.impulse_responses) {
+    if (!impulse_response.empty()) {
+      bank.push_back(Normalized(impulse_response));
+    }
+  }
+  if (spec.impulse_responses.empty()) {
+    std::seed_seq seq{static_cast<std::uint32_t>(spec.room_seed), static_cast<std::uint32_t>(spec.room_seed >> 32U)};
+    std::mt19937 engine(seq);
+    for (std::size_t i = 0; i < spec.synthetic_rooms; ++i) {
+      bank.push_back(SyntheticRoom(engine, spec));
+    }
+  }
+  for (const auto &impulse_response : bank) {
+    convolvers.emplace_back(impulse_response, spec.partition_size);
+  }
+}
+
+AugmentedAudio Augmenter::Apply(std::span<const int16_t> clean, std::size_t variant, std::mt19937 &engine) const {
+  AugmentedAudio result;
+  AugmentationParams &params = result.params;
+  params.variant = variant;
+  const std::size_t count = clean.size();
+  std::vector<float> signal(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    signal[i] = static_cast<float>(clean[i]) * k_pcm_scale;
+  }
+
+  const auto max_shift = static_cast<std::ptrdiff_t>(spec.max_shift_seconds * static_cast<double>(spec.sample_rate));
+  if (max_shift > 0) {
+    params.shift_samples = std::uniform_int_distribution<std::ptrdiff_t>(-max_shift, max_shift)(engine);
+    Shift(signal, params.shift_samples);
+  }
+
+  if (!convolvers.empty()) {
+    params.impulse_response = std::uniform_int_distribution<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(convolvers.size()) - 1)(engine);
+    params.wet_mix = std::uniform_real_distribution<double>(spec.wet_min, spec.wet_max)(engine);
+    if (params.wet_mix > 0.0) {
+      std::vector<float> wet(count);
+      convolvers[static_cast<std::size_t>(params.impulse_response)].Process(signal, wet);
+      const auto dry_gain = static_cast<float>(1.0 - params.wet_mix);
+      const auto wet_gain = static_cast<float>(params.wet_mix);
+      for (std::size_t i = 0; i < count; ++i) {
+        signal[i] = dry_gain * signal[i] + wet_gain * wet[i];
+      }
+    }
+  }
+
+  params.gain_db = std::uniform_real_distribution<double>(spec.gain_db_min, spec.gain_db_max)(engine);
+  const auto gain = static_cast<float>(DbToLinear(params.gain_db));
+  for (auto &value : signal) {
+    value *= gain;
+  }
+
+  if (spec.noise) {
+    params.noise = true;
+    params.noise_color = spec.noise_colors[std::uniform_int_distribution<std::size_t>(0U, spec.noise_colors.size() - 1U)(engine)];
+    params.snr_db = std::uniform_real_distribution<double>(spec.snr_db_min, spec.snr_db_max)(engine);
+    const auto noise = ColoredNoise(count, params.noise_color, engine);
+    const double noise_rms = Rms(noise) + 1e-8;
+    const auto noise_gain = static_cast<float>(Rms(signal) / DbToLinear(params.snr_db) / noise_rms);
+    for (std::size_t i = 0; i < count; ++i) {
+      signal[i] += noise_gain * noise[i];
+    }
+  }
+
+  float peak = 0.0F;
+  for (const float value : signal) {
+    peak = std::max(peak, std::abs(value));
+  }
+  if (peak > k_peak_limit) {
+    params.limiter_gain = k_peak_limit / static_cast<double>(peak);
+  }
+  // Requantize as dataset_augmentor.py's write_pcm16_mono: round(x * 32767).
+  const auto scale = static_cast<float>(params.limiter_gain * 32767.0);
+  result.audio.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    result.audio[i] = static_cast<int16_t>(std::clamp(std::nearbyint(signal[i] * scale), -32768.0F, 32767.0F));
+  }
+  return result;
+}
+
+} // namespace dsp
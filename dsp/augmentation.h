@@ -0,0 +1,133 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * augmentation.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DSP_AUGMENTATION_H_
+#define DSP_AUGMENTATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dsp/fft.h"
+
+namespace dsp {
+
+enum class NoiseColor : uint8_t { white, pink, brown };
+
+std::string NoiseColorName(NoiseColor color);
+// Parses "white", "pink" or "brown", throws std::invalid_argument otherwise.
+NoiseColor ParseNoiseColor(const std::string &name);
+
+// Ranges every variant draws its parameters from, uniformly. The defaults
+// follow deep_trainer/dataset_augmentor.py where it has an equivalent.
+struct AugmentationSpec {
+  std::size_t variants = 1; // Augmented copies per rendered sample.
+  double gain_db_min = -3.0;
+  double gain_db_max = 3.0;
+  bool noise = true;
+  double snr_db_min = 28.0;
+  double snr_db_max = 42.0;
+  std::vector<NoiseColor> noise_colors{NoiseColor::white, NoiseColor::pink, NoiseColor::brown};
+  double max_shift_seconds = 0.05; // Delay or advance, the vacated end is zero filled. 0 disables.
+  bool convolution = true;
+  double wet_min = 0.0;
+  double wet_max = 0.25;
+  // Impulse responses at sample_rate. Left empty, `synthetic_rooms` decaying
+  // noise tails of room_seconds_min..max are generated from room_seed.
+  std::vector<std::vector<float>> impulse_responses;
+  std::size_t synthetic_rooms = 8;
+  double room_seconds_min = 0.02;
+  double room_seconds_max = 0.15;
+  std::uint64_t room_seed = 0;
+  std::size_t partition_size = 1024; // Convolution block, a power of two.
+  std::uint32_t sample_rate = 44100;
+};
+
+// What one variant drew, for the metadata JSON.
+struct AugmentationParams {
+  std::size_t variant = 0;
+  double gain_db = 0.0;
+  bool noise = false;
+  NoiseColor noise_color = NoiseColor::white;
+  double snr_db = 0.0;
+  std::ptrdiff_t shift_samples = 0; // Positive delays the signal.
+  std::ptrdiff_t impulse_response = -1; // Index into the bank, -1 when dry.
+  double wet_mix = 0.0;
+  double limiter_gain = 1.0; // Applied when the result would have clipped.
+};
+
+struct AugmentedAudio {
+  std::vector<int16_t> audio;
+  AugmentationParams params;
+};
+
+/*
+ * Uniformly partitioned overlap-save convolution. The impulse response is cut
+ * into partition_size blocks whose spectra are computed once; each input block
+ * then costs one forward and one inverse real FFT of 2 * partition_size plus a
+ * multiply-accumulate over the frequency-domain delay line. Const and thread safe.
+ */
+class PartitionedConvolver {
+public:
+  PartitionedConvolver(std::span<const float> impulse_response, std::size_t partition_size);
+
+  std::size_t Length() const { return length; }
+  std::size_t Partitions() const { return partition_real.size(); }
+  /*
+   * @parameters input, output (same size as input, may not alias it)
+   * Writes the first input.size() samples of input * impulse_response.
+   */
+  void Process(std::span<const float> input, std::span<float> output) const;
+
+private:
+  std::size_t partition_size;
+  std::size_t length;
+  std::shared_ptr<const RealFftPlan> plan;
+  // Split real/imaginary spectra keep the accumulate loop a plain vectorizable FMA.
+  std::vector<std::vector<double>> partition_real;
+  std::vector<std::vector<double>> partition_imag;
+};
+
+/*
+ * In-memory port of the dataset_augmentor.py idea for freshly rendered audio:
+ * time shift, convolution with a small impulse response (dry/wet), gain, then
+ * coloured noise at a drawn SNR, and a peak limiter before requantizing. The
+ * impulse response bank and its partition spectra are built once; Apply is const
+ * and may be called from several threads. Every draw comes from the caller's
+ * engine, so a (sample, variant) seed reproduces the variant exactly.
+ */
+class Augmenter {
+public:
+  explicit Augmenter(AugmentationSpec spec);
+
+  const AugmentationSpec &Spec() const { return spec; }
+  std::size_t ImpulseResponses() const { return convolvers.size(); }
+
+  /*
+   * @parameters clean (rendered pcm16), variant (recorded in the params), engine
+   * @returns the augmented audio, same length as clean, and the drawn parameters
+   */
+  AugmentedAudio Apply(std::span<const int16_t> clean, std::size_t variant, std::mt19937 &engine) const;
+
+private:
+  AugmentationSpec spec;
+  std::vector<PartitionedConvolver> convolvers;
+};
+
+} // namespace dsp
+
+#endif // DSP_AUGMENTATION_H_
@@ -0,0 +1,194 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dsp/feature_extractor.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+#include "include/filewriter.h"
+
+namespace dsp {
+
+namespace {
+std::size_t ParseDimension(std::string_view text, const std::string &resolution) {
+  std::size_t value = 0;
+  const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc{} || end != text.data() + text.size() || value == 0) {
+    throw std::invalid_argument("Invalid feature resolution: " + resolution);
+  }
+  return value;
+}
+
+// np.linspace(start, stop, count) including the exact end point.
+std::vector<double> Linspace(double start, double stop, std::size_t count) {
+  std::vector<double> values(count, start);
+  if (count > 1) {
+    const double step = (stop - start) / static_cast<double>(count - 1);
+    for (std::size_t i = 0; i < count; ++i) {
+      values[i] = start + static_cast<double>(i) * step;
+    }
+    values.back() = stop;
+  }
+  return values;
+}
+
+// np.geomspace(start, stop, count) including the exact end points.
+std::vector<double> Geomspace(double start, double stop, std::size_t count) {
+  std::vector<double> values = Linspace(std::log10(start), std::log10(stop), count);
+  for (auto &value : values) {
+    value = std::pow(10.0, value);
+  }
+  values.front() = start;
+  if (count > 1) {
+    values.back() = stop;
+  }
+  return values;
+}
+
+// Python's round(): half to even, which is nearbyint under the default rounding mode.
+std::size_t RoundSamples(double seconds, std::uint32_t sample_rate) {
+  return static_cast<std::size_t>(std::max(0.0, std::nearbyint(seconds * static_cast<double>(sample_rate))));
+}
+} // namespace
+
+FeatureSpec FeatureSpec::WithResolution(const std::string &resolution) const {
+  FeatureSpec parsed = *this;
+  const auto separator = resolution.find_first_of("xX");
+  const std::string_view text(resolution);
+  if (separator == std::string::npos) {
+    parsed.frequency_bins = parsed.time_frames = ParseDimension(text, resolution);
+  } else {
+    parsed.frequency_bins = ParseDimension(text.substr(0, separator), resolution);
+    parsed.time_frames = ParseDimension(text.substr(separator + 1), resolution);
+  }
+  return parsed;
+}
+
+std::string FeatureSpec::Name() const { return std::to_string(frequency_bins) + "x" + std::to_string(time_frames); }
+
+FeatureExtractor::FeatureExtractor(const FeatureSpec &feature_spec) : spec(feature_spec) {
+  if (spec.frequency_bins == 0 || spec.time_frames == 0 || spec.sample_rate == 0) {
+    throw std::invalid_argument("Feature bins, frames and sample rate must be positive");
+  }
+  crop_start = RoundSamples(spec.crop_start_seconds, spec.sample_rate);
+  crop_count = RoundSamples(spec.crop_seconds, spec.sample_rate);
+  if (crop_count == 0) {
+    throw std::invalid_argument("crop_seconds must be positive");
+  }
+
+  fft_size = std::max<std::size_t>(256U, spec.frequency_bins * spec.fft_size_multiplier);
+  fft_size += fft_size % 2;
+  plan = GetRealPlan(fft_size);
+
+  // np.hanning, evaluated in double and stored as float32 like the Python path.
+  window.resize(fft_size);
+  for (std::size_t n = 0; n < fft_size; ++n) {
+    window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * static_cast<double>(n) / static_cast<double>(fft_size - 1)));
+  }
+
+  // np.linspace(0, max_start, frames, dtype=int64) truncates toward zero.
+  const std::size_t max_start = std::max(crop_count, fft_size) - fft_size;
+  frame_starts.assign(spec.time_frames, 0U);
+  if (spec.time_frames > 1) {
+    const auto starts = Linspace(0.0, static_cast<double>(max_start), spec.time_frames);
+    std::transform(starts.begin(), starts.end(), frame_starts.begin(), [](double start) { return static_cast<std::size_t>(start); });
+  }
+
+  // np.interp(target, source[1:], magnitude[1:]) as a fixed two-tap projection.
+  const std::size_t linear_bins = plan->SpectrumSize();
+  const double nyquist = static_cast<double>(spec.sample_rate) / 2.0;
+  const auto source = Linspace(0.0, nyquist, linear_bins);
+  const auto target = Geomspace(std::max(20.0, source[1]), nyquist, spec.frequency_bins);
+  projection.reserve(spec.frequency_bins);
+  for (const double frequency : target) {
+    if (frequency <= source[1]) {
+      projection.push_back({1U, 1.0, 1U, 0.0});
+      continue;
+    }
+    if (frequency >= source.back()) {
+      projection.push_back({linear_bins - 1, 1.0, linear_bins - 1, 0.0});
+      continue;
+    }
+    const auto upper = static_cast<std::size_t>(std::upper_bound(source.begin() + 1, source.end(), frequency) - source.begin());
+    const std::size_t lower = upper - 1;
+    const double fraction = (frequency - source[lower]) / (source[upper] - source[lower]);
+    projection.push_back({lower, 1.0 - fraction, upper, fraction});
+  }
+}
+
+SlftFileHeader FeatureExtractor::Header() const {
+  return filewriter::slft::MakeHeader(spec.sample_rate, static_cast<std::uint32_t>(k_channels),
+                                     static_cast<std::uint32_t>(spec.frequency_bins), static_cast<std::uint32_t>(spec.time_frames));
+}
+
+std::vector<float> FeatureExtractor::Extract(std::span<const int16_t> samples) const {
+  const std::size_t bins = spec.frequency_bins;
+  const std::size_t frames = spec.time_frames;
+
+  // crop_or_pad_samples, then the zero padding _stft_magnitude applies for short crops.
+  std::vector<float> working(std::max(crop_count, fft_size), 0.0F);
+  if (crop_start < samples.size()) {
+    const std::size_t copy_count = std::min(crop_count, samples.size() - crop_start);
+    for (std::size_t i = 0; i < copy_count; ++i) {
+      working[i] = static_cast<float>(samples[crop_start + i]) / 32768.0F;
+    }
+  }
+
+  std::vector<double> frame(fft_size);
+  std::vector<Complex> spectrum(plan->SpectrumSize());
+  std::vector<float> magnitude(spectrum.size());
+  std::vector<float> tensor(TensorSize());
+  float *log_frequency = tensor.data();
+  for (std::size_t t = 0; t < frames; ++t) {
+    const float *start = working.data() + frame_starts[t];
+    for (std::size_t n = 0; n < fft_size; ++n) {
+      frame[n] = static_cast<double>(start[n] * window[n]);
+    }
+    plan->Forward(frame, spectrum);
+    for (std::size_t k = 0; k < spectrum.size(); ++k) {
+      magnitude[k] = static_cast<float>(std::abs(spectrum[k]));
+    }
+    for (std::size_t f = 0; f < bins; ++f) {
+      const auto &tap = projection[f];
+      log_frequency[f * frames + t] =
+          static_cast<float>(tap.lower_weight * magnitude[tap.lower_bin] + tap.upper_weight * magnitude[tap.upper_bin]);
+    }
+  }
+
+  // _normalize_log_magnitude: dB relative to the loudest cell, clipped to 80 dB of range.
+  float peak = -std::numeric_limits<float>::infinity();
+  for (std::size_t i = 0; i < bins * frames; ++i) {
+    log_frequency[i] = 20.0F * std::log10(std::max(log_frequency[i], 1e-6F));
+    peak = std::max(peak, log_frequency[i]);
+  }
+  for (std::size_t i = 0; i < bins * frames; ++i) {
+    const float decibels = std::clamp(log_frequency[i] - peak, -80.0F, 0.0F);
+    log_frequency[i] = (decibels + 80.0F) / 80.0F;
+  }
+
+  float *temporal_delta = log_frequency + bins * frames;
+  float *onset = temporal_delta + bins * frames;
+  for (std::size_t f = 0; f < bins; ++f) {
+    const float *row = log_frequency + f * frames;
+    for (std::size_t t = 0; t < frames; ++t) {
+      const float delta = t == 0 ? 0.0F : row[t] - row[t - 1];
+      temporal_delta[f * frames + t] = std::clamp((delta + 1.0F) * 0.5F, 0.0F, 1.0F);
+      onset[f * frames + t] = std::clamp(delta, 0.0F, 1.0F);
+    }
+  }
+  return tensor;
+}
+
+} // namespace dsp
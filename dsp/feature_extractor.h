@@ -0,0 +1,94 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * feature_extractor.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DSP_FEATURE_EXTRACTOR_H_
+#define DSP_FEATURE_EXTRACTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dsp/fft.h"
+#include "include/structures.h"
+
+namespace dsp {
+
+// Mirrors deep_trainer/audio_features.py FeatureSpec.
+struct FeatureSpec {
+  std::size_t frequency_bins = 128;
+  std::size_t time_frames = 128;
+  double crop_seconds = 5.0;
+  double crop_start_seconds = 0.0;
+  std::size_t fft_size_multiplier = 4;
+  std::uint32_t sample_rate = 44100;
+
+  /*
+   * Parses "FxT" (e.g. "128x256") into bins and frames, keeping the other fields.
+   * @parameters resolution "FxT" or a single number for square tensors.
+   * @returns the spec, throws std::invalid_argument on malformed input.
+   */
+  FeatureSpec WithResolution(const std::string &resolution) const;
+  std::string Name() const; // "FxT"
+};
+
+/*
+ * Native port of extract_feature_tensor_from_samples: Hann windowed STFT,
+ * linear-to-log frequency interpolation, dB normalisation, then temporal delta
+ * and onset channels. Window, frame offsets, FFT plan and the sparse
+ * log-frequency projection are built once per spec; Extract is const and may be
+ * called from several threads.
+ */
+class FeatureExtractor {
+public:
+  static constexpr std::size_t k_channels = 3;
+
+  explicit FeatureExtractor(const FeatureSpec &spec);
+
+  const FeatureSpec &Spec() const { return spec; }
+  std::size_t FftSize() const { return fft_size; }
+  std::size_t TensorSize() const { return k_channels * spec.frequency_bins * spec.time_frames; }
+  SlftFileHeader Header() const;
+
+  /*
+   * @parameters samples mono pcm16 at spec.sample_rate; cropped or zero padded
+   *             to the spec's crop window.
+   * @returns channels x frequency_bins x time_frames float32, channel major.
+   */
+  std::vector<float> Extract(std::span<const int16_t> samples) const;
+
+private:
+  FeatureSpec spec;
+  std::size_t fft_size;
+  std::size_t crop_start;
+  std::size_t crop_count;
+  std::shared_ptr<const RealFftPlan> plan;
+  std::vector<float> window;
+  std::vector<std::size_t> frame_starts;
+
+  // Each log bin interpolates between two neighbouring linear bins (np.interp),
+  // so the projection is stored as a pair of (bin, weight) per row.
+  struct Projection {
+    std::size_t lower_bin;
+    double lower_weight;
+    std::size_t upper_bin;
+    double upper_weight;
+  };
+  std::vector<Projection> projection;
+};
+
+} // namespace dsp
+
+#endif // DSP_FEATURE_EXTRACTOR_H_
@@ -0,0 +1,210 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dsp/fft.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+namespace dsp {
+
+namespace {
+// Complex product without the NaN/Inf recovery of operator* (a __muldc3 call per
+// butterfly). Same result for finite operands, and the loops stay inlinable.
+inline Complex Multiply(const Complex &a, const Complex &b) {
+  return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+} // namespace
+
+std::size_t NextPowerOfTwo(std::size_t value) {
+  std::size_t power = 1;
+  while (power < value) {
+    power <<= 1U;
+  }
+  return power;
+}
+
+FftPlan::FftPlan(std::size_t fft_size) : size(fft_size), power_of_two(fft_size > 0 && (fft_size & (fft_size - 1)) == 0) {
+  if (size == 0) {
+    throw std::invalid_argument("FFT size must be positive");
+  }
+  if (power_of_two) {
+    std::vector<Complex> twiddles(size / 2);
+    for (std::size_t k = 0; k < twiddles.size(); ++k) {
+      twiddles[k] = std::polar(1.0, -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size));
+    }
+    // Each pass gets its own contiguous copy of the twiddles it uses, so the butterfly loop reads them in order.
+    stage_twiddles.reserve(size);
+    for (std::size_t length = 2; length <= size; length <<= 1U) {
+      for (std::size_t j = 0; j < length / 2; ++j) {
+        stage_twiddles.push_back(twiddles[j * (size / length)]);
+      }
+    }
+    bit_reverse.resize(size);
+    std::size_t bits = 0;
+    while ((std::size_t{1} << bits) < size) {
+      ++bits;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      std::size_t reversed = 0;
+      for (std::size_t b = 0; b < bits; ++b) {
+        reversed |= ((i >> b) & 1U) << (bits - 1 - b);
+      }
+      bit_reverse[i] = reversed;
+    }
+    return;
+  }
+
+  // Bluestein: x[k]*w[k] convolved with conj(w), w[k] = exp(-i*pi*k^2/n).
+  const std::size_t convolution_size = NextPowerOfTwo(2 * size - 1);
+  convolution_plan = std::make_unique<FftPlan>(convolution_size);
+  chirp.resize(size);
+  for (std::size_t k = 0; k < size; ++k) {
+    // k^2 mod 2n keeps the phase argument small and exact for large k.
+    const std::size_t k_squared = (k * k) % (2 * size);
+    chirp[k] = std::polar(1.0, -std::numbers::pi * static_cast<double>(k_squared) / static_cast<double>(size));
+  }
+  chirp_spectrum.assign(convolution_size, Complex{});
+  chirp_spectrum[0] = std::conj(chirp[0]);
+  for (std::size_t k = 1; k < size; ++k) {
+    chirp_spectrum[k] = std::conj(chirp[k]);
+    chirp_spectrum[convolution_size - k] = std::conj(chirp[k]);
+  }
+  convolution_plan->Forward(chirp_spectrum);
+}
+
+void FftPlan::Forward(std::span<Complex> data) const {
+  if (data.size() != size) {
+    throw std::invalid_argument("FFT input size does not match the plan");
+  }
+  if (power_of_two) {
+    Radix2(data);
+  } else {
+    Bluestein(data);
+  }
+}
+
+void FftPlan::Inverse(std::span<Complex> data) const {
+  for (auto &value : data) {
+    value = std::conj(value);
+  }
+  Forward(data);
+  const double scale = 1.0 / static_cast<double>(size);
+  for (auto &value : data) {
+    value = std::conj(value) * scale;
+  }
+}
+
+void FftPlan::Radix2(std::span<Complex> data) const {
+  for (std::size_t i = 0; i < size; ++i) {
+    const std::size_t j = bit_reverse[i];
+    if (i < j) {
+      std::swap(data[i], data[j]);
+    }
+  }
+  const Complex *stage = stage_twiddles.data();
+  for (std::size_t length = 2; length <= size; length <<= 1U) {
+    const std::size_t half = length / 2;
+    for (std::size_t start = 0; start < size; start += length) {
+      Complex *low = data.data() + start;
+      Complex *high = low + half;
+      for (std::size_t j = 0; j < half; ++j) {
+        const Complex odd = Multiply(high[j], stage[j]);
+        const Complex even = low[j];
+        low[j] = even + odd;
+        high[j] = even - odd;
+      }
+    }
+    stage += half;
+  }
+}
+
+void FftPlan::Bluestein(std::span<Complex> data) const {
+  const std::size_t convolution_size = convolution_plan->Size();
+  std::vector<Complex> work(convolution_size);
+  for (std::size_t k = 0; k < size; ++k) {
+    work[k] = Multiply(data[k], chirp[k]);
+  }
+  convolution_plan->Forward(work);
+  for (std::size_t k = 0; k < convolution_size; ++k) {
+    work[k] = Multiply(work[k], chirp_spectrum[k]);
+  }
+  convolution_plan->Inverse(work);
+  for (std::size_t k = 0; k < size; ++k) {
+    data[k] = Multiply(work[k], chirp[k]);
+  }
+}
+
+RealFftPlan::RealFftPlan(std::size_t fft_size) : size(fft_size), half_plan(std::max<std::size_t>(1U, fft_size / 2)) {
+  if (size < 2 || size % 2 != 0) {
+    throw std::invalid_argument("Real FFT size must be even");
+  }
+  twiddles.resize(size / 2 + 1);
+  for (std::size_t k = 0; k < twiddles.size(); ++k) {
+    twiddles[k] = std::polar(1.0, -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size));
+  }
+}
+
+void RealFftPlan::Forward(std::span<const double> input, std::span<Complex> spectrum) const {
+  const std::size_t half = size / 2;
+  std::vector<Complex> packed(half);
+  for (std::size_t k = 0; k < half; ++k) {
+    packed[k] = Complex(input[2 * k], input[2 * k + 1]);
+  }
+  half_plan.Forward(packed);
+  // Split the packed transform into even/odd sample spectra and recombine.
+  for (std::size_t k = 0; k <= half; ++k) {
+    const Complex z_k = packed[k % half];
+    const Complex z_mirror = std::conj(packed[(half - k) % half]);
+    const Complex even = 0.5 * (z_k + z_mirror);
+    const Complex odd = Multiply(Complex(0.0, -0.5), z_k - z_mirror);
+    spectrum[k] = even + Multiply(twiddles[k], odd);
+  }
+}
+
+void RealFftPlan::Inverse(std::span<const Complex> spectrum, std::span<double> output) const {
+  const std::size_t half = size / 2;
+  std::vector<Complex> packed(half);
+  for (std::size_t k = 0; k < half; ++k) {
+    const Complex x_k = spectrum[k];
+    const Complex x_mirror = std::conj(spectrum[half - k]);
+    const Complex even = 0.5 * (x_k + x_mirror);
+    const Complex odd = Multiply(0.5 * (x_k - x_mirror), std::conj(twiddles[k]));
+    packed[k] = even + Multiply(Complex(0.0, 1.0), odd);
+  }
+  half_plan.Inverse(packed);
+  for (std::size_t k = 0; k < half; ++k) {
+    output[2 * k] = packed[k].real();
+    output[2 * k + 1] = packed[k].imag();
+  }
+}
+
+namespace {
+template <typename Plan> std::shared_ptr<const Plan> CachedPlan(std::size_t size) {
+  static std::mutex cache_mutex;
+  static std::map<std::size_t, std::shared_ptr<const Plan>> cache;
+  std::lock_guard lock(cache_mutex);
+  auto &plan = cache[size];
+  if (!plan) {
+    plan = std::make_shared<const Plan>(size);
+  }
+  return plan;
+}
+} // namespace
+
+std::shared_ptr<const FftPlan> GetPlan(std::size_t size) { return CachedPlan<FftPlan>(size); }
+
+std::shared_ptr<const RealFftPlan> GetRealPlan(std::size_t size) { return CachedPlan<RealFftPlan>(size); }
+
+} // namespace dsp
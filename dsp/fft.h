@@ -0,0 +1,81 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * fft.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DSP_FFT_H_
+#define DSP_FFT_H_
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace dsp {
+
+using Complex = std::complex<double>;
+
+/*
+ * Complex FFT of a fixed size. Powers of two use an iterative radix-2 transform
+ * with precomputed twiddles; other sizes go through Bluestein's chirp-z on a
+ * power-of-two convolution. Plans are immutable and safe to share between threads.
+ */
+class FftPlan {
+public:
+  explicit FftPlan(std::size_t size);
+
+  std::size_t Size() const { return size; }
+  void Forward(std::span<Complex> data) const;
+  void Inverse(std::span<Complex> data) const; // Scaled by 1/size.
+
+private:
+  std::size_t size;
+  bool power_of_two;
+  std::vector<Complex> stage_twiddles; // exp(-2 pi i j / length) for every pass length, passes back to back.
+  std::vector<std::size_t> bit_reverse;
+
+  // Bluestein state for sizes that are not a power of two.
+  std::vector<Complex> chirp;
+  std::vector<Complex> chirp_spectrum;
+  std::unique_ptr<FftPlan> convolution_plan;
+
+  void Radix2(std::span<Complex> data) const;
+  void Bluestein(std::span<Complex> data) const;
+};
+
+// FFT of an even-length real signal through a half-size complex FFT.
+class RealFftPlan {
+public:
+  explicit RealFftPlan(std::size_t size);
+
+  std::size_t Size() const { return size; }
+  std::size_t SpectrumSize() const { return size / 2 + 1; }
+  // input.size() == Size(), spectrum.size() == SpectrumSize().
+  void Forward(std::span<const double> input, std::span<Complex> spectrum) const;
+  // Inverse of Forward, scaled by 1/size.
+  void Inverse(std::span<const Complex> spectrum, std::span<double> output) const;
+
+private:
+  std::size_t size;
+  FftPlan half_plan;
+  std::vector<Complex> twiddles;
+};
+
+// Process-wide plan cache so repeated extractors of one size share tables.
+std::shared_ptr<const FftPlan> GetPlan(std::size_t size);
+std::shared_ptr<const RealFftPlan> GetRealPlan(std::size_t size);
+
+std::size_t NextPowerOfTwo(std::size_t value);
+
+} // namespace dsp
+
+#endif // DSP_FFT_H_
@@ -0,0 +1,194 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dsp/pitch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+namespace dsp {
+
+namespace {
+// Python's round(): half to even, which is nearbyint under the default rounding mode.
+std::size_t RoundSamples(double seconds, uint32_t sample_rate) {
+  return static_cast<std::size_t>(std::max(0.0, std::nearbyint(seconds * static_cast<double>(sample_rate))));
+}
+
+// Vertex of the parabola through (-1, left), (0, centre), (1, right), clipped to half a lag.
+double ParabolicOffset(double left, double centre, double right) {
+  const double denominator = left - 2.0 * centre + right;
+  if (std::abs(denominator) <= 1e-12) {
+    return 0.0;
+  }
+  return std::clamp(0.5 * (left - right) / denominator, -0.5, 0.5);
+}
+} // namespace
+
+PitchMethod PitchOptions::ParseMethod(const std::string &name) {
+  if (name == "autocorrelation") {
+    return PitchMethod::autocorrelation;
+  }
+  if (name == "yin") {
+    return PitchMethod::yin;
+  }
+  throw std::invalid_argument("Unknown pitch method: " + name);
+}
+
+PitchEstimator::PitchEstimator(uint32_t a_sample_rate, const PitchOptions &a_options) : sample_rate(a_sample_rate), options(a_options) {
+  if (sample_rate == 0U || options.minimum_hz <= 0.0 || options.maximum_hz <= options.minimum_hz || options.frame_seconds <= 0.0 ||
+      options.hop_seconds <= 0.0) {
+    throw std::invalid_argument("Pitch estimation needs a sample rate, 0 < minimum_hz < maximum_hz and positive frame and hop");
+  }
+  const double rate = static_cast<double>(sample_rate);
+  frame_size = std::max<std::size_t>(256U, RoundSamples(options.frame_seconds, sample_rate));
+  hop_size = std::max<std::size_t>(1U, RoundSamples(options.hop_seconds, sample_rate));
+  min_lag = std::max<std::size_t>(1U, static_cast<std::size_t>(rate / options.maximum_hz));
+  max_lag = std::min(frame_size - 2, static_cast<std::size_t>(rate / options.minimum_hz));
+  plan = GetRealPlan(NextPowerOfTwo(2 * frame_size));
+
+  window.assign(frame_size, 1.0);
+  if (options.method == PitchMethod::autocorrelation) {
+    // np.hanning, rounded to float32 like the Python path.
+    for (std::size_t n = 0; n < frame_size; ++n) {
+      window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * static_cast<double>(n) / static_cast<double>(frame_size - 1)));
+    }
+  }
+}
+
+double PitchEstimator::AutocorrelationLag(std::span<const double> correlation, double &strength) const {
+  const auto peak = std::max_element(correlation.begin() + static_cast<std::ptrdiff_t>(min_lag),
+                                     correlation.begin() + static_cast<std::ptrdiff_t>(max_lag) + 1);
+  const auto lag = static_cast<std::size_t>(peak - correlation.begin());
+  strength = correlation[lag] / std::max(correlation[0], 1e-8);
+  if (strength < options.minimum_strength) {
+    strength = 0.0;
+    return 0.0;
+  }
+  return static_cast<double>(lag) + ParabolicOffset(correlation[lag - 1], correlation[lag], correlation[lag + 1]);
+}
+
+double PitchEstimator::YinLag(std::span<const double> frame, std::span<const double> correlation, std::vector<double> &difference,
+                              double &strength) const {
+  // d(tau) = sum_j (x[j] - x[j + tau])^2 over the overlap, from prefix energies and the correlation; then normalised by its
+  // running mean so d'(0) = 1 and short lags are not favoured.
+  const std::size_t last = max_lag + 1;
+  double tail_energy = 0.0; // sum of x[j]^2 for j >= tau
+  for (const double value : frame) {
+    tail_energy += value * value;
+  }
+  double head_energy = tail_energy; // sum of x[j]^2 for j < frame_size - tau
+  double running = 0.0;
+  difference.assign(last + 1, 1.0);
+  for (std::size_t tau = 1; tau <= last; ++tau) {
+    tail_energy -= frame[tau - 1] * frame[tau - 1];
+    head_energy -= frame[frame_size - tau] * frame[frame_size - tau];
+    const double value = std::max(0.0, head_energy + tail_energy - 2.0 * correlation[tau]);
+    running += value;
+    difference[tau] = running > 0.0 ? value * static_cast<double>(tau) / running : 1.0;
+  }
+
+  std::size_t lag = 0;
+  for (std::size_t tau = min_lag; tau <= max_lag; ++tau) {
+    if (difference[tau] < options.yin_threshold) {
+      lag = tau;
+      while (lag < max_lag && difference[lag + 1] < difference[lag]) {
+        ++lag;
+      }
+      break;
+    }
+  }
+  if (lag == 0U) {
+    lag = static_cast<std::size_t>(std::min_element(difference.begin() + static_cast<std::ptrdiff_t>(min_lag),
+                                                    difference.begin() + static_cast<std::ptrdiff_t>(max_lag) + 1) -
+                                   difference.begin());
+  }
+  strength = std::clamp(1.0 - difference[lag], 0.0, 1.0);
+  if (strength < options.minimum_strength) {
+    strength = 0.0;
+    return 0.0;
+  }
+  return static_cast<double>(lag) + ParabolicOffset(difference[lag - 1], difference[lag], difference[lag + 1]);
+}
+
+PitchEstimate PitchEstimator::Estimate(std::span<const float> samples) const {
+  PitchEstimate estimate;
+  if (samples.empty() || max_lag <= min_lag) {
+    return estimate;
+  }
+  double mean = 0.0;
+  for (const float sample : samples) {
+    mean += static_cast<double>(sample);
+  }
+  mean /= static_cast<double>(samples.size());
+  std::vector<double> centred(std::max(samples.size(), frame_size), 0.0);
+  double energy = 0.0;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    centred[i] = static_cast<double>(samples[i]) - mean;
+    energy += centred[i] * centred[i];
+  }
+  if (std::sqrt(energy / static_cast<double>(samples.size())) < 1e-4) {
+    return estimate;
+  }
+
+  const std::size_t transform_size = plan->Size();
+  std::vector<double> frame(frame_size);
+  std::vector<double> padded(transform_size, 0.0);
+  std::vector<Complex> spectrum(plan->SpectrumSize());
+  std::vector<double> correlation(transform_size);
+  std::vector<double> difference;
+  double weighted_log = 0.0;
+  double total_strength = 0.0;
+  const std::size_t start_limit = std::max<std::size_t>(1U, centred.size() - frame_size + 1);
+  for (std::size_t start = 0; start < start_limit; start += hop_size) {
+    ++estimate.frames;
+    const double *source = centred.data() + start;
+    double frame_mean = 0.0;
+    for (std::size_t n = 0; n < frame_size; ++n) {
+      frame_mean += source[n];
+    }
+    frame_mean /= static_cast<double>(frame_size);
+    double frame_energy = 0.0;
+    for (std::size_t n = 0; n < frame_size; ++n) {
+      frame[n] = (source[n] - frame_mean) * window[n];
+      frame_energy += frame[n] * frame[n];
+    }
+    if (frame_energy < 1e-7) {
+      continue;
+    }
+
+    // Linear autocorrelation: the transform is at least twice the frame, so the circular one does not wrap.
+    std::copy(frame.begin(), frame.end(), padded.begin());
+    plan->Forward(padded, spectrum);
+    for (auto &bin : spectrum) {
+      bin = Complex(bin.real() * bin.real() + bin.imag() * bin.imag(), 0.0);
+    }
+    plan->Inverse(spectrum, correlation);
+
+    double strength = 0.0;
+    const double lag = options.method == PitchMethod::yin ? YinLag(frame, correlation, difference, strength)
+                                                          : AutocorrelationLag({correlation.data(), frame_size}, strength);
+    if (strength <= 0.0) {
+      continue;
+    }
+    ++estimate.voiced_frames;
+    weighted_log += strength * std::log2(static_cast<double>(sample_rate) / lag);
+    total_strength += strength;
+  }
+  if (estimate.voiced_frames == 0U) {
+    return estimate;
+  }
+  estimate.frequency = std::exp2(weighted_log / total_strength);
+  estimate.strength = total_strength / static_cast<double>(estimate.voiced_frames);
+  return estimate;
+}
+
+} // namespace dsp
@@ -0,0 +1,94 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * pitch.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef DSP_PITCH_H_
+#define DSP_PITCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dsp/fft.h"
+
+namespace dsp {
+
+enum class PitchMethod {
+  autocorrelation, // deep_trainer/audio_features.py estimate_fundamental_frequency.
+  yin,             // Cumulative mean normalised difference (de Cheveigné and Kawahara).
+};
+
+// Defaults mirror estimate_fundamental_frequency's keyword arguments.
+struct PitchOptions {
+  PitchMethod method = PitchMethod::autocorrelation;
+  double minimum_hz = 40.0;
+  double maximum_hz = 1200.0;
+  double frame_seconds = 0.08;
+  double hop_seconds = 0.04;
+  double minimum_strength = 0.25; // Frames with a weaker periodicity are unvoiced.
+  double yin_threshold = 0.15;    // First dip of the normalised difference below this wins.
+
+  /*
+   * @parameters "autocorrelation" or "yin"
+   * @returns the method, throws std::invalid_argument otherwise
+   */
+  static PitchMethod ParseMethod(const std::string &name);
+};
+
+struct PitchEstimate {
+  std::optional<double> frequency; // Hz; empty for silence or unvoiced input.
+  double strength = 0.0;           // Mean periodicity of the voiced frames, 0 to 1.
+  std::size_t voiced_frames = 0;
+  std::size_t frames = 0;
+};
+
+/*
+ * Frame-wise f0 with the difference or autocorrelation function computed as
+ * |FFT|^2 on a zero-padded power-of-two transform, so a frame costs O(n log n)
+ * instead of the O(n * lags) of np.correlate. Per-frame estimates are combined
+ * as the strength-weighted mean of their log2 frequency, as the Python helper
+ * does. Plans and the window are built once per sample rate; Estimate is const
+ * and may be called from several threads.
+ */
+class PitchEstimator {
+public:
+  PitchEstimator(uint32_t sample_rate, const PitchOptions &options);
+
+  const PitchOptions &Options() const { return options; }
+  uint32_t SampleRate() const { return sample_rate; }
+
+  // samples: mono, full scale +-1.
+  PitchEstimate Estimate(std::span<const float> samples) const;
+
+private:
+  uint32_t sample_rate;
+  PitchOptions options;
+  std::size_t frame_size;
+  std::size_t hop_size;
+  std::size_t min_lag;
+  std::size_t max_lag;
+  std::shared_ptr<const RealFftPlan> plan; // 2 * frame_size rounded up, so the correlation does not wrap.
+  std::vector<double> window;              // np.hanning for autocorrelation, flat for YIN.
+
+  // Returns the refined lag and its strength, or a strength of 0 for an unvoiced frame.
+  double AutocorrelationLag(std::span<const double> correlation, double &strength) const;
+  double YinLag(std::span<const double> frame, std::span<const double> correlation, std::vector<double> &difference,
+                double &strength) const;
+};
+
+} // namespace dsp
+
+#endif // DSP_PITCH_H_
@@ -0,0 +1,324 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "include/async_writer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define SOUNDLEARNER_HAVE_IO_URING 1
+#endif
+
+namespace filewriter {
+namespace async {
+
+namespace {
+constexpr std::size_t k_max_iovecs = 64;
+
+std::vector<iovec> ToIovecs(std::span<const Buffer> parts) {
+  std::vector<iovec> iovecs;
+  iovecs.reserve(parts.size());
+  for (const auto &part : parts) {
+    if (!part.empty()) {
+      iovecs.push_back({const_cast<char *>(part.data()), part.size()});
+    }
+  }
+  return iovecs;
+}
+
+std::size_t TotalSize(std::span<const Buffer> parts) {
+  std::size_t total = 0;
+  for (const auto &part : parts) {
+    total += part.size();
+  }
+  return total;
+}
+
+// Drops the first `written` bytes from an iovec list after a short write.
+void Advance(std::vector<iovec> &iovecs, std::size_t written) {
+  auto it = iovecs.begin();
+  while (it != iovecs.end() && written >= it->iov_len) {
+    written -= it->iov_len;
+    ++it;
+  }
+  iovecs.erase(iovecs.begin(), it);
+  if (!iovecs.empty()) {
+    iovecs.front().iov_base = static_cast<char *>(iovecs.front().iov_base) + written;
+    iovecs.front().iov_len -= written;
+  }
+}
+
+void WriteIovecs(int fd, std::vector<iovec> iovecs, std::uint64_t offset, const std::string &path) {
+  while (!iovecs.empty()) {
+    const int count = static_cast<int>(std::min(iovecs.size(), k_max_iovecs));
+    const ssize_t written = pwritev(fd, iovecs.data(), count, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Failed writing output file: " + path + " (" + std::strerror(errno) + ")");
+    }
+    offset += static_cast<std::uint64_t>(written);
+    Advance(iovecs, static_cast<std::size_t>(written));
+  }
+}
+
+int OpenForWrite(const std::string &path) {
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open output file: " + path);
+  }
+  return fd;
+}
+} // namespace
+
+void WriteVectored(int fd, std::span<const Buffer> parts, std::uint64_t offset, const std::string &path) {
+  WriteIovecs(fd, ToIovecs(parts), offset, path);
+}
+
+namespace detail {
+
+#if defined(SOUNDLEARNER_HAVE_IO_URING)
+/*
+ * Minimal io_uring driven through the raw syscalls so no liburing is required.
+ * Only IORING_OP_WRITEV is used; submissions and completions are handled by the
+ * owning thread.
+ */
+class IoUring {
+public:
+  static std::unique_ptr<IoUring> Create(unsigned entries) {
+    io_uring_params params{};
+    const int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return nullptr;
+    }
+    auto ring = std::unique_ptr<IoUring>(new IoUring(fd));
+    if (!ring->Map(params)) {
+      return nullptr;
+    }
+    return ring;
+  }
+
+  ~IoUring() {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+      munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr != MAP_FAILED) {
+      munmap(sq_ptr, sq_size);
+    }
+    close(ring_fd);
+  }
+
+  unsigned Capacity() const { return sq_entries; }
+
+  void QueueWritev(int fd, const iovec *iovecs, unsigned count, std::uint64_t user_data) {
+    const unsigned tail = *sq_tail;
+    const unsigned index = tail & *sq_mask;
+    io_uring_sqe &sqe = static_cast<io_uring_sqe *>(sqes)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(iovecs);
+    sqe.len = count;
+    sqe.off = 0;
+    sqe.user_data = user_data;
+    sq_array[index] = index;
+    std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+    ++pending;
+  }
+
+  // Takes back everything queued since the last submit. The kernel reads entries only in io_uring_enter, so none are in flight.
+  void DiscardQueued() {
+    std::atomic_ref<unsigned>(*sq_tail).store(*sq_tail - pending, std::memory_order_release);
+    pending = 0;
+  }
+
+  // Submits everything queued and waits for all completions; results[user_data] = res.
+  bool SubmitAndWait(std::vector<int> &results) {
+    unsigned to_submit = pending;
+    unsigned outstanding = pending;
+    pending = 0;
+    while (outstanding > 0) {
+      const long entered = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1U, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (entered < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      to_submit -= std::min(to_submit, static_cast<unsigned>(entered));
+      unsigned head = *cq_head;
+      while (head != std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire)) {
+        const io_uring_cqe &cqe = cqes[head & *cq_mask];
+        results[static_cast<std::size_t>(cqe.user_data)] = cqe.res;
+        ++head;
+        --outstanding;
+      }
+      std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+    }
+    return true;
+  }
+
+private:
+  int ring_fd;
+  void *sq_ptr = MAP_FAILED;
+  void *cq_ptr = MAP_FAILED;
+  void *sqes = MAP_FAILED;
+  std::size_t sq_size = 0;
+  std::size_t cq_size = 0;
+  std::size_t sqes_size = 0;
+  unsigned sq_entries = 0;
+  unsigned pending = 0;
+  unsigned *sq_tail = nullptr;
+  unsigned *sq_mask = nullptr;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+
+  explicit IoUring(int fd) : ring_fd(fd) {}
+
+  bool Map(const io_uring_params &params) {
+    sq_entries = params.sq_entries;
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0U;
+    if (single_mmap) {
+      sq_size = cq_size = std::max(sq_size, cq_size);
+    }
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+      return false;
+    }
+    cq_ptr = single_mmap ? sq_ptr : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      return false;
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    auto *sq_base = static_cast<char *>(sq_ptr);
+    auto *cq_base = static_cast<char *>(cq_ptr);
+    sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+    return true;
+  }
+};
+#else
+class IoUring {
+public:
+  static std::unique_ptr<IoUring> Create(unsigned) { return nullptr; }
+  unsigned Capacity() const { return 0; }
+  void QueueWritev(int, const iovec *, unsigned, std::uint64_t) {}
+  void DiscardQueued() {}
+  bool SubmitAndWait(std::vector<int> &) { return false; }
+};
+#endif
+
+} // namespace detail
+
+BatchFileWriter::BatchFileWriter(bool allow_io_uring, unsigned ring_entries) {
+  if (allow_io_uring) {
+    ring = detail::IoUring::Create(ring_entries);
+  }
+}
+
+BatchFileWriter::~BatchFileWriter() = default;
+
+std::string_view BatchFileWriter::Backend() const { return ring ? "io_uring" : "pwritev"; }
+
+void BatchFileWriter::Write(std::span<const FileWrite> files) {
+  if (!ring) {
+    for (const auto &file : files) {
+      const int fd = OpenForWrite(file.path);
+      try {
+        WriteVectored(fd, file.parts, 0, file.path);
+      } catch (...) {
+        close(fd);
+        throw;
+      }
+      close(fd);
+    }
+    return;
+  }
+
+  const std::size_t chunk = ring->Capacity();
+  for (std::size_t first = 0; first < files.size(); first += chunk) {
+    if (!ring) {
+      Write(files.subspan(first));
+      return;
+    }
+    const std::size_t count = std::min(chunk, files.size() - first);
+    std::vector<int> fds(count, -1);
+    std::vector<std::vector<iovec>> iovecs(count);
+    std::vector<int> results(count, 0);
+    try {
+      for (std::size_t i = 0; i < count; ++i) {
+        const auto &file = files[first + i];
+        fds[i] = OpenForWrite(file.path);
+        iovecs[i] = ToIovecs(file.parts);
+        ring->QueueWritev(fds[i], iovecs[i].data(), static_cast<unsigned>(std::min(iovecs[i].size(), k_max_iovecs)), i);
+      }
+      const bool submitted = ring->SubmitAndWait(results);
+      if (!submitted) {
+        // Tearing the ring down cancels anything in flight; rewrite those files below.
+        ring.reset();
+      }
+      for (std::size_t i = 0; i < count; ++i) {
+        const auto &file = files[first + i];
+        // Finish short or failed ring writes synchronously.
+        const std::size_t written = submitted && results[i] > 0 ? static_cast<std::size_t>(results[i]) : 0U;
+        if (written < TotalSize(file.parts)) {
+          Advance(iovecs[i], written);
+          WriteIovecs(fds[i], std::move(iovecs[i]), written, file.path);
+        }
+      }
+    } catch (...) {
+      // An open failing mid-batch leaves earlier files queued with iovecs that die here; they must not reach the next submit.
+      if (ring) {
+        ring->DiscardQueued();
+      }
+      for (const int fd : fds) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+      throw;
+    }
+    for (const int fd : fds) {
+      close(fd);
+    }
+  }
+}
+
+} // namespace async
+} // namespace filewriter
@@ -0,0 +1,70 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * async_writer.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INCLUDE_ASYNC_WRITER_H_
+#define INCLUDE_ASYNC_WRITER_H_
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace filewriter {
+namespace async {
+
+using Buffer = std::span<const char>;
+
+template <typename T> Buffer AsBuffer(std::span<const T> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size_bytes()};
+}
+inline Buffer AsBuffer(std::string_view data) { return {data.data(), data.size()}; }
+
+// A whole file assembled from several buffers. The buffers must outlive the write.
+struct FileWrite {
+  std::string path;
+  std::vector<Buffer> parts;
+};
+
+// Gathers all parts into one pwritev call at the given offset, retrying short writes.
+void WriteVectored(int fd, std::span<const Buffer> parts, std::uint64_t offset, const std::string &path);
+
+namespace detail {
+class IoUring;
+} // namespace detail
+
+/*
+ * Writes batches of whole files. On Linux the writes of a batch are submitted
+ * together through io_uring; if the kernel refuses a ring (old kernel, seccomp)
+ * every file falls back to a single pwritev. Not thread safe: use one writer per
+ * thread.
+ */
+class BatchFileWriter {
+public:
+  explicit BatchFileWriter(bool allow_io_uring = true, unsigned ring_entries = 64);
+  ~BatchFileWriter();
+  BatchFileWriter(const BatchFileWriter &) = delete;
+  BatchFileWriter &operator=(const BatchFileWriter &) = delete;
+
+  void Write(std::span<const FileWrite> files);
+  std::string_view Backend() const;
+
+private:
+  std::unique_ptr<detail::IoUring> ring;
+};
+
+} // namespace async
+} // namespace filewriter
+
+#endif // INCLUDE_ASYNC_WRITER_H_
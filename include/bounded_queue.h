@@ -0,0 +1,138 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * bounded_queue.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INCLUDE_BOUNDED_QUEUE_H_
+#define INCLUDE_BOUNDED_QUEUE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*
+ * Multi-producer multi-consumer FIFO with a fixed capacity. Push blocks while the
+ * queue is full, which is how a slow consumer applies backpressure to producers.
+ * Time spent blocked on either side is accumulated so callers can tell which
+ * stage is the bottleneck.
+ */
+template <typename T> class BoundedQueue {
+public:
+  struct Stats {
+    std::size_t capacity = 0;
+    std::size_t max_depth = 0;
+    double mean_depth = 0.0; // Sampled at every push.
+    std::uint64_t pushed = 0;
+    std::chrono::nanoseconds push_stall{0}; // Producers waiting for space.
+    std::chrono::nanoseconds pop_stall{0};  // Consumers waiting for items.
+  };
+
+  explicit BoundedQueue(std::size_t queue_capacity) : capacity(std::max<std::size_t>(1U, queue_capacity)) {}
+
+  // Returns false if the queue was closed before the item could be queued.
+  bool Push(T item) {
+    std::unique_lock lock(mutex);
+    if (items.size() >= capacity && !closed) {
+      const auto start = std::chrono::steady_clock::now();
+      not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+      push_stall += std::chrono::steady_clock::now() - start;
+    }
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    ++pushed;
+    depth_sum += items.size();
+    max_depth = std::max(max_depth, items.size());
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+  }
+
+  // Blocks until at least one item is available, then takes up to max_items.
+  // An empty result means the queue is closed and drained.
+  std::vector<T> PopBatch(std::size_t max_items) {
+    std::vector<T> batch;
+    std::unique_lock lock(mutex);
+    if (items.empty() && !closed) {
+      const auto start = std::chrono::steady_clock::now();
+      not_empty.wait(lock, [this] { return !items.empty() || closed; });
+      pop_stall += std::chrono::steady_clock::now() - start;
+    }
+    const std::size_t count = std::min(max_items, items.size());
+    batch.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      batch.push_back(std::move(items.front()));
+      items.pop_front();
+    }
+    lock.unlock();
+    not_full.notify_all();
+    return batch;
+  }
+
+  std::optional<T> Pop() {
+    auto batch = PopBatch(1);
+    if (batch.empty()) {
+      return std::nullopt;
+    }
+    return std::move(batch.front());
+  }
+
+  // Wakes all waiters; queued items can still be popped.
+  void Close() {
+    {
+      std::lock_guard lock(mutex);
+      closed = true;
+    }
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+  std::size_t Depth() const {
+    std::lock_guard lock(mutex);
+    return items.size();
+  }
+
+  Stats GetStats() const {
+    std::lock_guard lock(mutex);
+    Stats stats;
+    stats.capacity = capacity;
+    stats.max_depth = max_depth;
+    stats.mean_depth = pushed > 0 ? static_cast<double>(depth_sum) / static_cast<double>(pushed) : 0.0;
+    stats.pushed = pushed;
+    stats.push_stall = push_stall;
+    stats.pop_stall = pop_stall;
+    return stats;
+  }
+
+private:
+  const std::size_t capacity;
+  mutable std::mutex mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+  std::deque<T> items;
+  bool closed = false;
+
+  std::uint64_t pushed = 0;
+  std::uint64_t depth_sum = 0;
+  std::size_t max_depth = 0;
+  std::chrono::nanoseconds push_stall{0};
+  std::chrono::nanoseconds pop_stall{0};
+};
+
+#endif // INCLUDE_BOUNDED_QUEUE_H_
@@ -22,6 +22,7 @@ constexpr uint32_t EXIT_NORMAL = 0;
 constexpr uint32_t EXIT_BAD_ARGS = 1;
 constexpr uint32_t EXIT_READ_FILE_FAILED = 2;
 constexpr uint32_t EXIT_BAD_SOURCE_SIGNAL = 3;
+constexpr uint32_t EXIT_WRITE_FILE_FAILED = 4;
 
 // Application constants
 constexpr uint32_t SAMPLE_RATE = 44100;
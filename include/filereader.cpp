@@ -10,42 +10,319 @@
 
 #include "include/filereader.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstring>
-#include <fstream>
-#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "include/filewriter.h"
+#include "include/lossless_audio.h"
 
 namespace filereader {
 namespace wave {
 
+namespace {
+
+constexpr uint16_t k_format_extensible = 0xFFFE;
+constexpr std::size_t k_riff_header_size = 12;
+constexpr std::size_t k_chunk_header_size = 8;
+constexpr std::size_t k_fmt_size = 16;
+constexpr std::size_t k_extensible_fmt_size = 40;
+constexpr std::size_t k_sub_format_offset = 24; // Within an extensible fmt chunk; its first two bytes are the format tag.
+
+template <typename T> T ReadLE(const uint8_t *bytes) {
+  T value{};
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+// Chunk ids are four printable ASCII characters.
+bool IsChunkId(const uint8_t *bytes, const uint8_t *end) {
+  return end - bytes >= 4 && std::all_of(bytes, bytes + 4, [](uint8_t value) { return value >= 0x20U && value <= 0x7EU; });
+}
+
+enum class Encoding { u8, s16, s24, s32, f32, f64 };
+
+template <Encoding E> constexpr std::size_t k_width = E == Encoding::u8    ? 1
+                                                      : E == Encoding::s16 ? 2
+                                                      : E == Encoding::s24 ? 3
+                                                      : E == Encoding::f64 ? 8
+                                                                           : 4;
+
+// Maps LoadSample's value to [-1, 1); 24 bit samples are loaded into the top of an int32.
+template <Encoding E> constexpr float k_full_scale = E == Encoding::u8    ? 1.0F / 128.0F
+                                                     : E == Encoding::s16 ? 1.0F / 32768.0F
+                                                     : E == Encoding::s24 || E == Encoding::s32 ? 1.0F / 2147483648.0F
+                                                                                                : 1.0F;
+
+Encoding EncodingOf(const WavFileHeader &header, const std::string &filename) {
+  constexpr uint16_t k_pcm = 1;
+  constexpr uint16_t k_float = 3;
+  Encoding encoding{};
+  if (header.audio_format == k_pcm && header.bit_depth == 8) {
+    encoding = Encoding::u8;
+  } else if (header.audio_format == k_pcm && header.bit_depth == 16) {
+    encoding = Encoding::s16;
+  } else if (header.audio_format == k_pcm && header.bit_depth == 24) {
+    encoding = Encoding::s24;
+  } else if (header.audio_format == k_pcm && header.bit_depth == 32) {
+    encoding = Encoding::s32;
+  } else if (header.audio_format == k_float && header.bit_depth == 32) {
+    encoding = Encoding::f32;
+  } else if (header.audio_format == k_float && header.bit_depth == 64) {
+    encoding = Encoding::f64;
+  } else {
+    throw ReadError("Unsupported wave encoding (format " + std::to_string(header.audio_format) + ", " +
+                    std::to_string(header.bit_depth) + " bit): " + filename);
+  }
+  if (header.block_allign != header.num_of_channels * header.bit_depth / 8U) {
+    throw ReadError("Block alignment does not match the channels and bit depth: " + filename);
+  }
+  return encoding;
+}
+
+// Unaligned little-endian loads through memcpy compile to plain vector loads.
+template <Encoding E> float LoadSample(const uint8_t *bytes) {
+  if constexpr (E == Encoding::u8) {
+    return static_cast<float>(static_cast<int>(bytes[0]) - 128);
+  } else if constexpr (E == Encoding::s24) {
+    const auto packed = static_cast<uint32_t>(bytes[0]) << 8U | static_cast<uint32_t>(bytes[1]) << 16U |
+                        static_cast<uint32_t>(bytes[2]) << 24U;
+    return static_cast<float>(static_cast<int32_t>(packed));
+  } else {
+    using Stored = std::conditional_t<E == Encoding::s16, int16_t,
+                                      std::conditional_t<E == Encoding::s32, int32_t, std::conditional_t<E == Encoding::f32, float, double>>>;
+    Stored value{};
+    std::memcpy(&value, bytes, sizeof(Stored));
+    return static_cast<float>(value);
+  }
+}
+
+// De-interleave, downmix and scale in one pass. A fixed channel count leaves the
+// compiler straight-line loop bodies it vectorizes.
+template <Encoding E, std::size_t Channels> void DownmixFixed(const uint8_t *in, std::size_t frames, float *out) {
+  constexpr float scale = k_full_scale<E> / static_cast<float>(Channels);
+  for (std::size_t frame = 0; frame < frames; ++frame) {
+    const uint8_t *at = in + frame * k_width<E> * Channels;
+    float sum = 0.0F;
+    for (std::size_t channel = 0; channel < Channels; ++channel) {
+      sum += LoadSample<E>(at + channel * k_width<E>);
+    }
+    out[frame] = sum * scale;
+  }
+}
+
+template <Encoding E> void Downmix(const uint8_t *in, std::size_t frames, std::size_t channels, float *out) {
+  switch (channels) {
+  case 1:
+    DownmixFixed<E, 1>(in, frames, out);
+    return;
+  case 2:
+    DownmixFixed<E, 2>(in, frames, out);
+    return;
+  default:
+    break;
+  }
+  const float scale = k_full_scale<E> / static_cast<float>(channels);
+  for (std::size_t frame = 0; frame < frames; ++frame) {
+    const uint8_t *at = in + frame * k_width<E> * channels;
+    float sum = 0.0F;
+    for (std::size_t channel = 0; channel < channels; ++channel) {
+      sum += LoadSample<E>(at + channel * k_width<E>);
+    }
+    out[frame] = sum * scale;
+  }
+}
+
+void DownmixBlock(Encoding encoding, const uint8_t *in, std::size_t frames, std::size_t channels, float *out) {
+  switch (encoding) {
+  case Encoding::u8:
+    Downmix<Encoding::u8>(in, frames, channels, out);
+    break;
+  case Encoding::s16:
+    Downmix<Encoding::s16>(in, frames, channels, out);
+    break;
+  case Encoding::s24:
+    Downmix<Encoding::s24>(in, frames, channels, out);
+    break;
+  case Encoding::s32:
+    Downmix<Encoding::s32>(in, frames, channels, out);
+    break;
+  case Encoding::f32:
+    Downmix<Encoding::f32>(in, frames, channels, out);
+    break;
+  case Encoding::f64:
+    Downmix<Encoding::f64>(in, frames, channels, out);
+    break;
+  }
+}
+
+// Round half away from zero and clip; branch-free so it vectorizes.
+template <typename T> void Quantize(std::span<const float> in, float full_scale, T *out) {
+  const float low = -full_scale;
+  // int32's maximum rounds up to 2^31 as a float; stay one float step below it.
+  const float high = std::numeric_limits<T>::digits > std::numeric_limits<float>::digits
+                         ? std::nextafter(static_cast<float>(std::numeric_limits<T>::max()), 0.0F)
+                         : static_cast<float>(std::numeric_limits<T>::max());
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    const float scaled = in[i] * full_scale;
+    const float rounded = scaled + (scaled >= 0.0F ? 0.5F : -0.5F);
+    out[i] = static_cast<T>(std::clamp(rounded, low, high));
+  }
+}
+
+} // namespace
+
 WaveReaderC::WaveReaderC(const std::string &a_filename) : filename(a_filename) {
-  std::ifstream wav_file(a_filename, std::ios::binary);
-  if (!wav_file.is_open()) {
-    std::cout << "ERROR!!! Could not open wave file " << a_filename << std::endl;
-    exit(EXIT_READ_FILE_FAILED);
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw ReadError("Could not open wave file " + filename);
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    close(fd);
+    throw ReadError("Could not open wave file " + filename + " file size invalid");
+  }
+  mapped_size = static_cast<std::size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw ReadError("Could not map wave file " + filename);
+  }
+  mapped = static_cast<const uint8_t *>(address);
+  madvise(address, mapped_size, MADV_SEQUENTIAL);
+
+  try {
+    const std::span<const uint8_t> bytes(mapped, mapped_size);
+    if (lossless::IsEncoded(bytes)) {
+      // SLAC files decode to the PCM a 16 bit mono wave of the same samples holds.
+      owned = lossless::Decode(bytes);
+      header = filewriter::wave::MakeMonoHeader(owned.size());
+      header.sample_rate = lossless::ReadInfo(bytes).sample_rate;
+      header.bytes_per_second = header.sample_rate * header.block_allign;
+      data = {reinterpret_cast<const uint8_t *>(owned.data()), owned.size() * sizeof(int16_t)};
+      Release();
+      return;
+    }
+    ParseRiff();
+  } catch (const ReadError &) {
+    Release();
+    throw;
+  } catch (const std::exception &error) {
+    Release();
+    throw ReadError(filename + ": " + error.what());
+  }
+}
+
+// Walks the chunks after "RIFF"/"WAVE"; every chunk is padded to an even size.
+void WaveReaderC::ParseRiff() {
+  if (mapped_size < k_riff_header_size || std::memcmp(mapped, header.riff, 4) != 0 ||
+      std::memcmp(mapped + 8, header.wave, 4) != 0) {
+    throw ReadError("Not a RIFF/WAVE file: " + filename);
+  }
+  header.chunk_size = ReadLE<uint32_t>(mapped + 4);
+  bool has_format = false;
+  bool has_data = false;
+  std::size_t offset = k_riff_header_size;
+  while (offset + k_chunk_header_size <= mapped_size && !(has_format && has_data)) {
+    const uint8_t *chunk = mapped + offset;
+    const std::size_t chunk_size = ReadLE<uint32_t>(chunk + 4);
+    const std::size_t available = mapped_size - offset - k_chunk_header_size;
+    const uint8_t *body = chunk + k_chunk_header_size;
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunk_size < k_fmt_size || chunk_size > available) {
+        throw ReadError("Truncated fmt chunk in " + filename);
+      }
+      header.sub_chunk_1_size = static_cast<uint32_t>(chunk_size);
+      header.audio_format = ReadLE<uint16_t>(body);
+      header.num_of_channels = ReadLE<uint16_t>(body + 2);
+      header.sample_rate = ReadLE<uint32_t>(body + 4);
+      header.bytes_per_second = ReadLE<uint32_t>(body + 8);
+      header.block_allign = ReadLE<uint16_t>(body + 12);
+      header.bit_depth = ReadLE<uint16_t>(body + 14);
+      if (header.audio_format == k_format_extensible && chunk_size >= k_extensible_fmt_size) {
+        header.audio_format = ReadLE<uint16_t>(body + k_sub_format_offset);
+      }
+      has_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      // Streaming writers leave the size at 0xFFFFFFFF, or at 0 with the samples running to the end of the file, and
+      // truncated files end early: take what is there. A 0 size followed by another chunk is a genuinely empty chunk.
+      const bool followed = available >= k_chunk_header_size && IsChunkId(body, body + available) &&
+                            ReadLE<uint32_t>(body + 4) <= available - k_chunk_header_size;
+      const bool streaming = chunk_size == 0xFFFFFFFFU || (chunk_size == 0U && !followed);
+      const std::size_t size = (streaming || chunk_size > available) ? available : chunk_size;
+      data = {body, size};
+      header.sub_chunk_2_size = static_cast<uint32_t>(size);
+      has_data = true;
+    }
+    offset += k_chunk_header_size + chunk_size;
+    // Some writers omit the pad byte after an odd sized chunk; follow whichever position holds a chunk id.
+    if ((chunk_size & 1U) != 0U) {
+      const uint8_t *end = mapped + mapped_size;
+      const bool unpadded = offset < mapped_size && IsChunkId(mapped + offset, end) && !IsChunkId(mapped + offset + 1, end);
+      offset += unpadded ? 0U : 1U;
+    }
   }
-  wav_file.unsetf(std::ios::skipws);
+  if (!has_format || !has_data) {
+    throw ReadError(std::string("Missing ") + (has_format ? "data" : "fmt ") + " chunk in " + filename);
+  }
+  if (header.num_of_channels == 0U || header.block_allign == 0U) {
+    throw ReadError("Invalid fmt chunk in " + filename);
+  }
+  data = data.first(data.size() - data.size() % header.block_allign);
+  header.sub_chunk_2_size = static_cast<uint32_t>(data.size());
+  if (header.bit_depth == 16 && reinterpret_cast<std::uintptr_t>(data.data()) % alignof(int16_t) != 0U) {
+    // Only a malformed, unpadded chunk before data gets here; fall back to one copy.
+    owned.resize(data.size() / sizeof(int16_t));
+    std::memcpy(owned.data(), data.data(), data.size());
+    data = {reinterpret_cast<const uint8_t *>(owned.data()), data.size()};
+    Release();
+  }
+}
 
-  wav_file.seekg(0, std::ios::end);
-  const auto file_end = wav_file.tellg();
-  if (file_end <= 0) {
-    std::cout << "ERROR!!! Could not open wave file " << a_filename << " file size invalid " << std::endl;
-    exit(EXIT_READ_FILE_FAILED);
+WaveReaderC::~WaveReaderC() { Release(); }
+
+WaveReaderC::WaveReaderC(WaveReaderC &&other) noexcept
+    : filename(std::move(other.filename)), header(other.header), mapped(std::exchange(other.mapped, nullptr)),
+      mapped_size(std::exchange(other.mapped_size, 0)), data(std::exchange(other.data, {})), owned(std::move(other.owned)) {}
+
+WaveReaderC &WaveReaderC::operator=(WaveReaderC &&other) noexcept {
+  if (this != &other) {
+    Release();
+    filename = std::move(other.filename);
+    header = other.header;
+    mapped = std::exchange(other.mapped, nullptr);
+    mapped_size = std::exchange(other.mapped_size, 0);
+    data = std::exchange(other.data, {});
+    owned = std::move(other.owned);
   }
-  const auto file_size = static_cast<std::size_t>(file_end);
-  wav_file.seekg(0, std::ios::beg);
+  return *this;
+}
 
-  if (file_size <= sizeof(WavFileHeader)) {
-    std::cout << "ERROR!!! Could not open wave file " << a_filename << " file size to small " << std::endl;
-    exit(EXIT_READ_FILE_FAILED);
+void WaveReaderC::Release() {
+  if (mapped != nullptr) {
+    munmap(const_cast<uint8_t *>(mapped), mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
   }
+}
 
-  std::vector<char> buffer(file_size);
-  wav_file.read(buffer.data(), static_cast<std::streamsize>(file_size));
-  std::memcpy(&header, buffer.data(), sizeof(WavFileHeader));
-  wav_data = std::vector<char>(buffer.begin() + sizeof(WavFileHeader), buffer.end());
+std::span<const int16_t> WaveReaderC::Samples() const {
+  if (header.audio_format != 1U || header.bit_depth != 16U) {
+    throw ReadError("Not a 16 bit PCM wave: " + filename);
+  }
+  return {reinterpret_cast<const int16_t *>(data.data()), data.size() / sizeof(int16_t)};
 }
 
-std::string WaveReaderC::HeaderToString() {
+std::string WaveReaderC::HeaderToString() const {
   std::string ret_string = "{\n";
   ret_string += "\"riff\": " + std::string(header.riff, 4) + ",\n";
   ret_string += "\"chunk_size\": " + std::to_string(header.chunk_size) + ",\n";
@@ -60,20 +337,91 @@ std::string WaveReaderC::HeaderToString() {
   ret_string += "\"bit_depth\": " + std::to_string(header.bit_depth) + ",\n";
   ret_string += "\"sub_chunk_2_id\": " + std::string(header.sub_chunk_2_id, 4) + ",\n";
   ret_string += "\"sub_chunk_2_size\": " + std::to_string(header.sub_chunk_2_size) + ",\n";
-  ret_string += "\"data_size\": " + std::to_string(wav_data.size()) + "\n";
+  ret_string += "\"data_size\": " + std::to_string(data.size()) + "\n";
   ret_string += "}\n";
   return ret_string;
 }
 
-std::vector<int16_t> WaveReaderC::ToMono16BitWave() {
-  if (header.num_of_channels == 1 && header.bit_depth == 16) {
-    std::vector<int16_t> out_vector(wav_data.size() / sizeof(int16_t));
-    std::memcpy(reinterpret_cast<char *>(out_vector.data()), wav_data.data(), wav_data.size());
-    return out_vector;
+std::size_t WaveReaderC::ReadMono(std::size_t first_frame, std::span<float> out) const {
+  const Encoding encoding = EncodingOf(header, filename);
+  const std::size_t frames = std::min(out.size(), Frames() - std::min(first_frame, Frames()));
+  if (frames == 0U) {
+    return 0;
+  }
+  DownmixBlock(encoding, data.data() + first_frame * header.block_allign, frames, header.num_of_channels, out.data());
+  return frames;
+}
+
+std::size_t WaveReaderC::ReadMono(std::size_t first_frame, std::span<int16_t> out) const {
+  const Encoding encoding = EncodingOf(header, filename);
+  const std::size_t frames = std::min(out.size(), Frames() - std::min(first_frame, Frames()));
+  if (frames == 0U) {
+    return 0;
+  }
+  if (encoding == Encoding::s16 && header.num_of_channels == 1U) {
+    std::memcpy(out.data(), data.data() + first_frame * header.block_allign, frames * sizeof(int16_t));
+    return frames;
   }
+  std::array<float, 1024> block; // Stays in L1 between the downmix and the quantize pass.
+  for (std::size_t done = 0; done < frames; done += block.size()) {
+    const std::size_t count = std::min(block.size(), frames - done);
+    DownmixBlock(encoding, data.data() + (first_frame + done) * header.block_allign, count, header.num_of_channels, block.data());
+    Quantize<int16_t>(std::span<const float>(block.data(), count), 32768.0F, out.data() + done);
+  }
+  return frames;
+}
+
+// Drops the whole pages of the mapping before byte_offset of the data chunk; a no-op for decoded data.
+void WaveReaderC::DropBefore(std::size_t byte_offset) const {
+  if (mapped == nullptr || data.data() < mapped || data.data() >= mapped + mapped_size) {
+    return;
+  }
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const std::size_t end = static_cast<std::size_t>(data.data() - mapped) + byte_offset;
+  const std::size_t dropped = end - end % page;
+  if (dropped != 0U) {
+    madvise(const_cast<uint8_t *>(mapped), dropped, MADV_DONTNEED);
+  }
+}
+
+void WaveReaderC::StreamMono(const std::function<void(std::span<const float>)> &consume, std::size_t block_frames) const {
+  std::vector<float> block(std::max<std::size_t>(block_frames, 1));
+  for (std::size_t first = 0; first < Frames(); first += block.size()) {
+    const std::size_t frames = ReadMono(first, block);
+    consume(std::span<const float>(block.data(), frames));
+    DropBefore((first + frames) * header.block_allign);
+  }
+}
+
+void WaveReaderC::StreamMono(const std::function<void(std::span<const int16_t>)> &consume, std::size_t block_frames) const {
+  std::vector<int16_t> block(std::max<std::size_t>(block_frames, 1));
+  for (std::size_t first = 0; first < Frames(); first += block.size()) {
+    const std::size_t frames = ReadMono(first, block);
+    consume(std::span<const int16_t>(block.data(), frames));
+    DropBefore((first + frames) * header.block_allign);
+  }
+}
+
+std::vector<int16_t> WaveReaderC::ToMono16BitWave() const {
+  std::vector<int16_t> out(Frames());
+  ReadMono(0, out);
+  return out;
+}
+
+std::vector<int32_t> WaveReaderC::ToMono32BitWave() const {
+  std::vector<int32_t> out(Frames());
+  std::array<float, 1024> block;
+  for (std::size_t first = 0; first < out.size(); first += block.size()) {
+    const std::size_t frames = ReadMono(first, block);
+    Quantize<int32_t>(std::span<const float>(block.data(), frames), 2147483648.0F, out.data() + first);
+  }
+  return out;
+}
 
-  // TODO(Brandon): Handle other formats.
-  return std::vector<int16_t>(wav_data.size());
+std::vector<float> WaveReaderC::ToMonoFloatWave() const {
+  std::vector<float> out(Frames());
+  ReadMono(0, out);
+  return out;
 }
 
 } // namespace wave
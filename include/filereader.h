@@ -15,7 +15,11 @@
 #ifndef INCLUDE_FILEREADER_H_
 #define INCLUDE_FILEREADER_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -38,21 +42,83 @@ private:
 } // namespace bmp
 
 namespace wave {
+// Thrown when a file cannot be opened, is not a RIFF/WAVE or SLAC stream, or is malformed.
+class ReadError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/*
+ * Reads .wav files, and .slac files (include/lossless_audio.h) as if they were a
+ * 16 bit mono wave, and converts any layout to mono. The wave is memory-mapped and its RIFF chunks walked, so
+ * fmt/LIST/fact chunks in any order are handled and the data chunk is viewed in
+ * place. Throws ReadError.
+ */
 class WaveReaderC {
 public:
   explicit WaveReaderC(const std::string &a_filename);
+  ~WaveReaderC();
+  WaveReaderC(const WaveReaderC &) = delete;
+  WaveReaderC &operator=(const WaveReaderC &) = delete;
+  WaveReaderC(WaveReaderC &&other) noexcept;
+  WaveReaderC &operator=(WaveReaderC &&other) noexcept;
 
-  std::string HeaderToString();
-  std::vector<int16_t> ToMono16BitWave();
+  std::string HeaderToString() const;
+  const WavFileHeader &Header() const { return header; }
+  uint32_t SampleRate() const { return header.sample_rate; }
+  uint16_t Channels() const { return header.num_of_channels; }
+  uint16_t BitDepth() const { return header.bit_depth; }
+  // 1 for integer PCM, 3 for IEEE float; WAVE_FORMAT_EXTENSIBLE files report their sub format.
+  uint16_t AudioFormat() const { return header.audio_format; }
+
+  // Payload of the data chunk, clamped to the file; valid while the reader lives.
+  std::span<const uint8_t> Data() const { return data; }
+  /*
+   * Interleaved samples of a 16 bit PCM file without copying them.
+   * @returns a view valid while the reader lives; throws ReadError for other formats
+   */
+  std::span<const int16_t> Samples() const;
 
-  // TODO(Brandon) for future.
-  std::vector<int32_t> ToMono32BitWave();
-  std::vector<float> ToMonoFloatWave();
+  // Frames in the data chunk (one sample per channel each).
+  std::size_t Frames() const { return data.size() / header.block_allign; }
+
+  /*
+   * Converts frames [first_frame, first_frame + out.size()) of any 8/16/24/32 bit
+   * PCM or 32/64 bit float wave to mono, averaging the channels. Floats are in
+   * [-1, 1); 16 bit output is rounded and clipped.
+   * @parameters first frame, output (its size is the frame count wanted)
+   * @returns frames written, fewer than out.size() at the end of the data; throws ReadError for other encodings
+   */
+  std::size_t ReadMono(std::size_t first_frame, std::span<float> out) const;
+  std::size_t ReadMono(std::size_t first_frame, std::span<int16_t> out) const;
+
+  /*
+   * Calls consume with consecutive mono blocks of at most block_frames frames.
+   * Pages behind the cursor are dropped from the mapping, so a recording of any
+   * length streams in constant memory.
+   * @parameters consumer, block size in frames
+   */
+  void StreamMono(const std::function<void(std::span<const float>)> &consume, std::size_t block_frames = k_stream_block_frames) const;
+  void StreamMono(const std::function<void(std::span<const int16_t>)> &consume, std::size_t block_frames = k_stream_block_frames) const;
+
+  // Whole-file mono conversions; a mono 16 bit wave is copied as is.
+  std::vector<int16_t> ToMono16BitWave() const;
+  std::vector<int32_t> ToMono32BitWave() const; // Full scale int32, with float precision (24 significant bits).
+  std::vector<float> ToMonoFloatWave() const;
+
+  static constexpr std::size_t k_stream_block_frames = 16384;
 
 private:
   std::string filename;
   WavFileHeader header;
-  std::vector<char> wav_data;
+  const uint8_t *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<const uint8_t> data;
+  std::vector<int16_t> owned; // Decoded SLAC, or a data chunk at an odd offset.
+
+  void ParseRiff();
+  void Release();
+  void DropBefore(std::size_t byte_offset) const;
 };
 } // namespace wave
 } // namespace filereader
@@ -10,8 +10,14 @@
 
 #include "include/filewriter.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 
@@ -37,6 +43,45 @@ RGBA MakeRgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
   return rgba;
 }
 
+RGBA Inferno(double value) {
+  constexpr std::array<std::array<double, 4>, 6> k_stops = {{
+      {0.0, 0.0, 4.0, 30.0},
+      {0.2, 52.0, 16.0, 92.0},
+      {0.4, 120.0, 28.0, 109.0},
+      {0.6, 187.0, 55.0, 84.0},
+      {0.8, 249.0, 142.0, 8.0},
+      {1.0, 252.0, 255.0, 164.0},
+  }};
+  value = std::clamp(value, 0.0, 1.0);
+  std::size_t upper = 1;
+  while (upper + 1 < k_stops.size() && value > k_stops[upper][0]) {
+    ++upper;
+  }
+  const auto &low = k_stops[upper - 1];
+  const auto &high = k_stops[upper];
+  const double t = (value - low[0]) / (high[0] - low[0]);
+  const auto channel = [&](std::size_t i) { return static_cast<uint8_t>(low[i] + t * (high[i] - low[i])); };
+  return MakeRgba(channel(1), channel(2), channel(3));
+}
+
+// One row of packed BGRA (BMP) or RGB (P6) bytes through the table.
+template <typename T> static void ColorRow(std::span<const T> row, const image::ColorLut &lut, bool bgra, std::vector<char> &out) {
+  const std::size_t channels = bgra ? 4 : 3;
+  out.resize(row.size() * channels);
+  char *at = out.data();
+  for (const T value : row) {
+    const RGBA rgba = lut(value);
+    if (bgra) {
+      std::memcpy(at, &rgba, sizeof(rgba));
+    } else {
+      at[0] = static_cast<char>(rgba.rgba_st.R);
+      at[1] = static_cast<char>(rgba.rgba_st.G);
+      at[2] = static_cast<char>(rgba.rgba_st.B);
+    }
+    at += channels;
+  }
+}
+
 } // namespace detail
 
 namespace text {
@@ -62,31 +107,63 @@ void WriteFile(const std::string &filename, const std::string &content) {
 
 namespace image {
 
-Image::Image(std::size_t image_width, std::size_t image_height)
-    : width(image_width), height(image_height), pixels(image_width * image_height) {}
+const ColorLut &ColorLut::For(ColorScaleType color_scale) {
+  static const ColorLut grayscale(ColorScaleType::GRAYSCALE);
+  static const ColorLut rgb(ColorScaleType::RGB);
+  static const ColorLut yuv(ColorScaleType::YUV);
+  static const ColorLut inferno(ColorScaleType::INFERNO);
+  switch (color_scale) {
+  case ColorScaleType::RGB:
+    return rgb;
+  case ColorScaleType::YUV:
+    return yuv;
+  case ColorScaleType::INFERNO:
+    return inferno;
+  case ColorScaleType::GRAYSCALE:
+  default:
+    return grayscale;
+  }
+}
+
+ColorLut::ColorLut(ColorScaleType color_scale) {
+  for (std::size_t i = 0; i < k_size; ++i) {
+    table[i] = ToRgba(static_cast<double>(i) / static_cast<double>(k_size - 1), color_scale);
+  }
+}
 
 } // namespace image
 
 namespace ppm {
 
-void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale) {
-  std::ofstream fout(file_name, std::ios::out | std::ios::trunc);
+template <typename T> static void WriteImage(const image::BasicImage<T> &image, const std::string &file_name, ColorScaleType color_scale) {
+  std::ofstream fout(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
   detail::EnsureOpen(fout, file_name);
 
-  fout << "P3\n" << image.Width() << ' ' << image.Height() << "\n255\n";
+  const auto &lut = image::ColorLut::For(color_scale);
+  fout << "P6\n" << image.Width() << ' ' << image.Height() << "\n255\n";
+  std::vector<char> row_bytes;
   for (std::size_t row = image.Height(); row-- > 0;) {
-    for (std::size_t col = 0; col < image.Width(); ++col) {
-      const RGBA rgba = ToRgba(image.At(col, row), color_scale);
-      fout << static_cast<int>(rgba.rgba_st.R) << ' ' << static_cast<int>(rgba.rgba_st.G) << ' ' << static_cast<int>(rgba.rgba_st.B) << '\n';
-    }
+    detail::ColorRow(image.Row(row), lut, false, row_bytes);
+    fout.write(row_bytes.data(), static_cast<std::streamsize>(row_bytes.size()));
+  }
+  if (!fout) {
+    throw std::runtime_error("Unable to write image: " + file_name);
   }
 }
 
+void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale) {
+  WriteImage(image, file_name, color_scale);
+}
+
+void Write(const image::ImageU16 &image, const std::string &file_name, ColorScaleType color_scale) {
+  WriteImage(image, file_name, color_scale);
+}
+
 } // namespace ppm
 
 namespace bmp {
 
-void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale) {
+template <typename T> static void WriteImage(const image::BasicImage<T> &image, const std::string &file_name, ColorScaleType color_scale) {
   BMPFileHeader file_header{};
   BMPInfoHeader info_header{};
 
@@ -105,29 +182,55 @@ void Write(const image::Image &image, const std::string &file_name, ColorScaleTy
   fout.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
   fout.write(reinterpret_cast<const char *>(&info_header), sizeof(info_header));
 
+  // 32 bit rows need no padding.
+  const auto &lut = image::ColorLut::For(color_scale);
+  std::vector<char> row_bytes;
   for (std::size_t row = image.Height(); row-- > 0;) {
-    for (std::size_t col = 0; col < image.Width(); ++col) {
-      const RGBA rgba = ToRgba(image.At(col, row), color_scale);
-      fout.write(reinterpret_cast<const char *>(&rgba), sizeof(rgba));
-    }
+    detail::ColorRow(image.Row(row), lut, true, row_bytes);
+    fout.write(row_bytes.data(), static_cast<std::streamsize>(row_bytes.size()));
+  }
+  if (!fout) {
+    throw std::runtime_error("Unable to write image: " + file_name);
   }
 }
 
+void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale) {
+  WriteImage(image, file_name, color_scale);
+}
+
+void Write(const image::ImageU16 &image, const std::string &file_name, ColorScaleType color_scale) {
+  WriteImage(image, file_name, color_scale);
+}
+
 } // namespace bmp
 
 namespace wave {
 
-MonoWriter::MonoWriter(const std::vector<int16_t> &data) : wav_data(data) {}
-
-void MonoWriter::Write(const std::string &file_name) {
+WavFileHeader MakeMonoHeader(std::size_t sample_count, uint32_t sample_rate) {
   WavFileHeader header{};
   header.num_of_channels = 1;
-  header.sample_rate = SAMPLE_RATE;
+  header.sample_rate = sample_rate;
   header.bit_depth = BITDEPTH;
   header.block_allign = static_cast<uint16_t>(header.num_of_channels * header.bit_depth / 8);
   header.bytes_per_second = header.sample_rate * header.block_allign;
-  header.sub_chunk_2_size = static_cast<uint32_t>(wav_data.size() * sizeof(int16_t));
+  header.sub_chunk_2_size = static_cast<uint32_t>(sample_count * sizeof(int16_t));
   header.chunk_size = 36U + header.sub_chunk_2_size;
+  return header;
+}
+
+// RIFF sizes are 32 bit.
+static void CheckWaveSize(std::size_t sample_count, const std::string &file_name) {
+  constexpr std::size_t k_max_samples = (std::numeric_limits<uint32_t>::max() - 36U) / sizeof(int16_t);
+  if (sample_count > k_max_samples) {
+    throw std::runtime_error("Wave data exceeds 4 GiB: " + file_name);
+  }
+}
+
+MonoWriter::MonoWriter(std::span<const int16_t> data, uint32_t a_sample_rate) : wav_data(data), sample_rate(a_sample_rate) {}
+
+void MonoWriter::Write(const std::string &file_name) {
+  CheckWaveSize(wav_data.size(), file_name);
+  const WavFileHeader header = MakeMonoHeader(wav_data.size(), sample_rate);
 
   std::ofstream fout(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
   detail::EnsureOpen(fout, file_name);
@@ -135,5 +238,131 @@ void MonoWriter::Write(const std::string &file_name) {
   fout.write(reinterpret_cast<const char *>(wav_data.data()), static_cast<std::streamsize>(header.sub_chunk_2_size));
 }
 
+MonoStreamWriter::MonoStreamWriter(const std::string &a_file_name, uint32_t a_sample_rate)
+    : file_name(a_file_name), sample_rate(a_sample_rate), out(a_file_name, std::ios::out | std::ios::binary | std::ios::trunc) {
+  detail::EnsureOpen(out, file_name);
+  PatchHeader();
+}
+
+MonoStreamWriter::~MonoStreamWriter() {
+  try {
+    Close();
+  } catch (const std::exception &) {
+    // Destructors must not throw; call Close to see the error.
+  }
+}
+
+void MonoStreamWriter::Append(std::span<const int16_t> block) {
+  if (!out.is_open()) {
+    throw std::runtime_error("Wave stream already closed: " + file_name);
+  }
+  CheckWaveSize(sample_count + block.size(), file_name);
+  out.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(block.size_bytes()));
+  sample_count += block.size();
+}
+
+void MonoStreamWriter::Flush() {
+  if (out.is_open()) {
+    PatchHeader();
+    out.flush();
+  }
+}
+
+void MonoStreamWriter::Close() {
+  if (out.is_open()) {
+    PatchHeader();
+    out.close();
+    if (!out) {
+      throw std::runtime_error("Unable to write wave file: " + file_name);
+    }
+  }
+}
+
+void MonoStreamWriter::PatchHeader() {
+  const WavFileHeader header = MakeMonoHeader(sample_count, sample_rate);
+  const auto end = out.tellp();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (end > std::streampos(static_cast<std::streamoff>(sizeof(header)))) {
+    out.seekp(end);
+  }
+  if (!out) {
+    throw std::runtime_error("Unable to write wave file: " + file_name);
+  }
+}
+
+MonoMappedWriter::MonoMappedWriter(const std::string &a_file_name, std::size_t capacity, uint32_t a_sample_rate)
+    : file_name(a_file_name), sample_rate(a_sample_rate) {
+  CheckWaveSize(capacity, file_name);
+  fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open output file: " + file_name);
+  }
+  mapped_size = sizeof(WavFileHeader) + capacity * sizeof(int16_t);
+  if (ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+    close(fd);
+    throw std::runtime_error("Unable to size wave file: " + file_name);
+  }
+  mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    close(fd);
+    throw std::runtime_error("Unable to map wave file: " + file_name);
+  }
+  // The header is 44 bytes, so the samples start int16_t aligned in the page-aligned map.
+  const WavFileHeader header = MakeMonoHeader(capacity, sample_rate);
+  std::memcpy(mapped, &header, sizeof(header));
+  samples = {reinterpret_cast<int16_t *>(static_cast<char *>(mapped) + sizeof(header)), capacity};
+}
+
+MonoMappedWriter::~MonoMappedWriter() {
+  try {
+    Close(samples.size());
+  } catch (const std::exception &) {
+    // Destructors must not throw; call Close to see the error.
+  }
+}
+
+void MonoMappedWriter::Close(std::size_t sample_count) {
+  if (fd < 0) {
+    return;
+  }
+  sample_count = std::min(sample_count, samples.size());
+  const WavFileHeader header = MakeMonoHeader(sample_count, sample_rate);
+  std::memcpy(mapped, &header, sizeof(header));
+  munmap(mapped, mapped_size);
+  const bool truncated = ftruncate(fd, static_cast<off_t>(sizeof(header) + sample_count * sizeof(int16_t))) == 0;
+  const bool closed = close(fd) == 0;
+  fd = -1;
+  mapped = nullptr;
+  samples = {};
+  if (!truncated || !closed) {
+    throw std::runtime_error("Unable to finish wave file: " + file_name);
+  }
+}
+
 } // namespace wave
+
+namespace slft {
+
+SlftFileHeader MakeHeader(uint32_t sample_rate, uint32_t channels, uint32_t frequency_bins, uint32_t time_frames) {
+  SlftFileHeader header{};
+  header.sample_rate = sample_rate;
+  header.channels = channels;
+  header.frequency_bins = frequency_bins;
+  header.time_frames = time_frames;
+  return header;
+}
+
+void Write(const std::string &file_name, const SlftFileHeader &header, const std::vector<float> &data) {
+  const std::size_t expected = static_cast<std::size_t>(header.channels) * header.frequency_bins * header.time_frames;
+  if (data.size() != expected) {
+    throw std::runtime_error("SLFT data size does not match its header: " + file_name);
+  }
+  std::ofstream fout(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+  detail::EnsureOpen(fout, file_name);
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  fout.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)));
+}
+
+} // namespace slft
 } // namespace filewriter
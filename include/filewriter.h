@@ -22,6 +22,7 @@
 #include <fstream>
 #include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -53,6 +54,8 @@ template <typename T> static inline double NormalizePixel(T value) {
 
 uint8_t ToByte(double value);
 RGBA MakeRgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255U);
+// deep_trainer/audio_features.py inferno_like_colormap: linear between six stops, truncated to bytes.
+RGBA Inferno(double value);
 
 } // namespace detail
 
@@ -66,21 +69,56 @@ void WriteFile(const std::string &filename, const std::string &content);
 
 namespace image {
 
-class Image {
+// Row-major pixels. Floats are in [0, 1]; uint16 uses the full range.
+template <typename T> class BasicImage {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, uint16_t>, "Images hold float or uint16 pixels");
+
 public:
-  Image(std::size_t width, std::size_t height);
+  BasicImage(std::size_t image_width, std::size_t image_height)
+      : width(image_width), height(image_height), pixels(image_width * image_height) {}
 
   std::size_t Width() const { return width; }
   std::size_t Height() const { return height; }
-  double &At(std::size_t col, std::size_t row) { return pixels[row * width + col]; }
-  double At(std::size_t col, std::size_t row) const { return pixels[row * width + col]; }
+  T &At(std::size_t col, std::size_t row) { return pixels[row * width + col]; }
+  T At(std::size_t col, std::size_t row) const { return pixels[row * width + col]; }
+  std::span<T> Row(std::size_t row) { return std::span<T>(pixels).subspan(row * width, width); }
+  std::span<const T> Row(std::size_t row) const { return std::span<const T>(pixels).subspan(row * width, width); }
 
 private:
   std::size_t width;
   std::size_t height;
-  std::vector<double> pixels;
+  std::vector<T> pixels;
+};
+
+using Image = BasicImage<float>;
+using ImageU16 = BasicImage<uint16_t>;
+
+/*
+ * A color scale sampled at k_size points, so coloring a pixel is one table
+ * load instead of ToRgba's square root and branch ladder.
+ */
+class ColorLut {
+public:
+  static constexpr std::size_t k_size = 4096;
+
+  // One table per scale, built on first use.
+  static const ColorLut &For(ColorScaleType color_scale);
+
+  RGBA operator()(float value) const {
+    // Written so NaN maps to the first entry.
+    const float index = value > 0.0F ? std::min(value, 1.0F) * static_cast<float>(k_size - 1) + 0.5F : 0.0F;
+    return table[static_cast<std::size_t>(index)];
+  }
+  RGBA operator()(uint16_t value) const { return table[value >> 4U]; }
+
+private:
+  explicit ColorLut(ColorScaleType color_scale);
+
+  std::array<RGBA, k_size> table;
 };
 
+static_assert(ColorLut::k_size << 4U == 65536U, "uint16 pixels index the table by their top 12 bits");
+
 } // namespace image
 
 template <typename T, std::size_t W, std::size_t H> class ImgWriter {
@@ -131,6 +169,8 @@ template <typename T> static inline RGBA ToRgba(T value, ColorScaleType type) {
     }
     return detail::MakeRgba(r_val, g_val, b_val);
   }
+  case ColorScaleType::INFERNO:
+    return detail::Inferno(clamped_val);
   case ColorScaleType::GRAYSCALE:
   default: {
     const uint8_t c_val = detail::ToByte(clamped_val);
@@ -141,7 +181,9 @@ template <typename T> static inline RGBA ToRgba(T value, ColorScaleType type) {
 
 namespace ppm {
 
+// Binary P6.
 void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale = ColorScaleType::GRAYSCALE);
+void Write(const image::ImageU16 &image, const std::string &file_name, ColorScaleType color_scale = ColorScaleType::GRAYSCALE);
 
 template <typename T, std::size_t W, std::size_t H, ColorScaleType C = ColorScaleType::GRAYSCALE> class PPMWriter : public ImgWriter<T, W, H> {
 public:
@@ -151,16 +193,13 @@ public:
   explicit PPMWriter(ImageData &&data) : ImgWriter<T, W, H>(std::move(data)) {}
 
   void Write(const std::string &file_name) override {
-    std::ofstream fout(file_name, std::ios::out | std::ios::trunc);
-    detail::EnsureOpen(fout, file_name);
-
-    fout << "P3\n" << W << ' ' << H << "\n255\n";
-    for (std::size_t row = H; row-- > 0;) {
+    image::Image image(W, H);
+    for (std::size_t row = 0; row < H; ++row) {
       for (std::size_t col = 0; col < W; ++col) {
-        const RGBA rgba = ToRgba((*this->img_data)[col][row], C);
-        fout << static_cast<int>(rgba.rgba_st.R) << ' ' << static_cast<int>(rgba.rgba_st.G) << ' ' << static_cast<int>(rgba.rgba_st.B) << '\n';
+        image.At(col, row) = static_cast<float>(detail::NormalizePixel((*this->img_data)[col][row]));
       }
     }
+    ppm::Write(image, file_name, C);
   }
 };
 
@@ -168,7 +207,9 @@ public:
 
 namespace bmp {
 
+// 32 bit, one buffered write per row.
 void Write(const image::Image &image, const std::string &file_name, ColorScaleType color_scale = ColorScaleType::GRAYSCALE);
+void Write(const image::ImageU16 &image, const std::string &file_name, ColorScaleType color_scale = ColorScaleType::GRAYSCALE);
 
 template <typename T, std::size_t W, std::size_t H> class BMPWriter : public ImgWriter<T, W, H> {
 public:
@@ -178,30 +219,13 @@ public:
   explicit BMPWriter(ImageData &&data) : ImgWriter<T, W, H>(std::move(data)) {}
 
   template <ColorScaleType C = ColorScaleType::GRAYSCALE> void Write(const std::string &file_name) {
-    BMPFileHeader file_header{};
-    BMPInfoHeader info_header{};
-
-    info_header.size = sizeof(BMPInfoHeader);
-    info_header.width = static_cast<int32_t>(W);
-    info_header.height = static_cast<int32_t>(H);
-    info_header.bit_count = 32;
-    info_header.compression = 0;
-    info_header.size_image = static_cast<uint32_t>(W * H * sizeof(RGBA));
-
-    file_header.offset_data = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
-    file_header.file_size = file_header.offset_data + info_header.size_image;
-
-    std::ofstream fout(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
-    detail::EnsureOpen(fout, file_name);
-    fout.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
-    fout.write(reinterpret_cast<const char *>(&info_header), sizeof(info_header));
-
-    for (std::size_t row = H; row-- > 0;) {
+    image::Image image(W, H);
+    for (std::size_t row = 0; row < H; ++row) {
       for (std::size_t col = 0; col < W; ++col) {
-        const RGBA rgba = ToRgba((*this->img_data)[col][row], C);
-        fout.write(reinterpret_cast<const char *>(&rgba), sizeof(rgba));
+        image.At(col, row) = static_cast<float>(detail::NormalizePixel((*this->img_data)[col][row]));
       }
     }
+    bmp::Write(image, file_name, C);
   }
 
   void Write(const std::string &file_name) override { Write<ColorScaleType::GRAYSCALE>(file_name); }
@@ -211,17 +235,82 @@ public:
 
 namespace wave {
 
+WavFileHeader MakeMonoHeader(std::size_t sample_count, uint32_t sample_rate = SAMPLE_RATE);
+
+// Writes a finished buffer; the samples are viewed, not copied, and must outlive Write.
 class MonoWriter {
 public:
-  explicit MonoWriter(const std::vector<int16_t> &data);
+  explicit MonoWriter(std::span<const int16_t> data, uint32_t a_sample_rate = SAMPLE_RATE);
 
   void Write(const std::string &file_name);
 
 private:
-  std::vector<int16_t> wav_data;
+  std::span<const int16_t> wav_data;
+  uint32_t sample_rate;
+};
+
+/*
+ * Appends blocks as they are produced. The header is written with zero sizes
+ * and patched by Flush and Close, so a reader of the growing file sees every
+ * flushed sample. Throws std::runtime_error.
+ */
+class MonoStreamWriter {
+public:
+  explicit MonoStreamWriter(const std::string &a_file_name, uint32_t a_sample_rate = SAMPLE_RATE);
+  ~MonoStreamWriter(); // Closes; errors are only reported by an explicit Close.
+  MonoStreamWriter(const MonoStreamWriter &) = delete;
+  MonoStreamWriter &operator=(const MonoStreamWriter &) = delete;
+
+  void Append(std::span<const int16_t> block);
+  void Flush(); // Patches the header sizes and flushes.
+  void Close();
+  std::size_t SampleCount() const { return sample_count; }
+
+private:
+  std::string file_name;
+  uint32_t sample_rate;
+  std::ofstream out;
+  std::size_t sample_count = 0;
+
+  void PatchHeader();
+};
+
+/*
+ * Sizes the file up front and maps it, so a renderer writes samples straight
+ * into the page cache (InstrumentModel::GenerateIntSignal has a span overload).
+ * Throws std::runtime_error.
+ */
+class MonoMappedWriter {
+public:
+  MonoMappedWriter(const std::string &a_file_name, std::size_t capacity, uint32_t a_sample_rate = SAMPLE_RATE);
+  ~MonoMappedWriter(); // Closes with the full capacity unless Close was called.
+  MonoMappedWriter(const MonoMappedWriter &) = delete;
+  MonoMappedWriter &operator=(const MonoMappedWriter &) = delete;
+
+  std::span<int16_t> Samples() { return samples; }
+  /*
+   * Patches the header, unmaps and truncates the file to the samples kept.
+   * @parameters sample_count (at most the capacity)
+   */
+  void Close(std::size_t sample_count);
+
+private:
+  std::string file_name;
+  uint32_t sample_rate;
+  int fd = -1;
+  void *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<int16_t> samples;
 };
 
 } // namespace wave
+
+namespace slft {
+
+SlftFileHeader MakeHeader(uint32_t sample_rate, uint32_t channels, uint32_t frequency_bins, uint32_t time_frames);
+void Write(const std::string &file_name, const SlftFileHeader &header, const std::vector<float> &data);
+
+} // namespace slft
 } // namespace filewriter
 
 #endif // INCLUDE_FILEWRITER_H_
@@ -0,0 +1,1144 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "include/lossless_audio.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace lossless {
+
+namespace {
+constexpr uint16_t k_version = 2;
+constexpr unsigned k_sample_bits = 16;
+constexpr unsigned k_parameter_bits = 5;
+constexpr unsigned k_escape_parameter = 31;
+constexpr unsigned k_max_rice_parameter = 30;
+constexpr unsigned k_partition_order_bits = 4;
+constexpr unsigned k_precision_bits = 4;
+constexpr unsigned k_shift_bits = 5;
+// LPC residuals beyond this are not worth coding; the block falls back to another method.
+constexpr int64_t k_max_residual = int64_t{1} << 30U;
+
+std::runtime_error Corrupt(const std::string &what) { return std::runtime_error("Corrupt SLAC stream: " + what); }
+
+// CRC-32 with the zlib polynomial, eight bytes per step (slicing-by-8).
+constexpr std::array<std::array<uint32_t, 256>, 8> k_crc_tables = [] {
+  std::array<std::array<uint32_t, 256>, 8> tables{};
+  for (uint32_t i = 0; i < 256U; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1U) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256U; ++i) {
+    for (std::size_t table = 1; table < tables.size(); ++table) {
+      tables[table][i] = (tables[table - 1U][i] >> 8U) ^ tables[0][tables[table - 1U][i] & 0xFFU];
+    }
+  }
+  return tables;
+}();
+
+// Continues crc over size bytes; start from 0. Equal to zlib.crc32(data, crc).
+uint32_t Crc32(uint32_t crc, const void *data, std::size_t size) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  crc = ~crc;
+  for (; size >= 8U; size -= 8U, bytes += 8) {
+    uint32_t low = 0;
+    uint32_t high = 0;
+    std::memcpy(&low, bytes, 4);
+    std::memcpy(&high, bytes + 4, 4);
+    low ^= crc;
+    crc = k_crc_tables[7][low & 0xFFU] ^ k_crc_tables[6][(low >> 8U) & 0xFFU] ^ k_crc_tables[5][(low >> 16U) & 0xFFU] ^
+          k_crc_tables[4][low >> 24U] ^ k_crc_tables[3][high & 0xFFU] ^ k_crc_tables[2][(high >> 8U) & 0xFFU] ^
+          k_crc_tables[1][(high >> 16U) & 0xFFU] ^ k_crc_tables[0][high >> 24U];
+  }
+  for (; size > 0U; --size, ++bytes) {
+    crc = (crc >> 8U) ^ k_crc_tables[0][(crc ^ *bytes) & 0xFFU];
+  }
+  return ~crc;
+}
+
+uint32_t SampleCrc(uint32_t crc, std::span<const int16_t> samples) { return Crc32(crc, samples.data(), samples.size_bytes()); }
+
+uint32_t BlockCrc(const SlacBlockHeader &header, const uint8_t *payload) {
+  return Crc32(Crc32(0, &header, offsetof(SlacBlockHeader, crc32)), payload, header.payload_bytes);
+}
+
+uint32_t ZigZag(int32_t value) { return (static_cast<uint32_t>(value) << 1U) ^ static_cast<uint32_t>(value >> 31U); }
+int32_t UnZigZag(uint32_t value) { return static_cast<int32_t>(value >> 1U) ^ -static_cast<int32_t>(value & 1U); }
+
+// Runs fn(item, worker) for every item on up to `threads` threads and rethrows the first failure.
+template <typename Fn> void ParallelFor(std::size_t count, std::size_t threads, Fn &&fn) {
+  const std::size_t workers = std::min(std::max<std::size_t>(threads, 1U), count);
+  if (workers <= 1U) {
+    for (std::size_t item = 0; item < count; ++item) {
+      fn(item, std::size_t{0});
+    }
+    return;
+  }
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr first_error;
+  std::mutex error_mutex;
+  std::vector<std::thread> pool;
+  for (std::size_t worker = 0; worker < workers; ++worker) {
+    pool.emplace_back([&, worker] {
+      try {
+        for (std::size_t item = next++; item < count && !failed; item = next++) {
+          fn(item, worker);
+        }
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        if (!first_error) {
+          first_error = std::current_exception();
+        }
+        failed = true;
+      }
+    });
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+// MSB-first bit packer appending to a byte vector.
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<uint8_t> &bytes) : out(bytes) {}
+
+  // count <= 32
+  void Put(uint32_t value, unsigned count) {
+    accumulator = (accumulator << count) | (value & ((uint64_t{1} << count) - 1U));
+    pending += count;
+    if (pending >= 32U) {
+      pending -= 32U;
+      const auto word = static_cast<uint32_t>(accumulator >> pending);
+      const std::array<uint8_t, 4> bytes = {static_cast<uint8_t>(word >> 24U), static_cast<uint8_t>(word >> 16U),
+                                            static_cast<uint8_t>(word >> 8U), static_cast<uint8_t>(word)};
+      out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+  }
+
+  void PutRice(uint32_t value, unsigned parameter) {
+    uint32_t quotient = value >> parameter;
+    const uint32_t low = value & ((1U << parameter) - 1U);
+    if (quotient + 1U + parameter <= 32U) {
+      Put((1U << parameter) | low, quotient + 1U + parameter);
+      return;
+    }
+    for (; quotient >= 32U; quotient -= 32U) {
+      Put(0, 32);
+    }
+    Put(1, quotient + 1U);
+    Put(low, parameter);
+  }
+
+  // Pads the stream to a whole byte.
+  void Flush() {
+    if (pending % 8U != 0U) {
+      Put(0, 8U - pending % 8U);
+    }
+    for (; pending >= 8U; pending -= 8U) {
+      out.push_back(static_cast<uint8_t>(accumulator >> (pending - 8U)));
+    }
+  }
+
+private:
+  std::vector<uint8_t> &out;
+  uint64_t accumulator = 0;
+  unsigned pending = 0;
+};
+
+/*
+ * MSB-first bit reader over [begin, limit). The buffer is left aligned and
+ * refilled eight bytes at a time; bits past `available` are either zero or the
+ * stream bits that belong there, so refills can OR whole words in.
+ */
+class BitReader {
+public:
+  BitReader(const uint8_t *begin, const uint8_t *limit) : start(begin), position(begin), end(limit) { Refill(); }
+
+  uint32_t Get(unsigned count) {
+    if (count == 0U) {
+      return 0;
+    }
+    if (available < count) {
+      Refill();
+      if (available < count) {
+        throw Corrupt("block payload is truncated");
+      }
+    }
+    const auto value = static_cast<uint32_t>(buffer >> (64U - count));
+    buffer <<= count;
+    available -= count;
+    return value;
+  }
+
+  int32_t GetSigned(unsigned count) {
+    const unsigned unused = 32U - count;
+    return static_cast<int32_t>(Get(count) << unused) >> unused;
+  }
+
+  // Decodes count Rice coded residuals with one parameter and hands each to emit.
+  template <typename Emit> void GetRice(std::size_t count, unsigned parameter, Emit &&emit) {
+    // Locals keep the hot state in registers; stores through out could alias the members.
+    uint64_t bits = buffer;
+    unsigned bits_available = available;
+    const uint8_t *next = position;
+    std::size_t i = 0;
+    // Away from the end of the stream the buffer is topped up before every code without a branch.
+    for (; i < count && end - next >= 8; ++i) {
+      uint64_t word = 0;
+      std::memcpy(&word, next, sizeof(word));
+      if constexpr (std::endian::native == std::endian::little) {
+        word = std::byteswap(word);
+      }
+      bits |= word >> bits_available;
+      next += (63U - bits_available) >> 3U;
+      bits_available |= 56U;
+      const auto zeros = static_cast<unsigned>(std::countl_zero(bits));
+      const unsigned length = zeros + 1U + parameter;
+      if (length > bits_available) [[unlikely]] {
+        buffer = bits;
+        available = bits_available;
+        position = next;
+        emit(UnZigZag(GetLongRice(parameter)));
+        bits = buffer;
+        bits_available = available;
+        next = position;
+        continue;
+      }
+      // Two shifts so that parameter 0 yields 0 without a branch.
+      const auto low = static_cast<uint32_t>(((bits << (zeros + 1U)) >> (63U - parameter)) >> 1U);
+      emit(UnZigZag((zeros << parameter) | low));
+      bits <<= length;
+      bits_available -= length;
+    }
+    buffer = bits;
+    available = bits_available;
+    position = next;
+    for (; i < count; ++i) {
+      emit(UnZigZag(GetLongRice(parameter)));
+    }
+  }
+
+  std::size_t BitsConsumed() const { return static_cast<std::size_t>(position - start) * 8U - available; }
+
+private:
+  const uint8_t *start;
+  const uint8_t *position;
+  const uint8_t *end;
+  uint64_t buffer = 0;
+  unsigned available = 0; // Never above 63, so shifts by available + 1 stay defined.
+
+  void Refill() {
+    if (end - position >= 8) {
+      uint64_t word = 0;
+      std::memcpy(&word, position, sizeof(word));
+      if constexpr (std::endian::native == std::endian::little) {
+        word = std::byteswap(word);
+      }
+      buffer |= word >> available;
+      position += (63U - available) >> 3U;
+      available |= 56U;
+    } else {
+      for (; available <= 55U && position < end; available += 8U) {
+        buffer |= static_cast<uint64_t>(*position++) << (56U - available);
+      }
+    }
+  }
+
+  // Unary runs longer than the buffer, and every code near the end of the stream.
+  uint32_t GetLongRice(unsigned parameter) {
+    uint32_t quotient = 0;
+    for (;;) {
+      if (available == 0U) {
+        Refill();
+        if (available == 0U) {
+          throw Corrupt("Rice code runs past the end of the block");
+        }
+      }
+      const auto zeros = std::min(static_cast<unsigned>(std::countl_zero(buffer)), available);
+      quotient += zeros;
+      if (quotient > (UINT32_MAX >> parameter)) {
+        throw Corrupt("Rice code overflows");
+      }
+      if (zeros < available) {
+        buffer <<= zeros + 1U;
+        available -= zeros + 1U;
+        break;
+      }
+      buffer = 0;
+      available = 0;
+    }
+    return (quotient << parameter) | Get(parameter);
+  }
+};
+
+StreamInfo ParseHeader(const SlacFileHeader &header) {
+  if (std::memcmp(header.magic, "SLAC", 4) != 0) {
+    throw std::runtime_error("Not a SLAC stream");
+  }
+  if (header.version != k_version || header.channels != 1U || header.bits_per_sample != k_sample_bits) {
+    throw std::runtime_error("Unsupported SLAC stream: version " + std::to_string(header.version) + ", " + std::to_string(header.channels) +
+                             " channel(s), " + std::to_string(header.bits_per_sample) + " bit");
+  }
+  if (header.block_size == 0U || header.block_size > k_max_block_size) {
+    throw Corrupt("block size " + std::to_string(header.block_size));
+  }
+  StreamInfo info;
+  info.sample_rate = header.sample_rate;
+  info.block_size = header.block_size;
+  info.sample_count = header.sample_count;
+  info.crc32 = header.crc32;
+  return info;
+}
+
+void ValidateOptions(const EncoderOptions &options) {
+  if (options.block_size == 0U || options.block_size > k_max_block_size) {
+    throw std::invalid_argument("SLAC block size must be between 1 and " + std::to_string(k_max_block_size));
+  }
+  if (options.max_lpc_order > k_max_lpc_order || options.max_partition_order > k_max_partition_order) {
+    throw std::invalid_argument("SLAC LPC order must be at most " + std::to_string(k_max_lpc_order) + " and partition order at most " +
+                                std::to_string(k_max_partition_order));
+  }
+  if (options.coefficient_precision < 5U || options.coefficient_precision > 15U) {
+    throw std::invalid_argument("SLAC coefficient precision must be between 5 and 15 bits");
+  }
+}
+
+SlacFileHeader MakeFileHeader(uint32_t sample_rate, uint32_t block_size, uint64_t sample_count, uint32_t crc) {
+  SlacFileHeader header{};
+  header.version = k_version;
+  header.sample_rate = sample_rate;
+  header.block_size = block_size;
+  header.crc32 = crc;
+  header.sample_count = sample_count;
+  return header;
+}
+
+void AppendBytes(std::vector<uint8_t> &out, const void *data, std::size_t size) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+/*
+ * Rice partitioning of one residual: the partition order and per-partition
+ * parameters with the fewest bits.
+ */
+struct RicePlan {
+  unsigned partition_order = 0;
+  std::vector<uint8_t> parameters; // k_escape_parameter for raw partitions.
+  std::vector<uint8_t> raw_widths;
+  uint64_t bits = 0;
+};
+
+struct PartitionStats {
+  uint64_t sum = 0;
+  uint32_t max = 0;
+};
+
+// Bits for one partition; sets the parameter (or escape width) that achieves them.
+uint64_t PartitionCost(std::size_t count, const PartitionStats &stats, uint8_t &parameter, uint8_t &raw_width) {
+  raw_width = static_cast<uint8_t>(std::bit_width(stats.max));
+  const uint64_t escape_bits = k_parameter_bits + 5U + count * raw_width;
+  if (count == 0U || stats.max == 0U) {
+    parameter = count == 0U ? 0U : static_cast<uint8_t>(k_escape_parameter);
+    return count == 0U ? k_parameter_bits : escape_bits;
+  }
+  // The mean of a geometric source puts the best parameter near log2(mean).
+  const auto mean = stats.sum / count;
+  const auto guess = static_cast<unsigned>(std::max(1, static_cast<int>(std::bit_width(mean)))) - 1U;
+  uint64_t best_bits = std::numeric_limits<uint64_t>::max();
+  for (unsigned k = guess == 0U ? 0U : guess - 1U; k <= std::min(guess + 1U, k_max_rice_parameter); ++k) {
+    const uint64_t bits = k_parameter_bits + count * (k + 1U) + (stats.sum >> k);
+    if (bits < best_bits) {
+      best_bits = bits;
+      parameter = static_cast<uint8_t>(k);
+    }
+  }
+  if (escape_bits < best_bits) {
+    parameter = static_cast<uint8_t>(k_escape_parameter);
+    return escape_bits;
+  }
+  return best_bits;
+}
+
+} // namespace
+
+namespace detail {
+// Owns the scratch buffers for encoding blocks; one per thread.
+class BlockEncoder {
+public:
+  explicit BlockEncoder(const EncoderOptions &encoder_options) : options(encoder_options) {}
+
+  // Appends the block header and payload for samples to out.
+  void Encode(std::span<const int16_t> samples, std::vector<uint8_t> &out) {
+    const std::size_t n = samples.size();
+    signal.assign(samples.begin(), samples.end());
+
+    SlacBlockHeader header{};
+    header.sample_count = static_cast<uint16_t>(n);
+    const std::size_t header_offset = out.size();
+    AppendBytes(out, &header, sizeof(header));
+    const std::size_t payload_offset = out.size();
+    BitWriter writer(out);
+
+    if (std::all_of(signal.begin(), signal.end(), [&](int32_t value) { return value == signal.front(); })) {
+      header.method = static_cast<uint8_t>(BlockMethod::constant);
+      writer.Put(static_cast<uint32_t>(signal.front()), k_sample_bits);
+    } else {
+      Candidate best;
+      best.method = BlockMethod::verbatim;
+      best.bits = n * k_sample_bits;
+      TryFixed(best);
+      TryLpc(best);
+      header.method = static_cast<uint8_t>(best.method);
+      header.order = static_cast<uint8_t>(best.order);
+      if (best.method == BlockMethod::verbatim) {
+        for (const int32_t value : signal) {
+          writer.Put(static_cast<uint32_t>(value), k_sample_bits);
+        }
+      } else {
+        for (std::size_t i = 0; i < best.order; ++i) {
+          writer.Put(static_cast<uint32_t>(signal[i]), k_sample_bits);
+        }
+        if (best.method == BlockMethod::lpc) {
+          writer.Put(options.coefficient_precision - 1U, k_precision_bits);
+          writer.Put(best.shift, k_shift_bits);
+          for (std::size_t i = 0; i < best.order; ++i) {
+            writer.Put(static_cast<uint32_t>(best.coefficients[i]), options.coefficient_precision);
+          }
+        }
+        WriteResidual(writer, best_zigzag, best.order, best.plan);
+      }
+    }
+    writer.Flush();
+    header.payload_bytes = static_cast<uint32_t>(out.size() - payload_offset);
+    header.crc32 = BlockCrc(header, out.data() + payload_offset);
+    std::memcpy(out.data() + header_offset, &header, sizeof(header));
+  }
+
+private:
+  struct Candidate {
+    BlockMethod method = BlockMethod::verbatim;
+    unsigned order = 0;
+    unsigned shift = 0;
+    std::array<int32_t, k_max_lpc_order> coefficients{};
+    RicePlan plan;
+    uint64_t bits = 0;
+  };
+
+  const EncoderOptions &options;
+  std::vector<int32_t> signal;
+  std::vector<uint32_t> zigzag;
+  std::vector<uint32_t> best_zigzag;
+  std::vector<double> window;
+  std::vector<double> windowed;
+  std::vector<PartitionStats> partition_stats;
+  RicePlan plan;
+
+  void Accept(Candidate &best, BlockMethod method, unsigned order, uint64_t bits) {
+    best.method = method;
+    best.order = order;
+    best.bits = bits;
+    std::swap(best.plan, plan);
+    std::swap(best_zigzag, zigzag);
+  }
+
+  void TryFixed(Candidate &best) {
+    const std::size_t n = signal.size();
+    for (unsigned order = 0; order <= k_max_fixed_order && order < n; ++order) {
+      zigzag.resize(n);
+      const int32_t *x = signal.data();
+      for (std::size_t i = order; i < n; ++i) {
+        int32_t residual = 0;
+        switch (order) {
+        case 0:
+          residual = x[i];
+          break;
+        case 1:
+          residual = x[i] - x[i - 1];
+          break;
+        case 2:
+          residual = x[i] - 2 * x[i - 1] + x[i - 2];
+          break;
+        case 3:
+          residual = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+          break;
+        default:
+          residual = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+          break;
+        }
+        zigzag[i] = ZigZag(residual);
+      }
+      const uint64_t bits = order * k_sample_bits + PlanRice(order);
+      if (bits < best.bits) {
+        Accept(best, BlockMethod::fixed, order, bits);
+      }
+    }
+  }
+
+  void TryLpc(Candidate &best) {
+    const std::size_t n = signal.size();
+    const unsigned max_order = static_cast<unsigned>(std::min<std::size_t>(options.max_lpc_order, n > 1U ? n - 1U : 0U));
+    if (max_order == 0U) {
+      return;
+    }
+    // Tukey(0.5) window before the autocorrelation, as FLAC does by default.
+    if (window.size() != n) {
+      window.assign(n, 1.0);
+      const std::size_t taper = n / 4U;
+      for (std::size_t i = 0; i < taper; ++i) {
+        const double value = 0.5 - 0.5 * std::cos(std::numbers::pi * static_cast<double>(i) / static_cast<double>(taper));
+        window[i] = value;
+        window[n - 1U - i] = value;
+      }
+    }
+    windowed.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      windowed[i] = static_cast<double>(signal[i]) * window[i];
+    }
+    std::array<double, k_max_lpc_order + 1U> autocorrelation{};
+    for (unsigned lag = 0; lag <= max_order; ++lag) {
+      double sum = 0.0;
+      for (std::size_t i = lag; i < n; ++i) {
+        sum += windowed[i] * windowed[i - lag];
+      }
+      autocorrelation[lag] = sum;
+    }
+    if (autocorrelation[0] <= 0.0) {
+      return;
+    }
+
+    // Levinson-Durbin: predictors of every order up to max_order.
+    std::array<std::array<double, k_max_lpc_order>, k_max_lpc_order> predictors{};
+    std::array<double, k_max_lpc_order> errors{};
+    std::array<double, k_max_lpc_order> current{};
+    double error = autocorrelation[0];
+    unsigned orders = 0;
+    for (unsigned m = 0; m < max_order; ++m) {
+      double accumulator = autocorrelation[m + 1U];
+      for (unsigned j = 0; j < m; ++j) {
+        accumulator -= current[j] * autocorrelation[m - j];
+      }
+      const double reflection = accumulator / error;
+      const auto previous = current;
+      current[m] = reflection;
+      for (unsigned j = 0; j < m; ++j) {
+        current[j] = previous[j] - reflection * previous[m - 1U - j];
+      }
+      error *= 1.0 - reflection * reflection;
+      predictors[m] = current;
+      errors[m] = error;
+      orders = m + 1U;
+      if (error <= 0.0) {
+        break;
+      }
+    }
+
+    const auto try_order = [&](unsigned order) {
+      Candidate candidate;
+      if (!Quantize(std::span(predictors[order - 1U].data(), order), candidate.coefficients, candidate.shift) ||
+          !LpcResidual(order, candidate.coefficients, candidate.shift)) {
+        return;
+      }
+      const uint64_t bits = order * (k_sample_bits + options.coefficient_precision) + k_precision_bits + k_shift_bits + PlanRice(order);
+      if (bits < best.bits) {
+        best.coefficients = candidate.coefficients;
+        best.shift = candidate.shift;
+        Accept(best, BlockMethod::lpc, order, bits);
+      }
+    };
+    if (options.exhaustive_order_search) {
+      for (unsigned order = 1; order <= orders; ++order) {
+        try_order(order);
+      }
+      return;
+    }
+    // Expected residual bits from the prediction error, traded against the cost of the coefficients.
+    unsigned best_order = 1;
+    double best_estimate = std::numeric_limits<double>::max();
+    for (unsigned order = 1; order <= orders; ++order) {
+      const double scaled_error = 0.5 * errors[order - 1U] / static_cast<double>(n);
+      const double bits_per_sample = scaled_error > 0.0 ? std::max(0.0, 0.5 * std::log2(scaled_error)) : 0.0;
+      const double estimate = bits_per_sample * static_cast<double>(n - order) + order * (k_sample_bits + options.coefficient_precision);
+      if (estimate < best_estimate) {
+        best_estimate = estimate;
+        best_order = order;
+      }
+    }
+    try_order(best_order);
+  }
+
+  // Quantizes to coefficient_precision bits with a shared shift, carrying the rounding error forward.
+  bool Quantize(std::span<const double> predictor, std::array<int32_t, k_max_lpc_order> &coefficients, unsigned &shift) const {
+    double largest = 0.0;
+    for (const double value : predictor) {
+      largest = std::max(largest, std::abs(value));
+    }
+    if (!(largest > 0.0) || !std::isfinite(largest)) {
+      return false;
+    }
+    int exponent = 0;
+    std::frexp(largest, &exponent);
+    const int precision = static_cast<int>(options.coefficient_precision);
+    const int signed_shift = std::min(precision - 1 - exponent, static_cast<int>((1U << k_shift_bits) - 1U));
+    if (signed_shift < 0) {
+      return false;
+    }
+    shift = static_cast<unsigned>(signed_shift);
+    const int32_t largest_coefficient = (1 << (precision - 1)) - 1;
+    double carried = 0.0;
+    for (std::size_t i = 0; i < predictor.size(); ++i) {
+      carried += std::ldexp(predictor[i], signed_shift);
+      const auto rounded = static_cast<int32_t>(std::clamp<long>(std::lround(carried), -largest_coefficient - 1, largest_coefficient));
+      coefficients[i] = rounded;
+      carried -= rounded;
+    }
+    return true;
+  }
+
+  bool LpcResidual(unsigned order, const std::array<int32_t, k_max_lpc_order> &coefficients, unsigned shift) {
+    const std::size_t n = signal.size();
+    zigzag.resize(n);
+    const int32_t *x = signal.data();
+    for (std::size_t i = order; i < n; ++i) {
+      int64_t prediction = 0;
+      for (unsigned j = 0; j < order; ++j) {
+        prediction += int64_t{coefficients[j]} * x[i - 1U - j];
+      }
+      const int64_t residual = x[i] - (prediction >> shift);
+      if (residual >= k_max_residual || residual <= -k_max_residual) {
+        return false;
+      }
+      zigzag[i] = ZigZag(static_cast<int32_t>(residual));
+    }
+    return true;
+  }
+
+  // Plans the Rice coding of zigzag[order..n) into `plan`; returns its bit count.
+  uint64_t PlanRice(unsigned order) {
+    const std::size_t n = signal.size();
+    unsigned finest = 0;
+    for (unsigned p = 1; p <= options.max_partition_order; ++p) {
+      if (n % (std::size_t{1} << p) != 0U || (n >> p) <= order) {
+        break;
+      }
+      finest = p;
+    }
+    const std::size_t partitions = std::size_t{1} << finest;
+    const std::size_t partition_size = n >> finest;
+    partition_stats.assign(partitions, {});
+    for (std::size_t partition = 0; partition < partitions; ++partition) {
+      PartitionStats &stats = partition_stats[partition];
+      for (std::size_t i = std::max<std::size_t>(partition * partition_size, order); i < (partition + 1U) * partition_size; ++i) {
+        stats.sum += zigzag[i];
+        stats.max = std::max(stats.max, zigzag[i]);
+      }
+    }
+
+    plan.bits = std::numeric_limits<uint64_t>::max();
+    std::vector<uint8_t> parameters;
+    std::vector<uint8_t> widths;
+    for (unsigned p = finest + 1U; p-- > 0U;) {
+      const std::size_t count = std::size_t{1} << p;
+      if (p < finest) {
+        // Merge neighbours of the finer level in place.
+        for (std::size_t partition = 0; partition < count; ++partition) {
+          const PartitionStats &left = partition_stats[2U * partition];
+          const PartitionStats &right = partition_stats[2U * partition + 1U];
+          partition_stats[partition] = {left.sum + right.sum, std::max(left.max, right.max)};
+        }
+      }
+      parameters.resize(count);
+      widths.resize(count);
+      uint64_t bits = k_partition_order_bits;
+      for (std::size_t partition = 0; partition < count; ++partition) {
+        const std::size_t size = (n >> p) - (partition == 0U ? order : 0U);
+        bits += PartitionCost(size, partition_stats[partition], parameters[partition], widths[partition]);
+      }
+      if (bits < plan.bits) {
+        plan.bits = bits;
+        plan.partition_order = p;
+        plan.parameters = parameters;
+        plan.raw_widths = widths;
+      }
+    }
+    return plan.bits;
+  }
+
+  void WriteResidual(BitWriter &writer, const std::vector<uint32_t> &values, unsigned order, const RicePlan &rice) const {
+    const std::size_t n = signal.size();
+    writer.Put(rice.partition_order, k_partition_order_bits);
+    const std::size_t partition_size = n >> rice.partition_order;
+    for (std::size_t partition = 0; partition < rice.parameters.size(); ++partition) {
+      const unsigned parameter = rice.parameters[partition];
+      writer.Put(parameter, k_parameter_bits);
+      const std::size_t first = std::max<std::size_t>(partition * partition_size, order);
+      const std::size_t last = (partition + 1U) * partition_size;
+      if (parameter == k_escape_parameter) {
+        const unsigned width = rice.raw_widths[partition];
+        writer.Put(width, 5);
+        for (std::size_t i = first; i < last; ++i) {
+          writer.Put(values[i], width);
+        }
+      } else {
+        for (std::size_t i = first; i < last; ++i) {
+          writer.PutRice(values[i], parameter);
+        }
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+namespace {
+/*
+ * Predictors turn residuals back into samples. They are fed one residual at a
+ * time straight from the Rice decoder, so the bit reader and the prediction
+ * recurrence overlap instead of running as two passes. Samples pass through
+ * int16_t, which also keeps corrupt streams from overflowing the history.
+ */
+template <unsigned Order> class FixedPredictor {
+public:
+  explicit FixedPredictor(const int16_t *warmup) {
+    for (unsigned j = 0; j < Order; ++j) {
+      history[j] = warmup[Order - 1U - j];
+    }
+  }
+
+  int16_t Next(int32_t residual) {
+    int64_t value = residual;
+    if constexpr (Order == 1) {
+      value += history[0];
+    } else if constexpr (Order == 2) {
+      value += 2 * history[0] - history[1];
+    } else if constexpr (Order == 3) {
+      value += 3 * (history[0] - history[1]) + history[2];
+    } else if constexpr (Order == 4) {
+      value += 4 * (history[0] + history[2]) - 6 * history[1] - history[3];
+    }
+    const auto sample = static_cast<int16_t>(value);
+    if constexpr (Order > 0) {
+      for (unsigned j = Order - 1U; j > 0U; --j) {
+        history[j] = history[j - 1U];
+      }
+      history[0] = sample;
+    }
+    return sample;
+  }
+
+private:
+  std::array<int64_t, Order> history{}; // Newest first.
+};
+
+template <unsigned Order> class LpcPredictor {
+public:
+  LpcPredictor(const int16_t *warmup, const int32_t *coefficients, unsigned coefficient_shift) : shift(coefficient_shift) {
+    for (unsigned j = 0; j < Order; ++j) {
+      taps[j] = coefficients[j];
+      history[j] = warmup[Order - 1U - j];
+    }
+  }
+
+  int16_t Next(int32_t residual) {
+    // Oldest taps first: only the last multiply-add waits for the previous sample.
+    int64_t prediction = 0;
+    for (unsigned j = Order - 1U; j > 0U; --j) {
+      prediction += taps[j] * history[j];
+    }
+    prediction += taps[0] * history[0];
+    const auto sample = static_cast<int16_t>(residual + (prediction >> shift));
+    for (unsigned j = Order - 1U; j > 0U; --j) {
+      history[j] = history[j - 1U];
+    }
+    history[0] = sample;
+    return sample;
+  }
+
+private:
+  std::array<int64_t, Order> taps{};
+  std::array<int64_t, Order> history{}; // Newest first.
+  unsigned shift;
+};
+
+// Orders above the unrolled ones read their history back from the output.
+class LongLpcPredictor {
+public:
+  LongLpcPredictor(int16_t *block_samples, unsigned predictor_order, const int32_t *coefficients, unsigned coefficient_shift)
+      : samples(block_samples), order(predictor_order), position(predictor_order), shift(coefficient_shift) {
+    std::copy_n(coefficients, order, taps.begin());
+  }
+
+  int16_t Next(int32_t residual) {
+    int64_t prediction = 0;
+    for (unsigned j = 0; j < order; ++j) {
+      prediction += int64_t{taps[j]} * samples[position - 1U - j];
+    }
+    const auto sample = static_cast<int16_t>(residual + (prediction >> shift));
+    samples[position++] = sample;
+    return sample;
+  }
+
+private:
+  int16_t *samples;
+  unsigned order;
+  std::size_t position;
+  unsigned shift;
+  std::array<int32_t, k_max_lpc_order> taps{};
+};
+
+// Reads the partitioned residual after the warm-up samples and reconstructs out[order..n).
+template <typename Predictor> void DecodeResidual(BitReader &reader, std::span<int16_t> out, unsigned order, Predictor predictor) {
+  const std::size_t n = out.size();
+  const unsigned partition_order = reader.Get(k_partition_order_bits);
+  const std::size_t partition_size = n >> partition_order;
+  if ((partition_size << partition_order) != n || partition_size <= order) {
+    throw Corrupt("invalid Rice partition order");
+  }
+  int16_t *sample = out.data() + order;
+  const auto emit = [&](int32_t residual) { *sample++ = predictor.Next(residual); };
+  for (std::size_t partition = 0, first = order; partition < (std::size_t{1} << partition_order); ++partition) {
+    const std::size_t last = (partition + 1U) * partition_size;
+    const unsigned parameter = reader.Get(k_parameter_bits);
+    if (parameter == k_escape_parameter) {
+      const unsigned width = reader.Get(5);
+      for (std::size_t i = first; i < last; ++i) {
+        emit(UnZigZag(reader.Get(width)));
+      }
+    } else {
+      reader.GetRice(last - first, parameter, emit);
+    }
+    first = last;
+  }
+}
+
+template <unsigned Order = 1>
+void DecodeLpc(BitReader &reader, std::span<int16_t> out, unsigned order, const int32_t *coefficients, unsigned shift) {
+  constexpr unsigned k_unrolled_orders = 12;
+  if constexpr (Order <= k_unrolled_orders) {
+    if (order == Order) {
+      return DecodeResidual(reader, out, order, LpcPredictor<Order>(out.data(), coefficients, shift));
+    }
+    return DecodeLpc<Order + 1U>(reader, out, order, coefficients, shift);
+  } else {
+    DecodeResidual(reader, out, order, LongLpcPredictor(out.data(), order, coefficients, shift));
+  }
+}
+
+void DecodeFixed(BitReader &reader, std::span<int16_t> out, unsigned order) {
+  switch (order) {
+  case 0:
+    return DecodeResidual(reader, out, order, FixedPredictor<0>(out.data()));
+  case 1:
+    return DecodeResidual(reader, out, order, FixedPredictor<1>(out.data()));
+  case 2:
+    return DecodeResidual(reader, out, order, FixedPredictor<2>(out.data()));
+  case 3:
+    return DecodeResidual(reader, out, order, FixedPredictor<3>(out.data()));
+  default:
+    return DecodeResidual(reader, out, order, FixedPredictor<4>(out.data()));
+  }
+}
+
+/*
+ * Decodes the block that starts at `block` (its header) into out.
+ * @parameters block, limit (end of readable memory), out (sample_count samples)
+ * @returns the block size in bytes, header included
+ */
+std::size_t DecodeBlock(const uint8_t *block, const uint8_t *limit, std::span<int16_t> out) {
+  SlacBlockHeader header{};
+  std::memcpy(&header, block, sizeof(header));
+  const std::size_t n = header.sample_count;
+  const unsigned order = header.order;
+  if (n != out.size() || n == 0U) {
+    throw Corrupt("unexpected block length");
+  }
+  if (static_cast<std::size_t>(limit - block) - sizeof(header) < header.payload_bytes) {
+    throw Corrupt("block payload is truncated");
+  }
+  if (BlockCrc(header, block + sizeof(header)) != header.crc32) {
+    throw Corrupt("block checksum mismatch");
+  }
+  BitReader reader(block + sizeof(header), limit);
+  const auto method = static_cast<BlockMethod>(header.method);
+  if (method == BlockMethod::constant) {
+    std::fill(out.begin(), out.end(), static_cast<int16_t>(reader.GetSigned(k_sample_bits)));
+  } else if (method == BlockMethod::verbatim) {
+    for (auto &value : out) {
+      value = static_cast<int16_t>(reader.GetSigned(k_sample_bits));
+    }
+  } else if (method == BlockMethod::fixed || method == BlockMethod::lpc) {
+    if ((method == BlockMethod::fixed && order > k_max_fixed_order) || (method == BlockMethod::lpc && (order == 0U || order > k_max_lpc_order)) ||
+        order >= n) {
+      throw Corrupt("invalid predictor order " + std::to_string(order));
+    }
+    for (std::size_t i = 0; i < order; ++i) {
+      out[i] = static_cast<int16_t>(reader.GetSigned(k_sample_bits));
+    }
+    if (method == BlockMethod::fixed) {
+      DecodeFixed(reader, out, order);
+    } else {
+      std::array<int32_t, k_max_lpc_order> coefficients{};
+      const unsigned precision = reader.Get(k_precision_bits) + 1U;
+      const unsigned shift = reader.Get(k_shift_bits);
+      for (std::size_t i = 0; i < order; ++i) {
+        coefficients[i] = reader.GetSigned(precision);
+      }
+      DecodeLpc(reader, out, order, coefficients.data(), shift);
+    }
+  } else {
+    throw Corrupt("unknown block method " + std::to_string(header.method));
+  }
+  if (reader.BitsConsumed() > std::size_t{header.payload_bytes} * 8U) {
+    throw Corrupt("block payload is truncated");
+  }
+  return sizeof(header) + header.payload_bytes;
+}
+
+struct BlockLocation {
+  std::size_t offset = 0;
+  std::size_t first_sample = 0;
+  std::size_t sample_count = 0;
+};
+
+std::vector<BlockLocation> LocateBlocks(std::span<const uint8_t> stream, uint64_t &sample_count) {
+  std::vector<BlockLocation> blocks;
+  std::size_t offset = sizeof(SlacFileHeader);
+  std::size_t total = 0;
+  while (offset < stream.size()) {
+    if (stream.size() - offset < sizeof(SlacBlockHeader)) {
+      throw Corrupt("truncated block header");
+    }
+    SlacBlockHeader header{};
+    std::memcpy(&header, stream.data() + offset, sizeof(header));
+    if (stream.size() - offset - sizeof(header) < header.payload_bytes) {
+      throw Corrupt("truncated block payload");
+    }
+    blocks.push_back({offset, total, header.sample_count});
+    total += header.sample_count;
+    offset += sizeof(header) + header.payload_bytes;
+  }
+  if (sample_count != k_unknown_sample_count && sample_count != total) {
+    throw Corrupt("header announces " + std::to_string(sample_count) + " samples, blocks hold " + std::to_string(total));
+  }
+  sample_count = total;
+  return blocks;
+}
+} // namespace
+
+bool IsEncoded(std::span<const uint8_t> bytes) { return bytes.size() >= 4U && std::memcmp(bytes.data(), "SLAC", 4) == 0; }
+
+StreamInfo ReadInfo(std::span<const uint8_t> stream) {
+  if (stream.size() < sizeof(SlacFileHeader)) {
+    throw std::runtime_error("Not a SLAC stream: too short");
+  }
+  SlacFileHeader header{};
+  std::memcpy(&header, stream.data(), sizeof(header));
+  return ParseHeader(header);
+}
+
+std::vector<uint8_t> Encode(std::span<const int16_t> samples, uint32_t sample_rate, const EncoderOptions &options) {
+  ValidateOptions(options);
+  const std::size_t block_count = (samples.size() + options.block_size - 1U) / options.block_size;
+  std::vector<std::vector<uint8_t>> blocks(block_count);
+  std::vector<std::unique_ptr<detail::BlockEncoder>> encoders;
+  for (std::size_t i = 0; i < std::min(std::max<std::size_t>(options.threads, 1U), std::max<std::size_t>(block_count, 1U)); ++i) {
+    encoders.push_back(std::make_unique<detail::BlockEncoder>(options));
+  }
+  ParallelFor(block_count, options.threads, [&](std::size_t block, std::size_t worker) {
+    const std::size_t first = block * options.block_size;
+    encoders[worker]->Encode(samples.subspan(first, std::min<std::size_t>(options.block_size, samples.size() - first)), blocks[block]);
+  });
+
+  const SlacFileHeader header = MakeFileHeader(sample_rate, options.block_size, samples.size(), SampleCrc(0, samples));
+  std::size_t total = sizeof(header);
+  for (const auto &block : blocks) {
+    total += block.size();
+  }
+  std::vector<uint8_t> stream;
+  stream.reserve(total);
+  AppendBytes(stream, &header, sizeof(header));
+  for (const auto &block : blocks) {
+    stream.insert(stream.end(), block.begin(), block.end());
+  }
+  return stream;
+}
+
+std::vector<int16_t> Decode(std::span<const uint8_t> stream, std::size_t threads) {
+  StreamInfo info = ReadInfo(stream);
+  const bool complete = info.sample_count != k_unknown_sample_count;
+  const auto blocks = LocateBlocks(stream, info.sample_count);
+  std::vector<int16_t> samples(info.sample_count);
+  const uint8_t *limit = stream.data() + stream.size();
+  ParallelFor(blocks.size(), threads, [&](std::size_t block, std::size_t) {
+    const BlockLocation &location = blocks[block];
+    DecodeBlock(stream.data() + location.offset, limit, std::span(samples).subspan(location.first_sample, location.sample_count));
+  });
+  if (complete && SampleCrc(0, samples) != info.crc32) {
+    throw Corrupt("sample checksum mismatch");
+  }
+  return samples;
+}
+
+StreamEncoder::StreamEncoder(std::ostream &output, uint32_t sample_rate, EncoderOptions encoder_options)
+    : out(output), options(std::move(encoder_options)) {
+  ValidateOptions(options);
+  encoder = std::make_unique<detail::BlockEncoder>(options);
+  header_position = out.tellp();
+  const SlacFileHeader header = MakeFileHeader(sample_rate, options.block_size, k_unknown_sample_count, 0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  bytes_written = sizeof(header);
+  pending.reserve(options.block_size);
+}
+
+StreamEncoder::~StreamEncoder() {
+  if (!finished) {
+    try {
+      Finish();
+    } catch (...) {
+      // Destructors must not throw; call Finish explicitly to see write errors.
+    }
+  }
+}
+
+void StreamEncoder::FlushBlock(std::span<const int16_t> block) {
+  encoded.clear();
+  encoder->Encode(block, encoded);
+  out.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+  if (!out) {
+    throw std::runtime_error("Unable to write SLAC stream");
+  }
+  samples_written += block.size();
+  bytes_written += encoded.size();
+  crc = SampleCrc(crc, block);
+}
+
+void StreamEncoder::Write(std::span<const int16_t> samples) {
+  if (finished) {
+    throw std::logic_error("SLAC stream encoder is already finished");
+  }
+  // Whole blocks are encoded straight from the input; only the remainder is buffered.
+  if (!pending.empty()) {
+    const std::size_t take = std::min<std::size_t>(options.block_size - pending.size(), samples.size());
+    pending.insert(pending.end(), samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(take));
+    samples = samples.subspan(take);
+    if (pending.size() < options.block_size) {
+      return;
+    }
+    FlushBlock(pending);
+    pending.clear();
+  }
+  for (; samples.size() >= options.block_size; samples = samples.subspan(options.block_size)) {
+    FlushBlock(samples.first(options.block_size));
+  }
+  pending.assign(samples.begin(), samples.end());
+}
+
+void StreamEncoder::Finish() {
+  if (finished) {
+    return;
+  }
+  finished = true;
+  if (!pending.empty()) {
+    FlushBlock(pending);
+    pending.clear();
+  }
+  if (header_position >= 0) {
+    const auto end_position = out.tellp();
+    out.seekp(header_position + static_cast<std::streamoff>(offsetof(SlacFileHeader, crc32)));
+    out.write(reinterpret_cast<const char *>(&crc), sizeof(crc));
+    out.write(reinterpret_cast<const char *>(&samples_written), sizeof(samples_written));
+    out.seekp(end_position);
+  }
+  out.flush();
+  if (!out) {
+    throw std::runtime_error("Unable to write SLAC stream");
+  }
+}
+
+StreamDecoder::StreamDecoder(std::istream &input) : in(input) {
+  SlacFileHeader header{};
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    throw std::runtime_error("Not a SLAC stream: too short");
+  }
+  info = ParseHeader(header);
+}
+
+bool StreamDecoder::NextBlock() {
+  SlacBlockHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (in.gcount() == 0 && in.eof()) {
+    if (info.sample_count != k_unknown_sample_count && samples_decoded != info.sample_count) {
+      throw Corrupt("header announces " + std::to_string(info.sample_count) + " samples, blocks hold " + std::to_string(samples_decoded));
+    }
+    return false;
+  }
+  if (in.gcount() != sizeof(header)) {
+    throw Corrupt("truncated block header");
+  }
+  payload.resize(sizeof(header) + header.payload_bytes);
+  std::memcpy(payload.data(), &header, sizeof(header));
+  if (!in.read(reinterpret_cast<char *>(payload.data() + sizeof(header)), header.payload_bytes)) {
+    throw Corrupt("truncated block payload");
+  }
+  block.resize(header.sample_count);
+  DecodeBlock(payload.data(), payload.data() + payload.size(), block);
+  samples_decoded += block.size();
+  crc = SampleCrc(crc, block);
+  // The whole-stream checksum is checked as the last announced sample arrives, so readers that stop there see it too.
+  if (info.sample_count != k_unknown_sample_count) {
+    if (samples_decoded > info.sample_count) {
+      throw Corrupt("blocks hold more than the " + std::to_string(info.sample_count) + " samples the header announces");
+    }
+    if (samples_decoded == info.sample_count && crc != info.crc32) {
+      throw Corrupt("sample checksum mismatch");
+    }
+  }
+  block_position = 0;
+  return true;
+}
+
+std::size_t StreamDecoder::Read(std::span<int16_t> out) {
+  std::size_t copied = 0;
+  while (copied < out.size()) {
+    if (block_position == block.size() && !NextBlock()) {
+      break;
+    }
+    const std::size_t take = std::min(out.size() - copied, block.size() - block_position);
+    std::copy_n(block.begin() + static_cast<std::ptrdiff_t>(block_position), take, out.begin() + static_cast<std::ptrdiff_t>(copied));
+    block_position += take;
+    copied += take;
+  }
+  return copied;
+}
+
+} // namespace lossless
@@ -0,0 +1,143 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * lossless_audio.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INCLUDE_LOSSLESS_AUDIO_H_
+#define INCLUDE_LOSSLESS_AUDIO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "include/structures.h"
+
+// SLAC: lossless 16 bit mono audio in the style of FLAC. Each block is predicted
+// with the cheapest of a fixed polynomial or a quantized LPC filter and the
+// residual is Rice coded. The stream layout is documented in structures.h.
+namespace lossless {
+
+constexpr uint32_t k_default_block_size = 4096;
+constexpr uint32_t k_max_block_size = std::numeric_limits<uint16_t>::max();
+constexpr uint32_t k_max_fixed_order = 4;
+constexpr uint32_t k_max_lpc_order = 32;
+constexpr uint32_t k_max_partition_order = 15;
+constexpr uint64_t k_unknown_sample_count = std::numeric_limits<uint64_t>::max();
+
+enum class BlockMethod : uint8_t { constant = 0, verbatim = 1, fixed = 2, lpc = 3 };
+
+struct EncoderOptions {
+  uint32_t block_size = k_default_block_size;
+  uint32_t max_lpc_order = 12;          // 0: fixed predictors only.
+  uint32_t coefficient_precision = 14;  // Bits per quantized LPC coefficient, sign included (5..15).
+  uint32_t max_partition_order = 6;     // Rice partitions per block are at most 2^max_partition_order.
+  bool exhaustive_order_search = false; // Try every LPC order instead of the one the prediction error suggests.
+  std::size_t threads = 1;              // Blocks encoded in parallel by Encode.
+};
+
+struct StreamInfo {
+  uint32_t sample_rate = 0;
+  uint32_t block_size = 0;
+  uint64_t sample_count = 0;
+  uint32_t crc32 = 0; // Of the decoded samples, unless sample_count is k_unknown_sample_count.
+};
+
+namespace detail {
+class BlockEncoder;
+} // namespace detail
+
+// True when the bytes start with a SLAC file header.
+bool IsEncoded(std::span<const uint8_t> bytes);
+StreamInfo ReadInfo(std::span<const uint8_t> stream);
+
+/*
+ * Encodes a whole signal into a SLAC stream.
+ * @parameters samples, sample_rate, options
+ * @returns the stream, file header included
+ */
+std::vector<uint8_t> Encode(std::span<const int16_t> samples, uint32_t sample_rate, const EncoderOptions &options = {});
+
+/*
+ * Decodes a whole SLAC stream. Blocks are located first, so threads > 1 decodes
+ * them in parallel. Throws std::runtime_error on a truncated or corrupt stream,
+ * including a block or whole-stream checksum mismatch.
+ * @parameters stream, threads
+ * @returns the samples
+ */
+std::vector<int16_t> Decode(std::span<const uint8_t> stream, std::size_t threads = 1);
+
+/*
+ * Encodes a signal of unknown length as it arrives, one block at a time. The
+ * sample count in the header is patched by Finish when the output is seekable.
+ */
+class StreamEncoder {
+public:
+  StreamEncoder(std::ostream &out, uint32_t sample_rate, EncoderOptions options = {});
+  ~StreamEncoder();
+  StreamEncoder(const StreamEncoder &) = delete;
+  StreamEncoder &operator=(const StreamEncoder &) = delete;
+
+  void Write(std::span<const int16_t> samples);
+  // Encodes the final partial block. Further writes are an error.
+  void Finish();
+
+  uint64_t SamplesWritten() const { return samples_written; }
+  uint64_t BytesWritten() const { return bytes_written; }
+
+private:
+  std::ostream &out;
+  EncoderOptions options;
+  std::unique_ptr<detail::BlockEncoder> encoder;
+  std::streamoff header_position = -1;
+  std::vector<int16_t> pending;
+  std::vector<uint8_t> encoded;
+  uint64_t samples_written = 0;
+  uint64_t bytes_written = 0;
+  uint32_t crc = 0;
+  bool finished = false;
+
+  void FlushBlock(std::span<const int16_t> block);
+};
+
+// Decodes a SLAC stream block by block without holding it in memory. Read
+// throws std::runtime_error on a corrupt block, and on a whole-stream checksum
+// mismatch as the last sample the header announces is decoded.
+class StreamDecoder {
+public:
+  explicit StreamDecoder(std::istream &in);
+
+  const StreamInfo &Info() const { return info; }
+  /*
+   * Copies the next samples into out.
+   * @parameters out
+   * @returns the number of samples copied, 0 once the stream is exhausted.
+   */
+  std::size_t Read(std::span<int16_t> out);
+
+private:
+  std::istream &in;
+  StreamInfo info;
+  std::vector<uint8_t> payload;
+  std::vector<int16_t> block;
+  std::size_t block_position = 0;
+  uint64_t samples_decoded = 0;
+  uint32_t crc = 0;
+
+  bool NextBlock();
+};
+
+} // namespace lossless
+
+#endif // INCLUDE_LOSSLESS_AUDIO_H_
@@ -0,0 +1,241 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "include/midi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace midi {
+
+namespace {
+
+constexpr uint32_t k_default_tempo = 500000; // Microseconds per quarter note, 120 bpm.
+constexpr uint8_t k_sustain_controller = 64;
+
+class Reader {
+public:
+  explicit Reader(std::span<const uint8_t> a_data) : data(a_data) {}
+
+  bool AtEnd() const { return position >= data.size(); }
+
+  uint8_t Byte() {
+    Need(1);
+    return data[position++];
+  }
+  uint32_t BigEndian(std::size_t bytes) {
+    Need(bytes);
+    uint32_t value = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      value = (value << 8U) | data[position++];
+    }
+    return value;
+  }
+  // Variable-length quantity: 7 bits per byte, high bit set on all but the last, at most 4 bytes.
+  uint32_t Variable() {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      const uint8_t byte = Byte();
+      value = (value << 7U) | (byte & 0x7FU);
+      if ((byte & 0x80U) == 0U) {
+        return value;
+      }
+    }
+    throw std::runtime_error("MIDI variable-length quantity longer than 4 bytes");
+  }
+  std::span<const uint8_t> Bytes(std::size_t count) {
+    Need(count);
+    const auto bytes = data.subspan(position, count);
+    position += count;
+    return bytes;
+  }
+
+private:
+  std::span<const uint8_t> data;
+  std::size_t position = 0;
+
+  void Need(std::size_t count) const {
+    if (data.size() - position < count) {
+      throw std::runtime_error("Truncated MIDI file");
+    }
+  }
+};
+
+// Events in ticks, before the tempo map is applied.
+struct TickEvent {
+  uint64_t tick = 0;
+  Event event;
+};
+
+struct TempoChange {
+  uint64_t tick = 0;
+  uint32_t microseconds_per_quarter = k_default_tempo;
+};
+
+void ReadTrack(std::span<const uint8_t> track, std::vector<TickEvent> &events, std::vector<TempoChange> &tempos) {
+  Reader reader(track);
+  uint64_t tick = 0;
+  uint8_t running_status = 0;
+  while (!reader.AtEnd()) {
+    tick += reader.Variable();
+    uint8_t status = reader.Byte();
+    if (status == 0xFFU) {
+      const uint8_t type = reader.Byte();
+      const auto payload = reader.Bytes(reader.Variable());
+      if (type == 0x51U && payload.size() == 3U) {
+        tempos.push_back({tick, (static_cast<uint32_t>(payload[0]) << 16U) | (static_cast<uint32_t>(payload[1]) << 8U) | payload[2]});
+      } else if (type == 0x2FU) {
+        return; // End of track.
+      }
+      running_status = 0;
+      continue;
+    }
+    if (status == 0xF0U || status == 0xF7U) {
+      reader.Bytes(reader.Variable()); // Sysex.
+      running_status = 0;
+      continue;
+    }
+    if (status >= 0xF0U) {
+      throw std::runtime_error("Unexpected MIDI system message in a track");
+    }
+    uint8_t first = 0;
+    if (status < 0x80U) {
+      if (running_status == 0U) {
+        throw std::runtime_error("MIDI data byte without a running status");
+      }
+      first = status;
+      status = running_status;
+    } else {
+      running_status = status;
+      first = reader.Byte();
+    }
+    const uint8_t type = status & 0xF0U;
+    const uint8_t channel = status & 0x0FU;
+    // Program change and channel pressure carry one data byte, the rest two.
+    const uint8_t second = (type == 0xC0U || type == 0xD0U) ? 0U : reader.Byte();
+    Event event;
+    event.channel = channel;
+    event.key = first & 0x7FU;
+    if (type == 0x90U && second != 0U) {
+      event.kind = EventKind::note_on;
+      event.velocity = second & 0x7FU;
+    } else if (type == 0x80U || type == 0x90U) {
+      event.kind = EventKind::note_off;
+    } else if (type == 0xB0U && first == k_sustain_controller) {
+      event.kind = second >= 64U ? EventKind::sustain_on : EventKind::sustain_off;
+      event.key = 0;
+    } else {
+      continue;
+    }
+    events.push_back({tick, event});
+  }
+}
+
+} // namespace
+
+double KeyFrequency(uint8_t key) { return 440.0 * std::exp2((static_cast<double>(key) - 69.0) / 12.0); }
+
+Sequence Parse(std::span<const uint8_t> contents, uint32_t sample_rate) {
+  Reader reader(contents);
+  const auto chunk_type = [&reader]() {
+    const auto type = reader.Bytes(4);
+    return std::string(reinterpret_cast<const char *>(type.data()), type.size());
+  };
+  if (contents.size() < 14U || chunk_type() != "MThd") {
+    throw std::runtime_error("Not a Standard MIDI File");
+  }
+  const uint32_t header_size = reader.BigEndian(4);
+  Sequence sequence;
+  sequence.sample_rate = sample_rate;
+  sequence.format = static_cast<uint16_t>(reader.BigEndian(2));
+  sequence.track_count = static_cast<uint16_t>(reader.BigEndian(2));
+  sequence.division = static_cast<uint16_t>(reader.BigEndian(2));
+  if (header_size < 6U) {
+    throw std::runtime_error("Malformed MIDI header");
+  }
+  reader.Bytes(header_size - 6U);
+  if (sequence.format > 1U) {
+    throw std::runtime_error("MIDI format " + std::to_string(sequence.format) + " is not supported");
+  }
+  if (sequence.division == 0U) {
+    throw std::runtime_error("MIDI division is zero");
+  }
+
+  std::vector<TickEvent> events;
+  std::vector<TempoChange> tempos;
+  for (uint16_t tracks_read = 0; tracks_read < sequence.track_count && !reader.AtEnd();) {
+    const auto type = chunk_type();
+    const auto body = reader.Bytes(reader.BigEndian(4));
+    if (type != "MTrk") {
+      continue; // Unknown chunks are skipped.
+    }
+    ++tracks_read;
+    const std::size_t track_start = events.size();
+    ReadTrack(body, events, tempos);
+    // Each track is in tick order already; merging keeps ties in file order.
+    std::inplace_merge(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(track_start), events.end(),
+                       [](const TickEvent &a, const TickEvent &b) { return a.tick < b.tick; });
+  }
+  std::stable_sort(tempos.begin(), tempos.end(), [](const TempoChange &a, const TempoChange &b) { return a.tick < b.tick; });
+  sequence.tempo_changes = tempos.size();
+
+  // Ticks to seconds. SMPTE divisions count ticks per frame at a fixed frame rate, so tempo does not apply.
+  const bool smpte = (sequence.division & 0x8000U) != 0U;
+  const double smpte_ticks_per_second =
+      smpte ? static_cast<double>(256U - (sequence.division >> 8U)) * static_cast<double>(sequence.division & 0xFFU) : 0.0;
+  if (smpte && smpte_ticks_per_second <= 0.0) {
+    throw std::runtime_error("Malformed MIDI SMPTE division");
+  }
+  sequence.events.reserve(events.size());
+  std::size_t next_tempo = 0;
+  uint64_t segment_tick = 0;
+  double segment_seconds = 0.0;
+  uint32_t tempo = k_default_tempo;
+  for (const auto &[tick, event] : events) {
+    double seconds = 0.0;
+    if (smpte) {
+      seconds = static_cast<double>(tick) / smpte_ticks_per_second;
+    } else {
+      for (; next_tempo < tempos.size() && tempos[next_tempo].tick <= tick; ++next_tempo) {
+        segment_seconds += static_cast<double>(tempos[next_tempo].tick - segment_tick) * tempo * 1e-6 / sequence.division;
+        segment_tick = tempos[next_tempo].tick;
+        tempo = tempos[next_tempo].microseconds_per_quarter;
+      }
+      seconds = segment_seconds + static_cast<double>(tick - segment_tick) * tempo * 1e-6 / sequence.division;
+    }
+    const double sample = std::round(seconds * sample_rate);
+    if (sample > static_cast<double>(std::numeric_limits<uint32_t>::max())) {
+      throw std::runtime_error("MIDI sequence too long");
+    }
+    Event timed = event;
+    timed.sample = static_cast<uint32_t>(sample);
+    sequence.events.push_back(timed);
+  }
+  return sequence;
+}
+
+Sequence Load(const std::string &file_name, uint32_t sample_rate) {
+  std::ifstream file(file_name, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Unable to read MIDI file " + file_name);
+  }
+  const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  try {
+    return Parse(contents, sample_rate);
+  } catch (const std::runtime_error &error) {
+    throw std::runtime_error(file_name + ": " + error.what());
+  }
+}
+
+} // namespace midi
@@ -15,5 +15,54 @@
 #ifndef INCLUDE_MIDI_H_
 #define INCLUDE_MIDI_H_
 
-// TODO(brandon): Add midi file parser
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "include/common.h"
+
+namespace midi {
+
+enum class EventKind : uint8_t { note_on = 1, note_off = 2, sustain_on = 3, sustain_off = 4 };
+
+// One performance event at its sample time; 8 bytes so a whole piece stays in cache.
+struct Event {
+  uint32_t sample = 0;
+  EventKind kind = EventKind::note_on;
+  uint8_t channel = 0;
+  uint8_t key = 0;
+  uint8_t velocity = 0; // 1-127 for note_on.
+};
+static_assert(sizeof(Event) == 8, "MIDI events are packed for streaming");
+
+struct Sequence {
+  uint16_t format = 0;
+  uint16_t track_count = 0;
+  uint16_t division = 0; // Ticks per quarter note, or the raw SMPTE division.
+  uint32_t sample_rate = SAMPLE_RATE;
+  std::size_t tempo_changes = 0;
+  std::vector<Event> events; // Sorted by sample; ties keep file order, earlier tracks first.
+
+  double Seconds() const { return events.empty() ? 0.0 : static_cast<double>(events.back().sample) / sample_rate; }
+};
+
+// MIDI key to frequency, equal temperament with A4 (key 69) at 440 Hz.
+double KeyFrequency(uint8_t key);
+
+/*
+ * Parses a Standard MIDI File of format 0 or 1: running status, meta and
+ * sysex events, and the tempo map (tempo changes from any track apply to all
+ * of them) or SMPTE time. Note on with velocity 0 becomes note off, and
+ * controller 64 becomes sustain on/off. Other channel messages are dropped.
+ * Throws std::runtime_error on a malformed or format 2 file.
+ * @parameters file contents, sample rate the event times are expressed in
+ * @returns the sequence
+ */
+Sequence Parse(std::span<const uint8_t> contents, uint32_t sample_rate = SAMPLE_RATE);
+Sequence Load(const std::string &file_name, uint32_t sample_rate = SAMPLE_RATE);
+
+} // namespace midi
+
 #endif // INCLUDE_MIDI_H_
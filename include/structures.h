@@ -66,7 +66,7 @@ union RGBA {
   } rgba_st;
   uint32_t rgba;
 };
-enum class ColorScaleType { GRAYSCALE, RGB, YUV };
+enum class ColorScaleType { GRAYSCALE, RGB, YUV, INFERNO };
 
 struct BMPFileHeader {
   uint16_t file_type = 0x4D42; // File type always BM which is 0x4D42
@@ -104,6 +104,89 @@ struct BMPColorHeader {
   uint32_t unused[16]{0};                // Unused data for sRGB color space
 };
 
+// SoundLearner feature tensor (deep_trainer/slft.py): header followed by
+// channels * frequency_bins * time_frames little endian float32, channel major.
+struct SlftFileHeader {
+  char magic[4] = {'S', 'L', 'F', 'T'};
+  uint32_t version = 1;
+  uint32_t sample_rate = 44100;
+  uint32_t channels = 0;
+  uint32_t frequency_bins = 0;
+  uint32_t time_frames = 0;
+};
+
+/** SoundLearner lossless audio (include/lossless_audio.h), all integers little endian
+      SlacFileHeader, then one block per block_size samples (the last may be shorter):
+      SlacBlockHeader followed by payload_bytes of MSB-first bit stream.
+      Checksums are CRC-32 (zlib.crc32): each block's covers its header fields up to
+      crc32 and its payload, the file header's covers the decoded samples as 16 bit
+      little endian PCM, like FLAC's MD5.
+      Block payload by method:
+        constant   16 bit sample.
+        verbatim   sample_count x 16 bit samples.
+        fixed      order x 16 bit warm-up samples, residual.
+        lpc        order x 16 bit warm-up samples, 4 bit precision - 1, 5 bit shift,
+                   order x precision bit coefficients, residual.
+      Residual: 4 bit partition order p, then 2^p partitions of sample_count >> p
+      residuals (the first one order fewer). Each partition starts with a 5 bit Rice
+      parameter k and holds zigzag coded residuals as unary(u >> k), then k low bits.
+      k = 31 escapes to a 5 bit width w followed by zigzag values in w raw bits.
+*/
+struct SlacFileHeader {
+  char magic[4] = {'S', 'L', 'A', 'C'};
+  uint16_t version = 2;
+  uint16_t channels = 1;
+  uint32_t sample_rate = 44100;
+  uint16_t bits_per_sample = 16;
+  uint16_t reserved_0 = 0;
+  uint32_t block_size = 4096;
+  uint32_t crc32 = 0;        // Of the decoded samples; patched with sample_count by a stream encoder.
+  uint64_t sample_count = 0; // UINT64_MAX while a stream encoder could not patch it.
+};
+
+struct SlacBlockHeader {
+  uint32_t payload_bytes = 0;
+  uint16_t sample_count = 0;
+  uint8_t method = 0; // lossless::BlockMethod.
+  uint8_t order = 0;  // Predictor order for fixed and lpc blocks.
+  uint32_t crc32 = 0; // Of the fields above and the payload.
+};
+
+// SoundLearner binary instrument (.slin): header followed by string_count
+// records, fields in the oscillator CSV column order, little endian. The
+// records hold the exact parameter bits, and a dataset sample's header holds
+// the exact note it was rendered at, so a .slin renders bit-identical audio
+// where a six-decimal .data/.meta pair only renders close to it. Version 1
+// headers end after string_count and carry no note.
+struct InstrumentFileHeader {
+  char magic[4] = {'S', 'L', 'I', 'N'};
+  uint32_t version = 2;
+  uint32_t record_size = 56; // sizeof(InstrumentStringRecord); readers reject other sizes.
+  uint32_t string_count = 0;
+  double note_frequency = 0.0; // 0 when the instrument is not tied to a rendered note.
+  double velocity = 0.0;
+};
+
+struct InstrumentStringRecord {
+  double amplitude_factor = 0.0;
+  double frequency_factor = 0.0;
+  double phase = 0.0;
+  double amplitude_decay = 0.0;
+  double amplitude_attack = 0.0;
+  double frequency_decay = 0.0;
+  uint32_t coupled = 1;
+  uint32_t reserved = 0;
+};
+
 #pragma pack(pop)
 
+constexpr uint32_t k_instrument_header_v1_size = 16;
+
+// Bytes before the first record: version 1 headers stop after string_count.
+constexpr uint32_t InstrumentHeaderSize(uint32_t version) {
+  return version == 1U ? k_instrument_header_v1_size : static_cast<uint32_t>(sizeof(InstrumentFileHeader));
+}
+
+static_assert(sizeof(InstrumentFileHeader) == 32 && sizeof(InstrumentStringRecord) == 56, "Instrument file layout is part of the format");
+
 #endif // INCLUDE_STRUCTURES_H_
@@ -15,10 +15,16 @@
 #include "instrument/instrument_model.h"
 
 #include <algorithm>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <limits>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utility>
 
 namespace instrument {
@@ -27,6 +33,10 @@ namespace {
 bool CoupledStringsFirst(const std::unique_ptr<oscillator::StringOccilator> &a_osc, const std::unique_ptr<oscillator::StringOccilator> &b_osc) {
   return a_osc->IsCoupled() && !b_osc->IsCoupled();
 }
+
+// Upper bounds of one string's CSV and JSON text, so serializing reserves once.
+constexpr std::size_t k_csv_bytes_per_string = 7 * 12;
+constexpr std::size_t k_json_bytes_per_string = 200;
 } // namespace
 
 InstrumentModel::InstrumentModel(const std::vector<std::string> &csv_strings, const std::string &instrument_name) : name(instrument_name) {
@@ -35,6 +45,82 @@ InstrumentModel::InstrumentModel(const std::vector<std::string> &csv_strings, co
                 [&](const auto &str) { sound_strings.push_back(std::move(oscillator::StringOccilator::CreateStringFromCsv(str))); });
 }
 
+InstrumentModel::InstrumentModel(std::span<const InstrumentStringRecord> records, const std::string &instrument_name) : name(instrument_name) {
+  sound_strings.reserve(records.size());
+  for (const auto &record : records) {
+    sound_strings.push_back(oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+}
+
+InstrumentFileHeader InstrumentModel::ReadBinaryHeader(std::string_view contents, const std::string &instrument_name) {
+  InstrumentFileHeader header;
+  if (contents.size() < k_instrument_header_v1_size || std::memcmp(contents.data(), header.magic, sizeof(header.magic)) != 0) {
+    throw std::invalid_argument(instrument_name + ": truncated instrument header");
+  }
+  std::memcpy(static_cast<void *>(&header), contents.data(), k_instrument_header_v1_size); // The version decides the full size.
+  const std::size_t header_size = InstrumentHeaderSize(header.version);
+  if ((header.version != 1U && header.version != 2U) || header.record_size != sizeof(InstrumentStringRecord) ||
+      contents.size() < header_size + static_cast<std::size_t>(header.string_count) * sizeof(InstrumentStringRecord)) {
+    throw std::invalid_argument(instrument_name + ": unsupported or truncated .slin instrument");
+  }
+  std::memcpy(&header, contents.data(), header_size);
+  return header;
+}
+
+InstrumentModel InstrumentModel::Parse(std::string_view contents, const std::string &instrument_name) {
+  InstrumentFileHeader header;
+  if (contents.size() >= sizeof(header.magic) && std::memcmp(contents.data(), header.magic, sizeof(header.magic)) == 0) {
+    header = ReadBinaryHeader(contents, instrument_name);
+    // Packed records have alignment 1, so they are read in place from the file bytes.
+    const auto *records = reinterpret_cast<const InstrumentStringRecord *>(contents.data() + InstrumentHeaderSize(header.version));
+    return InstrumentModel(std::span(records, header.string_count), instrument_name);
+  }
+  InstrumentModel model(0, instrument_name);
+  model.sound_strings.reserve(static_cast<std::size_t>(std::count(contents.begin(), contents.end(), '\n')) + 1U);
+  while (!contents.empty()) {
+    const auto end = std::min(contents.find('\n'), contents.size());
+    auto line = contents.substr(0, end);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      model.sound_strings.push_back(oscillator::StringOccilator::CreateStringFromCsv(line));
+    }
+    contents.remove_prefix(std::min(end + 1, contents.size()));
+  }
+  return model;
+}
+
+InstrumentModel InstrumentModel::Load(const std::string &file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open instrument " + file_name);
+  }
+  struct stat status {};
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("Unable to stat instrument " + file_name);
+  }
+  const auto size = static_cast<std::size_t>(status.st_size);
+  if (size == 0U) {
+    close(fd);
+    return InstrumentModel(0, file_name);
+  }
+  void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Unable to map instrument " + file_name);
+  }
+  try {
+    auto model = Parse(std::string_view(static_cast<const char *>(address), size), file_name);
+    munmap(address, size);
+    return model;
+  } catch (...) {
+    munmap(address, size);
+    throw;
+  }
+}
+
 InstrumentModel::InstrumentModel(std::size_t num_strings, const std::string &instrument_name) : name(instrument_name) {
   sound_strings.reserve(num_strings);
   for (std::size_t i = 0; i < num_strings; i++) {
@@ -61,6 +147,7 @@ InstrumentModel::InstrumentModel(std::size_t num_coupled_strings, std::size_t nu
 void InstrumentModel::AddTunedString(const oscillator::StringOccilator &&a_tuned_string) {
   auto tuned_string = std::make_unique<oscillator::StringOccilator>(oscillator::StringOccilator(a_tuned_string));
   sound_strings.push_back(std::move(tuned_string));
+  sorted_by = SortType::none;
 }
 
 /*
@@ -70,6 +157,17 @@ void InstrumentModel::AddTunedString(const oscillator::StringOccilator &&a_tuned
  */
 void InstrumentModel::AddUntunedString(bool is_coupled) {
   sound_strings.push_back(oscillator::StringOccilator::CreateUntunedString(is_coupled));
+  sorted_by = SortType::none;
+}
+
+/*
+ * Add a randomly tuned string drawn from the caller's engine and frequency factor range.
+ * @parameters: is_coupled, rand_eng (random source), frequency factor range
+ * @returns: none
+ */
+void InstrumentModel::AddUntunedString(bool is_coupled, std::mt19937 &rand_eng, double min_frequency_factor, double max_frequency_factor) {
+  sound_strings.push_back(oscillator::StringOccilator::CreateUntunedString(is_coupled, rand_eng, min_frequency_factor, max_frequency_factor));
+  sorted_by = SortType::none;
 }
 
 /*
@@ -78,16 +176,14 @@ void InstrumentModel::AddUntunedString(bool is_coupled) {
  * @returns: JSON string
  */
 std::string InstrumentModel::ToJson(SortType sort_type) {
-  std::string return_json = "{\n";
-  if (sort_type == SortType::frequency) {
-    SortStringsByFreq();
-  } else if (sort_type == SortType::amplitude) {
-    SortStringsByAmplitude();
-  }
-  return_json += "\"name\": \"" + name + "\",\n";
-  return_json += "\"strings\": [\n";
+  Sort(sort_type);
+  std::string return_json;
+  return_json.reserve(name.size() + 32U + sound_strings.size() * k_json_bytes_per_string);
+  return_json += "{\n\"name\": \"";
+  return_json += name;
+  return_json += "\",\n\"strings\": [\n";
   for (std::size_t j = 0; j < sound_strings.size(); j++) {
-    return_json += sound_strings[j]->ToJson();
+    sound_strings[j]->AppendJson(return_json);
     if (j + 1 != sound_strings.size()) {
       return_json += ",\n";
     }
@@ -97,22 +193,47 @@ std::string InstrumentModel::ToJson(SortType sort_type) {
 }
 
 std::string InstrumentModel::ToCsv(SortType sort_type) {
-  std::string return_csv = "";
-  if (sort_type == SortType::frequency) {
-    SortStringsByFreq();
-  } else if (sort_type == SortType::amplitude) {
-    SortStringsByAmplitude();
-  }
+  Sort(sort_type);
+  std::string return_csv;
+  return_csv.reserve(sound_strings.size() * k_csv_bytes_per_string);
   for (std::size_t j = 0; j < sound_strings.size(); j++) {
-    return_csv += sound_strings[j]->ToCsv();
+    sound_strings[j]->AppendCsv(return_csv);
     if (j + 1 != sound_strings.size()) {
-      return_csv += "\n";
+      return_csv += '\n';
     }
   }
 
   return return_csv;
 }
 
+std::vector<InstrumentStringRecord> InstrumentModel::ToRecords(SortType sort_type) {
+  Sort(sort_type);
+  std::vector<InstrumentStringRecord> records;
+  records.reserve(sound_strings.size());
+  for (const auto &sound_string : sound_strings) {
+    records.push_back(sound_string->ToRecord());
+  }
+  return records;
+}
+
+std::string InstrumentModel::ToBinary(SortType sort_type) {
+  const auto records = ToRecords(sort_type);
+  InstrumentFileHeader header;
+  header.string_count = static_cast<uint32_t>(records.size());
+  std::string binary(sizeof(header) + records.size() * sizeof(InstrumentStringRecord), '\0');
+  std::memcpy(binary.data(), &header, sizeof(header));
+  std::memcpy(binary.data() + sizeof(header), records.data(), records.size() * sizeof(InstrumentStringRecord));
+  return binary;
+}
+
+std::string InstrumentModel::CanonicalParameters() const {
+  std::string canonical;
+  for (const auto &sound_string : sound_strings) {
+    sound_string->AppendCanonical(canonical);
+  }
+  return canonical;
+}
+
 /*
  * Generates a array of double sample values representing
  * the sound of the note played.
@@ -143,12 +264,18 @@ std::vector<double> InstrumentModel::GenerateSignal(double velocity, double freq
  */
 std::vector<int16_t> InstrumentModel::GenerateIntSignal(double velocity, double frequency, std::size_t num_of_samples, bool &has_distorted_out,
                                                         bool return_on_distort) {
+  std::vector<int16_t> signal(num_of_samples);
+  GenerateIntSignal(velocity, frequency, signal, has_distorted_out, return_on_distort);
+  return signal;
+}
+
+std::size_t InstrumentModel::GenerateIntSignal(double velocity, double frequency, std::span<int16_t> out, bool &has_distorted_out,
+                                               bool return_on_distort) {
   has_distorted_out = false;
   std::for_each(sound_strings.begin(), sound_strings.end(), [&](const auto &s) { s->PrimeString(frequency, velocity); });
 
   // Generate samples.
-  std::vector<int16_t> signal(num_of_samples);
-  for (std::size_t i = 0; i < num_of_samples; i++) {
+  for (std::size_t i = 0; i < out.size(); i++) {
     double sample_val{0};
     std::for_each(sound_strings.begin(), sound_strings.end(), [&](const auto &s) { sample_val += s->NextSample(); });
 
@@ -161,18 +288,42 @@ std::vector<int16_t> InstrumentModel::GenerateIntSignal(double velocity, double
       has_distorted_out = true;
     }
     if (return_on_distort && has_distorted_out) {
-      return signal;
+      return i;
     }
 
     constexpr short max_int = std::numeric_limits<int16_t>::max();
-    signal[i] = static_cast<int16_t>(max_int * sample_val);
+    out[i] = static_cast<int16_t>(max_int * sample_val);
   }
 
-  return signal;
+  return out.size();
+}
+
+std::vector<Partial> InstrumentModel::PrimePartials(double velocity, double frequency) {
+  std::vector<Partial> partials;
+  partials.reserve(sound_strings.size());
+  for (const auto &sound_string : sound_strings) {
+    sound_string->PrimeString(frequency, velocity);
+    partials.push_back({sound_string->GetFrequency(), sound_string->GetPeakAmplitude(), sound_string->IsCoupled()});
+  }
+  return partials;
 }
 
 void InstrumentModel::AmendGain(double factor) {
   std::for_each(sound_strings.begin(), sound_strings.end(), [&factor](const auto &s) { s->AmendGain(factor); });
+  sorted_by = SortType::none;
+}
+
+// Sorting is skipped when the strings are already in the requested order.
+void InstrumentModel::Sort(SortType sort_type) {
+  if (sort_type == SortType::none || sort_type == sorted_by) {
+    return;
+  }
+  if (sort_type == SortType::frequency) {
+    SortStringsByFreq();
+  } else {
+    SortStringsByAmplitude();
+  }
+  sorted_by = sort_type;
 }
 
 void InstrumentModel::SortStringsByFreq() {
@@ -16,13 +16,25 @@
 #define INSTRUMENT_INSTRUMENT_MODEL_H_
 
 #include <memory>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "include/structures.h"
 #include "instrument/string_oscillator.h"
 
 namespace instrument {
 enum class SortType { none, amplitude, frequency };
+
+// Where one string starts for a note, before any frequency decay.
+struct Partial {
+  double frequency = 0.0;
+  double peak_amplitude = 0.0;
+  bool coupled = false;
+};
+
 class InstrumentModel {
 public:
   static constexpr std::size_t k_max_strings = 1000U;
@@ -30,16 +42,49 @@ public:
   InstrumentModel(const std::vector<std::string> &csv_string, const std::string &instrument_name);
   InstrumentModel(std::size_t num_strings, const std::string &instrument_name);
   InstrumentModel(std::size_t num_coupled_strings, std::size_t num_uncoupled_strings, const std::string &instrument_name);
+  InstrumentModel(std::span<const InstrumentStringRecord> records, const std::string &instrument_name);
   const std::string &GetName() const { return name; }
 
+  /*
+   * Reads a binary .slin instrument (include/structures.h) or oscillator CSV,
+   * one string per line, told apart by the .slin magic.
+   * @parameters contents (whole file), instrument_name
+   * @returns the instrument; throws std::invalid_argument on a malformed file
+   */
+  static InstrumentModel Parse(std::string_view contents, const std::string &instrument_name);
+  /*
+   * Validates a .slin header and its record count against the file size.
+   * @parameters contents (whole file, starting with the SLIN magic), instrument_name
+   * @returns the header, note_frequency 0 for version 1; throws std::invalid_argument on a malformed file
+   */
+  static InstrumentFileHeader ReadBinaryHeader(std::string_view contents, const std::string &instrument_name);
+  // Parse over a read-only memory map of the file; throws std::runtime_error when it cannot be read.
+  static InstrumentModel Load(const std::string &file_name);
+
   void AddTunedString(const oscillator::StringOccilator &&a_tuned_string);
   void AddUntunedString(bool is_uncoupled = false);
+  void AddUntunedString(bool is_coupled, std::mt19937 &rand_eng, double min_frequency_factor, double max_frequency_factor);
 
   std::string ToCsv(SortType sort_type = SortType::none);
   std::string ToJson(SortType sort_type = SortType::none);
+  std::string ToBinary(SortType sort_type = SortType::none); // .slin file contents.
+  // Records in the current string order, as ToBinary writes them.
+  std::vector<InstrumentStringRecord> ToRecords(SortType sort_type = SortType::none);
+  // Every string's exact parameters in render order; equal bytes render equal audio.
+  std::string CanonicalParameters() const;
   std::vector<double> GenerateSignal(double velocity, double frequency, std::size_t num_of_samples);
   std::vector<int16_t> GenerateIntSignal(double velocity, double frequency, std::size_t num_of_samples, bool &has_distorted_out,
                                          bool return_on_distort = true);
+  /*
+   * Renders into caller memory, e.g. filewriter::wave::MonoMappedWriter::Samples().
+   * @parameters velocity, frequency, out (its size is the sample count), has_distorted_out, return_on_distort
+   * @returns samples rendered; with return_on_distort the rest of out is left untouched
+   */
+  std::size_t GenerateIntSignal(double velocity, double frequency, std::span<int16_t> out, bool &has_distorted_out,
+                                bool return_on_distort = true);
+
+  // Primes every string for the note and reports its partials; generating a signal primes them again.
+  std::vector<Partial> PrimePartials(double velocity, double frequency);
 
   std::unique_ptr<InstrumentModel> TuneInstrument(uint8_t amount);
   void AmendGain(double factor);
@@ -49,7 +94,9 @@ public:
 private:
   std::vector<std::unique_ptr<oscillator::StringOccilator>> sound_strings;
   std::string name;
+  SortType sorted_by = SortType::none; // Order the strings are known to be in; adding or changing strings resets it.
 
+  void Sort(SortType sort_type);
   void SortStringsByFreq();
   void SortStringsByAmplitude();
 };
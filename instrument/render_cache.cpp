@@ -0,0 +1,358 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "instrument/render_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace instrument {
+
+namespace {
+constexpr uint32_t k_entry_version = 1;
+constexpr const char *k_entry_extension = ".slrc";
+constexpr const char *k_audio_tag = "audio";
+constexpr const char *k_lock_file = "lock";
+// A process re-scans the directory after storing this fraction of the cap, so peers sharing it overshoot by at most that much each.
+constexpr uint64_t k_rescan_fraction = 16;
+
+// Exclusive flock on the cache's lock file, so only one process at a time re-scans and evicts.
+class DirectoryLock {
+public:
+  explicit DirectoryLock(const std::string &directory)
+      : fd(open((std::filesystem::path(directory) / k_lock_file).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) {
+    // Without the lock, concurrent evictions may remove a few entries too many; the cache stays correct.
+    if (fd >= 0) {
+      while (flock(fd, LOCK_EX) != 0 && errno == EINTR) {
+      }
+    }
+  }
+  ~DirectoryLock() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  DirectoryLock(const DirectoryLock &) = delete;
+  DirectoryLock &operator=(const DirectoryLock &) = delete;
+
+private:
+  int fd;
+};
+
+uint64_t Mix(uint64_t value) {
+  value ^= value >> 30U;
+  value *= 0xBF58476D1CE4E5B9ULL;
+  value ^= value >> 27U;
+  value *= 0x94D049BB133111EBULL;
+  return value ^ (value >> 31U);
+}
+
+// Two independently seeded multiply-rotate lanes over 8-byte words, finalised with the splitmix64 mixer.
+std::array<uint64_t, 2> Hash128(std::string_view bytes, std::array<uint64_t, 2> seed = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL}) {
+  uint64_t lane_a = seed[0] ^ bytes.size();
+  uint64_t lane_b = seed[1];
+  std::size_t position = 0;
+  for (; position + sizeof(uint64_t) <= bytes.size(); position += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes.data() + position, sizeof(word));
+    lane_a = std::rotl(lane_a ^ (word * 0x87C37B91114253D5ULL), 31) * 0x4CF5AD432745937FULL;
+    lane_b = std::rotl(lane_b ^ (word * 0x4CF5AD432745937FULL), 29) * 0x87C37B91114253D5ULL + lane_a;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes.data() + position, bytes.size() - position);
+  lane_a = Mix(lane_a ^ tail);
+  lane_b = Mix(lane_b ^ lane_a);
+  return {Mix(lane_a + lane_b), lane_b};
+}
+
+template <typename T> void AppendBits(std::string &out, T value) { out.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+uint64_t Nanoseconds(std::chrono::nanoseconds duration) { return static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)); }
+} // namespace
+
+RenderKey RenderKey::Make(const InstrumentModel &instrument, double frequency, double velocity, std::size_t num_samples,
+                          uint32_t sample_rate, bool stop_on_clip) {
+  RenderKey key;
+  AppendBits(key.bytes, k_render_engine_version);
+  AppendBits(key.bytes, sample_rate);
+  AppendBits(key.bytes, static_cast<uint64_t>(num_samples));
+  AppendBits(key.bytes, frequency);
+  AppendBits(key.bytes, velocity);
+  AppendBits(key.bytes, static_cast<uint8_t>(stop_on_clip));
+  key.bytes += instrument.CanonicalParameters();
+  key.hash = Hash128(key.bytes);
+  return key;
+}
+
+void RenderCache::Stats::Print(std::ostream &out) const {
+  const auto rate = [](uint64_t hits, uint64_t lookups) { return lookups == 0U ? 0.0 : 100.0 * static_cast<double>(hits) / static_cast<double>(lookups); };
+  out << "render cache: audio " << audio_hits << "/" << audio_lookups << " hits (" << std::fixed << std::setprecision(1)
+      << rate(audio_hits, audio_lookups) << "%)";
+  if (feature_lookups > 0U) {
+    out << ", features " << feature_hits << "/" << feature_lookups << " hits (" << rate(feature_hits, feature_lookups) << "%)";
+  }
+  out << ", saved " << std::setprecision(2) << std::chrono::duration<double>(saved).count() << " s, stored " << stored << ", evicted "
+      << evicted << ", size " << std::setprecision(1) << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MiB\n";
+}
+
+RenderCache::RenderCache(Options a_options) : options(std::move(a_options)) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  fs::create_directories(options.directory, error);
+  if (error) {
+    throw std::runtime_error("Could not create render cache directory " + options.directory + ": " + error.message());
+  }
+  std::lock_guard lock(entries_mutex);
+  const DirectoryLock directory_lock(options.directory);
+  if (!Rescan()) {
+    throw std::runtime_error("Could not scan render cache directory " + options.directory);
+  }
+  Evict();
+}
+
+// Call with entries_mutex held. Rebuilds the entries from the directory, which other processes may have changed.
+bool RenderCache::Rescan() {
+  namespace fs = std::filesystem;
+  struct Found {
+    fs::file_time_type time;
+    std::string path;
+    uint64_t size;
+  };
+  std::vector<Found> found;
+  std::error_code error;
+  for (auto file = fs::recursive_directory_iterator(options.directory, error); !error && file != fs::recursive_directory_iterator();
+       file.increment(error)) {
+    std::error_code stat_error;
+    if (!file->is_regular_file(stat_error) || file->path().extension() != k_entry_extension) {
+      continue;
+    }
+    // Entries evicted by a peer while the scan runs are simply skipped.
+    const auto time = file->last_write_time(stat_error);
+    const auto size = stat_error ? 0U : file->file_size(stat_error);
+    if (!stat_error) {
+      found.push_back({time, file->path().string(), size});
+    }
+  }
+  if (error) {
+    return false;
+  }
+  std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) { return a.time < b.time; });
+  entries.clear();
+  recency.clear();
+  total_bytes = 0;
+  for (auto &file : found) {
+    recency.push_back(std::move(file.path));
+    entries[recency.back()] = Entry{file.size, std::prev(recency.end())};
+    total_bytes += file.size;
+  }
+  unscanned_bytes = 0;
+  return true;
+}
+
+std::string RenderCache::EntryPath(const RenderKey &key, const std::string &tag) const {
+  const auto hash = tag == k_audio_tag ? key.hash : Hash128(tag, key.hash);
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << std::setw(16) << hash[0] << std::setw(16) << hash[1];
+  const std::string hex = name.str();
+  return (std::filesystem::path(options.directory) / hex.substr(0, 2) / (hex + k_entry_extension)).string();
+}
+
+std::optional<std::vector<uint8_t>> RenderCache::Load(const RenderKey &key, const std::string &tag, EntryKind kind, uint64_t &produce_ns) {
+  const std::string path = EntryPath(key, tag);
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  RenderCacheEntryHeader header;
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!file || std::memcmp(header.magic, "SLRC", 4) != 0 || header.version != k_entry_version ||
+      header.kind != static_cast<uint32_t>(kind) || header.key_size != key.bytes.size() + tag.size()) {
+    return std::nullopt;
+  }
+  // The header is untrusted: the payload must be exactly what follows the key, or a torn entry could ask for any allocation.
+  std::error_code error;
+  const uint64_t file_size = std::filesystem::file_size(path, error);
+  if (error || file_size < sizeof(header) + header.key_size || header.payload_size != file_size - sizeof(header) - header.key_size) {
+    return std::nullopt;
+  }
+  std::string stored_key(header.key_size, '\0');
+  file.read(stored_key.data(), static_cast<std::streamsize>(stored_key.size()));
+  if (!file || stored_key.compare(0, key.bytes.size(), key.bytes) != 0 || stored_key.compare(key.bytes.size(), tag.size(), tag) != 0) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> payload(header.payload_size);
+  file.read(reinterpret_cast<char *>(payload.data()), static_cast<std::streamsize>(payload.size()));
+  if (!file) {
+    return std::nullopt;
+  }
+  Touch(path);
+  produce_ns = header.produce_ns;
+  return payload;
+}
+
+void RenderCache::Store(const RenderKey &key, const std::string &tag, EntryKind kind, std::span<const uint8_t> payload,
+                        std::chrono::nanoseconds produce_time) {
+  namespace fs = std::filesystem;
+  const std::string path = EntryPath(key, tag);
+  std::error_code error;
+  fs::create_directories(fs::path(path).parent_path(), error);
+  RenderCacheEntryHeader header;
+  header.kind = static_cast<uint32_t>(kind);
+  header.key_size = static_cast<uint32_t>(key.bytes.size() + tag.size());
+  header.payload_size = payload.size();
+  header.produce_ns = Nanoseconds(produce_time);
+  const std::string temporary = path + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(temporary_counter++);
+  {
+    std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(key.bytes.data(), static_cast<std::streamsize>(key.bytes.size()));
+    file.write(tag.data(), static_cast<std::streamsize>(tag.size()));
+    file.write(reinterpret_cast<const char *>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!file) {
+      // A full or read-only cache only costs future hits; the render itself succeeded.
+      file.close();
+      fs::remove(temporary, error);
+      return;
+    }
+  }
+  fs::rename(temporary, path, error);
+  if (error) {
+    fs::remove(temporary, error);
+    return;
+  }
+  ++stored;
+  std::lock_guard lock(entries_mutex);
+  Track(path, sizeof(header) + header.key_size + payload.size());
+}
+
+/*
+ * Call with entries_mutex held. The entries only know what this process wrote
+ * since its last scan, so before evicting, and every 1/k_rescan_fraction of the
+ * cap written, it re-scans the shared directory under the lock file and evicts
+ * by the directory's real size.
+ */
+void RenderCache::Track(const std::string &path, uint64_t size) {
+  if (const auto existing = entries.find(path); existing != entries.end()) {
+    total_bytes -= existing->second.size;
+    recency.erase(existing->second.recency);
+    entries.erase(existing);
+  }
+  recency.push_back(path);
+  entries[path] = Entry{size, std::prev(recency.end())};
+  total_bytes += size;
+  unscanned_bytes += size;
+  if (total_bytes <= options.max_bytes && unscanned_bytes <= options.max_bytes / k_rescan_fraction) {
+    return;
+  }
+  const DirectoryLock directory_lock(options.directory);
+  Rescan();
+  Evict();
+}
+
+// Call with entries_mutex held, and the directory lock when other processes may share it.
+void RenderCache::Evict() {
+  while (total_bytes > options.max_bytes && recency.size() > 1U) {
+    const std::string victim = recency.front();
+    recency.pop_front();
+    total_bytes -= entries[victim].size;
+    entries.erase(victim);
+    std::error_code error;
+    if (std::filesystem::remove(victim, error)) {
+      ++evicted;
+    }
+  }
+}
+
+void RenderCache::CountSaved(uint64_t produce_ns, std::chrono::steady_clock::time_point lookup_start) {
+  const auto lookup = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - lookup_start);
+  saved_ns += static_cast<int64_t>(produce_ns) - lookup.count();
+}
+
+void RenderCache::Touch(const std::string &path) {
+  std::error_code error;
+  std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+  std::lock_guard lock(entries_mutex);
+  if (const auto entry = entries.find(path); entry != entries.end()) {
+    recency.splice(recency.end(), recency, entry->second.recency);
+  }
+}
+
+std::optional<std::vector<int16_t>> RenderCache::LoadAudio(const RenderKey &key) {
+  const auto start = std::chrono::steady_clock::now();
+  ++audio_lookups;
+  uint64_t render_ns = 0;
+  const auto payload = Load(key, k_audio_tag, EntryKind::audio, render_ns);
+  if (!payload) {
+    return std::nullopt;
+  }
+  std::vector<int16_t> audio;
+  try {
+    audio = lossless::Decode(*payload);
+  } catch (const std::runtime_error &) {
+    return std::nullopt;
+  }
+  ++audio_hits;
+  CountSaved(render_ns, start);
+  return audio;
+}
+
+void RenderCache::StoreAudio(const RenderKey &key, std::span<const int16_t> audio, std::chrono::nanoseconds render_time) {
+  const auto stream = lossless::Encode(audio, SAMPLE_RATE, options.audio);
+  Store(key, k_audio_tag, EntryKind::audio, stream, render_time);
+}
+
+std::optional<std::vector<float>> RenderCache::LoadFeatures(const RenderKey &key, const std::string &tag, std::size_t expected_size) {
+  const auto start = std::chrono::steady_clock::now();
+  ++feature_lookups;
+  uint64_t extract_ns = 0;
+  const auto payload = Load(key, tag, EntryKind::features, extract_ns);
+  if (!payload || payload->size() != expected_size * sizeof(float)) {
+    return std::nullopt;
+  }
+  std::vector<float> features(expected_size);
+  std::memcpy(features.data(), payload->data(), payload->size());
+  ++feature_hits;
+  CountSaved(extract_ns, start);
+  return features;
+}
+
+void RenderCache::StoreFeatures(const RenderKey &key, const std::string &tag, std::span<const float> features,
+                                std::chrono::nanoseconds extract_time) {
+  Store(key, tag, EntryKind::features, std::span(reinterpret_cast<const uint8_t *>(features.data()), features.size_bytes()), extract_time);
+}
+
+RenderCache::Stats RenderCache::GetStats() const {
+  Stats stats;
+  stats.audio_lookups = audio_lookups;
+  stats.audio_hits = audio_hits;
+  stats.feature_lookups = feature_lookups;
+  stats.feature_hits = feature_hits;
+  stats.stored = stored;
+  stats.evicted = evicted;
+  stats.saved = std::chrono::nanoseconds(saved_ns.load());
+  std::lock_guard lock(entries_mutex);
+  stats.bytes = total_bytes;
+  return stats;
+}
+
+} // namespace instrument
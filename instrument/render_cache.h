@@ -0,0 +1,157 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * render_cache.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INSTRUMENT_RENDER_CACHE_H_
+#define INSTRUMENT_RENDER_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/lossless_audio.h"
+#include "instrument/instrument_model.h"
+
+/** Render cache entry format (<cache>/<first two hex digits>/<hash>.slrc)
+      Offset 0      RenderCacheEntryHeader.
+      key_size      Full key: the render key, then the entry tag ("audio" or a
+                    feature spec). A lookup whose key differs is a miss, so hash
+                    collisions cost a render and never return the wrong audio.
+      payload_size  SLAC stream for audio, float32 values for features.
+    Entries are written to a temporary file and renamed into place, so several
+    processes may share a cache directory. Eviction is by file modification
+    time, which a hit refreshes. The size cap holds for the directory, not per
+    process: eviction re-scans it under an flock on <cache>/lock.
+*/
+namespace instrument {
+
+// Bump when a change to the oscillators or the instrument makes old renders stale.
+constexpr uint32_t k_render_engine_version = 1;
+
+#pragma pack(push, 1)
+
+struct RenderCacheEntryHeader {
+  char magic[4] = {'S', 'L', 'R', 'C'};
+  uint32_t version = 1;
+  uint32_t kind = 0; // RenderCache::EntryKind.
+  uint32_t key_size = 0;
+  uint64_t payload_size = 0;
+  uint64_t produce_ns = 0; // What rendering or extracting the payload cost; a hit saves it.
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(RenderCacheEntryHeader) == 32, "Render cache entry header layout is part of the file format");
+
+// Canonical description of one render and its 128-bit hash.
+struct RenderKey {
+  std::string bytes;
+  std::array<uint64_t, 2> hash = {};
+
+  /*
+   * @parameters instrument (strings in render order), note frequency, velocity,
+   *             sample count, sample rate, stop_on_clip (GenerateIntSignal's
+   *             return_on_distort)
+   * @returns the key; exact parameter bits and k_render_engine_version included
+   */
+  static RenderKey Make(const InstrumentModel &instrument, double frequency, double velocity, std::size_t num_samples,
+                        uint32_t sample_rate, bool stop_on_clip);
+};
+
+/*
+ * Content-addressed store of rendered notes (SLAC-compressed) and of the
+ * feature tensors extracted from them, capped at max_bytes with least recently
+ * used eviction. Thread safe.
+ */
+class RenderCache {
+public:
+  enum class EntryKind : uint32_t { audio = 1, features = 2 };
+
+  struct Options {
+    std::string directory;
+    uint64_t max_bytes = 4ULL << 30U;
+    lossless::EncoderOptions audio;
+  };
+
+  struct Stats {
+    uint64_t audio_lookups = 0;
+    uint64_t audio_hits = 0;
+    uint64_t feature_lookups = 0;
+    uint64_t feature_hits = 0;
+    uint64_t stored = 0;
+    uint64_t evicted = 0;
+    uint64_t bytes = 0; // Current size of the cache directory.
+    std::chrono::nanoseconds saved{0}; // Render and extraction time the hits replaced, minus their load time.
+
+    void Print(std::ostream &out) const;
+  };
+
+  // Scans the directory (created when missing) for existing entries; throws std::runtime_error when it cannot.
+  explicit RenderCache(Options a_options);
+
+  std::optional<std::vector<int16_t>> LoadAudio(const RenderKey &key);
+  void StoreAudio(const RenderKey &key, std::span<const int16_t> audio, std::chrono::nanoseconds render_time);
+
+  // tag names the feature spec; a cached tensor of a different size is a miss.
+  std::optional<std::vector<float>> LoadFeatures(const RenderKey &key, const std::string &tag, std::size_t expected_size);
+  void StoreFeatures(const RenderKey &key, const std::string &tag, std::span<const float> features,
+                     std::chrono::nanoseconds extract_time);
+
+  Stats GetStats() const;
+  const std::string &Directory() const { return options.directory; }
+
+private:
+  struct Entry {
+    uint64_t size = 0;
+    std::list<std::string>::iterator recency;
+  };
+
+  Options options;
+  mutable std::mutex entries_mutex;
+  std::unordered_map<std::string, Entry> entries; // By path.
+  std::list<std::string> recency;                 // Least recently used first.
+  uint64_t total_bytes = 0;
+  uint64_t unscanned_bytes = 0; // Stored since the last directory scan.
+  std::atomic<uint64_t> temporary_counter{0};
+
+  std::atomic<uint64_t> audio_lookups{0};
+  std::atomic<uint64_t> audio_hits{0};
+  std::atomic<uint64_t> feature_lookups{0};
+  std::atomic<uint64_t> feature_hits{0};
+  std::atomic<uint64_t> stored{0};
+  std::atomic<uint64_t> evicted{0};
+  std::atomic<int64_t> saved_ns{0};
+
+  std::optional<std::vector<uint8_t>> Load(const RenderKey &key, const std::string &tag, EntryKind kind, uint64_t &produce_ns);
+  void Store(const RenderKey &key, const std::string &tag, EntryKind kind, std::span<const uint8_t> payload,
+             std::chrono::nanoseconds produce_time);
+  std::string EntryPath(const RenderKey &key, const std::string &tag) const;
+  void CountSaved(uint64_t produce_ns, std::chrono::steady_clock::time_point lookup_start);
+  void Touch(const std::string &path);
+  void Track(const std::string &path, uint64_t size);
+  bool Rescan();
+  void Evict();
+};
+
+} // namespace instrument
+
+#endif // INSTRUMENT_RENDER_CACHE_H_
@@ -0,0 +1,348 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "instrument/sample_bank.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/midi.h"
+#include "instrument/render_cache.h"
+#include "instrument/string_oscillator.h"
+
+namespace instrument {
+namespace bank {
+
+namespace {
+
+constexpr std::size_t k_bake_block = 4096;
+
+std::size_t AlignUp(std::size_t value, std::size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+struct BakedZone {
+  BankZone zone;
+  std::vector<int16_t> samples;
+};
+
+// Renders one note at full precision and stores it scaled to its own peak, trimmed after its last audible sample.
+void BakeZone(std::vector<oscillator::StringOccilator> &strings, double frequency, double velocity, std::vector<double> &signal,
+              BakedZone &baked) {
+  for (auto &sound_string : strings) {
+    sound_string.PrimeString(frequency, velocity);
+  }
+  std::fill(signal.begin(), signal.end(), 0.0);
+  for (std::size_t first = 0; first < signal.size(); first += k_bake_block) {
+    const std::span<double> block(signal.data() + first, std::min(k_bake_block, signal.size() - first));
+    for (auto &sound_string : strings) {
+      sound_string.AccumulateBlock(block);
+    }
+  }
+  double peak = 0.0;
+  for (const double value : signal) {
+    peak = std::max(peak, std::abs(value));
+  }
+  constexpr double max_int = std::numeric_limits<int16_t>::max();
+  const float scale = peak > 0.0 ? static_cast<float>(peak / max_int) : 1.0F;
+  baked.samples.resize(signal.size());
+  std::size_t frames = 0;
+  for (std::size_t i = 0; i < signal.size(); ++i) {
+    const double quantised = std::clamp(std::round(signal[i] / scale), -max_int, max_int);
+    baked.samples[i] = static_cast<int16_t>(quantised);
+    if (baked.samples[i] != 0) {
+      frames = i + 1;
+    }
+  }
+  baked.samples.resize(frames);
+  baked.zone = {frequency, velocity, 0, static_cast<uint32_t>(frames), scale};
+}
+
+// Catmull-Rom (4-point, third order Hermite) through x0 and x1 at t in [0, 1).
+inline double Hermite(double xm1, double x0, double x1, double x2, double t) {
+  const double c1 = 0.5 * (x1 - xm1);
+  const double c2 = xm1 - 2.5 * x0 + 2.0 * x1 - 0.5 * x2;
+  const double c3 = 0.5 * (x2 - xm1) + 1.5 * (x0 - x1);
+  return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+inline double LayerSample(const SampleBank::Voice::Layer &layer, std::size_t index, double t) {
+  const int16_t *samples = layer.samples;
+  if (index >= 1U && index + 2U < layer.frames) {
+    return layer.gain * Hermite(samples[index - 1], samples[index], samples[index + 1], samples[index + 2], t);
+  }
+  // Zone edges: silence before the first and after the last sample.
+  const auto at = [&layer, samples](std::size_t i) { return i < layer.frames ? static_cast<double>(samples[i]) : 0.0; };
+  const double before = index >= 1U ? at(index - 1) : 0.0;
+  return layer.gain * Hermite(before, at(index), at(index + 1), at(index + 2), t);
+}
+
+} // namespace
+
+void BakeReport::Print(std::ostream &out) const {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  out << "bake: " << zones << " zones, " << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1024.0 * 1024.0)
+      << " MiB, " << static_cast<double>(rendered_samples) / SAMPLE_RATE << " s of audio rendered in " << std::setprecision(2) << seconds
+      << " s\n";
+}
+
+std::array<uint64_t, 2> Fingerprint(const InstrumentModel &instrument) {
+  return RenderKey::Make(instrument, 0.0, 0.0, 0U, SAMPLE_RATE, false).hash;
+}
+
+BakeReport Bake(InstrumentModel &instrument, const std::string &path, const BakeOptions &options) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<double> velocities = options.velocities;
+  std::sort(velocities.begin(), velocities.end());
+  velocities.erase(std::unique(velocities.begin(), velocities.end()), velocities.end());
+  if (velocities.empty() || velocities.front() <= 0.0) {
+    throw std::invalid_argument("Sample bank needs positive velocity layers");
+  }
+  if (options.key_step == 0U || options.lowest_key > options.highest_key || options.highest_key > 127U) {
+    throw std::invalid_argument("Sample bank keys must rise from lowest to highest (at most 127) in non-zero steps");
+  }
+  if (!(options.seconds > 0.0) || options.seconds * SAMPLE_RATE > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("Sample bank length out of range");
+  }
+  std::vector<oscillator::StringOccilator> prototype;
+  for (const auto &record : instrument.ToRecords()) {
+    prototype.push_back(*oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+  if (prototype.empty()) {
+    throw std::invalid_argument("Sample bank needs an instrument with strings");
+  }
+  std::vector<uint8_t> keys;
+  for (unsigned key = options.lowest_key; key <= options.highest_key; key += options.key_step) {
+    keys.push_back(static_cast<uint8_t>(key));
+  }
+
+  const std::size_t layer_count = velocities.size();
+  const auto zone_frames = static_cast<std::size_t>(std::llround(options.seconds * SAMPLE_RATE));
+  std::vector<BakedZone> baked(keys.size() * layer_count);
+  std::atomic<std::size_t> next{0};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  const auto work = [&]() {
+    std::vector<oscillator::StringOccilator> strings = prototype;
+    std::vector<double> signal(zone_frames);
+    for (std::size_t zone = next++; zone < baked.size(); zone = next++) {
+      try {
+        BakeZone(strings, midi::KeyFrequency(keys[zone / layer_count]), velocities[zone % layer_count], signal, baked[zone]);
+      } catch (...) {
+        const std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = baked.size();
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (std::size_t worker = 1; worker < std::min(std::max<std::size_t>(options.threads, 1), baked.size()); ++worker) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  BankFileHeader header;
+  header.key_count = static_cast<uint32_t>(keys.size());
+  header.layer_count = static_cast<uint32_t>(layer_count);
+  header.zone_frames = static_cast<uint32_t>(zone_frames);
+  header.fingerprint = Fingerprint(instrument);
+  header.zones_offset = AlignUp(sizeof(header), k_zone_alignment);
+  header.data_offset = AlignUp(header.zones_offset + baked.size() * sizeof(BankZone), k_zone_alignment);
+  uint64_t offset = header.data_offset;
+  for (auto &[zone, samples] : baked) {
+    zone.offset = offset;
+    offset = AlignUp(offset + samples.size() * sizeof(int16_t), k_zone_alignment);
+  }
+  header.data_size = offset - header.data_offset;
+
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+    const auto pad_to = [&file](uint64_t position) {
+      static constexpr char zeros[k_zone_alignment] = {};
+      const auto padding = static_cast<std::streamsize>(position - static_cast<uint64_t>(file.tellp()));
+      file.write(zeros, padding);
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    pad_to(header.zones_offset);
+    for (const auto &item : baked) {
+      file.write(reinterpret_cast<const char *>(&item.zone), sizeof(BankZone));
+    }
+    for (const auto &[zone, samples] : baked) {
+      pad_to(zone.offset);
+      file.write(reinterpret_cast<const char *>(samples.data()), static_cast<std::streamsize>(samples.size() * sizeof(int16_t)));
+    }
+    pad_to(offset);
+    file.close();
+    if (!file) {
+      std::filesystem::remove(temporary);
+      throw std::runtime_error("Unable to write sample bank: " + temporary);
+    }
+  }
+  std::filesystem::rename(temporary, path);
+
+  BakeReport report;
+  report.zones = baked.size();
+  report.bytes = offset;
+  report.rendered_samples = baked.size() * zone_frames;
+  report.elapsed = std::chrono::steady_clock::now() - start;
+  return report;
+}
+
+SampleBank::SampleBank(const std::string &a_file_name) : file_name(a_file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open sample bank: " + file_name);
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < sizeof(BankFileHeader)) {
+    close(fd);
+    throw std::runtime_error("Sample bank too small: " + file_name);
+  }
+  mapped_size = static_cast<std::size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Unable to map sample bank: " + file_name);
+  }
+  mapped = static_cast<const char *>(address);
+
+  const auto reject = [&](const std::string &reason) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+    throw std::runtime_error(reason + ": " + file_name);
+  };
+  std::memcpy(&header, mapped, sizeof(header));
+  const BankFileHeader expected{};
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != k_version) {
+    reject("Not a version " + std::to_string(k_version) + " sample bank");
+  }
+  const std::size_t zone_count = static_cast<std::size_t>(header.key_count) * header.layer_count;
+  if (zone_count == 0U || header.sample_rate == 0U || header.zones_offset % k_zone_alignment != 0U ||
+      header.zones_offset + zone_count * sizeof(BankZone) > mapped_size || header.data_offset + header.data_size > mapped_size) {
+    reject("Sample bank tables are truncated");
+  }
+  zones = {reinterpret_cast<const BankZone *>(mapped + header.zones_offset), zone_count};
+  for (const auto &zone : zones) {
+    if (zone.offset % alignof(int16_t) != 0U || zone.offset + zone.frames * sizeof(int16_t) > mapped_size || !(zone.frequency > 0.0)) {
+      reject("Sample bank zone is out of range");
+    }
+  }
+}
+
+SampleBank::~SampleBank() {
+  if (mapped != nullptr) {
+    munmap(const_cast<char *>(mapped), mapped_size);
+  }
+}
+
+SampleBank::Voice SampleBank::Start(double frequency, double velocity) const {
+  if (!(frequency > 0.0) || velocity < 0.0) {
+    throw std::invalid_argument("Sample bank notes need a positive frequency and velocity");
+  }
+  const std::size_t layer_count = header.layer_count;
+  // Nearest baked key in pitch, so the shift stays within half a key step.
+  std::size_t key = 0;
+  double nearest = std::numeric_limits<double>::max();
+  for (std::size_t candidate = 0; candidate < header.key_count; ++candidate) {
+    const double distance = std::abs(std::log(frequency / zones[candidate * layer_count].frequency));
+    if (distance < nearest) {
+      nearest = distance;
+      key = candidate;
+    }
+  }
+  const auto key_zones = zones.subspan(key * layer_count, layer_count);
+  const auto layer = [this](const BankZone &zone, double gain) {
+    return Voice::Layer{reinterpret_cast<const int16_t *>(mapped + zone.offset), zone.frames, gain * zone.scale};
+  };
+
+  Voice voice;
+  voice.step = frequency / key_zones[0].frequency * header.sample_rate / SAMPLE_RATE;
+  const auto upper = std::find_if(key_zones.begin(), key_zones.end(), [velocity](const BankZone &zone) { return zone.velocity >= velocity; });
+  if (upper == key_zones.begin() || upper == key_zones.end()) {
+    // Outside the baked layers the nearest one is scaled. This is exact only while StringOccilator::PrimeString
+    // keeps max_amplitude = velocity * amplitude_factor, which makes the audio linear in velocity.
+    const BankZone &zone = upper == key_zones.end() ? key_zones.back() : key_zones.front();
+    voice.layers[0] = layer(zone, velocity / zone.velocity);
+  } else {
+    const BankZone &lower = *(upper - 1);
+    const double weight = (velocity - lower.velocity) / (upper->velocity - lower.velocity);
+    voice.layers[0] = layer(lower, 1.0 - weight);
+    voice.layers[1] = layer(*upper, weight);
+  }
+  return voice;
+}
+
+std::size_t SampleBank::Render(Voice &voice, std::span<double> out) const {
+  const std::size_t end = std::max(voice.layers[0].frames, voice.layers[1].frames);
+  std::size_t rendered = 0;
+  for (; rendered < out.size(); ++rendered) {
+    const double whole = std::floor(voice.position);
+    const auto index = static_cast<std::size_t>(whole);
+    if (index >= end) {
+      break;
+    }
+    const double t = voice.position - whole;
+    double value = LayerSample(voice.layers[0], index, t);
+    if (voice.layers[1].frames != 0U) {
+      value += LayerSample(voice.layers[1], index, t);
+    }
+    out[rendered] += value;
+    voice.position += voice.step;
+  }
+  return rendered;
+}
+
+std::size_t SampleBank::GenerateIntSignal(double velocity, double frequency, std::span<int16_t> out, bool &has_distorted_out,
+                                          bool return_on_distort) const {
+  has_distorted_out = false;
+  Voice voice = Start(frequency, velocity);
+  std::array<double, 1024> block;
+  constexpr double max_int = std::numeric_limits<int16_t>::max();
+  for (std::size_t first = 0; first < out.size(); first += block.size()) {
+    const std::size_t count = std::min(block.size(), out.size() - first);
+    block.fill(0.0);
+    Render(voice, std::span<double>(block.data(), count));
+    for (std::size_t i = 0; i < count; ++i) {
+      double sample_val = block[i];
+      if (sample_val > 1.0 || sample_val < -1.0) {
+        sample_val = std::clamp(sample_val, -1.0, 1.0);
+        has_distorted_out = true;
+        if (return_on_distort) {
+          return first + i;
+        }
+      }
+      out[first + i] = static_cast<int16_t>(max_int * sample_val);
+    }
+  }
+  return out.size();
+}
+
+} // namespace bank
+} // namespace instrument
@@ -0,0 +1,165 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * sample_bank.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INSTRUMENT_SAMPLE_BANK_H_
+#define INSTRUMENT_SAMPLE_BANK_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "include/common.h"
+#include "instrument/instrument_model.h"
+
+/** Sample bank format (.slbk, all integers little endian)
+      Offset 0       BankFileHeader.
+      zones_offset   key_count x layer_count BankZone, key major: zone
+                     key * layer_count + layer. Keys rise in pitch and every
+                     key has the same velocity layers, rising in velocity.
+      data_offset    int16 samples of every zone, each zone starting on a
+                     64 byte boundary. A zone stops at its last non-zero
+                     sample; its value is sample * scale.
+    The instrument fingerprint is the hash of its RenderKey at zero note, so a
+    bank can tell whether it was baked from a given instrument.
+*/
+namespace instrument {
+namespace bank {
+
+constexpr uint32_t k_version = 1;
+constexpr std::size_t k_zone_alignment = 64;
+
+#pragma pack(push, 1)
+
+struct BankFileHeader {
+  char magic[4] = {'S', 'L', 'B', 'K'};
+  uint32_t version = k_version;
+  uint32_t sample_rate = SAMPLE_RATE;
+  uint32_t key_count = 0;
+  uint32_t layer_count = 0;
+  uint32_t zone_frames = 0; // Baked length; trimmed zones are shorter.
+  std::array<uint64_t, 2> fingerprint = {};
+  uint64_t zones_offset = 0;
+  uint64_t data_offset = 0;
+  uint64_t data_size = 0;
+};
+
+struct BankZone {
+  double frequency = 0.0; // The baked note.
+  double velocity = 0.0;
+  uint64_t offset = 0; // Absolute.
+  uint32_t frames = 0;
+  float scale = 0.0F;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(BankFileHeader) == 64, "Sample bank header layout is part of the file format");
+static_assert(sizeof(BankZone) == 32, "Sample bank zone layout is part of the file format");
+
+struct BakeOptions {
+  uint8_t lowest_key = 21;  // MIDI keys; A0 to C8 covers a piano.
+  uint8_t highest_key = 108;
+  uint8_t key_step = 3; // Semitones between baked keys; playback shifts at most half of it.
+  // Velocity layers, as player -v / 100. The oscillators scale linearly with
+  // velocity, so one layer scaled at playback is exact for them.
+  std::vector<double> velocities = {1.0};
+  double seconds = 4.0;
+  std::size_t threads = 1;
+};
+
+struct BakeReport {
+  std::size_t zones = 0;
+  uint64_t bytes = 0;
+  uint64_t rendered_samples = 0;
+  std::chrono::nanoseconds elapsed{0};
+
+  void Print(std::ostream &out) const;
+};
+
+/*
+ * Renders every key and velocity layer with the block oscillator path and
+ * writes the bank through a temporary file renamed over path. Throws
+ * std::invalid_argument on bad options, std::runtime_error when the file
+ * cannot be written.
+ * @parameters instrument, output path, options
+ * @returns what was baked
+ */
+BakeReport Bake(InstrumentModel &instrument, const std::string &path, const BakeOptions &options);
+
+// The fingerprint a bank of this instrument carries.
+std::array<uint64_t, 2> Fingerprint(const InstrumentModel &instrument);
+
+/*
+ * A memory-mapped sample bank. A note plays the zone nearest in pitch,
+ * resampled with 4-point Hermite interpolation, crossfading the two velocity
+ * layers around its velocity. Const and thread safe; voices hold the state.
+ */
+class SampleBank {
+public:
+  struct Voice {
+    struct Layer {
+      const int16_t *samples = nullptr;
+      std::size_t frames = 0;
+      double gain = 0.0; // Zone scale times crossfade weight.
+    };
+    std::array<Layer, 2> layers;
+    double position = 0.0; // In zone frames.
+    double step = 1.0;     // Zone frames per output sample.
+
+    bool Finished() const { return position >= static_cast<double>(std::max(layers[0].frames, layers[1].frames)); }
+  };
+
+  // Throws std::runtime_error when the file cannot be mapped or is not a bank.
+  explicit SampleBank(const std::string &file_name);
+  ~SampleBank();
+  SampleBank(const SampleBank &) = delete;
+  SampleBank &operator=(const SampleBank &) = delete;
+
+  const BankFileHeader &Header() const { return header; }
+  std::span<const BankZone> Zones() const { return zones; }
+  bool Matches(const InstrumentModel &instrument) const { return header.fingerprint == Fingerprint(instrument); }
+
+  Voice Start(double frequency, double velocity) const;
+  /*
+   * Adds the voice's next samples to out.
+   * @parameters voice, out (accumulated into)
+   * @returns samples added; fewer than out.size() once the voice has ended
+   */
+  std::size_t Render(Voice &voice, std::span<double> out) const;
+  /*
+   * One note converted as InstrumentModel::GenerateIntSignal converts it;
+   * samples past the end of the zone are zero.
+   * @parameters velocity, frequency, out, has_distorted_out, return_on_distort
+   * @returns samples rendered
+   */
+  std::size_t GenerateIntSignal(double velocity, double frequency, std::span<int16_t> out, bool &has_distorted_out,
+                                bool return_on_distort = true) const;
+
+private:
+  std::string file_name;
+  BankFileHeader header;
+  const char *mapped = nullptr;
+  std::size_t mapped_size = 0;
+  std::span<const BankZone> zones;
+};
+
+} // namespace bank
+} // namespace instrument
+
+#endif // INSTRUMENT_SAMPLE_BANK_H_
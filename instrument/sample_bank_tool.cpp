@@ -0,0 +1,321 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * sample_bank_tool.cpp
+ *  Created on: 19 Oct 2026
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dsp/fft.h"
+#include "include/common.h"
+#include "instrument/instrument_model.h"
+#include "instrument/sample_bank.h"
+#include "instrument/string_oscillator.h"
+
+static void AppUsage() {
+  std::cerr << "Usage: sample_bank <bake|info|compare> <instrument or bank> [options]\n"
+            << "  bake     render the instrument over a grid of keys and velocities into a .slbk bank\n"
+            << "  info     print the bank header\n"
+            << "  compare  CPU per voice and spectral error of the bank against live rendering\n"
+            << "-h --help\n"
+            << "-o --output <file> (bake; default <instrument>.slbk)\n"
+            << "--low <21> --high <108> --step <3> (bake; MIDI keys and semitones between baked keys)\n"
+            << "--layers <1.0> (bake; comma separated velocity layers, as -v / 100)\n"
+            << "--seconds <4> (bake; zone length, compare; note length)\n"
+            << "-j --threads <hardware threads> (bake)\n"
+            << "--bank <file> (compare; default <instrument>.slbk)\n"
+            << "--notes <16> (compare; notes spread over the bank's range)\n"
+            << "-v --velocity <100> (compare)\n"
+            << std::endl;
+}
+
+static bool ParseSize(std::string_view source, std::size_t &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static bool ParseDouble(std::string_view source, double &out) {
+  const auto result = std::from_chars(source.data(), source.data() + source.size(), out);
+  return result.ec == std::errc{} && result.ptr == source.data() + source.size();
+}
+
+static bool ParseKey(std::string_view source, uint8_t &out) {
+  std::size_t key = 0;
+  if (!ParseSize(source, key) || key > 127U) {
+    return false;
+  }
+  out = static_cast<uint8_t>(key);
+  return true;
+}
+
+static bool ParseLayers(std::string_view source, std::vector<double> &out) {
+  out.clear();
+  while (!source.empty()) {
+    const std::size_t comma = std::min(source.find(','), source.size());
+    double velocity = 0.0;
+    if (!ParseDouble(source.substr(0, comma), velocity) || velocity <= 0.0) {
+      return false;
+    }
+    out.push_back(velocity);
+    source.remove_prefix(std::min(comma + 1, source.size()));
+  }
+  return !out.empty();
+}
+
+static void PrintInfo(const instrument::bank::SampleBank &bank) {
+  const auto &header = bank.Header();
+  const auto zones = bank.Zones();
+  std::cout << header.key_count << " keys x " << header.layer_count << " layers, " << header.sample_rate << " Hz, " << std::fixed
+            << std::setprecision(2) << static_cast<double>(header.zone_frames) / header.sample_rate << " s zones, "
+            << std::setprecision(1) << static_cast<double>(header.data_size) / (1024.0 * 1024.0) << " MiB of samples\n"
+            << "keys " << zones.front().frequency << " Hz to " << zones.back().frequency << " Hz, layers";
+  for (std::size_t layer = 0; layer < header.layer_count; ++layer) {
+    std::cout << " " << std::setprecision(2) << zones[layer].velocity;
+  }
+  std::cout << std::endl;
+}
+
+struct SpectralError {
+  double convergence = 0.0;     // ||live| - |bank||| / ||live|| over the spectrogram.
+  double log_distance_db = 0.0; // RMS dB difference per frame, averaged; bins below -100 dB of the peak are floored.
+};
+
+// Hann-windowed spectrograms, 2048-sample frames every 512 samples.
+static SpectralError CompareSpectra(const std::vector<double> &live, const std::vector<double> &baked) {
+  constexpr std::size_t frame = 2048;
+  constexpr std::size_t hop = 512;
+  const auto plan = dsp::GetRealPlan(frame);
+  std::vector<double> window(frame);
+  for (std::size_t i = 0; i < frame; ++i) {
+    window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * static_cast<double>(i) / static_cast<double>(frame));
+  }
+  const auto spectrogram = [&](const std::vector<double> &signal) {
+    std::vector<double> input(frame);
+    std::vector<dsp::Complex> spectrum(plan->SpectrumSize());
+    std::vector<double> magnitudes;
+    for (std::size_t first = 0; first + frame <= signal.size(); first += hop) {
+      for (std::size_t i = 0; i < frame; ++i) {
+        input[i] = signal[first + i] * window[i];
+      }
+      plan->Forward(input, spectrum);
+      for (const auto &bin : spectrum) {
+        magnitudes.push_back(std::abs(bin));
+      }
+    }
+    return magnitudes;
+  };
+  const auto live_magnitudes = spectrogram(live);
+  const auto bank_magnitudes = spectrogram(baked);
+  SpectralError error;
+  if (live_magnitudes.empty()) {
+    return error;
+  }
+  const double floor = 1e-5 * *std::max_element(live_magnitudes.begin(), live_magnitudes.end()) + 1e-12;
+  double difference = 0.0;
+  double energy = 0.0;
+  double distance = 0.0;
+  const std::size_t bins = plan->SpectrumSize();
+  const std::size_t frames = live_magnitudes.size() / bins;
+  for (std::size_t f = 0; f < frames; ++f) {
+    double frame_distance = 0.0;
+    for (std::size_t b = f * bins; b < (f + 1) * bins; ++b) {
+      const double delta = live_magnitudes[b] - bank_magnitudes[b];
+      difference += delta * delta;
+      energy += live_magnitudes[b] * live_magnitudes[b];
+      const double decibels = 20.0 * std::log10((live_magnitudes[b] + floor) / (bank_magnitudes[b] + floor));
+      frame_distance += decibels * decibels;
+    }
+    distance += std::sqrt(frame_distance / static_cast<double>(bins));
+  }
+  error.convergence = energy > 0.0 ? std::sqrt(difference / energy) : 0.0;
+  error.log_distance_db = distance / static_cast<double>(frames);
+  return error;
+}
+
+static double Seconds(std::chrono::steady_clock::duration duration) { return std::chrono::duration<double>(duration).count(); }
+
+static void Compare(instrument::InstrumentModel &model, const instrument::bank::SampleBank &bank, std::size_t notes, double velocity,
+                    double seconds) {
+  if (!bank.Matches(model)) {
+    std::cerr << "warning: the bank was not baked from this instrument" << std::endl;
+  }
+  std::vector<instrument::oscillator::StringOccilator> strings;
+  for (const auto &record : model.ToRecords()) {
+    strings.push_back(*instrument::oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+  const auto zones = bank.Zones();
+  const double lowest = zones.front().frequency;
+  const double highest = zones.back().frequency;
+  const auto length = static_cast<std::size_t>(std::llround(seconds * SAMPLE_RATE));
+  constexpr std::size_t block = 1024;
+  std::vector<double> live(length);
+  std::vector<double> baked(length);
+  double live_seconds = 0.0;
+  double bank_seconds = 0.0;
+  double convergence_sum = 0.0;
+  double convergence_max = 0.0;
+  double distance_sum = 0.0;
+  double distance_max = 0.0;
+  std::cout << "note_hz,shift_cents,live_ns_per_sample,bank_ns_per_sample,spectral_convergence,log_spectral_distance_db\n";
+  for (std::size_t note = 0; note < notes; ++note) {
+    // Spread evenly in pitch, so most notes fall between baked keys.
+    const double position = notes > 1U ? static_cast<double>(note) / static_cast<double>(notes - 1U) : 0.5;
+    const double frequency = lowest * std::pow(highest / lowest, position);
+
+    std::fill(live.begin(), live.end(), 0.0);
+    auto start = std::chrono::steady_clock::now();
+    for (auto &sound_string : strings) {
+      sound_string.PrimeString(frequency, velocity);
+    }
+    for (std::size_t first = 0; first < length; first += block) {
+      const std::span<double> out(live.data() + first, std::min(block, length - first));
+      for (auto &sound_string : strings) {
+        sound_string.AccumulateBlock(out);
+      }
+    }
+    const double live_time = Seconds(std::chrono::steady_clock::now() - start);
+
+    std::fill(baked.begin(), baked.end(), 0.0);
+    start = std::chrono::steady_clock::now();
+    auto voice = bank.Start(frequency, velocity);
+    for (std::size_t first = 0; first < length && !voice.Finished(); first += block) {
+      bank.Render(voice, std::span<double>(baked.data() + first, std::min(block, length - first)));
+    }
+    const double bank_time = Seconds(std::chrono::steady_clock::now() - start);
+
+    const auto error = CompareSpectra(live, baked);
+    const double shift_cents = 1200.0 * std::log2(voice.step);
+    std::cout << std::fixed << std::setprecision(2) << frequency << "," << shift_cents << "," << live_time * 1e9 / static_cast<double>(length)
+              << "," << bank_time * 1e9 / static_cast<double>(length) << "," << std::setprecision(4) << error.convergence << ","
+              << std::setprecision(2) << error.log_distance_db << "\n";
+    live_seconds += live_time;
+    bank_seconds += bank_time;
+    convergence_sum += error.convergence;
+    convergence_max = std::max(convergence_max, error.convergence);
+    distance_sum += error.log_distance_db;
+    distance_max = std::max(distance_max, error.log_distance_db);
+  }
+  const double samples = static_cast<double>(length * notes);
+  const double live_ns = live_seconds * 1e9 / samples;
+  const double bank_ns = bank_seconds * 1e9 / samples;
+  const auto real_time_voices = [](double ns) { return ns > 0.0 ? 1e9 / (ns * SAMPLE_RATE) : 0.0; };
+  std::cout << std::fixed << std::setprecision(1) << "live: " << live_ns << " ns per voice-sample (" << strings.size() << " strings), "
+            << std::setprecision(0) << real_time_voices(live_ns) << " voices in real time per core\n"
+            << std::setprecision(1) << "bank: " << bank_ns << " ns per voice-sample, " << std::setprecision(0) << real_time_voices(bank_ns)
+            << " voices in real time per core, " << std::setprecision(1) << (bank_ns > 0.0 ? live_ns / bank_ns : 0.0) << "x cheaper\n"
+            << std::setprecision(4) << "spectral convergence mean " << convergence_sum / static_cast<double>(notes) << ", max "
+            << convergence_max << std::setprecision(2) << "; log spectral distance mean " << distance_sum / static_cast<double>(notes)
+            << " dB, max " << distance_max << " dB" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string command;
+  std::string source;
+  std::string output;
+  std::string bank_file;
+  instrument::bank::BakeOptions options;
+  options.threads = std::max(1U, std::thread::hardware_concurrency());
+  bool seconds_given = false;
+  std::size_t notes = 16;
+  double velocity = 1.0;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      AppUsage();
+      return EXIT_NORMAL;
+    }
+    bool parsed = true;
+    if (((arg == "-o") || (arg == "--output")) && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "--low" && i + 1 < argc) {
+      parsed = ParseKey(argv[++i], options.lowest_key);
+    } else if (arg == "--high" && i + 1 < argc) {
+      parsed = ParseKey(argv[++i], options.highest_key);
+    } else if (arg == "--step" && i + 1 < argc) {
+      parsed = ParseKey(argv[++i], options.key_step) && options.key_step > 0U;
+    } else if (arg == "--layers" && i + 1 < argc) {
+      parsed = ParseLayers(argv[++i], options.velocities);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      parsed = ParseDouble(argv[++i], options.seconds) && options.seconds > 0.0;
+      seconds_given = true;
+    } else if (((arg == "-j") || (arg == "--threads")) && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], options.threads) && options.threads > 0U;
+    } else if (arg == "--bank" && i + 1 < argc) {
+      bank_file = argv[++i];
+    } else if (arg == "--notes" && i + 1 < argc) {
+      parsed = ParseSize(argv[++i], notes) && notes > 0U;
+    } else if (((arg == "-v") || (arg == "--velocity")) && i + 1 < argc) {
+      std::size_t percent = 0;
+      parsed = ParseSize(argv[++i], percent) && percent <= 255U;
+      velocity = static_cast<double>(percent) / 100.0;
+    } else if (arg.starts_with("-")) {
+      parsed = false;
+    } else if (command.empty()) {
+      command = arg;
+    } else if (source.empty()) {
+      source = arg;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      std::cerr << "Invalid option: " << arg << std::endl;
+      AppUsage();
+      return EXIT_BAD_ARGS;
+    }
+  }
+  if (source.empty() || (command != "bake" && command != "info" && command != "compare")) {
+    AppUsage();
+    return EXIT_BAD_ARGS;
+  }
+
+  try {
+    if (command == "info") {
+      PrintInfo(instrument::bank::SampleBank(source));
+      return EXIT_NORMAL;
+    }
+    auto model = instrument::InstrumentModel::Load(source);
+    if (command == "bake") {
+      if (output.empty()) {
+        output = source + ".slbk";
+      }
+      instrument::bank::BakeReport report;
+      try {
+        report = instrument::bank::Bake(model, output, options);
+      } catch (const std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+        return EXIT_WRITE_FILE_FAILED;
+      }
+      std::cout << output << ": ";
+      report.Print(std::cout);
+      return EXIT_NORMAL;
+    }
+    if (bank_file.empty()) {
+      bank_file = source + ".slbk";
+    }
+    Compare(model, instrument::bank::SampleBank(bank_file), notes, velocity, seconds_given ? options.seconds : 2.0);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_BAD_ARGS;
+  } catch (const std::exception &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
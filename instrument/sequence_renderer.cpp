@@ -0,0 +1,233 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "instrument/sequence_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace instrument {
+
+namespace {
+constexpr uint8_t k_percussion_channel = 9;
+constexpr double k_release_floor = 1e-4; // -80 dB; a releasing voice is freed below it.
+} // namespace
+
+void SequenceRenderer::Stats::Print(std::ostream &out) const {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  const double audio_seconds = static_cast<double>(samples) / SAMPLE_RATE;
+  out << "sequence: " << notes << " notes, " << std::fixed << std::setprecision(2) << audio_seconds << " s of audio in " << seconds << " s ("
+      << std::setprecision(1) << (seconds > 0.0 ? audio_seconds / seconds : 0.0) << "x real time), polyphony " << max_polyphony << ", stolen "
+      << stolen << ", " << std::setprecision(2) << (samples == 0U ? 0.0 : static_cast<double>(string_samples) / static_cast<double>(samples))
+      << " strings per sample, gain " << std::setprecision(3) << gain << ", peak " << peak << ", limited " << limited << ", clipped "
+      << clipped << "\n";
+}
+
+SequenceRenderer::SequenceRenderer(std::span<const InstrumentStringRecord> records, const Options &a_options) : options(a_options) {
+  if (records.empty()) {
+    throw std::invalid_argument("Sequence renderer needs an instrument with strings");
+  }
+  if (options.voices == 0U || options.block_size == 0U || options.release_seconds <= 0.0) {
+    throw std::invalid_argument("Sequence renderer needs voices, a block size and a release time");
+  }
+  if (options.gain < 0.0 || options.limiter_release_seconds <= 0.0) {
+    throw std::invalid_argument("Sequence renderer needs a non-negative gain and a limiter release time");
+  }
+  release_step = std::pow(k_release_floor, 1.0 / (options.release_seconds * SAMPLE_RATE));
+  mix_gain = options.gain > 0.0 ? options.gain : 1.0 / std::sqrt(static_cast<double>(options.voices));
+  limiter_step = std::exp(-1.0 / (options.limiter_release_seconds * SAMPLE_RATE));
+  string_silence = options.silence / static_cast<double>(records.size());
+  std::vector<oscillator::StringOccilator> strings;
+  strings.reserve(records.size());
+  for (const auto &record : records) {
+    strings.push_back(*oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+  voices.resize(options.voices);
+  for (auto &voice : voices) {
+    voice.strings = strings;
+    voice.live.reserve(strings.size());
+  }
+  mix.resize(options.block_size);
+  voice_mix.resize(options.block_size);
+  pcm.resize(options.block_size);
+}
+
+void SequenceRenderer::NoteOn(const midi::Event &event, uint64_t now, Stats &stats) {
+  // Striking a key that is still sounding releases the earlier note, as a piano damper would.
+  for (auto &voice : voices) {
+    if (voice.state != VoiceState::free && voice.state != VoiceState::releasing && voice.channel == event.channel && voice.key == event.key) {
+      voice.state = VoiceState::releasing;
+    }
+  }
+  auto chosen = std::find_if(voices.begin(), voices.end(), [](const Voice &voice) { return voice.state == VoiceState::free; });
+  if (chosen == voices.end()) {
+    chosen = std::min_element(voices.begin(), voices.end(), [](const Voice &a, const Voice &b) {
+      const bool a_releasing = a.state == VoiceState::releasing;
+      const bool b_releasing = b.state == VoiceState::releasing;
+      if (a_releasing != b_releasing) {
+        return a_releasing;
+      }
+      return a_releasing ? a.gain < b.gain : a.started < b.started;
+    });
+    ++stats.stolen;
+  }
+  Voice &voice = *chosen;
+  const double frequency = midi::KeyFrequency(event.key);
+  const double velocity = options.velocity * event.velocity / 127.0;
+  voice.live.clear();
+  for (uint32_t i = 0; i < voice.strings.size(); ++i) {
+    voice.strings[i].PrimeString(frequency, velocity);
+    voice.live.push_back(i); // Within the reserved capacity.
+  }
+  voice.state = VoiceState::held;
+  voice.channel = event.channel;
+  voice.key = event.key;
+  voice.gain = 1.0;
+  voice.started = now;
+  ++stats.notes;
+}
+
+void SequenceRenderer::NoteOff(const midi::Event &event) {
+  for (auto &voice : voices) {
+    if (voice.state == VoiceState::held && voice.channel == event.channel && voice.key == event.key) {
+      voice.state = sustain[event.channel] ? VoiceState::sustained : VoiceState::releasing;
+    }
+  }
+}
+
+void SequenceRenderer::SustainOff(uint8_t channel) {
+  sustain[channel] = false;
+  for (auto &voice : voices) {
+    if (voice.state == VoiceState::sustained && voice.channel == channel) {
+      voice.state = VoiceState::releasing;
+    }
+  }
+}
+
+void SequenceRenderer::Mix(std::size_t count, Stats &stats) {
+  const std::span<double> block(mix.data(), count);
+  std::fill(block.begin(), block.end(), 0.0);
+  std::size_t sounding = 0;
+  for (auto &voice : voices) {
+    if (voice.state == VoiceState::free) {
+      continue;
+    }
+    ++sounding;
+    const std::span<double> own(voice_mix.data(), count);
+    std::fill(own.begin(), own.end(), 0.0);
+    for (std::size_t i = 0; i < voice.live.size();) {
+      auto &sound_string = voice.strings[voice.live[i]];
+      const double amplitude = sound_string.AccumulateBlock(own);
+      if (sound_string.IsDecaying() && amplitude < string_silence) {
+        voice.live[i] = voice.live.back();
+        voice.live.pop_back();
+      } else {
+        ++i;
+      }
+    }
+    stats.string_samples += voice.live.size() * count;
+    if (voice.state == VoiceState::releasing) {
+      double gain = voice.gain;
+      for (std::size_t i = 0; i < count; ++i) {
+        block[i] += gain * own[i];
+        gain *= release_step;
+      }
+      voice.gain = gain;
+    } else {
+      for (std::size_t i = 0; i < count; ++i) {
+        block[i] += own[i];
+      }
+    }
+    if (voice.live.empty() || voice.gain < k_release_floor) {
+      voice.state = VoiceState::free;
+    }
+  }
+  stats.max_polyphony = std::max(stats.max_polyphony, sounding);
+
+  // The same conversion as InstrumentModel::GenerateIntSignal, limiting or counting clipped samples instead of stopping.
+  constexpr double max_int = std::numeric_limits<int16_t>::max();
+  for (std::size_t i = 0; i < count; ++i) {
+    double sample = mix_gain * block[i];
+    stats.peak = std::max(stats.peak, std::abs(sample));
+    if (options.limit) {
+      // The envelope jumps to any peak above full scale and decays back to 1, so sample / envelope never clips.
+      limiter_envelope = std::max(std::abs(sample), 1.0 + (limiter_envelope - 1.0) * limiter_step);
+      stats.limited += std::abs(sample) > 1.0 ? 1U : 0U;
+      sample /= limiter_envelope;
+    } else if (sample > 1.0 || sample < -1.0) {
+      ++stats.clipped;
+      sample = std::clamp(sample, -1.0, 1.0);
+    }
+    pcm[i] = static_cast<int16_t>(max_int * sample);
+  }
+}
+
+SequenceRenderer::Stats SequenceRenderer::Render(const midi::Sequence &sequence, filewriter::wave::MonoStreamWriter &writer) {
+  const auto start = std::chrono::steady_clock::now();
+  Stats stats;
+  stats.gain = mix_gain;
+  limiter_envelope = 1.0;
+  for (auto &voice : voices) {
+    voice.state = VoiceState::free;
+  }
+  sustain.fill(false);
+  uint64_t now = 0;
+  std::size_t next = 0;
+  const auto &events = sequence.events;
+  const auto any_sounding = [this]() {
+    return std::any_of(voices.begin(), voices.end(), [](const Voice &voice) { return voice.state != VoiceState::free; });
+  };
+  while (next < events.size() || any_sounding()) {
+    for (; next < events.size() && events[next].sample <= now; ++next) {
+      const auto &event = events[next];
+      if (options.skip_percussion && event.channel == k_percussion_channel) {
+        continue;
+      }
+      switch (event.kind) {
+      case midi::EventKind::note_on:
+        NoteOn(event, now, stats);
+        break;
+      case midi::EventKind::note_off:
+        NoteOff(event);
+        break;
+      case midi::EventKind::sustain_on:
+        sustain[event.channel] = true;
+        break;
+      case midi::EventKind::sustain_off:
+        SustainOff(event.channel);
+        break;
+      }
+    }
+    if (next == events.size()) {
+      // The piece is over: let everything still held or pedalled fade out.
+      for (auto &voice : voices) {
+        if (voice.state == VoiceState::held || voice.state == VoiceState::sustained) {
+          voice.state = VoiceState::releasing;
+        }
+      }
+    }
+    // Blocks end at the next event so notes start on their exact sample.
+    std::size_t count = options.block_size;
+    if (next < events.size()) {
+      count = static_cast<std::size_t>(std::min<uint64_t>(count, events[next].sample - now));
+    }
+    Mix(count, stats);
+    writer.Append(std::span<const int16_t>(pcm.data(), count));
+    now += count;
+  }
+  stats.samples = now;
+  stats.elapsed = std::chrono::steady_clock::now() - start;
+  return stats;
+}
+
+} // namespace instrument
@@ -0,0 +1,113 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * sequence_renderer.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef INSTRUMENT_SEQUENCE_RENDERER_H_
+#define INSTRUMENT_SEQUENCE_RENDERER_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "include/filewriter.h"
+#include "include/midi.h"
+#include "include/structures.h"
+#include "instrument/string_oscillator.h"
+
+namespace instrument {
+
+/*
+ * Plays a MIDI sequence on one instrument. Every voice is a full set of the
+ * instrument's strings, primed for its key as InstrumentModel primes a single
+ * note, and rendered a block at a time with StringOccilator::AccumulateBlock.
+ * A string is dropped from its voice once it decays below the silence level;
+ * a released voice fades out over release_seconds. The mix is scaled by gain
+ * and then peak limited, so overlapping notes do not hard-clip. Voices, mix and
+ * output buffers are allocated up front, so the render loop allocates nothing.
+ */
+class SequenceRenderer {
+public:
+  struct Options {
+    std::size_t voices = 32; // Polyphony; a new note beyond it steals the quietest releasing or else the oldest voice.
+    std::size_t block_size = 256;
+    double velocity = 1.0;         // Scales MIDI velocity / 127, as player -v scales a single note.
+    double release_seconds = 0.25; // Fade after note off, or pedal up for a sustained note.
+    double silence = 0.5 / 32767.0; // Half an output step, split over a voice's strings.
+    bool skip_percussion = true;    // MIDI channel 10.
+    double gain = 0.0;              // Mix gain; 0 picks 1 / sqrt(voices), headroom for voices summing as noise.
+    bool limit = true;              // Peak limiter past full scale (instant attack, limiter_release_seconds); else hard clip.
+    double limiter_release_seconds = 0.05;
+  };
+
+  struct Stats {
+    std::size_t notes = 0;
+    std::size_t stolen = 0;
+    std::size_t max_polyphony = 0;
+    uint64_t samples = 0;
+    uint64_t clipped = 0;
+    uint64_t limited = 0; // Samples past full scale that the limiter caught.
+    double gain = 0.0;    // Applied to the mix.
+    double peak = 0.0;    // After gain, before the limiter.
+    uint64_t string_samples = 0; // Oscillator samples rendered; culled strings cost nothing.
+    std::chrono::nanoseconds elapsed{0};
+
+    void Print(std::ostream &out) const;
+  };
+
+  // Throws std::invalid_argument when the instrument has no strings or an option is zero.
+  SequenceRenderer(std::span<const InstrumentStringRecord> records, const Options &a_options);
+
+  /*
+   * Renders the sequence and appends it to writer a block at a time, ending
+   * once the last note has faded after the final event.
+   * @parameters sequence (at the writer's sample rate), writer
+   * @returns stats for the render
+   */
+  Stats Render(const midi::Sequence &sequence, filewriter::wave::MonoStreamWriter &writer);
+
+private:
+  enum class VoiceState { free, held, sustained, releasing };
+  struct Voice {
+    std::vector<oscillator::StringOccilator> strings;
+    std::vector<uint32_t> live; // Indices of strings still audible.
+    VoiceState state = VoiceState::free;
+    uint8_t channel = 0;
+    uint8_t key = 0;
+    double gain = 1.0;
+    uint64_t started = 0;
+  };
+
+  Options options;
+  double release_step;
+  double string_silence;
+  double mix_gain;
+  double limiter_step;
+  double limiter_envelope = 1.0;
+  std::vector<Voice> voices;
+  std::vector<double> mix;
+  std::vector<double> voice_mix;
+  std::vector<int16_t> pcm;
+  std::array<bool, 16> sustain{};
+
+  void NoteOn(const midi::Event &event, uint64_t now, Stats &stats);
+  void NoteOff(const midi::Event &event);
+  void SustainOff(uint8_t channel);
+  void Mix(std::size_t count, Stats &stats);
+};
+
+} // namespace instrument
+
+#endif // INSTRUMENT_SEQUENCE_RENDERER_H_
@@ -16,9 +16,11 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <cmath>
 #include <iostream>
 #include <random>
-#include <sstream>
+#include <stdexcept>
 #include <vector>
 namespace instrument {
 namespace oscillator {
@@ -49,6 +51,48 @@ double QuantizedFrequencyFactor(double normalized_factor, const std::array<doubl
   return anchors[anchor_index] * detune;
 }
 
+// Seeded once per thread: a per-string engine made every parsed or copied string pay for a random_device read.
+std::mt19937 &MutationEngine() {
+  thread_local std::mt19937 engine(std::random_device{}());
+  return engine;
+}
+
+// std::to_string(double) is "%f": fixed notation, six decimals.
+void AppendFixed(std::string &out, double value) {
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6);
+  out.append(buffer, result.ptr);
+}
+
+// Like std::stod: leading blanks and a '+' are skipped, trailing text is ignored.
+double ParseCsvField(std::string_view field) {
+  const auto first = field.find_first_not_of(" \t");
+  field.remove_prefix(std::min(first, field.size()));
+  if (!field.empty() && field.front() == '+') {
+    field.remove_prefix(1);
+  }
+  double value = 0.0;
+  const auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+  if (result.ec != std::errc{}) {
+    throw std::invalid_argument("Malformed oscillator CSV field: " + std::string(field));
+  }
+  return value;
+}
+
+// sin(2 * pi * cycles) for |cycles| < 2^51: reduce to a quarter wave, then the odd Taylor series through x^13
+// (error under 7e-10). Adding and subtracting 1.5 * 2^52 rounds to the nearest integer without a libm call, so
+// loops over this vectorise.
+inline double SineOfCycles(double cycles) {
+  constexpr double k_round = 6755399441055744.0;
+  const double x = cycles - ((cycles + k_round) - k_round);          // [-0.5, 0.5]
+  const double folded = std::copysign(0.25 - std::abs(std::abs(x) - 0.25), x); // sin(pi - a) = sin(a)
+  const double a = folded * (2.0 * M_PI);
+  const double a2 = a * a;
+  return a * (1.0 + a2 * (-1.0 / 6.0 +
+                          a2 * (1.0 / 120.0 +
+                                a2 * (-1.0 / 5040.0 + a2 * (1.0 / 362880.0 + a2 * (-1.0 / 39916800.0 + a2 * (1.0 / 6227020800.0)))))));
+}
+
 double StructuredFrequencyFactor(double normalized_factor, bool is_coupled) {
   if (is_coupled) {
     return QuantizedFrequencyFactor(normalized_factor, kFrequencyAnchors, k_coupled_detune_ratio);
@@ -62,7 +106,7 @@ StringOccilator::StringOccilator(double initial_phase, double frequency_factor,
     : phase_factor(std::clamp(initial_phase, 0.0, 1.0)), start_frequency_factor(std::clamp(frequency_factor, 0.0, 1.0)),
       start_amplitude_factor(std::clamp(amplitude_factor, 0.0, 1.0)), amplitude_attack_factor(std::clamp(amplitude_attack, 0.0, 1.0)),
       amplitude_decay_factor(std::clamp(amplitude_decay, 0.0, 1.0)), frequency_decay_factor(std::clamp(frequency_decay, 0.0, 1.0)),
-      base_frequency_coupled(is_coupled), rand_eng(std::mt19937(std::random_device{}())) {}
+      base_frequency_coupled(is_coupled) {}
 
 /*
  * Parse information required to generate a signal.
@@ -83,7 +127,7 @@ void StringOccilator::PrimeString(double freq, double velocity) {
   amplitude_state = 0.0;
   sample_pos = 0U;
   in_amplitude_decay = false;
-  max_amplitude = velocity * amplitude_factor;
+  max_amplitude = velocity * amplitude_factor; // Keep linear: SampleBank::Start scales baked layers by velocity.
   base_frequency = freq;
   frequency_state = ClampRenderedFrequency(base_frequency * frequency_factor);
   amplitude_attack_delta = amplitude_attack * max_amplitude;
@@ -117,6 +161,54 @@ double StringOccilator::NextSample() {
   return sample_val;
 }
 
+double StringOccilator::AccumulateBlock(std::span<double> out) {
+  // The envelope is a serial recurrence; the sines are not. Chunks of phases and amplitudes are filled first so
+  // the sine loop runs without dependencies between samples.
+  constexpr std::size_t k_chunk = 64;
+  std::array<double, k_chunk> phases{};
+  std::array<double, k_chunk> amplitudes{};
+  std::array<double, k_chunk> waves{};
+  double amplitude = amplitude_state;
+  double frequency = frequency_state;
+  std::size_t position = sample_pos;
+  bool decaying = in_amplitude_decay;
+  for (std::size_t start = 0; start < out.size(); start += k_chunk) {
+    const std::size_t count = std::min(k_chunk, out.size() - start);
+    std::size_t i = 0;
+    for (; i < count && !decaying; ++i) {
+      amplitude += amplitude_attack_delta;
+      if (amplitude >= max_amplitude) {
+        decaying = true;
+        amplitude = max_amplitude;
+      }
+      ++position;
+      phases[i] = static_cast<double>(position) * k_sample_increment * frequency + phase_factor;
+      amplitudes[i] = amplitude > k_min_amp_cutoff ? amplitude : 0.0;
+    }
+    // Both decay rates are at most 1, so the amplitude cannot reach its peak again and the frequency stays inside the
+    // range ClampRenderedFrequency keeps; the checks NextSample makes are no-ops here.
+    for (; i < count; ++i) {
+      amplitude *= amplitude_decay_rate;
+      frequency *= frequency_decay_rate;
+      ++position;
+      phases[i] = static_cast<double>(position) * k_sample_increment * frequency + phase_factor;
+      amplitudes[i] = amplitude > k_min_amp_cutoff ? amplitude : 0.0;
+    }
+    // A fixed trip count lets -O2 vectorise this loop; entries past count hold stale, finite values and are dropped.
+    for (std::size_t j = 0; j < k_chunk; ++j) {
+      waves[j] = amplitudes[j] * SineOfCycles(phases[j]);
+    }
+    for (std::size_t j = 0; j < count; ++j) {
+      out[start + j] += waves[j];
+    }
+  }
+  amplitude_state = amplitude;
+  frequency_state = frequency;
+  sample_pos = position;
+  in_amplitude_decay = decaying;
+  return amplitude;
+}
+
 /*
  * Create a JSON representation of the SoundString.
  *
@@ -124,39 +216,62 @@ double StringOccilator::NextSample() {
  * @returns: json string
  */
 std::string StringOccilator::ToJson() {
-  const std::string json_str = "{\n"
-                               "\"start_phase\":" +
-                               std::to_string(phase_factor) +
-                               ",\n"
-                               "\"start_frequency_factor\":" +
-                               std::to_string(start_frequency_factor) +
-                               ",\n"
-                               "\"start_amplitude_factor\":" +
-                               std::to_string(start_amplitude_factor) +
-                               ",\n"
-                               "\"amp_decay_rate\":" +
-                               std::to_string(amplitude_decay_factor) +
-                               ",\n"
-                               "\"amp_attack_delta\":" +
-                               std::to_string(amplitude_attack_factor) +
-                               ",\n"
-                               "\"freq_decay_rate\":" +
-                               std::to_string(frequency_decay_factor) +
-                               ",\n"
-                               "\"base_frequency_coupled\":" +
-                               std::to_string(base_frequency_coupled) +
-                               "\n"
-                               "}";
-  return json_str;
+  std::string json;
+  AppendJson(json);
+  return json;
+}
+
+void StringOccilator::AppendJson(std::string &out) const {
+  out += "{\n\"start_phase\":";
+  AppendFixed(out, phase_factor);
+  out += ",\n\"start_frequency_factor\":";
+  AppendFixed(out, start_frequency_factor);
+  out += ",\n\"start_amplitude_factor\":";
+  AppendFixed(out, start_amplitude_factor);
+  out += ",\n\"amp_decay_rate\":";
+  AppendFixed(out, amplitude_decay_factor);
+  out += ",\n\"amp_attack_delta\":";
+  AppendFixed(out, amplitude_attack_factor);
+  out += ",\n\"freq_decay_rate\":";
+  AppendFixed(out, frequency_decay_factor);
+  out += ",\n\"base_frequency_coupled\":";
+  out += base_frequency_coupled ? '1' : '0';
+  out += "\n}";
 }
 void StringOccilator::AmendGain(double factor) { start_amplitude_factor = std::clamp<double>(start_amplitude_factor * factor, 0.0, 1.0); }
 
 std::string StringOccilator::ToCsv() {
-  const std::string csv_str = std::to_string(start_amplitude_factor) + "," + std::to_string(start_frequency_factor) + "," +
-                              std::to_string(phase_factor) + "," + std::to_string(amplitude_decay_factor) + "," +
-                              std::to_string(amplitude_attack_factor) + "," + std::to_string(frequency_decay_factor) + "," +
-                              std::to_string(base_frequency_coupled);
-  return csv_str;
+  std::string csv;
+  AppendCsv(csv);
+  return csv;
+}
+
+void StringOccilator::AppendCsv(std::string &out) const {
+  for (const double value : {start_amplitude_factor, start_frequency_factor, phase_factor, amplitude_decay_factor, amplitude_attack_factor,
+                             frequency_decay_factor}) {
+    AppendFixed(out, value);
+    out += ',';
+  }
+  out += base_frequency_coupled ? '1' : '0';
+}
+
+InstrumentStringRecord StringOccilator::ToRecord() const {
+  InstrumentStringRecord record;
+  record.amplitude_factor = start_amplitude_factor;
+  record.frequency_factor = start_frequency_factor;
+  record.phase = phase_factor;
+  record.amplitude_decay = amplitude_decay_factor;
+  record.amplitude_attack = amplitude_attack_factor;
+  record.frequency_decay = frequency_decay_factor;
+  record.coupled = base_frequency_coupled ? 1U : 0U;
+  return record;
+}
+
+void StringOccilator::AppendCanonical(std::string &out) const {
+  const std::array<double, 6> parameters = {phase_factor,           start_frequency_factor, start_amplitude_factor,
+                                            amplitude_decay_factor, amplitude_attack_factor, frequency_decay_factor};
+  out.append(reinterpret_cast<const char *>(parameters.data()), sizeof(parameters));
+  out.push_back(base_frequency_coupled ? '\1' : '\0');
 }
 
 /*
@@ -166,6 +281,7 @@ std::string StringOccilator::ToCsv() {
  * @returns: Sound string pointer
  */
 std::unique_ptr<StringOccilator> StringOccilator::TuneString(uint8_t severity) {
+  std::mt19937 &rand_eng = MutationEngine();
   const double sev_factor = static_cast<double>(severity) / 255.0;
   std::uniform_real_distribution<> real_distr(-sev_factor, sev_factor);
   const double phase = phase_factor + ((real_distr(rand_eng) > 0) ? real_distr(rand_eng) : 0);
@@ -194,15 +310,28 @@ void StringOccilator::SetUntunedFrequencyFactorRange(double minimum, double maxi
  * @returns: Sound string pointer
  */
 std::unique_ptr<StringOccilator> StringOccilator::CreateUntunedString(bool is_coupled) {
+  return CreateUntunedString(is_coupled, stat_rand_eng, g_untuned_frequency_factor_min, g_untuned_frequency_factor_max);
+}
+
+/*
+ * Generates a new randomized SoundString oscillator drawing only from the given
+ * engine, so the result is a pure function of the engine state.
+ * @parameters: is_coupled, rand_eng (random source), frequency factor range
+ * @returns: Sound string pointer
+ */
+std::unique_ptr<StringOccilator> StringOccilator::CreateUntunedString(bool is_coupled, std::mt19937 &rand_eng, double min_frequency_factor,
+                                                                      double max_frequency_factor) {
+  const double clamped_minimum = std::clamp(min_frequency_factor, 0.0, 1.0);
+  const double clamped_maximum = std::clamp(max_frequency_factor, 0.0, 1.0);
   std::uniform_real_distribution<> real_distr(0, 1); // define the range.
-  std::uniform_real_distribution<> frequency_distr(g_untuned_frequency_factor_min, g_untuned_frequency_factor_max);
+  std::uniform_real_distribution<> frequency_distr(std::min(clamped_minimum, clamped_maximum), std::max(clamped_minimum, clamped_maximum));
 
-  const double phase = real_distr(stat_rand_eng);            // Maps to 0 to TAU
-  const double freq_factor = frequency_distr(stat_rand_eng); // Maps to the structured octave-anchor frequency ladder.
-  const double amplitude_factor = real_distr(stat_rand_eng); // Maps to 0 to 1
-  const double amplitude_decay = real_distr(stat_rand_eng);  // Maps to min_amplitude_decay_factor to 1;
-  const double amplitude_attack = real_distr(stat_rand_eng); // Maps to 0 to max Attack rate;
-  const double frequency_decay = real_distr(stat_rand_eng);  // Maps to min_amplitude_decay_factor to 1;
+  const double phase = real_distr(rand_eng);            // Maps to 0 to TAU
+  const double freq_factor = frequency_distr(rand_eng); // Maps to the structured octave-anchor frequency ladder.
+  const double amplitude_factor = real_distr(rand_eng); // Maps to 0 to 1
+  const double amplitude_decay = real_distr(rand_eng);  // Maps to min_amplitude_decay_factor to 1;
+  const double amplitude_attack = real_distr(rand_eng); // Maps to 0 to max Attack rate;
+  const double frequency_decay = real_distr(rand_eng);  // Maps to min_amplitude_decay_factor to 1;
 
   return std::make_unique<StringOccilator>(phase, freq_factor, amplitude_factor, amplitude_decay, amplitude_attack, frequency_decay, is_coupled);
 }
@@ -212,25 +341,33 @@ std::unique_ptr<StringOccilator> StringOccilator::CreateUntunedString(bool is_co
  * @parameters: none
  * @returns: Sound string pointer
  */
-std::unique_ptr<StringOccilator> StringOccilator::CreateStringFromCsv(const std::string &csv_string) {
-  std::stringstream string_stream(csv_string);
-  std::vector<std::string> result;
-  while (string_stream.good()) {
-    std::string substr;
-    getline(string_stream, substr, ',');
-    result.push_back(std::move(substr));
+std::unique_ptr<StringOccilator> StringOccilator::CreateStringFromCsv(std::string_view csv_string) {
+  std::array<double, 7> fields{};
+  std::size_t field_count = 0;
+  while (field_count < fields.size()) {
+    const auto comma = csv_string.find(',');
+    fields[field_count++] = ParseCsvField(csv_string.substr(0, comma));
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    csv_string.remove_prefix(comma + 1);
   }
 
   std::uniform_real_distribution<> real_distr(0, 1); // define the range.
-  const double amplitude_factor = result.size() > 0 ? std::stod(result[0]) : real_distr(stat_rand_eng) / 8;
-  const double freq_factor = result.size() > 1 ? std::stod(result[1]) : real_distr(stat_rand_eng);
-  const double phase = result.size() > 2 ? std::stod(result[2]) : real_distr(stat_rand_eng);
-  const double amplitude_decay = result.size() > 3 ? std::stod(result[3]) : real_distr(stat_rand_eng);
-  const double amplitude_attack = result.size() > 4 ? std::stod(result[4]) : real_distr(stat_rand_eng);
-  const double frequency_decay = result.size() > 5 ? std::stod(result[5]) : real_distr(stat_rand_eng);
-  const bool is_coupled = result.size() > 6 ? std::stod(result[6]) > 0.5 : true;
+  const double amplitude_factor = field_count > 0 ? fields[0] : real_distr(stat_rand_eng) / 8;
+  const double freq_factor = field_count > 1 ? fields[1] : real_distr(stat_rand_eng);
+  const double phase = field_count > 2 ? fields[2] : real_distr(stat_rand_eng);
+  const double amplitude_decay = field_count > 3 ? fields[3] : real_distr(stat_rand_eng);
+  const double amplitude_attack = field_count > 4 ? fields[4] : real_distr(stat_rand_eng);
+  const double frequency_decay = field_count > 5 ? fields[5] : real_distr(stat_rand_eng);
+  const bool is_coupled = field_count > 6 ? fields[6] > 0.5 : true;
 
   return std::make_unique<StringOccilator>(phase, freq_factor, amplitude_factor, amplitude_decay, amplitude_attack, frequency_decay, is_coupled);
 }
+
+std::unique_ptr<StringOccilator> StringOccilator::CreateStringFromRecord(const InstrumentStringRecord &record) {
+  return std::make_unique<StringOccilator>(record.phase, record.frequency_factor, record.amplitude_factor, record.amplitude_decay,
+                                           record.amplitude_attack, record.frequency_decay, record.coupled != 0U);
+}
 } // namespace oscillator
 } // namespace instrument
@@ -20,9 +20,12 @@
 
 #include <memory>
 #include <random>
+#include <span>
 #include <string>
+#include <string_view>
 
 #include "include/common.h"
+#include "include/structures.h"
 
 namespace instrument {
 namespace oscillator {
@@ -48,18 +51,41 @@ public:
                   double frequency_decay, bool is_coupled);
   void PrimeString(double frequency, double velocity);
   double NextSample();
+  /*
+   * Adds the next out.size() samples to out, advancing the same state as
+   * NextSample. The sine comes from a polynomial on the reduced phase, within
+   * 1e-9 of the amplitude, which is far below 16-bit quantisation; a block
+   * render can still differ from NextSample in the last bit of a sample.
+   * @parameters out (accumulated into)
+   * @returns the amplitude reached; once IsDecaying it only falls
+   */
+  double AccumulateBlock(std::span<double> out);
+  bool IsDecaying() const { return in_amplitude_decay; }
   void AmendGain(double factor);
   std::string ToCsv();
   std::string ToJson();
+  // Append to a caller's buffer, formatted as std::to_string would, without temporaries.
+  void AppendCsv(std::string &out) const;
+  void AppendJson(std::string &out) const;
+  InstrumentStringRecord ToRecord() const;
+  // Appends the exact bits of every parameter that shapes the rendered signal, for cache keys.
+  void AppendCanonical(std::string &out) const;
   std::unique_ptr<StringOccilator> TuneString(uint8_t amount);
   static void SetUntunedFrequencyFactorRange(double minimum, double maximum);
   static std::unique_ptr<StringOccilator> CreateUntunedString(bool is_coupled = true);
-  static std::unique_ptr<StringOccilator> CreateStringFromCsv(const std::string &csv_string);
+  static std::unique_ptr<StringOccilator> CreateUntunedString(bool is_coupled, std::mt19937 &rand_eng, double min_frequency_factor,
+                                                              double max_frequency_factor);
+  // Missing trailing fields are drawn at random; throws std::invalid_argument on a malformed field.
+  static std::unique_ptr<StringOccilator> CreateStringFromCsv(std::string_view csv_string);
+  static std::unique_ptr<StringOccilator> CreateStringFromRecord(const InstrumentStringRecord &record);
 
   std::size_t GetSampleNumber() const { return sample_pos; }
   const double &GetFreqFactor() const { return start_frequency_factor; }
   const double &GetAmpFactor() const { return start_amplitude_factor; }
   bool IsCoupled() const { return base_frequency_coupled; }
+  // Rendered frequency and peak amplitude of the primed note; the frequency decays while rendering.
+  double GetFrequency() const { return frequency_state; }
+  double GetPeakAmplitude() const { return max_amplitude; }
 
 private:
   // Sinusoid's start definition.
@@ -84,8 +110,6 @@ private:
   std::size_t sample_pos;
   bool in_amplitude_decay;
 
-  std::mt19937 rand_eng;
-
   // Create sample of a sin function for given parameters (frequency, amplitude,
   // sample rate, phase).
   //
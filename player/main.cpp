@@ -12,16 +12,31 @@
  *      Author: Brandon
  */
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
-#include <fstream>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
 
 #include "include/common.h"
 #include "include/filereader.h"
 #include "include/filewriter.h"
+#include "include/midi.h"
 #include "instrument/instrument_model.h"
+#include "instrument/render_cache.h"
+#include "instrument/sample_bank.h"
+#include "instrument/sequence_renderer.h"
 #include "instrument/string_oscillator.h"
+#include "player/manifest_batch.h"
+#include "player/pcm_stream.h"
+#include "player/render_server.h"
 
 static void AppUsage() {
   std::cerr << "Usage: \n"
@@ -30,14 +45,146 @@ static void AppUsage() {
             << "-n --note<440>\n"
             << "-v --velocity<100>\n"
             << "-l --length<5s>\n"
+            << "-c --cache <dir> (reuse a render cached by an earlier run, store it otherwise)\n"
+            << "--cache-mb <4096> (cache size cap)\n"
+            << "-m --manifest <jobs.csv> (render every row: filename,note,velocity,length[,output]; prints only a summary)\n"
+            << "-b --bank <file.slbk> (play the note from a bank baked by sample_bank; not cached)\n"
+            << "--midi <song.mid> (play a MIDI file on the instrument; writes <instrument>.<song>.wav)\n"
+            << "-o --output <wav> (--midi output path)\n"
+            << "--voices <32> (--midi polyphony)\n"
+            << "--release <0.25> (--midi release time in seconds)\n"
+            << "--gain <1/sqrt(voices)> (--midi mix gain before the peak limiter)\n"
+            << "--hard-clip (--midi clips past full scale instead of limiting)\n"
+            << "--stream <path|-> (write the note block by block as it renders, to stdout or a FIFO; report on stderr)\n"
+            << "--stream-format <wav|raw> (--stream output, raw is s16le mono)\n"
+            << "--block <256> (--stream samples per block)\n"
+            << "--buffer <8> (--stream blocks rendered ahead)\n"
+            << "--realtime (--stream at the audio rate, counting blocks not ready in time as underruns)\n"
+            << "--serve (answer render requests on stdin/stdout, see player/render_server.h)\n"
+            << "--socket <path> (answer render requests on a Unix domain socket)\n"
+            << "-j --threads <n> (render workers; --manifest defaults to hardware threads, --serve to 1)\n"
+            << "--instrument-cache <256> (parsed instruments kept when serving)\n"
             << std::endl;
 }
 
+// Serves until end of input or a shutdown request; stdout carries only protocol frames.
+static int Serve(const player::serve::RenderServer::Options &options, const std::string &socket_path) {
+  std::signal(SIGPIPE, SIG_IGN);
+  try {
+    player::serve::RenderServer server(options);
+    if (socket_path.empty()) {
+      server.Serve(STDIN_FILENO, STDOUT_FILENO);
+    } else {
+      std::cerr << "render server listening on " << socket_path << std::endl;
+      server.Listen(socket_path);
+    }
+    server.GetStats().Print(std::cerr);
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
+
+static int RenderManifest(const std::string &manifest, const player::batch::BatchOptions &options) {
+  std::vector<player::batch::RenderJob> jobs;
+  try {
+    jobs = player::batch::ReadManifest(manifest);
+  } catch (const std::runtime_error &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  player::batch::BatchReport report;
+  try {
+    report = player::batch::RunBatch(jobs, options);
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  report.Print(std::cout);
+  return report.failed == 0U ? EXIT_NORMAL : EXIT_WRITE_FILE_FAILED;
+}
+
+// Stdout may carry the audio, so the instrument is not echoed and the report goes to stderr.
+static int StreamPreview(const std::string &filename, double velocity, double note_played, uint32_t num_samples,
+                         const player::stream::StreamOptions &options) {
+  std::optional<instrument::InstrumentModel> loaded;
+  try {
+    loaded.emplace(instrument::InstrumentModel::Load(filename));
+  } catch (const std::exception &error) {
+    std::cerr << "unable to read instrument: " << error.what() << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  std::signal(SIGPIPE, SIG_IGN);
+  try {
+    player::stream::StreamNote(*loaded, velocity, note_played, num_samples, options).Print(std::cerr);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_BAD_ARGS;
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
+
+static int RenderMidi(const std::string &filename, const std::string &midi_file, std::string output,
+                      const instrument::SequenceRenderer::Options &options) {
+  std::optional<instrument::SequenceRenderer> renderer;
+  try {
+    renderer.emplace(instrument::InstrumentModel::Load(filename).ToRecords(), options);
+  } catch (const std::exception &error) {
+    std::cout << "unable to read instrument: " << error.what() << std::endl;
+    return EXIT_BAD_ARGS;
+  }
+  midi::Sequence sequence;
+  try {
+    sequence = midi::Load(midi_file);
+  } catch (const std::runtime_error &error) {
+    std::cerr << "ERROR!!! " << error.what() << std::endl;
+    return EXIT_READ_FILE_FAILED;
+  }
+  if (output.empty()) {
+    output = filename + "." + std::filesystem::path(midi_file).stem().string() + ".wav";
+  }
+  try {
+    filewriter::wave::MonoStreamWriter writer(output);
+    const auto stats = renderer->Render(sequence, writer);
+    writer.Close();
+    std::cout << output << ": " << sequence.events.size() << " events, " << sequence.tempo_changes << " tempo change(s)\n";
+    stats.Print(std::cout);
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  return EXIT_NORMAL;
+}
+
 int main(int argc, char **argv) {
   double velocity = 1.0;
   double note_played = 440.0;
   std::string filename = "";
   uint32_t num_samples = 5 * 44100;
+  instrument::RenderCache::Options cache_options;
+  player::serve::RenderServer::Options server_options;
+  std::string socket_path;
+  std::string manifest;
+  bool threads_given = false;
+  std::string bank_file;
+  std::string midi_file;
+  std::string output;
+  instrument::SequenceRenderer::Options sequence_options;
+  player::stream::StreamOptions stream_options;
+  bool stream = false;
+  // Serving and batch runs keep stdout for responses and the summary, so options are not echoed.
+  bool serve = std::any_of(argv + 1, argv + argc, [](const char *arg) { return std::string_view(arg) == "--serve"; });
+  const bool quiet = serve || std::any_of(argv + 1, argv + argc, [](const char *arg) {
+                       const std::string_view option(arg);
+                       return option == "-m" || option == "--manifest" || option == "--socket" || option == "--midi" ||
+                              option == "--stream";
+                     });
+  const bool realtime =
+      std::any_of(argv + 1, argv + argc, [](const char *arg) { return std::string_view(arg) == "--realtime"; });
   // Parse arguments.
   for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
@@ -46,10 +193,15 @@ int main(int argc, char **argv) {
       return EXIT_NORMAL;
     }
     if (((arg == "-f") || (arg == "--filename") || (arg == "-n") || (arg == "--note") || (arg == "-v") || (arg == "--velocity") || (arg == "-l") ||
-         (arg == "--length")) &&
+         (arg == "--length") || (arg == "-c") || (arg == "--cache") || (arg == "--cache-mb") || (arg == "--socket") || (arg == "-j") ||
+         (arg == "--threads") || (arg == "--instrument-cache") || (arg == "-m") || (arg == "--manifest") || (arg == "--midi") || (arg == "-o") ||
+         (arg == "--output") || (arg == "--voices") || (arg == "--release") || (arg == "--gain") || (arg == "-b") || (arg == "--bank") ||
+         (arg == "--stream") || (arg == "--stream-format") || (arg == "--block") || (arg == "--buffer")) &&
         (i + 1 < argc)) {
       std::string arg2 = argv[++i];
-      std::cout << arg << " " << arg2 << std::endl;
+      if (!quiet) {
+        std::cout << arg << " " << arg2 << std::endl;
+      }
       if ((arg == "-f") || (arg == "--filename")) {
         filename = arg2;
       } else if ((arg == "-n") || (arg == "--note")) {
@@ -58,32 +210,138 @@ int main(int argc, char **argv) {
         velocity = ((uint8_t)std::stoi(arg2)) / 100.0;
       } else if ((arg == "-l") || (arg == "--length")) {
         num_samples = ((uint32_t)std::stoul(arg2)) * 44100;
+      } else if ((arg == "-c") || (arg == "--cache")) {
+        cache_options.directory = arg2;
+      } else if (arg == "--cache-mb") {
+        cache_options.max_bytes = static_cast<uint64_t>(std::stoull(arg2)) << 20U;
+      } else if (arg == "--socket") {
+        socket_path = arg2;
+        serve = true;
+      } else if ((arg == "-j") || (arg == "--threads")) {
+        server_options.threads = std::stoul(arg2);
+        threads_given = true;
+      } else if ((arg == "-m") || (arg == "--manifest")) {
+        manifest = arg2;
+      } else if (arg == "--instrument-cache") {
+        server_options.instrument_cache_entries = std::stoul(arg2);
+      } else if ((arg == "-b") || (arg == "--bank")) {
+        bank_file = arg2;
+      } else if (arg == "--midi") {
+        midi_file = arg2;
+      } else if ((arg == "-o") || (arg == "--output")) {
+        output = arg2;
+      } else if (arg == "--voices") {
+        sequence_options.voices = std::stoul(arg2);
+      } else if (arg == "--release") {
+        sequence_options.release_seconds = std::stod(arg2);
+      } else if (arg == "--gain") {
+        sequence_options.gain = std::stod(arg2);
+      } else if (arg == "--stream") {
+        stream_options.output = arg2;
+        stream = true;
+      } else if (arg == "--stream-format") {
+        if (arg2 != "wav" && arg2 != "raw") {
+          std::cerr << "--stream-format is wav or raw." << std::endl;
+          return EXIT_BAD_ARGS;
+        }
+        stream_options.wav = arg2 == "wav";
+      } else if (arg == "--block") {
+        stream_options.block = std::stoul(arg2);
+      } else if (arg == "--buffer") {
+        stream_options.depth = std::stoul(arg2);
       } else {
         std::cerr << "--destination option requires one argument." << std::endl;
         return EXIT_BAD_ARGS;
       }
     }
   }
-
-  // Now read the model
-  std::vector<std::string> instrument_strings;
-  std::ifstream file(filename); // file just has some sentences
-  if (!file) {
-    std::cout << "unable to open file: " << filename << std::endl;
-    return EXIT_BAD_ARGS;
+  if (serve) {
+    if (!cache_options.directory.empty()) {
+      server_options.render_cache = cache_options;
+    }
+    return Serve(server_options, socket_path);
+  }
+  if (!manifest.empty()) {
+    player::batch::BatchOptions batch_options;
+    batch_options.threads = threads_given ? server_options.threads : std::max(1U, std::thread::hardware_concurrency());
+    if (!cache_options.directory.empty()) {
+      batch_options.render_cache = cache_options;
+    }
+    return RenderManifest(manifest, batch_options);
+  }
+  if (!midi_file.empty()) {
+    sequence_options.velocity = velocity;
+    sequence_options.limit =
+        std::none_of(argv + 1, argv + argc, [](const char *arg) { return std::string_view(arg) == "--hard-clip"; });
+    return RenderMidi(filename, midi_file, output, sequence_options);
+  }
+  if (stream) {
+    stream_options.realtime = realtime;
+    return StreamPreview(filename, velocity, note_played, num_samples, stream_options);
   }
 
-  std::string string_line;
-  while (std::getline(file, string_line)) {
-    instrument_strings.push_back(string_line);
-    std::cout << string_line << std::endl;
+  // Now read the model, oscillator CSV or binary .slin.
+  std::optional<instrument::InstrumentModel> loaded;
+  try {
+    loaded.emplace(instrument::InstrumentModel::Load(filename));
+  } catch (const std::exception &error) {
+    std::cout << "unable to read instrument: " << error.what() << std::endl;
+    return EXIT_BAD_ARGS;
   }
+  instrument::InstrumentModel &instru_model = *loaded;
+  std::cout << instru_model.ToCsv() << std::endl;
 
   std::cout << "\nmodel:\n" << std::endl;
-  instrument::InstrumentModel instru_model(instrument_strings, filename);
   std::cout << instru_model.ToJson() << std::endl;
-  bool has_distorted;
-  std::vector<int16_t> sample = instru_model.GenerateIntSignal(velocity, note_played, num_samples, has_distorted);
-  filewriter::wave::MonoWriter wave_writer(sample);
-  wave_writer.Write(filename + ".wav");
+  std::optional<instrument::bank::SampleBank> bank;
+  if (!bank_file.empty()) {
+    try {
+      bank.emplace(bank_file);
+    } catch (const std::runtime_error &error) {
+      std::cerr << "ERROR!!! " << error.what() << std::endl;
+      return EXIT_READ_FILE_FAILED;
+    }
+    if (!bank->Matches(instru_model)) {
+      std::cerr << "warning: " << bank_file << " was not baked from " << filename << std::endl;
+    }
+  }
+  std::optional<instrument::RenderCache> cache;
+  std::optional<instrument::RenderKey> cache_key;
+  std::optional<std::vector<int16_t>> sample;
+  if (!cache_options.directory.empty() && !bank) {
+    try {
+      cache.emplace(cache_options);
+    } catch (const std::runtime_error &error) {
+      std::cerr << error.what() << std::endl;
+      return EXIT_WRITE_FILE_FAILED;
+    }
+    cache_key = instrument::RenderKey::Make(instru_model, note_played, velocity, num_samples, SAMPLE_RATE, true);
+    sample = cache->LoadAudio(*cache_key);
+  }
+  try {
+    if (sample) {
+      filewriter::wave::MonoWriter(*sample).Write(filename + ".wav");
+    } else {
+      // Render straight into the mapped output file.
+      filewriter::wave::MonoMappedWriter wave_writer(filename + ".wav", num_samples);
+      const auto render_start = std::chrono::steady_clock::now();
+      bool has_distorted;
+      const std::size_t rendered = bank ? bank->GenerateIntSignal(velocity, note_played, wave_writer.Samples(), has_distorted)
+                                        : instru_model.GenerateIntSignal(velocity, note_played, wave_writer.Samples(), has_distorted);
+      if (has_distorted) {
+        // --stream applies the same policy, so both outputs carry the same samples.
+        std::cerr << "Clipped at sample " << rendered << "; the rest of the note is silent." << std::endl;
+      }
+      if (cache) {
+        cache->StoreAudio(*cache_key, wave_writer.Samples(), std::chrono::steady_clock::now() - render_start);
+      }
+      wave_writer.Close(num_samples);
+    }
+  } catch (const std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_WRITE_FILE_FAILED;
+  }
+  if (cache) {
+    cache->GetStats().Print(std::cout);
+  }
 }
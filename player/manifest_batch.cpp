@@ -0,0 +1,350 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "player/manifest_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "include/async_writer.h"
+#include "include/bounded_queue.h"
+#include "include/filewriter.h"
+#include "include/structures.h"
+#include "instrument/instrument_model.h"
+
+namespace player {
+namespace batch {
+
+namespace {
+
+std::string_view Trim(std::string_view text) {
+  const auto first = text.find_first_not_of(" \t\r");
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+std::vector<std::string_view> SplitFields(std::string_view line) {
+  std::vector<std::string_view> fields;
+  for (std::size_t start = 0;;) {
+    const auto comma = line.find(',', start);
+    fields.push_back(Trim(line.substr(start, comma == std::string_view::npos ? std::string_view::npos : comma - start)));
+    if (comma == std::string_view::npos) {
+      return fields;
+    }
+    start = comma + 1;
+  }
+}
+
+template <typename T> bool ParseNumber(std::string_view text, T &out) {
+  const auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+  return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+std::string Resolve(const std::filesystem::path &base, std::string_view path) {
+  const std::filesystem::path given(path);
+  return given.is_absolute() ? given.string() : (base / given).string();
+}
+
+// Parsed once per distinct file; jobs build their own InstrumentModel from the records.
+struct LoadedInstrument {
+  std::string name;
+  std::vector<InstrumentStringRecord> records;
+  std::string error;
+};
+
+struct RenderedJob {
+  std::size_t job = 0;
+  std::chrono::steady_clock::time_point started;
+  WavFileHeader header;
+  std::vector<int16_t> samples;
+};
+
+double Milliseconds(std::chrono::nanoseconds duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+double Percentile(std::vector<double> sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  const auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1U, sorted.size()) - 1U];
+}
+
+} // namespace
+
+std::vector<RenderJob> ReadManifest(const std::string &manifest) {
+  std::ifstream file(manifest);
+  if (!file) {
+    throw std::runtime_error("Unable to read manifest " + manifest);
+  }
+  const auto base = std::filesystem::path(manifest).parent_path();
+  enum Column { filename, note, velocity, length, output, unused };
+  std::vector<Column> columns;
+  std::vector<RenderJob> jobs;
+  std::unordered_map<std::string, std::size_t> outputs; // Output path to the line that claimed it.
+  std::string line;
+  for (std::size_t line_number = 1; std::getline(file, line); ++line_number) {
+    const auto text = Trim(line);
+    if (text.empty() || text.starts_with('#')) {
+      continue;
+    }
+    const auto fields = SplitFields(text);
+    if (columns.empty()) {
+      for (const auto field : fields) {
+        columns.push_back(field == "filename" || field == "instrument" ? filename
+                          : field == "note"                            ? note
+                          : field == "velocity"                        ? velocity
+                          : field == "length"                          ? length
+                          : field == "output"                          ? output
+                                                                       : unused);
+      }
+      if (std::find(columns.begin(), columns.end(), filename) == columns.end()) {
+        throw std::runtime_error(manifest + ": the header row needs a filename column");
+      }
+      continue;
+    }
+    if (fields.size() != columns.size()) {
+      throw std::runtime_error(manifest + ":" + std::to_string(line_number) + ": expected " + std::to_string(columns.size()) + " fields");
+    }
+    RenderJob job;
+    bool parsed = true;
+    for (std::size_t i = 0; i < fields.size() && parsed; ++i) {
+      switch (columns[i]) {
+      case filename:
+        job.filename = Resolve(base, fields[i]);
+        parsed = !fields[i].empty();
+        break;
+      case note: {
+        // The player reads -n with std::stof; keep the same float so batch and one-shot renders match.
+        float value = 0.0F;
+        parsed = ParseNumber(fields[i], value) && value > 0.0F;
+        job.note_frequency = value;
+        break;
+      }
+      case velocity: {
+        int value = 0;
+        parsed = ParseNumber(fields[i], value);
+        job.velocity = static_cast<uint8_t>(value) / 100.0;
+        break;
+      }
+      case length: {
+        double seconds = 0.0;
+        parsed = ParseNumber(fields[i], seconds) && seconds >= 0.0;
+        job.sample_count = static_cast<uint32_t>(std::llround(seconds * SAMPLE_RATE));
+        break;
+      }
+      case output:
+        if (!fields[i].empty()) {
+          job.output = Resolve(base, fields[i]);
+        }
+        break;
+      case unused:
+        break;
+      }
+    }
+    if (!parsed) {
+      throw std::runtime_error(manifest + ":" + std::to_string(line_number) + ": malformed row");
+    }
+    if (job.output.empty()) {
+      // Rows often share an instrument, so the row number keeps their default outputs apart.
+      job.output = job.filename + "." + std::to_string(jobs.size() + 1U) + ".wav";
+    }
+    const auto key = std::filesystem::path(job.output).lexically_normal().string();
+    const auto [previous, inserted] = outputs.emplace(key, line_number);
+    if (!inserted) {
+      throw std::runtime_error(manifest + ":" + std::to_string(line_number) + ": output " + job.output + " is also the output of line " +
+                               std::to_string(previous->second));
+    }
+    jobs.push_back(std::move(job));
+  }
+  return jobs;
+}
+
+void BatchReport::Print(std::ostream &out) const {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  out << "manifest: " << jobs - failed << "/" << jobs << " jobs, " << instruments << " instrument(s), " << std::fixed << std::setprecision(2)
+      << seconds << " s, " << std::setprecision(1) << (seconds > 0.0 ? static_cast<double>(jobs - failed) / seconds : 0.0) << " jobs/s on "
+      << threads << " thread(s), writes " << write_backend << "\n";
+  const auto percentiles = [&](const char *label, const std::vector<double> &values) {
+    out << label << std::setprecision(2) << "p50 " << Percentile(values, 0.50) << " ms, p90 " << Percentile(values, 0.90) << " ms, p99 "
+        << Percentile(values, 0.99) << " ms, max " << Percentile(values, 1.0) << " ms\n";
+  };
+  percentiles("render latency: ", render_ms);
+  percentiles("job latency (to written): ", job_ms);
+  if (render_cache) {
+    render_cache->Print(out);
+  }
+}
+
+BatchReport RunBatch(std::span<const RenderJob> jobs, const BatchOptions &options) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::size_t threads = std::max<std::size_t>(1U, options.threads);
+  BatchReport report;
+  report.jobs = jobs.size();
+  report.threads = threads;
+  report.render_ms.assign(jobs.size(), 0.0);
+  report.job_ms.assign(jobs.size(), 0.0);
+
+  std::optional<instrument::RenderCache> render_cache;
+  if (options.render_cache) {
+    render_cache.emplace(*options.render_cache);
+  }
+
+  std::vector<std::size_t> instrument_of(jobs.size());
+  std::vector<std::string> instrument_files;
+  {
+    std::unordered_map<std::string, std::size_t> index;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+      const auto [found, inserted] = index.try_emplace(jobs[i].filename, instrument_files.size());
+      if (inserted) {
+        instrument_files.push_back(jobs[i].filename);
+      }
+      instrument_of[i] = found->second;
+    }
+  }
+  report.instruments = instrument_files.size();
+
+  std::mutex log_mutex;
+  const auto run_workers = [threads](std::size_t count, const auto &body) {
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 0; worker < std::min(threads, count); ++worker) {
+      workers.emplace_back([&]() {
+        for (std::size_t i = next++; i < count; i = next++) {
+          body(i);
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  };
+
+  std::vector<LoadedInstrument> instruments(instrument_files.size());
+  run_workers(instrument_files.size(), [&](std::size_t i) {
+    try {
+      auto model = instrument::InstrumentModel::Load(instrument_files[i]);
+      instruments[i].name = model.GetName();
+      instruments[i].records = model.ToRecords();
+    } catch (const std::exception &error) {
+      instruments[i].error = error.what();
+    }
+  });
+
+  std::vector<char> failed(jobs.size(), 0);
+  const auto fail = [&](std::size_t job, const std::string &message) {
+    failed[job] = 1;
+    const std::lock_guard<std::mutex> lock(log_mutex);
+    std::cerr << "Skipping " << jobs[job].output << ": " << message << std::endl;
+  };
+
+  BoundedQueue<RenderedJob> rendered(threads * 4);
+  filewriter::async::BatchFileWriter writer(options.allow_io_uring);
+  report.write_backend = writer.Backend();
+  std::thread write_thread([&]() {
+    using filewriter::async::AsBuffer;
+    for (auto batch = rendered.PopBatch(std::max<std::size_t>(1U, options.write_batch)); !batch.empty();
+         batch = rendered.PopBatch(std::max<std::size_t>(1U, options.write_batch))) {
+      std::vector<filewriter::async::FileWrite> files;
+      files.reserve(batch.size());
+      for (const auto &item : batch) {
+        files.push_back({jobs[item.job].output,
+                         {AsBuffer(std::span<const WavFileHeader>(&item.header, 1)), AsBuffer(std::span<const int16_t>(item.samples))}});
+      }
+      try {
+        writer.Write(files);
+      } catch (const std::exception &) {
+        // Write the batch file by file to find the one that failed.
+        for (std::size_t i = 0; i < files.size(); ++i) {
+          try {
+            writer.Write(std::span(files).subspan(i, 1));
+          } catch (const std::exception &error) {
+            fail(batch[i].job, error.what());
+          }
+        }
+      }
+      const auto written = std::chrono::steady_clock::now();
+      for (const auto &item : batch) {
+        report.job_ms[item.job] = Milliseconds(written - item.started);
+      }
+    }
+  });
+
+  run_workers(jobs.size(), [&](std::size_t i) {
+    const auto job_start = std::chrono::steady_clock::now();
+    const auto &job = jobs[i];
+    const auto &loaded = instruments[instrument_of[i]];
+    if (!loaded.error.empty()) {
+      fail(i, "unable to read instrument: " + loaded.error);
+      return;
+    }
+    RenderedJob item;
+    item.job = i;
+    item.started = job_start;
+    item.header = filewriter::wave::MakeMonoHeader(job.sample_count);
+    instrument::InstrumentModel model(loaded.records, loaded.name);
+    std::optional<instrument::RenderKey> key;
+    std::optional<std::vector<int16_t>> cached;
+    if (render_cache) {
+      key = instrument::RenderKey::Make(model, job.note_frequency, job.velocity, job.sample_count, SAMPLE_RATE, true);
+      cached = render_cache->LoadAudio(*key);
+    }
+    if (cached && cached->size() == job.sample_count) {
+      item.samples = std::move(*cached);
+    } else {
+      item.samples.assign(job.sample_count, 0);
+      bool has_distorted = false;
+      const auto render_start = std::chrono::steady_clock::now();
+      model.GenerateIntSignal(job.velocity, job.note_frequency, item.samples, has_distorted);
+      if (render_cache) {
+        render_cache->StoreAudio(*key, item.samples, std::chrono::steady_clock::now() - render_start);
+      }
+    }
+    report.render_ms[i] = Milliseconds(std::chrono::steady_clock::now() - job_start);
+    rendered.Push(std::move(item));
+  });
+  rendered.Close();
+  write_thread.join();
+
+  report.elapsed = std::chrono::steady_clock::now() - start;
+  report.failed = static_cast<std::size_t>(std::count(failed.begin(), failed.end(), 1));
+  // Latencies of failed jobs would only skew the percentiles.
+  std::vector<double> render_ms;
+  std::vector<double> job_ms;
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    if (failed[i] == 0) {
+      render_ms.push_back(report.render_ms[i]);
+      job_ms.push_back(report.job_ms[i]);
+    }
+  }
+  report.render_ms = std::move(render_ms);
+  report.job_ms = std::move(job_ms);
+  if (render_cache) {
+    report.render_cache = render_cache->GetStats();
+  }
+  return report;
+}
+
+} // namespace batch
+} // namespace player
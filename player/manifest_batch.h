@@ -0,0 +1,91 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * manifest_batch.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef PLAYER_MANIFEST_BATCH_H_
+#define PLAYER_MANIFEST_BATCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "include/common.h"
+#include "instrument/render_cache.h"
+
+namespace player {
+namespace batch {
+
+// One `player -f filename -n note -v velocity -l length` run.
+struct RenderJob {
+  std::string filename;
+  double note_frequency = 440.0;
+  double velocity = 1.0; // -v / 100.
+  uint32_t sample_count = 5 * SAMPLE_RATE;
+  std::string output; // filename + ".<row>.wav" unless the manifest names one.
+};
+
+/*
+ * Reads a CSV manifest with a header row. Columns, in any order: filename (or
+ * instrument), note, velocity, length, output; only filename is required and
+ * the rest default as the player's options do. velocity is the -v percent,
+ * length whole or fractional seconds. Relative paths are relative to the
+ * manifest. Blank lines and lines starting with # are skipped; fields are not
+ * quoted. Without an output column a job writes filename.<row>.wav, row
+ * counting data rows from 1. Throws std::runtime_error naming the line of a
+ * malformed row or of a second row writing the same output.
+ * @parameters manifest path
+ * @returns jobs in manifest order
+ */
+std::vector<RenderJob> ReadManifest(const std::string &manifest);
+
+struct BatchOptions {
+  std::size_t threads = 1;
+  std::size_t write_batch = 32; // Files handed to the writer at once.
+  bool allow_io_uring = true;
+  std::optional<instrument::RenderCache::Options> render_cache;
+};
+
+struct BatchReport {
+  std::size_t jobs = 0;
+  std::size_t failed = 0;
+  std::size_t instruments = 0; // Distinct files parsed.
+  std::size_t threads = 0;
+  std::string write_backend;
+  std::chrono::nanoseconds elapsed{0};
+  // Per job, in milliseconds: render alone, and from pick-up until its file was written.
+  std::vector<double> render_ms;
+  std::vector<double> job_ms;
+  std::optional<instrument::RenderCache::Stats> render_cache;
+
+  void Print(std::ostream &out) const;
+};
+
+/*
+ * Renders every job on `threads` workers. Each distinct instrument file is
+ * parsed once, up front, and shared by all of its jobs. Rendered files are
+ * handed to one writer thread that writes them in batches through
+ * filewriter::async::BatchFileWriter. A job whose instrument or output fails is
+ * reported on stderr and counted; the rest still render.
+ * @parameters jobs, options
+ * @returns the report
+ */
+BatchReport RunBatch(std::span<const RenderJob> jobs, const BatchOptions &options);
+
+} // namespace batch
+} // namespace player
+
+#endif // PLAYER_MANIFEST_BATCH_H_
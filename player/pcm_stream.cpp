@@ -0,0 +1,243 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "player/pcm_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "include/bounded_queue.h"
+#include "include/filewriter.h"
+#include "instrument/string_oscillator.h"
+
+namespace player {
+namespace stream {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Block {
+  std::vector<int16_t> samples;
+  std::size_t count = 0;
+  Clock::time_point render_start;
+  Clock::duration render_time{0};
+};
+
+double Percentile(std::vector<double> sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  const auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1U, sorted.size()) - 1U];
+}
+
+double Milliseconds(Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+// Returns false when the reader has closed the pipe; throws on any other failure.
+bool WriteAll(int fd, const void *data, std::size_t size, const std::string &output) {
+  const auto *bytes = static_cast<const char *>(data);
+  while (size > 0U) {
+    const ssize_t written = write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EPIPE) {
+        return false;
+      }
+      throw std::runtime_error("Unable to write stream " + output + ": " + std::strerror(errno));
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+} // namespace
+
+void StreamReport::Print(std::ostream &out) const {
+  const double block_ms = 1000.0 * static_cast<double>(block) / SAMPLE_RATE;
+  double render_sum = 0.0;
+  for (const double value : render_ms) {
+    render_sum += value;
+  }
+  const double render_mean = render_ms.empty() ? 0.0 : render_sum / static_cast<double>(render_ms.size());
+  out << std::fixed << std::setprecision(2) << "stream: " << blocks << " blocks of " << block << " samples ("
+      << block_ms << " ms), depth " << depth << ", " << static_cast<double>(samples) / SAMPLE_RATE << " s of audio in "
+      << std::chrono::duration<double>(elapsed).count() << " s, " << strings << " strings"
+      << (reader_closed ? ", reader closed early" : "") << "\n";
+  out << std::setprecision(3) << "render: " << render_mean << " ms per block mean, " << Percentile(render_ms, 1.0)
+      << " ms max, " << std::setprecision(1) << (render_mean > 0.0 ? block_ms / render_mean : 0.0)
+      << "x real-time headroom\n";
+  out << std::setprecision(2) << (realtime ? "underruns: " : "waits for render: ") << waits << " ("
+      << Milliseconds(wait_time) << " ms), first block after " << Milliseconds(first_block) << " ms, clipped "
+      << (clipped_at ? "at sample " + std::to_string(*clipped_at) + ", silent from there as in player -f" : std::string("no"))
+      << "\n";
+  out << "block latency (render start to written): p50 " << Percentile(latency_ms, 0.50) << " ms, p90 "
+      << Percentile(latency_ms, 0.90) << " ms, p99 " << Percentile(latency_ms, 0.99) << " ms, max "
+      << Percentile(latency_ms, 1.0) << " ms\n";
+}
+
+StreamReport StreamNote(instrument::InstrumentModel &instrument, double velocity, double frequency,
+                        std::size_t sample_count, const StreamOptions &options) {
+  if (options.block == 0U || options.depth == 0U) {
+    throw std::invalid_argument("Streaming needs a block size and a buffer depth");
+  }
+  const auto start = Clock::now();
+  std::vector<instrument::oscillator::StringOccilator> strings;
+  for (const auto &record : instrument.ToRecords()) {
+    strings.push_back(*instrument::oscillator::StringOccilator::CreateStringFromRecord(record));
+  }
+  StreamReport report;
+  report.block = options.block;
+  report.depth = options.depth;
+  report.strings = strings.size();
+  report.realtime = options.realtime;
+
+  const bool to_stdout = options.output == "-";
+  const int fd = to_stdout ? STDOUT_FILENO : open(options.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open stream " + options.output + ": " + std::strerror(errno));
+  }
+
+  // One buffer more than the depth: the writer holds one while the renderer keeps `depth` ready.
+  BoundedQueue<Block> ready(options.depth);
+  BoundedQueue<Block> free_blocks(options.depth + 1U);
+  for (std::size_t i = 0; i <= options.depth; ++i) {
+    Block block;
+    block.samples.resize(options.block);
+    free_blocks.Push(std::move(block));
+  }
+  std::optional<uint64_t> clipped_at;
+  std::thread renderer([&]() {
+    constexpr double max_int = std::numeric_limits<int16_t>::max();
+    std::vector<double> mix(options.block);
+    for (auto &sound_string : strings) {
+      sound_string.PrimeString(frequency, velocity);
+    }
+    for (std::size_t first = 0; first < sample_count; first += options.block) {
+      auto block = free_blocks.Pop();
+      if (!block) {
+        break; // The writer stopped.
+      }
+      block->render_start = Clock::now();
+      block->count = std::min(options.block, sample_count - first);
+      const std::span<double> out(mix.data(), block->count);
+      std::fill(out.begin(), out.end(), 0.0);
+      if (!clipped_at) {
+        for (auto &sound_string : strings) {
+          sound_string.AccumulateBlock(out);
+        }
+      }
+      for (std::size_t i = 0; i < block->count; ++i) {
+        // The file player stops rendering at the first clipped sample and leaves the rest of the file silent.
+        if (!clipped_at && (out[i] > 1.0 || out[i] < -1.0)) {
+          clipped_at = first + i;
+        }
+        block->samples[i] = clipped_at ? int16_t{0} : static_cast<int16_t>(max_int * out[i]);
+      }
+      block->render_time = Clock::now() - block->render_start;
+      if (!ready.Push(std::move(*block))) {
+        break;
+      }
+    }
+    ready.Close();
+  });
+
+  const auto finish = [&]() {
+    free_blocks.Close();
+    ready.Close();
+    renderer.join();
+    if (!to_stdout) {
+      close(fd);
+    }
+  };
+  try {
+    const auto block_duration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(options.block) / SAMPLE_RATE));
+    bool open_for_writing = true;
+    if (options.wav) {
+      const WavFileHeader header = filewriter::wave::MakeMonoHeader(sample_count);
+      open_for_writing = WriteAll(fd, &header, sizeof(header), options.output);
+    }
+    // Prefill: writing starts once `depth` blocks are rendered, or the whole note if it is shorter.
+    std::deque<Block> held;
+    while (open_for_writing && held.size() < options.depth) {
+      auto block = ready.Pop();
+      if (!block) {
+        break;
+      }
+      held.push_back(std::move(*block));
+    }
+    Clock::time_point schedule = Clock::now();
+    while (open_for_writing) {
+      if (options.realtime) {
+        std::this_thread::sleep_until(schedule + static_cast<Clock::rep>(report.blocks) * block_duration);
+      }
+      std::optional<Block> block;
+      if (!held.empty()) {
+        block = std::move(held.front());
+        held.pop_front();
+      } else {
+        const bool starved = ready.Depth() == 0U;
+        const auto wait_start = Clock::now();
+        block = ready.Pop();
+        if (!block) {
+          break; // Rendered to the end.
+        }
+        if (starved) {
+          const auto waited = Clock::now() - wait_start;
+          ++report.waits;
+          report.wait_time += waited;
+          schedule += waited; // A sound card would have glitched and carried on from here.
+        }
+      }
+      open_for_writing = WriteAll(fd, block->samples.data(), block->count * sizeof(int16_t), options.output);
+      if (!open_for_writing) {
+        report.reader_closed = true;
+        break;
+      }
+      const auto written = Clock::now();
+      if (report.blocks == 0U) {
+        report.first_block = written - start;
+      }
+      ++report.blocks;
+      report.samples += block->count;
+      report.render_ms.push_back(Milliseconds(block->render_time));
+      report.latency_ms.push_back(Milliseconds(written - block->render_start));
+      free_blocks.Push(std::move(*block));
+    }
+    report.reader_closed = report.reader_closed || (!open_for_writing && report.samples < sample_count);
+  } catch (...) {
+    finish();
+    throw;
+  }
+  finish();
+  report.clipped_at = clipped_at;
+  report.elapsed = Clock::now() - start;
+  return report;
+}
+
+} // namespace stream
+} // namespace player
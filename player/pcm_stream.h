@@ -0,0 +1,81 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * pcm_stream.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef PLAYER_PCM_STREAM_H_
+#define PLAYER_PCM_STREAM_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "include/common.h"
+#include "instrument/instrument_model.h"
+
+namespace player {
+namespace stream {
+
+struct StreamOptions {
+  std::string output = "-"; // "-" for stdout, otherwise a file or FIFO (opening a FIFO waits for its reader).
+  bool wav = true;          // A WAV header sized for the whole note first, otherwise raw s16le mono.
+  std::size_t block = 256;  // Samples per block.
+  std::size_t depth = 8;    // Blocks rendered ahead; writing starts once they are ready.
+  // Write block n no earlier than n block durations after the first, as a sound
+  // card would consume them. Otherwise the reader's pace is the only clock.
+  bool realtime = false;
+};
+
+struct StreamReport {
+  std::size_t block = 0;
+  std::size_t depth = 0;
+  std::size_t blocks = 0;  // Written.
+  uint64_t samples = 0;    // Written.
+  // First sample beyond full scale. As in player -f it and the rest of the note are silent.
+  std::optional<uint64_t> clipped_at;
+  bool realtime = false;
+  // Blocks the writer wanted before they were rendered, and the time it waited for them. Under
+  // realtime each one is an underrun a sound card would have played as a gap; otherwise the
+  // reader is simply faster than the renderer.
+  std::size_t waits = 0;
+  std::chrono::nanoseconds wait_time{0};
+  bool reader_closed = false; // The reader went away before the end.
+  std::size_t strings = 0;
+  std::chrono::nanoseconds elapsed{0};
+  std::chrono::nanoseconds first_block{0}; // Start to the first block written.
+  // Per block, in milliseconds: rendering it, and from the start of its render until it was written.
+  std::vector<double> render_ms;
+  std::vector<double> latency_ms;
+
+  void Print(std::ostream &out) const;
+};
+
+/*
+ * Streams one note a block at a time. A render thread keeps up to `depth`
+ * blocks ahead of the writer, converting as GenerateIntSignal does: from the
+ * first clipped sample on the note is silent, so the stream carries the same
+ * samples as the file player writes. Throws
+ * std::runtime_error when the output cannot be opened or written; a reader
+ * closing the pipe ends the stream early instead.
+ * @parameters instrument, velocity, note frequency, sample count, options
+ * @returns what was streamed and how promptly
+ */
+StreamReport StreamNote(instrument::InstrumentModel &instrument, double velocity, double frequency,
+                        std::size_t sample_count, const StreamOptions &options);
+
+} // namespace stream
+} // namespace player
+
+#endif // PLAYER_PCM_STREAM_H_
@@ -0,0 +1,525 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "player/render_server.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+
+#include "include/filewriter.h"
+#include "instrument/instrument_model.h"
+
+namespace player {
+namespace serve {
+
+namespace {
+
+// A request the server answers with an error status; the connection stays usable.
+class RequestError : public std::runtime_error {
+public:
+  RequestError(Status a_status, const std::string &message) : std::runtime_error(message), status(a_status) {}
+  Status status;
+};
+
+// False on end of input before the first byte; throws on a read error or a message cut short.
+bool ReadExact(int fd, void *data, std::size_t size) {
+  char *bytes = static_cast<char *>(data);
+  std::size_t done = 0;
+  while (done < size) {
+    const ssize_t count = read(fd, bytes + done, size - done);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      if (count == 0 && done == 0U) {
+        return false;
+      }
+      throw std::runtime_error("Render request cut short");
+    }
+    done += static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const ResponseHeader &header, std::span<const char> payload) {
+  iovec parts[2] = {{const_cast<ResponseHeader *>(&header), sizeof(header)}, {const_cast<char *>(payload.data()), payload.size()}};
+  std::size_t remaining = sizeof(header) + payload.size();
+  int first = 0;
+  while (remaining > 0U) {
+    const ssize_t count = writev(fd, parts + first, 2 - first);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    auto written = static_cast<std::size_t>(count);
+    remaining -= written;
+    while (first < 2 && written >= parts[first].iov_len) {
+      written -= parts[first].iov_len;
+      ++first;
+    }
+    if (first < 2) {
+      parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + written;
+      parts[first].iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// A POSIX shared memory object mapped for the length of one render.
+class SharedSamples {
+public:
+  SharedSamples(const std::string &name, std::size_t count) : size(count * sizeof(int16_t)) {
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+      throw RequestError(Status::output_error, "Unable to open shared memory " + name + ": " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      close(fd);
+      throw RequestError(Status::output_error, "Unable to size shared memory " + name);
+    }
+    address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+      throw RequestError(Status::output_error, "Unable to map shared memory " + name);
+    }
+  }
+  ~SharedSamples() { munmap(address, size); }
+  SharedSamples(const SharedSamples &) = delete;
+  SharedSamples &operator=(const SharedSamples &) = delete;
+
+  std::span<int16_t> Samples() { return {static_cast<int16_t *>(address), size / sizeof(int16_t)}; }
+
+private:
+  std::size_t size;
+  void *address = nullptr;
+};
+
+} // namespace
+
+// Replies are written whole under a lock, so concurrent workers never interleave frames.
+struct RenderServer::Connection {
+  explicit Connection(int fd) : out_fd(fd) {}
+
+  void Reply(const ResponseHeader &header, std::span<const char> payload) {
+    const std::lock_guard<std::mutex> lock(write_mutex);
+    if (!broken && !WriteAll(out_fd, header, payload)) {
+      broken = true; // The client went away; remaining renders finish and are dropped.
+    }
+  }
+  void Reply(const ResponseHeader &header, const std::string &text) { Reply(header, std::span<const char>(text.data(), text.size())); }
+
+  void Started() {
+    const std::lock_guard<std::mutex> lock(pending_mutex);
+    ++pending;
+  }
+  void Finished() {
+    const std::lock_guard<std::mutex> lock(pending_mutex);
+    if (--pending == 0U) {
+      idle.notify_all();
+    }
+  }
+  void WaitIdle() {
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    idle.wait(lock, [this] { return pending == 0U; });
+  }
+
+  int out_fd;
+  std::mutex write_mutex;
+  bool broken = false;
+  std::mutex pending_mutex;
+  std::condition_variable idle;
+  std::size_t pending = 0;
+};
+
+void RenderServer::Stats::Print(std::ostream &out) const {
+  out << "render server: " << connections << " connection(s), " << requests << " request(s), " << renders << " render(s), " << errors
+      << " error(s), instruments " << instrument_hits << " cached / " << instrument_loads << " loaded, " << std::fixed << std::setprecision(2)
+      << (renders == 0U ? 0.0 : std::chrono::duration<double, std::milli>(render_busy).count() / static_cast<double>(renders))
+      << " ms per render\n";
+  if (render_cache) {
+    render_cache->Print(out);
+  }
+}
+
+RenderServer::RenderServer(const Options &a_options) : options(a_options), jobs(std::max<std::size_t>(1U, a_options.threads) * 4) {
+  if (options.render_cache) {
+    render_cache.emplace(*options.render_cache);
+  }
+  options.threads = std::max<std::size_t>(1U, options.threads);
+  options.instrument_cache_entries = std::max<std::size_t>(1U, options.instrument_cache_entries);
+  for (std::size_t i = 0; i < options.threads; ++i) {
+    workers.emplace_back([this]() { Work(); });
+  }
+}
+
+RenderServer::~RenderServer() {
+  RequestShutdown();
+  jobs.Close();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+RenderServer::Stats RenderServer::GetStats() const {
+  Stats stats;
+  stats.connections = connections;
+  stats.requests = requests;
+  stats.renders = renders;
+  stats.errors = errors;
+  stats.instrument_hits = instrument_hits;
+  stats.instrument_loads = instrument_loads;
+  stats.render_busy = std::chrono::nanoseconds(render_ns.load());
+  if (render_cache) {
+    stats.render_cache = render_cache->GetStats();
+  }
+  return stats;
+}
+
+void RenderServer::RequestShutdown() {
+  stopping = true;
+  const std::lock_guard<std::mutex> lock(sockets_mutex);
+  if (listen_fd >= 0) {
+    shutdown(listen_fd, SHUT_RDWR); // Wakes accept().
+  }
+  for (const int fd : open_sockets) {
+    shutdown(fd, SHUT_RD); // Ends their reads; replies still go out.
+  }
+}
+
+bool RenderServer::Serve(int in_fd, int out_fd) {
+  ++connections;
+  const auto connection = std::make_shared<Connection>(out_fd);
+  bool shutdown_requested = false;
+  try {
+    while (!stopping) {
+      Job job;
+      job.connection = connection;
+      RequestHeader &request = job.request;
+      if (!ReadExact(in_fd, &request, sizeof(request))) {
+        break;
+      }
+      ResponseHeader response;
+      response.request_id = request.request_id;
+      const RequestHeader expected{};
+      if (std::memcmp(request.magic, expected.magic, sizeof(request.magic)) != 0 || request.version != k_protocol_version ||
+          static_cast<uint64_t>(request.instrument_size) + request.output_name_size > k_max_request_payload) {
+        response.status = static_cast<uint32_t>(Status::bad_request);
+        const std::string message = "Not a version " + std::to_string(k_protocol_version) + " render request; closing the connection";
+        response.payload_size = static_cast<uint32_t>(message.size());
+        connection->Reply(response, message);
+        ++errors;
+        break;
+      }
+      ++requests;
+      job.instrument.resize(request.instrument_size);
+      job.output_name.resize(request.output_name_size);
+      if (!ReadExact(in_fd, job.instrument.data(), job.instrument.size()) && !job.instrument.empty()) {
+        throw std::runtime_error("Render request cut short");
+      }
+      if (!ReadExact(in_fd, job.output_name.data(), job.output_name.size()) && !job.output_name.empty()) {
+        throw std::runtime_error("Render request cut short");
+      }
+
+      switch (static_cast<RequestKind>(request.kind)) {
+      case RequestKind::render:
+        connection->Started();
+        if (!jobs.Push(std::move(job))) {
+          connection->Finished();
+          response.status = static_cast<uint32_t>(Status::bad_request);
+          connection->Reply(response, std::span<const char>());
+        }
+        break;
+      case RequestKind::ping:
+        connection->Reply(response, std::span<const char>());
+        break;
+      case RequestKind::stats: {
+        std::ostringstream text;
+        GetStats().Print(text);
+        response.payload_size = static_cast<uint32_t>(text.str().size());
+        connection->Reply(response, text.str());
+        break;
+      }
+      case RequestKind::shutdown:
+        shutdown_requested = true;
+        break;
+      default: {
+        const std::string message = "Unknown request kind " + std::to_string(request.kind);
+        response.status = static_cast<uint32_t>(Status::bad_request);
+        response.payload_size = static_cast<uint32_t>(message.size());
+        connection->Reply(response, message);
+        ++errors;
+      }
+      }
+      if (shutdown_requested) {
+        // Answered once everything queued before it has been.
+        connection->WaitIdle();
+        connection->Reply(response, std::span<const char>());
+        break;
+      }
+    }
+  } catch (const std::exception &error) {
+    std::cerr << "render server: " << error.what() << std::endl;
+  }
+  connection->WaitIdle();
+  if (shutdown_requested) {
+    RequestShutdown();
+  }
+  return shutdown_requested;
+}
+
+void RenderServer::Listen(const std::string &socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + socket_path);
+  }
+  std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to create a Unix socket");
+  }
+  // Only a leftover socket is replaced; any other file at the path is the user's and stays.
+  struct stat existing {};
+  if (lstat(socket_path.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      close(fd);
+      throw std::runtime_error("Refusing to replace " + socket_path + ": it exists and is not a socket");
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0) {
+      close(fd);
+      throw std::runtime_error("Another server is already listening on " + socket_path);
+    }
+    unlink(socket_path.c_str());
+  }
+  if (bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, 64) != 0) {
+    close(fd);
+    throw std::runtime_error("Unable to listen on " + socket_path + ": " + std::strerror(errno));
+  }
+  {
+    const std::lock_guard<std::mutex> lock(sockets_mutex);
+    listen_fd = fd;
+  }
+  std::vector<std::thread> clients;
+  while (!stopping) {
+    const int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      break;
+    }
+    {
+      const std::lock_guard<std::mutex> lock(sockets_mutex);
+      if (stopping) {
+        close(client);
+        break;
+      }
+      open_sockets.push_back(client);
+    }
+    clients.emplace_back([this, client]() {
+      Serve(client, client);
+      const std::lock_guard<std::mutex> lock(sockets_mutex);
+      open_sockets.erase(std::remove(open_sockets.begin(), open_sockets.end(), client), open_sockets.end());
+      close(client);
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  {
+    const std::lock_guard<std::mutex> lock(sockets_mutex);
+    listen_fd = -1;
+  }
+  close(fd);
+  unlink(socket_path.c_str());
+}
+
+void RenderServer::Work() {
+  for (auto job = jobs.Pop(); job; job = jobs.Pop()) {
+    try {
+      Render(*job);
+    } catch (const std::exception &error) {
+      // Only reached when even the error reply failed; the connection must still be released.
+      std::cerr << "render server: " << error.what() << std::endl;
+    }
+    job->connection->Finished();
+  }
+}
+
+std::shared_ptr<const RenderServer::CachedInstrument> RenderServer::FindInstrument(const Job &job, bool &hit) {
+  const bool is_inline = (job.request.flags & k_request_instrument_inline) != 0U;
+  std::string key;
+  if (is_inline) {
+    key = "inline\n" + job.instrument;
+  } else {
+    struct stat file_stat {};
+    if (stat(job.instrument.c_str(), &file_stat) != 0) {
+      throw RequestError(Status::instrument_error, "Unable to read instrument " + job.instrument);
+    }
+    key = "path\n" + job.instrument + "\n" + std::to_string(file_stat.st_size) + "\n" + std::to_string(file_stat.st_mtim.tv_sec) + "." +
+          std::to_string(file_stat.st_mtim.tv_nsec);
+  }
+  {
+    const std::lock_guard<std::mutex> lock(instruments_mutex);
+    const auto found = instruments.find(key);
+    if (found != instruments.end()) {
+      recency.splice(recency.end(), recency, found->second.recency);
+      hit = true;
+      return found->second.instrument;
+    }
+  }
+
+  // Parsed outside the lock; two workers racing on one new instrument both parse it and the first insert wins.
+  auto loaded = std::make_shared<CachedInstrument>();
+  try {
+    auto model = is_inline ? instrument::InstrumentModel::Parse(job.instrument, "inline") : instrument::InstrumentModel::Load(job.instrument);
+    loaded->name = model.GetName();
+    loaded->records = model.ToRecords();
+  } catch (const std::exception &error) {
+    throw RequestError(Status::instrument_error, std::string("Unable to read instrument: ") + error.what());
+  }
+  ++instrument_loads;
+  hit = false;
+  const std::lock_guard<std::mutex> lock(instruments_mutex);
+  const auto [entry, inserted] = instruments.try_emplace(key);
+  if (inserted) {
+    entry->second.instrument = loaded;
+    entry->second.recency = recency.insert(recency.end(), key);
+    while (instruments.size() > options.instrument_cache_entries) {
+      instruments.erase(recency.front());
+      recency.pop_front();
+    }
+  }
+  return entry->second.instrument;
+}
+
+void RenderServer::Render(const Job &job) {
+  const auto start = std::chrono::steady_clock::now();
+  const RequestHeader &request = job.request;
+  ResponseHeader response;
+  response.request_id = request.request_id;
+  std::vector<int16_t> pcm;
+  const auto reply_error = [&](Status status, const std::string &message) {
+    response.status = static_cast<uint32_t>(status);
+    response.payload_size = static_cast<uint32_t>(message.size());
+    ++errors;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    response.render_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    job.connection->Reply(response, message);
+  };
+  try {
+    const auto output = static_cast<Output>(request.output);
+    if (request.sample_count == 0U || request.sample_count > options.max_sample_count) {
+      throw RequestError(Status::bad_request, "Sample count must be between 1 and " + std::to_string(options.max_sample_count));
+    }
+    if (!std::isfinite(request.note_frequency) || request.note_frequency <= 0.0 || !std::isfinite(request.velocity) || request.velocity < 0.0) {
+      throw RequestError(Status::bad_request, "Note frequency must be positive and velocity non-negative");
+    }
+    if (output != Output::inline_pcm && output != Output::shared_memory && output != Output::wave_file) {
+      throw RequestError(Status::bad_request, "Unknown output " + std::to_string(request.output));
+    }
+    if (output != Output::inline_pcm && job.output_name.empty()) {
+      throw RequestError(Status::bad_request, "Shared memory and wave file output need an output name");
+    }
+
+    bool instrument_hit = false;
+    const auto cached = FindInstrument(job, instrument_hit);
+    instrument::InstrumentModel model(cached->records, cached->name);
+
+    std::optional<SharedSamples> shared;
+    std::optional<filewriter::wave::MonoMappedWriter> wave;
+    std::span<int16_t> out;
+    try {
+      if (output == Output::inline_pcm) {
+        pcm.resize(request.sample_count);
+        out = pcm;
+      } else if (output == Output::shared_memory) {
+        out = shared.emplace(job.output_name, request.sample_count).Samples();
+      } else {
+        out = wave.emplace(job.output_name, request.sample_count).Samples();
+      }
+    } catch (const RequestError &) {
+      throw;
+    } catch (const std::exception &error) {
+      throw RequestError(Status::output_error, error.what());
+    }
+    if (output == Output::shared_memory) {
+      std::fill(out.begin(), out.end(), int16_t{0});
+    }
+
+    const bool stop_on_clip = (request.flags & k_request_render_past_clip) == 0U;
+    std::optional<instrument::RenderKey> key;
+    std::optional<std::vector<int16_t>> cached_audio;
+    if (render_cache) {
+      key = instrument::RenderKey::Make(model, request.note_frequency, request.velocity, request.sample_count, SAMPLE_RATE, stop_on_clip);
+      cached_audio = render_cache->LoadAudio(*key);
+    }
+    if (cached_audio) {
+      std::copy_n(cached_audio->begin(), std::min(cached_audio->size(), out.size()), out.begin());
+      response.flags |= k_response_render_cache_hit;
+    } else {
+      const auto render_start = std::chrono::steady_clock::now();
+      bool has_distorted = false;
+      model.GenerateIntSignal(request.velocity, request.note_frequency, out, has_distorted, stop_on_clip);
+      if (has_distorted) {
+        response.flags |= k_response_distorted;
+      }
+      if (render_cache) {
+        render_cache->StoreAudio(*key, out, std::chrono::steady_clock::now() - render_start);
+      }
+    }
+    if (wave) {
+      try {
+        wave->Close(request.sample_count);
+      } catch (const std::exception &error) {
+        throw RequestError(Status::output_error, error.what());
+      }
+    }
+    if (instrument_hit) {
+      response.flags |= k_response_instrument_cache_hit;
+      ++instrument_hits;
+    }
+    response.sample_count = request.sample_count;
+    ++renders;
+  } catch (const RequestError &error) {
+    reply_error(error.status, error.what());
+    return;
+  } catch (const std::exception &error) {
+    // Runs on a worker thread: anything escaping here would terminate the whole server for one request.
+    reply_error(Status::render_error, error.what());
+    return;
+  }
+  const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  render_ns += elapsed.count();
+  response.render_ns = static_cast<uint64_t>(elapsed.count());
+  response.payload_size = static_cast<uint32_t>(pcm.size() * sizeof(int16_t));
+  job.connection->Reply(response, std::span<const char>(reinterpret_cast<const char *>(pcm.data()), pcm.size() * sizeof(int16_t)));
+}
+
+} // namespace serve
+} // namespace player
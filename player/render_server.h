@@ -0,0 +1,198 @@
+/*
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * render_server.h
+ *  Created on: 19 Oct 2026
+ */
+#pragma once
+#ifndef PLAYER_RENDER_SERVER_H_
+#define PLAYER_RENDER_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "include/bounded_queue.h"
+#include "include/common.h"
+#include "include/structures.h"
+#include "instrument/render_cache.h"
+
+/** player --serve protocol (all integers little endian)
+    A client sends requests, each a RequestHeader followed by instrument_size
+    bytes of instrument (a path, or the .data / .slin contents with
+    k_request_instrument_inline) and output_name_size bytes of output name.
+    The server answers every request with a ResponseHeader followed by
+    payload_size bytes: int16 PCM for Output::inline_pcm, UTF-8 text for
+    errors and stats. Renders run on a worker pool, so responses may come back
+    out of order; request_id pairs them up. A header with a bad magic or
+    version ends the connection, since the stream cannot be resynchronised.
+    Output::shared_memory renders into the POSIX shared memory object named by
+    the output name (created or resized to sample_count int16 values), and
+    Output::wave_file into a mono 16-bit WAV at that path, as `player -f` does.
+*/
+namespace player {
+namespace serve {
+
+constexpr uint32_t k_protocol_version = 1;
+constexpr uint32_t k_max_request_payload = 64U << 20U;
+
+enum class RequestKind : uint32_t { render = 1, ping = 2, stats = 3, shutdown = 4 };
+enum class Output : uint32_t { inline_pcm = 0, shared_memory = 1, wave_file = 2 };
+// render_error covers any other failure while rendering one request (allocation,
+// render cache I/O); the server reports it and keeps serving.
+enum class Status : uint32_t { ok = 0, bad_request = 1, instrument_error = 2, output_error = 3, render_error = 4 };
+
+constexpr uint32_t k_request_instrument_inline = 1U; // Instrument bytes are file contents, not a path.
+constexpr uint32_t k_request_render_past_clip = 2U;  // Keep rendering after the signal clips (return_on_distort = false).
+
+constexpr uint32_t k_response_distorted = 1U;
+constexpr uint32_t k_response_render_cache_hit = 2U;
+constexpr uint32_t k_response_instrument_cache_hit = 4U;
+
+#pragma pack(push, 1)
+
+struct RequestHeader {
+  char magic[4] = {'S', 'L', 'R', 'Q'};
+  uint32_t version = k_protocol_version;
+  uint64_t request_id = 0;
+  uint32_t kind = static_cast<uint32_t>(RequestKind::render);
+  uint32_t output = static_cast<uint32_t>(Output::inline_pcm);
+  uint32_t flags = 0;
+  uint32_t sample_count = 5 * SAMPLE_RATE;
+  double note_frequency = 440.0;
+  double velocity = 1.0; // player -v / 100.
+  uint32_t instrument_size = 0;
+  uint32_t output_name_size = 0;
+};
+
+struct ResponseHeader {
+  char magic[4] = {'S', 'L', 'R', 'S'};
+  uint32_t status = static_cast<uint32_t>(Status::ok);
+  uint64_t request_id = 0;
+  uint32_t flags = 0;
+  uint32_t sample_count = 0; // Samples in the output; the render is zero padded after a clip, like player output.
+  uint32_t sample_rate = SAMPLE_RATE;
+  uint32_t payload_size = 0;
+  uint64_t render_ns = 0; // Instrument lookup plus render or cache load, excluding the reply.
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(RequestHeader) == 56, "Render request layout is part of the protocol");
+static_assert(sizeof(ResponseHeader) == 40, "Render response layout is part of the protocol");
+
+/*
+ * Renders notes for any number of connections on one worker pool. Parsed
+ * instruments are kept, least recently used first out, as string records: a
+ * path entry is reused while the file's size and modification time are
+ * unchanged, an inline entry while its bytes are. Each render builds a fresh
+ * InstrumentModel from the records, so workers never share oscillator state.
+ */
+class RenderServer {
+public:
+  struct Options {
+    std::size_t threads = 1;
+    std::size_t instrument_cache_entries = 256;
+    uint32_t max_sample_count = 600U * SAMPLE_RATE;
+    std::optional<instrument::RenderCache::Options> render_cache;
+  };
+
+  struct Stats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t renders = 0;
+    uint64_t errors = 0;
+    uint64_t instrument_hits = 0;
+    uint64_t instrument_loads = 0;
+    std::chrono::nanoseconds render_busy{0}; // Summed over workers.
+    std::optional<instrument::RenderCache::Stats> render_cache;
+
+    void Print(std::ostream &out) const;
+  };
+
+  // Starts the workers; throws std::runtime_error when the render cache cannot be opened.
+  explicit RenderServer(const Options &a_options);
+  ~RenderServer();
+  RenderServer(const RenderServer &) = delete;
+  RenderServer &operator=(const RenderServer &) = delete;
+
+  /*
+   * Reads requests from in_fd and answers on out_fd until end of input, a
+   * protocol error or a shutdown request, then waits for the connection's
+   * renders to be answered. Several connections may be served at once.
+   * @parameters input and output descriptors (the same socket, or stdin and stdout)
+   * @returns true when the client asked the server to shut down
+   */
+  bool Serve(int in_fd, int out_fd);
+
+  // Accepts connections on a Unix domain socket, each on its own thread, until a client sends shutdown.
+  // A stale socket at the path is replaced; any other file, or a socket a live server still listens on, throws.
+  void Listen(const std::string &socket_path);
+
+  Stats GetStats() const;
+
+private:
+  struct Connection;
+  struct Job {
+    std::shared_ptr<Connection> connection;
+    RequestHeader request;
+    std::string instrument;
+    std::string output_name;
+  };
+  struct CachedInstrument {
+    std::string name;
+    std::vector<InstrumentStringRecord> records;
+  };
+  struct CacheEntry {
+    std::shared_ptr<const CachedInstrument> instrument;
+    std::list<std::string>::iterator recency;
+  };
+
+  Options options;
+  std::optional<instrument::RenderCache> render_cache;
+
+  BoundedQueue<Job> jobs;
+  std::vector<std::thread> workers;
+
+  mutable std::mutex instruments_mutex;
+  std::unordered_map<std::string, CacheEntry> instruments; // By cache key.
+  std::list<std::string> recency;                          // Least recently used first.
+
+  std::atomic<bool> stopping{false};
+  std::mutex sockets_mutex;
+  int listen_fd = -1;
+  std::vector<int> open_sockets; // Accepted connections, shut down for reading when the server stops.
+  std::atomic<uint64_t> connections{0};
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> renders{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> instrument_hits{0};
+  std::atomic<uint64_t> instrument_loads{0};
+  std::atomic<int64_t> render_ns{0};
+
+  void Work();
+  void Render(const Job &job);
+  std::shared_ptr<const CachedInstrument> FindInstrument(const Job &job, bool &hit);
+  void RequestShutdown();
+};
+
+} // namespace serve
+} // namespace player
+
+#endif // PLAYER_RENDER_SERVER_H_
@@ -26,11 +26,13 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--max-frequency-factor", type=float, default=1.0)
     parser.add_argument("--coupled-frequency-factors", default="")
     parser.add_argument("--require-fundamental", action="store_true")
+    parser.add_argument("--seed", type=int, default=None, help="Run seed; shards become reproducible index ranges of one dataset.")
     parser.add_argument("--freq-bins", type=int, required=True)
     parser.add_argument("--time-frames", type=int, required=True)
     parser.add_argument("--fft-size-multiplier", type=int, default=4)
     parser.add_argument("--workers", type=int, default=max(1, min(8, os.cpu_count() or 1)))
     parser.add_argument("--python-exe", type=Path, default=Path(sys.executable))
+    parser.add_argument("--render-cache", default="", help="WSL path of a render cache directory shared by every shard process.")
     parser.add_argument(
         "--builder",
         default="/mnt/c/Users/Brandon/Documents/wip/SoundLearner/build/dataset_builder/dataset_builder",
@@ -81,7 +83,7 @@ def clean_output_root(output_root: Path) -> None:
     output_root.mkdir(parents=True, exist_ok=True)
 
 
-def run_shard(shard_dir: Path, sample_count: int, args: argparse.Namespace, shard_index: int) -> None:
+def run_shard(shard_dir: Path, sample_count: int, start_index: int, args: argparse.Namespace, shard_index: int) -> None:
     shard_dir.mkdir(parents=True, exist_ok=True)
     command = (
         f"cd {to_wsl_path(shard_dir)} && "
@@ -101,6 +103,10 @@ def run_shard(shard_dir: Path, sample_count: int, args: argparse.Namespace, shar
       command += " --require-fundamental"
     if args.coupled_frequency_factors:
       command += f" --coupled-frequency-factors {args.coupled_frequency_factors}"
+    if args.seed is not None:
+      command += f" --seed {args.seed} -p {start_index}"
+    if args.render_cache:
+      command += f" --render-cache {args.render_cache}"
     result = subprocess.run(["wsl", "bash", "-lc", command], text=True, capture_output=True)
     if result.returncode != 0:
       raise RuntimeError(
@@ -164,9 +170,11 @@ def main() -> None:
 
     with ThreadPoolExecutor(max_workers=len(counts)) as executor:
       futures = []
+      start_index = 0
       for shard_index, count in enumerate(counts):
         shard_dir = shard_root / f"shard_{shard_index:02d}"
-        futures.append(executor.submit(run_shard, shard_dir, count, args, shard_index))
+        futures.append(executor.submit(run_shard, shard_dir, count, start_index, args, shard_index))
+        start_index += count
       for future in as_completed(futures):
         future.result()
 
@@ -0,0 +1,44 @@
+from __future__ import annotations
+
+import argparse
+from pathlib import Path
+import subprocess
+import sys
+import tempfile
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Check that an --only-indices rerun into a shard directory unpacks to one, newest, file per index.")
+    parser.add_argument("--dataset-builder", type=Path, default=Path("build/dataset_builder/dataset_builder"))
+    parser.add_argument("--shard-unpack", type=Path, default=Path("build/dataset/shard_unpack"))
+    return parser.parse_args()
+
+
+def run(*command: object, cwd: Path) -> None:
+    subprocess.run([str(part) for part in command], cwd=cwd, check=True, stdout=subprocess.DEVNULL)
+
+
+def main() -> int:
+    args = parse_args()
+    builder = args.dataset_builder.resolve()
+    unpack = args.shard_unpack.resolve()
+    with tempfile.TemporaryDirectory() as temp:
+      root = Path(temp)
+      common = ("-n", "6", "-t", "1", "--shard-output", "shards", "--shard-size", "2", "--min-note-frequency", "55", "--max-note-frequency", "440")
+      run(builder, *common, "--seed", "1", cwd=root)
+      # A different seed makes the rerun's copies distinguishable from the originals.
+      run(builder, *common, "--seed", "2", "--only-indices", "2-3", cwd=root)
+      shards = sorted((root / "shards").glob("shard_*.sls"))
+      run(unpack, "shards", "-o", "all", cwd=root)
+      run(unpack, shards[-1], "-o", "rerun", cwd=root)
+
+      wavs = sorted(path.name for path in (root / "all").glob("*.wav"))
+      expected = sorted(f"data{index}.wav" for index in range(6))
+      newest = all((root / "all" / name).read_bytes() == (root / "rerun" / name).read_bytes() for name in ("data2.wav", "data3.wav"))
+      ok = wavs == expected and newest
+      print(f"shards={len(shards)}, unpacked={len(wavs)}, rerun copies win={'yes' if newest else 'no'}, ok={'yes' if ok else 'no'}")
+      return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())